@@ -0,0 +1,439 @@
+#include "gbemu.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <span>
+#include <stop_token>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include "cartridge.hpp"
+#include "cpu.hpp"
+#include "instance.hpp"
+#include "instance_pool.hpp"
+#include "lockstep.hpp"
+#include "memory.hpp"
+#ifdef GB_LANES
+#include "lanes.hpp"
+#endif
+#include "ppu.hpp"
+#include "state.hpp"
+
+static_assert(GBEMU_SCREEN_WIDTH == gb::screen_width && GBEMU_SCREEN_HEIGHT == gb::screen_height);
+static_assert(GBEMU_START == static_cast<int>(gb::button::start) && GBEMU_RIGHT == static_cast<int>(gb::button::right));
+
+// min_rom_size covers the cartridge header, which picking a model and creating instances read (see
+// cartridge::loaded), so anything shorter is refused up front
+constexpr size_t min_rom_size = 0x150;
+
+struct gbemu_rom
+{
+    explicit gbemu_rom(std::vector<uint8_t>&& data) noexcept
+        : cart{std::move(data)}
+        , pool{cart}
+    {
+    }
+
+    gb::cartridge             cart;
+    mutable gb::instance_pool pool; // every instance running cart, created by any thread through a const rom
+};
+
+// An instance handle is the gb::instance itself, so each is the one block (see instance.hpp).
+static gb::cpu& machine(gbemu_instance* instance) noexcept
+{
+    return reinterpret_cast<gb::instance*>(instance)->machine();
+}
+
+static const gb::cpu& machine(const gbemu_instance* instance) noexcept
+{
+    return reinterpret_cast<const gb::instance*>(instance)->machine();
+}
+
+static gb::model pick_model(const gb::cartridge& cart, uint32_t flags) noexcept
+{
+    const bool color_game = cart.color_flag() != gb::cartridge::color_support::monochrome_supported;
+    return color_game && (flags & GBEMU_DMG) == 0 ? gb::model::color : gb::model::original;
+}
+
+// run runs whole frames, so each call leaves the instance between two
+static void run(gbemu_instance* instance, const uint8_t* buttons, uint32_t frames) noexcept
+{
+    auto& cpu = machine(instance);
+    if (buttons != nullptr) cpu.bus().input().set(*buttons);
+    for (uint32_t i = 0; i < frames; ++i) cpu.run_frame();
+}
+
+// A batch is handed out an instance at a time to whichever thread is free, so instances that take longer (a busier
+// scene, a different point in the game) don't hold up the rest.
+struct gbemu_runner
+{
+    explicit gbemu_runner(uint32_t threads)
+    {
+        // the thread waiting for a batch runs it too
+        workers.reserve(threads - 1);
+        for (uint32_t i = 1; i < threads; ++i)
+        {
+            workers.emplace_back([this](const std::stop_token& stop) { work(stop); });
+        }
+    }
+
+    gbemu_runner(const gbemu_runner&)            = delete;
+    gbemu_runner& operator=(const gbemu_runner&) = delete;
+
+    // the workers stop as they are destroyed
+    ~gbemu_runner() { wait(); }
+
+    bool submit(gbemu_instance* const* batch_instances, size_t batch_count, const uint8_t* batch_buttons, uint32_t n)
+    {
+        {
+            std::lock_guard guard{lock};
+            if (busy) return false;
+
+            busy      = true;
+            instances = batch_instances;
+            buttons   = batch_buttons;
+            count     = batch_count;
+            frames    = n;
+            next.store(0, std::memory_order_relaxed);
+            working = workers.size();
+            ++generation;
+        }
+        wake.notify_all();
+        return true;
+    }
+
+    void wait()
+    {
+        if (!busy) return;
+
+        claim_all();
+
+        std::unique_lock guard{lock};
+        done.wait(guard, [this] { return working == 0; });
+        busy = false;
+    }
+
+    // claim_all runs instances from the batch until there are none left to claim
+    void claim_all() noexcept
+    {
+        for (size_t i = next.fetch_add(1, std::memory_order_relaxed); i < count;
+             i = next.fetch_add(1, std::memory_order_relaxed))
+        {
+            run(instances[i], buttons != nullptr ? &buttons[i] : nullptr, frames);
+        }
+    }
+
+    void work(const std::stop_token& stop)
+    {
+        uint64_t seen = 0;
+        for (;;)
+        {
+            {
+                std::unique_lock guard{lock};
+                wake.wait(guard, stop, [&] { return generation != seen; });
+                if (stop.stop_requested()) return;
+                seen = generation;
+            }
+
+            claim_all();
+
+            std::lock_guard guard{lock};
+            if (--working == 0) done.notify_one();
+        }
+    }
+
+    std::mutex                  lock;
+    std::condition_variable_any wake;
+    std::condition_variable     done;
+    uint64_t                    generation = 0;
+    size_t                      working    = 0; // workers yet to finish the batch
+    bool                        busy       = false;
+
+    // the batch, only changed while no worker is working on it
+    gbemu_instance* const* instances = nullptr;
+    const uint8_t*         buttons   = nullptr;
+    size_t                 count     = 0;
+    uint32_t               frames    = 0;
+    std::atomic<size_t>    next{0}; // the next instance to claim
+
+    std::vector<std::jthread> workers;
+};
+
+// A link runs its two instances on a lockstep of their own, which keeps the cable plugged in from one run to the next.
+struct gbemu_link
+{
+    explicit gbemu_link(uint32_t quantum) noexcept
+        : ends{quantum}
+    {
+    }
+
+    gb::lockstep ends;
+};
+
+static int to_errno(const std::error_code& err) noexcept { return err ? -err.value() : 0; }
+
+extern "C" {
+
+int gbemu_rom_load(const void* data, size_t size, gbemu_rom** out)
+{
+    if (data == nullptr || out == nullptr || size < min_rom_size) return -EINVAL;
+
+    try
+    {
+        const auto* bytes = static_cast<const uint8_t*>(data);
+        *out              = new gbemu_rom{std::vector<uint8_t>(bytes, bytes + size)};
+        return 0;
+    }
+    catch (const std::bad_alloc&)
+    {
+        return -ENOMEM;
+    }
+}
+
+int gbemu_rom_open(const char* path, gbemu_rom** out)
+{
+    if (path == nullptr || out == nullptr) return -EINVAL;
+
+    std::unique_ptr<std::FILE, decltype(&std::fclose)> file{std::fopen(path, "rb"), &std::fclose};
+    if (file == nullptr) return -errno;
+
+    try
+    {
+        std::vector<uint8_t>        data;
+        std::array<uint8_t, 0x4000> buf{};
+        for (size_t n = 0; (n = std::fread(buf.data(), 1, buf.size(), file.get())) != 0;)
+        {
+            data.insert(data.end(), buf.begin(), buf.begin() + static_cast<ptrdiff_t>(n));
+        }
+        if (std::ferror(file.get()) != 0) return -EIO;
+        if (data.size() < min_rom_size) return -EINVAL;
+
+        *out = new gbemu_rom{std::move(data)};
+        return 0;
+    }
+    catch (const std::bad_alloc&)
+    {
+        return -ENOMEM;
+    }
+}
+
+void gbemu_rom_free(gbemu_rom* rom) { delete rom; }
+
+int gbemu_create(const gbemu_rom* rom, uint32_t flags, gbemu_instance** out)
+{
+    if (rom == nullptr || out == nullptr) return -EINVAL;
+
+    try
+    {
+        const auto boot     = (flags & GBEMU_BOOT_ROM) != 0 ? gb::boot_mode::full : gb::boot_mode::fast;
+        const bool accurate = (flags & GBEMU_ACCURATE) != 0;
+
+        auto instance = rom->pool.acquire(pick_model(rom->cart, flags), boot);
+        instance->machine().bus().set_accurate(accurate);
+        instance->machine().set_idle_skipping(!accurate);
+        *out = reinterpret_cast<gbemu_instance*>(instance.release());
+        return 0;
+    }
+    catch (const std::bad_alloc&)
+    {
+        return -ENOMEM;
+    }
+}
+
+void gbemu_destroy(gbemu_instance* instance)
+{
+    if (instance != nullptr) gb::instance_deleter{}(reinterpret_cast<gb::instance*>(instance));
+}
+
+int gbemu_fork(gbemu_instance* instance, gbemu_instance** out)
+{
+    if (instance == nullptr || out == nullptr) return -EINVAL;
+
+    try
+    {
+        *out = reinterpret_cast<gbemu_instance*>(reinterpret_cast<gb::instance*>(instance)->fork().release());
+        return 0;
+    }
+    catch (const std::bad_alloc&)
+    {
+        return -ENOMEM;
+    }
+}
+
+size_t gbemu_instance_size(const gbemu_rom* rom) { return rom != nullptr ? gb::instance::bytes(rom->cart) : 0; }
+
+int gbemu_runner_create(uint32_t threads, gbemu_runner** out)
+{
+    if (out == nullptr) return -EINVAL;
+    if (threads == 0) threads = std::max(1U, std::thread::hardware_concurrency());
+
+    try
+    {
+        *out = new gbemu_runner{threads};
+        return 0;
+    }
+    catch (const std::bad_alloc&)
+    {
+        return -ENOMEM;
+    }
+    catch (const std::system_error& err)
+    {
+        return to_errno(err.code());
+    }
+}
+
+void gbemu_runner_destroy(gbemu_runner* runner) { delete runner; }
+
+int gbemu_run(gbemu_runner*          runner,
+              gbemu_instance* const* instances,
+              size_t                 count,
+              const uint8_t*         buttons,
+              uint32_t               frames)
+{
+    if (runner != nullptr)
+    {
+        if (const int err = gbemu_submit(runner, instances, count, buttons, frames); err != 0) return err;
+        return gbemu_wait(runner);
+    }
+
+    if (instances == nullptr && count != 0) return -EINVAL;
+
+#ifdef GB_LANES
+    // all of them at once, in lockstep (see lanes.hpp)
+    try
+    {
+        gb::lanes batch;
+        for (size_t i = 0; i < count; ++i)
+        {
+            auto& cpu = machine(instances[i]);
+            if (buttons != nullptr) cpu.bus().input().set(buttons[i]);
+            batch.add(cpu);
+        }
+        for (uint32_t i = 0; i < frames; ++i) batch.run_frame();
+        return 0;
+    }
+    catch (const std::bad_alloc&)
+    {
+        return -ENOMEM;
+    }
+#else
+    for (size_t i = 0; i < count; ++i)
+    {
+        run(instances[i], buttons != nullptr ? &buttons[i] : nullptr, frames);
+    }
+    return 0;
+#endif
+}
+
+int gbemu_submit(gbemu_runner*          runner,
+                 gbemu_instance* const* instances,
+                 size_t                 count,
+                 const uint8_t*         buttons,
+                 uint32_t               frames)
+{
+    if (runner == nullptr || (instances == nullptr && count != 0)) return -EINVAL;
+    return runner->submit(instances, count, buttons, frames) ? 0 : -EBUSY;
+}
+
+int gbemu_wait(gbemu_runner* runner)
+{
+    if (runner == nullptr) return -EINVAL;
+
+    runner->wait();
+    return 0;
+}
+
+int gbemu_link_create(gbemu_instance* a, gbemu_instance* b, uint32_t quantum, gbemu_link** out)
+{
+    if (a == nullptr || b == nullptr || a == b || out == nullptr) return -EINVAL;
+
+    try
+    {
+        auto link = std::make_unique<gbemu_link>(quantum != 0 ? quantum : gb::serial::default_quantum);
+        link->ends.add(machine(a));
+        link->ends.add(machine(b));
+        link->ends.link(0, 1);
+        *out = link.release();
+        return 0;
+    }
+    catch (const std::bad_alloc&)
+    {
+        return -ENOMEM;
+    }
+}
+
+void gbemu_link_destroy(gbemu_link* link) { delete link; }
+
+int gbemu_link_run(gbemu_link* link, uint64_t cycles)
+{
+    if (link == nullptr || cycles == 0) return -EINVAL;
+
+    try
+    {
+        link->ends.run(cycles);
+        return 0;
+    }
+    catch (const std::system_error& err)
+    {
+        return to_errno(err.code());
+    }
+}
+
+uint64_t gbemu_frame_count(const gbemu_instance* instance) { return machine(instance).bus().display().frame_count(); }
+
+void gbemu_frames(gbemu_instance* const* instances, size_t count, const uint16_t** out)
+{
+    for (size_t i = 0; i < count; ++i) out[i] = machine(instances[i]).bus().display().front().data();
+}
+
+int gbemu_read_memory(gbemu_instance* const* instances, size_t count, uint16_t addr, size_t len, uint8_t* out)
+{
+    if (len > size_t{0x10000} - addr) return -EINVAL;
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        auto& mem = machine(instances[i]).bus();
+        for (size_t j = 0; j < len; ++j) *out++ = mem.peek(static_cast<uint16_t>(addr + j));
+    }
+    return 0;
+}
+
+int gbemu_write_memory(gbemu_instance* instance, uint16_t addr, const uint8_t* data, size_t len)
+{
+    if (len > size_t{0x10000} - addr) return -EINVAL;
+
+    auto& mem = machine(instance).bus();
+    for (size_t j = 0; j < len; ++j) mem.poke(static_cast<uint16_t>(addr + j), data[j]);
+    return 0;
+}
+
+size_t gbemu_state_size(const gbemu_instance* instance) { return gb::state_size(machine(instance)); }
+
+int gbemu_save_states(gbemu_instance* const* instances, size_t count, void* out, size_t stride)
+{
+    auto* at = static_cast<uint8_t*>(out);
+    for (size_t i = 0; i < count; ++i, at += stride)
+    {
+        if (const auto err = gb::save_state(machine(instances[i]), {at, stride}); err) return to_errno(err);
+    }
+    return 0;
+}
+
+int gbemu_load_states(gbemu_instance* const* instances, size_t count, const void* in, size_t stride, size_t size)
+{
+    const auto* at = static_cast<const uint8_t*>(in);
+    for (size_t i = 0; i < count; ++i, at += stride)
+    {
+        if (const auto err = gb::load_state(machine(instances[i]), {at, size}); err) return to_errno(err);
+    }
+    return 0;
+}
+}
@@ -0,0 +1,163 @@
+/*
+ * gbemu.h is the C API to the emulator core, for scripts, bots and bindings (see gbemu.py for Python's).
+ *
+ * It is built around batches: the calls that do real work take an array of instances, so driving thousands of them
+ * costs one call per step rather than one per instance, and results land in one contiguous buffer the caller owns.
+ *
+ * Functions returning int return 0 on success and a negated errno value on failure. Only gbemu_run, gbemu_wait and
+ * gbemu_runner_destroy wait for anything, and nothing may be called on an instance while a batch including it runs.
+ */
+#ifndef GBEMU_H
+#define GBEMU_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+#if defined(GBEMU_BUILDING)
+#define GBEMU_API __declspec(dllexport)
+#else
+#define GBEMU_API __declspec(dllimport)
+#endif
+#else
+#define GBEMU_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define GBEMU_SCREEN_WIDTH  160
+#define GBEMU_SCREEN_HEIGHT 144
+
+/* buttons, combined into a mask of those held down */
+enum
+{
+    GBEMU_RIGHT  = 1 << 0,
+    GBEMU_LEFT   = 1 << 1,
+    GBEMU_UP     = 1 << 2,
+    GBEMU_DOWN   = 1 << 3,
+    GBEMU_A      = 1 << 4,
+    GBEMU_B      = 1 << 5,
+    GBEMU_SELECT = 1 << 6,
+    GBEMU_START  = 1 << 7,
+};
+
+/* flags for gbemu_create */
+enum
+{
+    GBEMU_DMG      = 1 << 0, /* emulate the original Game Boy, even for color games */
+    GBEMU_BOOT_ROM = 1 << 1, /* run the boot ROM instead of starting at the cartridge entry point */
+    GBEMU_ACCURATE = 1 << 2, /* exact DMA timing, and no fast-forwarding of busy-wait loops */
+};
+
+/* gbemu_rom is a loaded cartridge, shared read-only by every instance running it */
+typedef struct gbemu_rom gbemu_rom;
+
+/* gbemu_instance is one emulated Game Boy */
+typedef struct gbemu_instance gbemu_instance;
+
+/* gbemu_runner is a pool of threads that runs batches of instances */
+typedef struct gbemu_runner gbemu_runner;
+
+/* gbemu_link is a link cable between two instances, which run together while it is plugged in */
+typedef struct gbemu_link gbemu_link;
+
+/* gbemu_rom_load copies size bytes of ROM from data, gbemu_rom_open reads it from the file at path. Either fails with
+ * EINVAL if the ROM is too short to hold a cartridge header. */
+GBEMU_API int  gbemu_rom_load(const void* data, size_t size, gbemu_rom** out);
+GBEMU_API int  gbemu_rom_open(const char* path, gbemu_rom** out);
+GBEMU_API void gbemu_rom_free(gbemu_rom* rom); /* once every instance running it is destroyed */
+
+/* gbemu_create powers on a new instance running rom, with a combination of GBEMU_DMG, GBEMU_BOOT_ROM and
+ * GBEMU_ACCURATE. Cartridge RAM starts out empty, and isn't saved anywhere but in states.
+ *
+ * Instances are carved from memory rom keeps until it is freed, and reuse that of destroyed instances, so creating and
+ * destroying them only allocates when more are running than ever before. Any thread may do either at any time. */
+GBEMU_API int  gbemu_create(const gbemu_rom* rom, uint32_t flags, gbemu_instance** out);
+GBEMU_API void gbemu_destroy(gbemu_instance* instance);
+
+/* gbemu_fork creates a new instance exactly where instance is, to branch a search from: it shares instance's RAM until
+ * either writes to it, a page at a time, so costs a few microseconds rather than a state's copy. Neither may be running
+ * meanwhile. The fork is destroyed like any other instance, in any order. */
+GBEMU_API int gbemu_fork(gbemu_instance* instance, gbemu_instance** out);
+
+/* gbemu_instance_size is the memory each instance running rom takes, in a single block: all of its state, with the ROM
+ * itself shared between them. It is 0 if rom is NULL. */
+GBEMU_API size_t gbemu_instance_size(const gbemu_rom* rom);
+
+/* gbemu_runner_create starts a runner that runs batches on threads threads, counting the one waiting for the batch;
+ * 0 is one per core. */
+GBEMU_API int  gbemu_runner_create(uint32_t threads, gbemu_runner** out);
+GBEMU_API void gbemu_runner_destroy(gbemu_runner* runner); /* waits for a batch still running */
+
+/* gbemu_run runs each of count instances for frames frames, spread over runner's threads (or on the calling thread if
+ * runner is NULL), and returns once they're all done. If buttons isn't NULL, each instance first has its buttons set
+ * to its entry, and holds them throughout. Built with GBEMU_LANES, a batch on the calling thread runs in lockstep on
+ * the experimental lanes core instead, with the same results. */
+GBEMU_API int gbemu_run(gbemu_runner*          runner,
+                        gbemu_instance* const* instances,
+                        size_t                 count,
+                        const uint8_t*         buttons,
+                        uint32_t               frames);
+
+/* gbemu_submit starts the same as gbemu_run without waiting for it, failing with EBUSY if the runner is already
+ * running a batch, and gbemu_wait waits for it (helping out meanwhile). Until then, instances and buttons must stay
+ * as they are. */
+GBEMU_API int gbemu_submit(gbemu_runner*          runner,
+                           gbemu_instance* const* instances,
+                           size_t                 count,
+                           const uint8_t*         buttons,
+                           uint32_t               frames);
+GBEMU_API int gbemu_wait(gbemu_runner* runner);
+
+/* gbemu_link_create plugs a link cable between instances a and b, which sync up through it every quantum cycles (0 for
+ * the default, about a millisecond). Until the link is destroyed, they may only run through gbemu_link_run: run on its
+ * own, either would wait forever for the other at the next sync point. */
+GBEMU_API int  gbemu_link_create(gbemu_instance* a, gbemu_instance* b, uint32_t quantum, gbemu_link** out);
+GBEMU_API void gbemu_link_destroy(gbemu_link* link); /* unplugs the cable */
+
+/* gbemu_link_run runs both ends of link for cycles clock cycles, each on its own thread, rounded up to a whole number
+ * of quanta so they end at the same sync point, and returns once both are done. */
+GBEMU_API int gbemu_link_run(gbemu_link* link, uint64_t cycles);
+
+/* gbemu_frame_count is the number of frames instance has completed since power on */
+GBEMU_API uint64_t gbemu_frame_count(const gbemu_instance* instance);
+
+/* gbemu_frames sets each of out[0 .. count) to the last frame completed by the instance, without copying it:
+ * GBEMU_SCREEN_WIDTH * GBEMU_SCREEN_HEIGHT pixels, row by row, each 15-bit BGR (red in bits 0-4). They stay valid
+ * until the instance runs again. */
+GBEMU_API void gbemu_frames(gbemu_instance* const* instances, size_t count, const uint16_t** out);
+
+/* gbemu_read_memory copies len bytes from addr in each instance's memory map to out, one after the other (so out
+ * holds count * len bytes). Reads have no side effects, on I/O registers or anything else. */
+GBEMU_API int gbemu_read_memory(gbemu_instance* const* instances,
+                                size_t                 count,
+                                uint16_t               addr,
+                                size_t                 len,
+                                uint8_t*               out);
+
+/* gbemu_write_memory writes len bytes from data to addr in instance's memory map */
+GBEMU_API int gbemu_write_memory(gbemu_instance* instance, uint16_t addr, const uint8_t* data, size_t len);
+
+/* gbemu_state_size is the size of instance's saved state, which is the same as long as it runs */
+GBEMU_API size_t gbemu_state_size(const gbemu_instance* instance);
+
+/* gbemu_save_states saves the state of each instance to out + i * stride, failing with ENOBUFS if stride is smaller
+ * than a state. */
+GBEMU_API int gbemu_save_states(gbemu_instance* const* instances, size_t count, void* out, size_t stride);
+
+/* gbemu_load_states loads the size byte state at in + i * stride into each instance; a stride of 0 loads the same
+ * state into all of them. A state only loads into an instance running the same ROM in the same mode, failing with
+ * EINVAL otherwise, and then every instance before it has been loaded and none after. */
+GBEMU_API int gbemu_load_states(gbemu_instance* const* instances,
+                                size_t                 count,
+                                const void*            in,
+                                size_t                 stride,
+                                size_t                 size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,287 @@
+"""Python bindings for the gbemu C API (gbemu.h), through ctypes, so they need nothing built beyond the gbemu-api
+library itself.
+
+A Batch drives many instances with one call per step::
+
+    rom = gbemu.Rom.open("game.gb")
+    batch = gbemu.Batch([gbemu.Instance(rom) for _ in range(256)], threads=0)
+    start = batch[0].save_state()
+    batch.load_states(start)            # every instance from the same point
+    batch.run(4, buttons=actions)       # one button mask per instance
+    ram = batch.read_memory(0xC000, 16) # 256 * 16 bytes, one instance after the other
+    frames = batch.frames()             # zero-copy views of each instance's screen
+
+Buffers are plain Python buffers (bytearray, memoryview), which numpy wraps without copying:
+numpy.frombuffer(frame, numpy.uint16).reshape(SCREEN_HEIGHT, SCREEN_WIDTH).
+
+The library is found through GBEMU_LIBRARY if set, and otherwise next to this file or on the usual search path.
+"""
+
+import ctypes
+import ctypes.util
+import os
+
+SCREEN_WIDTH = 160
+SCREEN_HEIGHT = 144
+
+RIGHT, LEFT, UP, DOWN, A, B, SELECT, START = (1 << i for i in range(8))
+
+DMG = 1 << 0
+BOOT_ROM = 1 << 1
+ACCURATE = 1 << 2
+
+
+def _load_library():
+    path = os.environ.get("GBEMU_LIBRARY")
+    if path is None:
+        here = os.path.dirname(os.path.abspath(__file__))
+        for name in ("libgbemu-api.so", "libgbemu-api.dylib", "gbemu-api.dll"):
+            if os.path.exists(os.path.join(here, name)):
+                path = os.path.join(here, name)
+                break
+    if path is None:
+        path = ctypes.util.find_library("gbemu-api")
+    if path is None:
+        raise OSError("gbemu-api library not found, set GBEMU_LIBRARY to its path")
+    return ctypes.CDLL(path)
+
+
+_lib = _load_library()
+
+_p = ctypes.c_void_p
+_pp = ctypes.POINTER(ctypes.c_void_p)
+_size = ctypes.c_size_t
+_u8p = ctypes.POINTER(ctypes.c_uint8)
+
+for _name, _restype, _argtypes in (
+    ("gbemu_rom_load", ctypes.c_int, (_p, _size, _pp)),
+    ("gbemu_rom_open", ctypes.c_int, (ctypes.c_char_p, _pp)),
+    ("gbemu_rom_free", None, (_p,)),
+    ("gbemu_create", ctypes.c_int, (_p, ctypes.c_uint32, _pp)),
+    ("gbemu_destroy", None, (_p,)),
+    ("gbemu_fork", ctypes.c_int, (_p, _pp)),
+    ("gbemu_instance_size", _size, (_p,)),
+    ("gbemu_runner_create", ctypes.c_int, (ctypes.c_uint32, _pp)),
+    ("gbemu_runner_destroy", None, (_p,)),
+    ("gbemu_run", ctypes.c_int, (_p, _pp, _size, _u8p, ctypes.c_uint32)),
+    ("gbemu_submit", ctypes.c_int, (_p, _pp, _size, _u8p, ctypes.c_uint32)),
+    ("gbemu_wait", ctypes.c_int, (_p,)),
+    ("gbemu_link_create", ctypes.c_int, (_p, _p, ctypes.c_uint32, _pp)),
+    ("gbemu_link_destroy", None, (_p,)),
+    ("gbemu_link_run", ctypes.c_int, (_p, ctypes.c_uint64)),
+    ("gbemu_frame_count", ctypes.c_uint64, (_p,)),
+    ("gbemu_frames", None, (_pp, _size, _pp)),
+    ("gbemu_read_memory", ctypes.c_int, (_pp, _size, ctypes.c_uint16, _size, _u8p)),
+    ("gbemu_write_memory", ctypes.c_int, (_p, ctypes.c_uint16, _u8p, _size)),
+    ("gbemu_state_size", _size, (_p,)),
+    ("gbemu_save_states", ctypes.c_int, (_pp, _size, _p, _size)),
+    ("gbemu_load_states", ctypes.c_int, (_pp, _size, _p, _size, _size)),
+):
+    _fn = getattr(_lib, _name)
+    _fn.restype = _restype
+    _fn.argtypes = _argtypes
+
+
+def _check(err):
+    if err != 0:
+        raise OSError(-err, os.strerror(-err))
+
+
+def _address(buf, size, writable=False):
+    """Points at the memory behind a Python buffer of at least size bytes, returning the address and what has to be
+    kept alive for as long as it is used. Writable buffers aren't copied."""
+    view = memoryview(buf).cast("B")
+    if view.nbytes < size:
+        raise ValueError(f"buffer of {view.nbytes} bytes, {size} needed")
+    if view.readonly:
+        if writable:
+            raise ValueError("buffer is read-only")
+        # ctypes won't point into immutable buffers such as bytes, so those are copied
+        copy = ctypes.create_string_buffer(view.tobytes(), view.nbytes)
+        return ctypes.addressof(copy), copy
+    return ctypes.addressof(ctypes.c_char.from_buffer(view)), view
+
+
+class Rom:
+    """A loaded cartridge, shared read-only by every instance running it."""
+
+    def __init__(self, data):
+        handle = _p()
+        _check(_lib.gbemu_rom_load(bytes(data), len(data), ctypes.byref(handle)))
+        self._handle = handle
+
+    @classmethod
+    def open(cls, path):
+        with open(path, "rb") as file:
+            return cls(file.read())
+
+    @property
+    def instance_size(self):
+        """The bytes each instance running the ROM takes, on top of the ROM itself."""
+        return _lib.gbemu_instance_size(self._handle)
+
+    def __del__(self):
+        if getattr(self, "_handle", None):
+            _lib.gbemu_rom_free(self._handle)
+            self._handle = None
+
+
+class Instance:
+    """One emulated Game Boy running rom."""
+
+    def __init__(self, rom, flags=0):
+        handle = _p()
+        _check(_lib.gbemu_create(rom._handle, flags, ctypes.byref(handle)))
+        self._handle = handle
+        self._rom = rom  # outlives the instance
+
+    def __del__(self):
+        if getattr(self, "_handle", None):
+            _lib.gbemu_destroy(self._handle)
+            self._handle = None
+
+    def fork(self):
+        """A new instance exactly where this one is, sharing its RAM until either writes to it."""
+        handle = _p()
+        _check(_lib.gbemu_fork(self._handle, ctypes.byref(handle)))
+        child = Instance.__new__(Instance)
+        child._handle = handle
+        child._rom = self._rom
+        return child
+
+    @property
+    def frame_count(self):
+        return _lib.gbemu_frame_count(self._handle)
+
+    def run(self, frames=1, buttons=None):
+        Batch([self]).run(frames, None if buttons is None else [buttons])
+
+    def frame(self):
+        return Batch([self]).frames()[0]
+
+    def read_memory(self, addr, length):
+        return Batch([self]).read_memory(addr, length)
+
+    def write_memory(self, addr, data):
+        data = bytes(data)
+        buf = (ctypes.c_uint8 * len(data)).from_buffer_copy(data)
+        _check(_lib.gbemu_write_memory(self._handle, addr, buf, len(data)))
+
+    @property
+    def state_size(self):
+        return _lib.gbemu_state_size(self._handle)
+
+    def save_state(self):
+        return Batch([self]).save_states()
+
+    def load_state(self, state):
+        Batch([self]).load_states(state)
+
+
+class Batch:
+    """Instances run, read and saved together, spread over a pool of threads (threads=0 for one per core, None to
+    run on the calling thread).
+
+    The instance array handed to the C API is built once, so each call costs the same however many instances there
+    are."""
+
+    def __init__(self, instances, threads=None):
+        self.instances = list(instances)
+        self._array = (_p * len(self.instances))(*(i._handle for i in self.instances))
+        self._runner = None
+        self._buttons = None
+        if threads is not None:
+            runner = _p()
+            _check(_lib.gbemu_runner_create(threads, ctypes.byref(runner)))
+            self._runner = runner
+
+    def __del__(self):
+        if getattr(self, "_runner", None):
+            _lib.gbemu_runner_destroy(self._runner)
+            self._runner = None
+
+    def __len__(self):
+        return len(self.instances)
+
+    def __getitem__(self, index):
+        return self.instances[index]
+
+    def _set_buttons(self, buttons):
+        if buttons is None:
+            return None
+        if len(buttons) != len(self.instances):
+            raise ValueError(f"{len(buttons)} button masks for {len(self.instances)} instances")
+        self._buttons = (ctypes.c_uint8 * len(buttons)).from_buffer_copy(bytes(buttons))
+        return self._buttons
+
+    def run(self, frames=1, buttons=None):
+        """Runs every instance for frames frames, first setting the buttons each holds if given one mask apiece."""
+        _check(_lib.gbemu_run(self._runner, self._array, len(self.instances), self._set_buttons(buttons), frames))
+
+    def submit(self, frames=1, buttons=None):
+        """Starts run without waiting for it, so the caller can get on with something else meanwhile. Nothing else may
+        be done with the batch until wait."""
+        if self._runner is None:
+            raise ValueError("submit needs a batch with threads")
+        _check(_lib.gbemu_submit(self._runner, self._array, len(self.instances), self._set_buttons(buttons), frames))
+
+    def wait(self):
+        _check(_lib.gbemu_wait(self._runner))
+
+    def frames(self):
+        """Each instance's last frame, as memoryviews of uint16 straight into the instances, valid until they run."""
+        pointers = (_p * len(self.instances))()
+        _lib.gbemu_frames(self._array, len(self.instances), pointers)
+        pixels = ctypes.c_uint16 * (SCREEN_WIDTH * SCREEN_HEIGHT)
+        return [memoryview(pixels.from_address(p)) for p in pointers]
+
+    def read_memory(self, addr, length, out=None):
+        """Reads length bytes from addr in each instance, into one buffer, instance after instance."""
+        size = length * len(self.instances)
+        if out is None:
+            out = bytearray(size)
+        address, keep = _address(out, size, writable=True)
+        _check(_lib.gbemu_read_memory(self._array, len(self.instances), addr, length, ctypes.cast(address, _u8p)))
+        return out
+
+    def save_states(self, out=None):
+        """Saves each instance's state into one buffer, instance after instance, each state_size bytes."""
+        stride = _lib.gbemu_state_size(self._array[0]) if self.instances else 0
+        size = stride * len(self.instances)
+        if out is None:
+            out = bytearray(size)
+        address, keep = _address(out, size, writable=True)
+        _check(_lib.gbemu_save_states(self._array, len(self.instances), address, stride))
+        return out
+
+    def load_states(self, states):
+        """Loads states saved by save_states, or a single state into every instance."""
+        if not self.instances:
+            return
+        stride = _lib.gbemu_state_size(self._array[0])
+        view = memoryview(states).cast("B")
+        if view.nbytes == stride:
+            address, keep = _address(view, stride)
+            _check(_lib.gbemu_load_states(self._array, len(self.instances), address, 0, stride))
+        else:
+            address, keep = _address(view, stride * len(self.instances))
+            _check(_lib.gbemu_load_states(self._array, len(self.instances), address, stride, stride))
+
+
+class Link:
+    """A link cable between instances a and b, which only run together, through run, while it is plugged in."""
+
+    def __init__(self, a, b, quantum=0):
+        handle = _p()
+        _check(_lib.gbemu_link_create(a._handle, b._handle, quantum, ctypes.byref(handle)))
+        self._handle = handle
+        self.ends = (a, b)  # outlive the link
+
+    def __del__(self):
+        if getattr(self, "_handle", None):
+            _lib.gbemu_link_destroy(self._handle)
+            self._handle = None
+
+    def run(self, cycles):
+        """Runs both ends for cycles clock cycles, rounded up to the end of a sync quantum."""
+        _check(_lib.gbemu_link_run(self._handle, cycles))
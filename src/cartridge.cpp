@@ -6,6 +6,9 @@
 #include <numeric>
 #include <string>
 
+#include "checksum.hpp"
+#include "hash.hpp"
+
 namespace gb
 {
 
@@ -68,9 +71,13 @@ std::string cartridge::title() const noexcept
 
 cartridge::color_support cartridge::color_flag() const noexcept
 {
+    // too short to have a header, e.g. a bare test program
+    if (!loaded()) return color_support::monochrome_supported;
+
     const auto flag = data[0x143];
 
     if (flag == 0xC0) return color_support::color_only;
+    if ((flag & 0x80) != 0) return color_support::color_supported;
     return color_support::monochrome_supported;
 }
 
@@ -195,17 +202,20 @@ bool cartridge::header_checksum_valid(uint8_t* actual) const noexcept
 
 bool cartridge::global_checksum_valid(uint16_t* actual) const noexcept
 {
-    uint16_t sum = 0;
-    for (uint8_t v : data)
-    {
-        sum += v;
-    }
-
-    sum -= data[0x014E] + data[0x014F];
+    const uint16_t sum = global_checksum(data);
     if (actual != nullptr) *actual = sum;
 
     const uint16_t expect = (static_cast<uint16_t>(data[0x014E]) << 8) | data[0x014F];
     return sum == expect;
 }
 
+uint16_t cartridge::global_checksum(std::span<const uint8_t> rom) noexcept
+{
+    if (rom.size() < 0x150) return checksum::sum16(rom);
+
+    return checksum::sum16(rom) - rom[0x014E] - rom[0x014F];
+}
+
+uint64_t cartridge::content_hash() const noexcept { return hash::hash64(data); }
+
 }
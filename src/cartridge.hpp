@@ -3,6 +3,7 @@
 #include <array>
 #include <cstddef>
 #include <cstdint>
+#include <span>
 #include <string>
 #include <vector>
 
@@ -14,6 +15,7 @@ struct cartridge
     enum class color_support
     {
         monochrome_supported,
+        color_supported, // works on both, with color enhancements on a CGB
         color_only,
     };
 
@@ -68,6 +70,12 @@ struct cartridge
     [[nodiscard]] bool          header_checksum_valid(uint8_t* actual) const noexcept;
     [[nodiscard]] bool          global_checksum_valid(uint16_t* actual) const noexcept;
 
+    // global_checksum computes the header's global checksum of rom: the sum of every byte except the checksum itself
+    [[nodiscard]] static uint16_t global_checksum(std::span<const uint8_t> rom) noexcept;
+
+    // content_hash identifies the ROM by its contents (hash::hash64 of data), e.g. to match saves or recordings to it
+    [[nodiscard]] uint64_t content_hash() const noexcept;
+
     std::vector<uint8_t> data;
 };
 
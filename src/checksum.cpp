@@ -0,0 +1,139 @@
+#include "checksum.hpp"
+
+#include <array>
+
+#include "simd.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+#define GB_SIMD_X86 1
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define GB_SIMD_NEON 1
+#endif
+
+namespace gb::checksum
+{
+
+using sum16_fn = uint16_t (*)(const uint8_t*, size_t) noexcept;
+
+constexpr size_t lanes = 32;
+
+static uint16_t sum16_scalar(const uint8_t* p, size_t len) noexcept
+{
+    // summed across independent 16-bit lanes, written as a plain loop over the lanes so the compiler can keep acc in
+    // vector registers; since only the low 16 bits matter, the lanes are free to wrap
+    std::array<uint16_t, lanes> acc{};
+
+    size_t i = 0;
+    for (; i + lanes <= len; i += lanes)
+    {
+        for (size_t j = 0; j < lanes; ++j) acc[j] += p[i + j];
+    }
+
+    uint16_t sum = 0;
+    for (const uint16_t lane : acc) sum += lane;
+    for (; i < len; ++i) sum += p[i];
+
+    return sum;
+}
+
+#ifdef GB_SIMD_X86
+
+// PSADBW against zero sums each group of 8 bytes into a 64-bit lane, which can't overflow
+static uint16_t sum16_sse2(const uint8_t* p, size_t len) noexcept
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i       acc0 = zero;
+    __m128i       acc1 = zero;
+
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32)
+    {
+        const __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+        const __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i + 16));
+        acc0             = _mm_add_epi64(acc0, _mm_sad_epu8(lo, zero));
+        acc1             = _mm_add_epi64(acc1, _mm_sad_epu8(hi, zero));
+    }
+
+    const __m128i  acc = _mm_add_epi64(acc0, acc1);
+    const uint64_t sum = _mm_cvtsi128_si64(acc) + _mm_cvtsi128_si64(_mm_unpackhi_epi64(acc, acc));
+
+    return static_cast<uint16_t>(sum + sum16_scalar(p + i, len - i));
+}
+
+#ifdef __GNUC__
+__attribute__((target("avx2"))) static uint16_t sum16_avx2(const uint8_t* p, size_t len) noexcept
+{
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i       acc0 = zero;
+    __m256i       acc1 = zero;
+
+    size_t i = 0;
+    for (; i + 64 <= len; i += 64)
+    {
+        const __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+        const __m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i + 32));
+        acc0             = _mm256_add_epi64(acc0, _mm256_sad_epu8(lo, zero));
+        acc1             = _mm256_add_epi64(acc1, _mm256_sad_epu8(hi, zero));
+    }
+
+    const __m256i  wide = _mm256_add_epi64(acc0, acc1);
+    const __m128i  acc  = _mm_add_epi64(_mm256_castsi256_si128(wide), _mm256_extracti128_si256(wide, 1));
+    const uint64_t sum  = _mm_cvtsi128_si64(acc) + _mm_cvtsi128_si64(_mm_unpackhi_epi64(acc, acc));
+
+    return static_cast<uint16_t>(sum + sum16_scalar(p + i, len - i));
+}
+#endif
+
+#endif
+
+#ifdef GB_SIMD_NEON
+
+// UADALP adds pairs of bytes into 16-bit lanes, which are free to wrap as only the low 16 bits of the sum matter
+static uint16_t sum16_neon(const uint8_t* p, size_t len) noexcept
+{
+    uint16x8_t acc0 = vdupq_n_u16(0);
+    uint16x8_t acc1 = vdupq_n_u16(0);
+
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32)
+    {
+        acc0 = vpadalq_u8(acc0, vld1q_u8(p + i));
+        acc1 = vpadalq_u8(acc1, vld1q_u8(p + i + 16));
+    }
+
+    return static_cast<uint16_t>(vaddvq_u16(vaddq_u16(acc0, acc1)) + sum16_scalar(p + i, len - i));
+}
+
+#endif
+
+static sum16_fn select_sum16(simd::level at) noexcept
+{
+    switch (at)
+    {
+#ifdef GB_SIMD_X86
+#ifdef __GNUC__
+    case simd::level::avx2: return sum16_avx2;
+#endif
+    case simd::level::sse2: return sum16_sse2;
+#endif
+#ifdef GB_SIMD_NEON
+    case simd::level::neon: return sum16_neon;
+#endif
+    default: return sum16_scalar;
+    }
+}
+
+uint16_t sum16(const void* data, size_t len) noexcept
+{
+    static const sum16_fn impl = select_sum16(simd::detect());
+    return impl(static_cast<const uint8_t*>(data), len);
+}
+
+uint16_t sum16(simd::level at, const void* data, size_t len) noexcept
+{
+    return select_sum16(at)(static_cast<const uint8_t*>(data), len);
+}
+
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+#include "simd.hpp"
+
+namespace gb::checksum
+{
+
+// sum16 is the sum of every byte, modulo 2^16, which is how the cartridge header's global checksum is computed.
+[[nodiscard]] uint16_t sum16(const void* data, size_t len) noexcept;
+
+[[nodiscard]] inline uint16_t sum16(std::span<const uint8_t> data) noexcept { return sum16(data.data(), data.size()); }
+
+// sum16 at a given level runs that implementation, for checking them against one another. The CPU must support it;
+// levels this build has no implementation of run the scalar one.
+[[nodiscard]] uint16_t sum16(simd::level at, const void* data, size_t len) noexcept;
+
+}
@@ -0,0 +1,359 @@
+#include "code_map.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <span>
+
+#include "opcodes.hpp"
+
+namespace gb
+{
+
+constexpr std::array<char, 4> map_magic   = {'G', 'B', 'C', 'M'};
+constexpr uint32_t            map_version = 1;
+constexpr size_t              header_size = 16;
+
+constexpr uint16_t bank_size = 0x4000;
+
+using file_ptr = std::unique_ptr<std::FILE, decltype(&std::fclose)>;
+
+static uint64_t get_le(const uint8_t* in, size_t len) noexcept
+{
+    uint64_t v = 0;
+    for (size_t i = len; i > 0; --i) v = (v << 8) | in[i - 1];
+    return v;
+}
+
+static void put_le(uint8_t* out, size_t len, uint64_t v) noexcept
+{
+    for (size_t i = 0; i < len; ++i) out[i] = static_cast<uint8_t>(v >> (i * 8));
+}
+
+uint16_t label::address() const noexcept
+{
+    if (bank() == 0) return static_cast<uint16_t>(offset);
+    return static_cast<uint16_t>(bank_size | (offset & (bank_size - 1)));
+}
+
+std::string label::name() const
+{
+    std::array<char, 32> buf{};
+
+    if (type == kind::vector)
+    {
+        switch (offset)
+        {
+        case 0x0040: return "int_vblank";
+        case 0x0048: return "int_lcd_stat";
+        case 0x0050: return "int_timer";
+        case 0x0058: return "int_serial";
+        case 0x0060: return "int_joypad";
+        case 0x0100: return "entry";
+        default: std::snprintf(buf.data(), buf.size(), "rst_%02X", offset); return buf.data();
+        }
+    }
+
+    const char* prefix = type == kind::call ? "sub" : "jump";
+    std::snprintf(buf.data(), buf.size(), "%s_%02X_%04X", prefix, bank(), address());
+    return buf.data();
+}
+
+size_t code_map::count(byte_kind kind) const noexcept
+{
+    return static_cast<size_t>(std::count(kinds.begin(), kinds.end(), kind));
+}
+
+namespace
+{
+
+constexpr int unknown = -1;
+
+// path is a run of instructions being followed, with what is known about the registers code selects banks with
+struct path
+{
+    uint16_t pc;
+    int      bank; // selected for 4000 - 7FFF
+    int      a  = unknown;
+    int      hl = unknown;
+};
+
+// analyzer follows every path through a ROM. Calls are assumed to return with the same bank selected.
+class analyzer
+{
+public:
+    analyzer(const cartridge& cart, code_map& out)
+        : rom{cart.data}
+        , controller{cart.describe_type().controller}
+        , banks{std::max<size_t>(1, cart.data.size() / bank_size)}
+        , out{out}
+    {}
+
+    void run()
+    {
+        out.kinds.assign(rom.size(), byte_kind::unknown);
+        out.labels.clear();
+        out.instructions = 0;
+        out.unresolved   = 0;
+
+        // the entry point, RST vectors and interrupt handlers, with bank 1 selected as at power on
+        auto start = [&](uint16_t addr)
+        {
+            if (addr >= rom.size()) return;
+            out.labels.push_back({addr, label::kind::vector});
+            pending.push_back({addr, 1});
+        };
+
+        start(0x0100);
+        for (uint16_t addr = 0x0000; addr <= 0x0060; addr += 8) start(addr); // RST 00 through the joypad interrupt
+
+        while (!pending.empty())
+        {
+            const path next = pending.back();
+            pending.pop_back();
+            follow(next);
+        }
+
+        // one label per address, the most specific kind winning
+        auto before = [](const label& a, const label& b)
+        { return a.offset != b.offset ? a.offset < b.offset : a.type > b.type; };
+        auto same = [](const label& a, const label& b) { return a.offset == b.offset; };
+
+        std::sort(out.labels.begin(), out.labels.end(), before);
+        out.labels.erase(std::unique(out.labels.begin(), out.labels.end(), same), out.labels.end());
+    }
+
+private:
+    // offset finds addr in the ROM with bank selected, returning false if it isn't ROM or the bank isn't known
+    [[nodiscard]] bool offset(uint16_t addr, int bank, uint32_t& out_offset) const noexcept
+    {
+        size_t off = addr;
+        if (addr >= 2 * bank_size) return false;
+        if (addr >= bank_size)
+        {
+            if (bank == unknown) return false;
+            off = ((static_cast<size_t>(bank) % banks) * bank_size) + (addr - bank_size);
+        }
+
+        if (off >= rom.size()) return false;
+        out_offset = static_cast<uint32_t>(off);
+        return true;
+    }
+
+    // select is the bank selected after val is written to addr, in ROM, with bank selected before
+    [[nodiscard]] int select(uint16_t addr, int val, int bank) const noexcept
+    {
+        using enum cartridge::memory_bank_controller;
+
+        switch (controller)
+        {
+        case none: return bank;
+
+        case mbc1:
+            if (addr < 0x2000 || addr >= 0x4000) return bank;
+            return val == unknown ? unknown : std::max(1, val & 0x1F);
+
+        case mbc2:
+            if (addr >= 0x4000 || (addr & 0x0100) == 0) return bank;
+            return val == unknown ? unknown : std::max(1, val & 0x0F);
+
+        case mbc3:
+            if (addr < 0x2000 || addr >= 0x4000) return bank;
+            return val == unknown ? unknown : std::max(1, val & 0x7F);
+
+        case mbc5:
+            // the low 8 bits at 2000 - 2FFF, bit 8 at 3000 - 3FFF
+            if (addr < 0x2000 || addr >= 0x4000) return bank;
+            if (val == unknown || bank == unknown) return unknown;
+            if (addr < 0x3000) return (bank & 0x100) | val;
+            return (bank & 0xFF) | ((val & 1) << 8);
+
+        default:
+            if (addr < 0x2000 || addr >= 0x4000) return bank;
+            return unknown;
+        }
+    }
+
+    void branch(const path& from, uint16_t target, label::kind kind)
+    {
+        uint32_t off = 0;
+        if (!offset(target, from.bank, off))
+        {
+            if (target >= bank_size && target < 2 * bank_size) ++out.unresolved;
+            return; // otherwise code copied to RAM
+        }
+
+        out.labels.push_back({off, kind});
+        if (out.kinds[off] != byte_kind::code) pending.push_back({target, from.bank});
+    }
+
+    void follow(path p)
+    {
+        using enum mnemonic;
+
+        for (;;)
+        {
+            uint32_t off = 0;
+            if (!offset(p.pc, p.bank, off)) return;
+
+            // already decoded, or the middle of an instruction decoded from elsewhere
+            if (out.kinds[off] == byte_kind::code || out.kinds[off] == byte_kind::operand) return;
+
+            std::array<uint8_t, 3> bytes{};
+            for (size_t i = 0; i < bytes.size() && off + i < rom.size(); ++i) bytes[i] = rom[off + i];
+
+            const opcode& info = lookup(bytes[0], bytes[1]);
+            if (info.name == ILLEGAL || off + info.length > rom.size()) return;
+
+            out.kinds[off] = byte_kind::code;
+            for (size_t i = 1; i < info.length; ++i) out.kinds[off + i] = byte_kind::operand;
+            ++out.instructions;
+
+            const uint16_t imm16 = static_cast<uint16_t>(bytes[1] | (bytes[2] << 8));
+            const auto     next  = static_cast<uint16_t>(p.pc + info.length);
+
+            auto write = [&](int addr, int val)
+            {
+                if (addr != unknown && addr < 2 * bank_size) p.bank = select(static_cast<uint16_t>(addr), val, p.bank);
+            };
+
+            switch (info.name)
+            {
+            case LD:
+            case LDH:
+                if (info.dst == operand::at_n16 && info.src == operand::A) write(imm16, p.a);
+                if (info.dst == operand::at_HL)
+                    write(p.hl, info.src == operand::n8 ? bytes[1] : info.src == operand::A ? p.a : unknown);
+                if (info.dst == operand::at_HLI || info.dst == operand::at_HLD) write(p.hl, p.a);
+
+                if (info.src == operand::at_n16) mark_data(imm16, p.bank);
+
+                if (info.dst == operand::A) p.a = info.src == operand::n8 ? bytes[1] : unknown;
+                if (info.dst == operand::HL) p.hl = info.src == operand::n16 ? imm16 : unknown;
+                if (info.dst == operand::H || info.dst == operand::L || info.dst == operand::at_HLI
+                    || info.dst == operand::at_HLD || info.src == operand::at_HLI || info.src == operand::at_HLD)
+                    p.hl = unknown;
+                break;
+
+            case XOR: p.a = info.src == operand::A ? 0 : unknown; break;
+            case CP: break;
+
+            case JR:
+                branch(p, static_cast<uint16_t>(next + static_cast<int8_t>(bytes[1])), label::kind::jump);
+                if (info.dst == operand::none) return;
+                break;
+
+            case JP:
+                if (info.src == operand::HL) return;
+                branch(p, imm16, label::kind::jump);
+                if (info.dst == operand::none) return;
+                break;
+
+            case CALL:
+            case RST:
+                branch(p, info.name == CALL ? imm16 : info.value, label::kind::call);
+                p.a = p.hl = unknown;
+                break;
+
+            case RET:
+                if (info.dst == operand::none) return;
+                break;
+
+            case RETI: return;
+
+            default:
+                // anything else changing A or HL
+                if (info.dst == operand::A || info.dst == operand::AF || info.name == RLCA || info.name == RRCA
+                    || info.name == RLA || info.name == RRA || info.name == DAA || info.name == CPL)
+                    p.a = unknown;
+                if (info.dst == operand::HL || info.dst == operand::H || info.dst == operand::L) p.hl = unknown;
+                break;
+            }
+
+            p.pc = next;
+        }
+    }
+
+    // mark_data records a read from addr, unless it is already known to be code
+    void mark_data(uint16_t addr, int bank)
+    {
+        uint32_t off = 0;
+        if (offset(addr, bank, off) && out.kinds[off] == byte_kind::unknown) out.kinds[off] = byte_kind::data;
+    }
+
+    std::span<const uint8_t>          rom;
+    cartridge::memory_bank_controller controller;
+    size_t                            banks;
+    code_map&                         out;
+    std::vector<path>                 pending;
+};
+
+}
+
+void analyze(const cartridge& cart, code_map& out) { analyzer{cart, out}.run(); }
+
+std::error_code load_code_map(const std::filesystem::path& path, code_map& out)
+{
+    file_ptr file{std::fopen(path.c_str(), "rb"), &std::fclose};
+    if (file == nullptr) return {errno, std::generic_category()};
+
+    std::array<uint8_t, header_size> header{};
+    if (std::fread(header.data(), 1, header.size(), file.get()) != header.size()
+        || std::memcmp(header.data(), map_magic.data(), map_magic.size()) != 0)
+        return std::make_error_code(std::errc::illegal_byte_sequence);
+
+    if (get_le(&header[4], 4) != map_version) return std::make_error_code(std::errc::not_supported);
+
+    const size_t         size = get_le(&header[8], 4);
+    std::vector<uint8_t> packed((size + 3) / 4);
+    if (std::fread(packed.data(), 1, packed.size(), file.get()) != packed.size())
+        return std::make_error_code(std::errc::illegal_byte_sequence);
+
+    out.kinds.resize(size);
+    for (size_t i = 0; i < size; ++i) out.kinds[i] = static_cast<byte_kind>((packed[i / 4] >> ((i % 4) * 2)) & 3U);
+
+    out.labels.clear();
+    out.instructions = out.count(byte_kind::code);
+    out.unresolved   = 0;
+    return {};
+}
+
+std::error_code save_code_map(const std::filesystem::path& path, const code_map& map)
+{
+    std::vector<uint8_t> image(header_size + ((map.kinds.size() + 3) / 4));
+    std::memcpy(image.data(), map_magic.data(), map_magic.size());
+    put_le(&image[4], 4, map_version);
+    put_le(&image[8], 4, map.kinds.size());
+
+    for (size_t i = 0; i < map.kinds.size(); ++i)
+    {
+        image[header_size + (i / 4)] |= static_cast<uint8_t>(static_cast<uint8_t>(map.kinds[i]) << ((i % 4) * 2));
+    }
+
+    file_ptr file{std::fopen(path.c_str(), "wb"), &std::fclose};
+    if (file == nullptr) return {errno, std::generic_category()};
+
+    if (std::fwrite(image.data(), 1, image.size(), file.get()) != image.size()) return {errno, std::generic_category()};
+    if (std::fclose(file.release()) != 0) return {errno, std::generic_category()};
+    return {};
+}
+
+std::error_code save_symbols(const std::filesystem::path& path, const code_map& map)
+{
+    file_ptr file{std::fopen(path.c_str(), "wb"), &std::fclose};
+    if (file == nullptr) return {errno, std::generic_category()};
+
+    for (const auto& l : map.labels)
+    {
+        if (std::fprintf(file.get(), "%02X:%04X %s\n", l.bank(), l.address(), l.name().c_str()) < 0)
+            return {errno, std::generic_category()};
+    }
+
+    if (std::fclose(file.release()) != 0) return {errno, std::generic_category()};
+    return {};
+}
+
+}
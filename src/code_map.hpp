@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "cartridge.hpp"
+
+namespace gb
+{
+
+// what a byte of ROM was found to be
+enum class byte_kind : uint8_t
+{
+    unknown, // never reached, and never read as data
+    code,    // the first byte of an instruction
+    operand, // the rest of an instruction
+    data,    // read by code with an absolute address
+};
+
+// label is an address code jumps or calls to
+struct label
+{
+    enum class kind : uint8_t
+    {
+        jump,
+        call,
+        vector, // the entry point, an RST or an interrupt handler
+    };
+
+    uint32_t offset; // into the ROM, so bank * 0x4000 + (address & 0x3FFF) for banked addresses
+    kind     type;
+
+    [[nodiscard]] uint16_t    bank() const noexcept { return static_cast<uint16_t>(offset >> 14U); }
+    [[nodiscard]] uint16_t    address() const noexcept; // as the CPU sees it
+    [[nodiscard]] std::string name() const;
+};
+
+// code_map is the result of following a ROM's control flow from every address the hardware can start executing at:
+// the entry point, the RST vectors and the interrupt handlers.
+//
+// Banked code is followed by tracking what the code writes to the cartridge's bank select register, through constants
+// loaded into A and HL just before. Jumps into the switchable bank that can't be resolved that way are counted, and not
+// followed.
+struct code_map
+{
+    std::vector<byte_kind> kinds;  // one per byte of ROM
+    std::vector<label>     labels; // sorted by offset
+
+    size_t instructions = 0;
+    size_t unresolved   = 0; // jumps and calls into the switchable bank, made with no known bank selected
+
+    [[nodiscard]] size_t count(byte_kind kind) const noexcept;
+};
+
+// analyze fills out with the code map of cart
+void analyze(const cartridge& cart, code_map& out);
+
+// The map is stored as a 16 byte little-endian header ("GBCM", version, ROM size, reserved), then each byte's kind in
+// two bits, four to a byte starting from the low bits.
+std::error_code load_code_map(const std::filesystem::path& path, code_map& out);
+std::error_code save_code_map(const std::filesystem::path& path, const code_map& map);
+
+// save_symbols writes map's labels in the "bank:address name" .sym format debuggers such as BGB read
+std::error_code save_symbols(const std::filesystem::path& path, const code_map& map);
+
+}
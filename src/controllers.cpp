@@ -0,0 +1,53 @@
+#include "controllers.hpp"
+
+#include <iomanip>
+#include <iostream>
+
+#include "direct_memory_bank.hpp"
+#include "mbc1.hpp"
+#include "mbc3.hpp"
+#include "mbc5.hpp"
+#include "save_file.hpp"
+
+namespace gb
+{
+
+std::unique_ptr<memory_bank_controller> make_controller(const cartridge& cart, const std::filesystem::path& save_path)
+{
+    if (!cart.loaded()) return std::make_unique<direct_memory_bank>(cart);
+
+    using kind = cartridge::memory_bank_controller;
+    using enum cartridge::additional_hardware;
+
+    const auto type = cart.describe_type();
+    if (type.controller != kind::mbc1 && type.controller != kind::mbc3 && type.controller != kind::mbc5)
+    {
+        // TODO the other controllers
+        if (!save_path.empty() && (type.hardware & battery))
+        {
+            std::cerr << "warning: the cartridge's memory bank controller isn't emulated, so neither is its battery "
+                         "backed memory, and progress won't be saved"
+                      << std::endl;
+        }
+        return std::make_unique<direct_memory_bank>(cart);
+    }
+
+    std::unique_ptr<save_file> save;
+    if (!save_path.empty() && (type.hardware & battery) && (cart.ram_size() != 0 || (type.hardware & timer)))
+    {
+        if (auto err = open_save(save_path, cart.ram_size(), type.hardware & timer, save); err)
+        {
+            std::cerr << "unable to open " << std::quoted(save_path.string()) << ", progress won't be saved: "
+                      << err.message() << std::endl;
+        }
+    }
+
+    switch (type.controller)
+    {
+    case kind::mbc1: return std::make_unique<mbc1>(cart, std::move(save));
+    case kind::mbc5: return std::make_unique<mbc5>(cart, std::move(save));
+    default: return std::make_unique<mbc3>(cart, std::move(save));
+    }
+}
+
+}
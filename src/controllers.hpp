@@ -0,0 +1,16 @@
+#pragma once
+
+#include <filesystem>
+#include <memory>
+
+#include "cartridge.hpp"
+#include "memory_bank_controller.hpp"
+
+namespace gb
+{
+
+// make_controller picks the memory bank controller cart needs, keeping battery-backed memory in save_path if not empty.
+// Without a save path, every controller keeps its own RAM and cart is only read, so it can be shared.
+std::unique_ptr<memory_bank_controller> make_controller(const cartridge& cart, const std::filesystem::path& save_path);
+
+}
@@ -5,38 +5,66 @@
 #include <cstdint>
 #include <limits>
 #include <memory>
-#include <stack>
 
+#include "interrupts.hpp"
 #include "models.hpp"
+#include "opcodes.hpp"
 #include "registers.hpp"
 #include "util.hpp"
 
 namespace gb
 {
 
+struct debugger;
 struct memory;
-
-enum class interrupt : uint8_t
-{
-    vblank   = 1U << 0U,
-    lcd_stat = 1U << 1U,
-    timer    = 1U << 2U,
-    serial   = 1U << 3U,
-    joypad   = 1U << 4U,
-
-    END = 1U << 5U,
-};
+class state_reader;
+class state_writer;
 
 struct cpu
 {
 public:
-    explicit cpu(std::unique_ptr<memory>&& mem, model model) noexcept;
+    explicit cpu(std::unique_ptr<memory>&& mem, model model, boot_mode boot = boot_mode::fast) noexcept;
+
+    // a cpu running mem, which must outlive it, as an instance's does (see instance.hpp)
+    cpu(memory& mem, model model, boot_mode boot = boot_mode::fast) noexcept;
 
     void run() noexcept;
+    void run_for(uint64_t cycles) noexcept; // run, but only until cycles have been run
     void stop() noexcept;
     void queue_interrupt(interrupt type) noexcept;
 
+    // step runs the next pipeline action (usually one instruction) and the peripherals, returning the cycles spent
+    uint32_t step() noexcept;
+
+    // run_frame steps until the display completes a frame, or stop
+    void run_frame() noexcept;
+
+    [[nodiscard]] memory&       bus() noexcept { return *mem; }
+    [[nodiscard]] const memory& bus() const noexcept { return *mem; }
+
+    [[nodiscard]] registers&       regs() noexcept { return r; }
+    [[nodiscard]] const registers& regs() const noexcept { return r; }
+
+    // stopped_by_debugger is true from when a breakpoint or watchpoint stops the cpu until it is resumed, see
+    // debugger.hpp
+    [[nodiscard]] bool stopped_by_debugger() const noexcept { return debug_stop; }
+
+    // total number of cycles run since power on
+    [[nodiscard]] uint64_t elapsed() const noexcept { return total_cycles; }
+
+    // Idle skipping fast-forwards busy-wait loops (such as polling LY) to the point where what they poll can change.
+    // It only changes how far each step goes, not what the program sees, but is best turned off for accuracy testing.
+    void               set_idle_skipping(bool enabled) noexcept { idle_skipping = enabled; }
+    [[nodiscard]] bool skipping_idle() const noexcept { return idle_skipping; }
+
+    // save_state and load_state cover the whole machine, see state.hpp
+    void save_state(state_writer& out) const noexcept;
+    void load_state(state_reader& in) noexcept;
+
 private:
+    friend struct debugger;
+    friend struct lanes;
+
     enum class condition : uint8_t
     {
         NZ, // if Z flag is clear
@@ -45,6 +73,8 @@ private:
         C,  // if C flag is set
     };
 
+    [[nodiscard]] bool check(condition cond) const noexcept;
+
     enum class action : uint8_t
     {
         execute,
@@ -56,170 +86,191 @@ private:
     uint8_t  fetch() noexcept;
     uint16_t fetch16() noexcept;
 
-    void     process_interrupts() noexcept;
-    void     update_lcd() noexcept;
-    void     update_timers() noexcept;
+    // debug_hook runs before every pipeline action in debug_mode, returning true if the debugger stops the cpu first
+    bool debug_hook(action next) noexcept;
+
+    // finish completes a step once its action has run, taking spent cycles: interrupts, DMA stalls and the peripherals
+    uint32_t finish(uint32_t spent) noexcept;
+
+    uint32_t process_interrupts() noexcept;
+    void     update_lcd(uint32_t spent) noexcept;
+    void     update_timers(uint32_t spent) noexcept;
+    uint32_t next_event() noexcept; // cycles until a peripheral could next request an interrupt
+
+    // idle loop detection, see cpu_idle.cpp
+    static constexpr uint8_t watch_stat = 1U << 0U; // polls STAT or HDMA5, which change with the ppu mode
+    static constexpr uint8_t watch_ly   = 1U << 1U;
+    static constexpr uint8_t watch_div  = 1U << 2U;
+    static constexpr uint8_t watch_tima = 1U << 3U;
+    static constexpr uint8_t not_idle   = 1U << 7U;
+
+    uint32_t       skip_idle_loop(uint16_t branch, uint32_t spent) noexcept;
+    uint8_t        scan_idle_loop(uint16_t start, uint16_t branch) noexcept;
+    static uint8_t watch_for(uint16_t addr) noexcept;
+    uint32_t       next_change(uint8_t watches) noexcept;
+
     uint32_t execute(uint8_t op) noexcept;
 
+    // The carry checks take the carry flag for ADC and SBC. The half carry is out of bit 3 for 8-bit operands, and
+    // out of bit 11 for 16-bit ones.
     template<std::unsigned_integral T>
-    static constexpr bool check_add_half_carry(T a, T b) noexcept
+    static constexpr bool check_add_half_carry(T a, T b, bool carry = false) noexcept
     {
-        constexpr T mask = std::numeric_limits<T>::max() >> 8;
-        return ((a & mask) + (b & mask)) > mask;
+        constexpr T mask = std::numeric_limits<T>::max() >> 4;
+        return (a & mask) + (b & mask) + (carry ? 1 : 0) > mask;
     }
 
     template<std::unsigned_integral T>
-    static constexpr bool check_add_carry(T a, T b) noexcept
+    static constexpr bool check_add_carry(T a, T b, bool carry = false) noexcept
     {
         using N = util::promote_t<T>;
-        return static_cast<N>(a) + static_cast<N>(b) > std::numeric_limits<T>::max();
+        return static_cast<N>(a) + static_cast<N>(b) + (carry ? 1 : 0) > std::numeric_limits<T>::max();
     }
 
     template<std::unsigned_integral T>
-    static constexpr bool check_sub_half_carry(T a, T b) noexcept
+    static constexpr bool check_sub_half_carry(T a, T b, bool carry = false) noexcept
     {
-        constexpr T mask = std::numeric_limits<T>::max() >> 8;
-        return static_cast<int>(a & mask) - static_cast<int>(b & mask) < 0;
+        constexpr T mask = std::numeric_limits<T>::max() >> 4;
+        return static_cast<int>(a & mask) - static_cast<int>(b & mask) - (carry ? 1 : 0) < 0;
     }
 
     template<std::unsigned_integral T>
-    static constexpr bool check_sub_carry(T a, T b) noexcept
+    static constexpr bool check_sub_carry(T a, T b, bool carry = false) noexcept
     {
-        return static_cast<int>(a) - static_cast<int>(b) < 0;
+        return static_cast<int>(a) - static_cast<int>(b) - (carry ? 1 : 0) < 0;
     }
 
-    // all instruction implementations return the number of cycles spent
-
-    // 8-bit loads
-    uint32_t op_ld_n(uint8_t& reg) noexcept;
-    uint32_t op_ld_n(uint16_t addr) noexcept;
-    uint32_t op_ld(uint8_t& dst, uint8_t val) noexcept;
-    uint32_t op_ld(uint8_t& dst, uint16_t addr) noexcept;
-    uint32_t op_ld(uint16_t addr, uint8_t val) noexcept;
-    uint32_t op_ld_from_nn(uint8_t& dst) noexcept;
-    uint32_t op_ld_to_nn(uint8_t val) noexcept;
-    // the suffix in the following functions is the destination of each ld instruction
-    uint32_t op_ldd_A() noexcept;
-    uint32_t op_ldd_HL() noexcept;
-    uint32_t op_ldi_A() noexcept;
-    uint32_t op_ldi_HL() noexcept;
-    uint32_t op_ldh_A() noexcept;
-    uint32_t op_ldh_n() noexcept;
-
-    // 16-bit loads
-    uint32_t op_ld16(uint16_t& reg) noexcept;
-    uint32_t op_ld16(uint16_t& reg, uint16_t val) noexcept;
-    uint32_t op_ld16_HL() noexcept;
-    uint32_t op_ld16_nn() noexcept;
-
-    // stack ops
-    uint32_t op_push(uint16_t val) noexcept;
-    uint32_t op_pop(uint16_t& reg) noexcept;
-
-    // 8-bit alu
-    uint32_t op_add(uint8_t& reg, uint8_t val) noexcept;
-    uint32_t op_add(uint8_t& reg, uint16_t addr) noexcept;
-    uint32_t op_add_n(uint8_t& reg) noexcept;
-
-    uint32_t op_adc(uint8_t& reg, uint8_t val) noexcept;
-    uint32_t op_adc(uint8_t& reg, uint16_t addr) noexcept;
-    uint32_t op_adc_n(uint8_t& reg) noexcept;
-
-    uint32_t op_sub(uint8_t& reg, uint8_t val) noexcept;
-    uint32_t op_sub(uint8_t& reg, uint16_t addr) noexcept;
-    uint32_t op_sub_n(uint8_t& reg) noexcept;
-
-    uint32_t op_sbc(uint8_t& reg, uint8_t val) noexcept;
-    uint32_t op_sbc(uint8_t& reg, uint16_t addr) noexcept;
-    uint32_t op_sbc_n(uint8_t& reg) noexcept;
-
-    uint32_t op_and(uint8_t& reg, uint8_t val) noexcept;
-    uint32_t op_and(uint8_t& reg, uint16_t addr) noexcept;
-    uint32_t op_and_n(uint8_t& reg) noexcept;
-
-    uint32_t op_or(uint8_t& reg, uint8_t val) noexcept;
-    uint32_t op_or(uint8_t& reg, uint16_t addr) noexcept;
-    uint32_t op_or_n(uint8_t& reg) noexcept;
-
-    uint32_t op_xor(uint8_t& reg, uint8_t val) noexcept;
-    uint32_t op_xor(uint8_t& reg, uint16_t addr) noexcept;
-    uint32_t op_xor_n(uint8_t& reg) noexcept;
-
-    uint32_t op_cp(uint8_t& reg, uint8_t val) noexcept;
-    uint32_t op_cp(uint8_t& reg, uint16_t addr) noexcept;
-    uint32_t op_cp_n(uint8_t& reg) noexcept;
-
-    uint32_t op_inc(uint8_t& reg) noexcept;
-    uint32_t op_inc(uint16_t addr) noexcept;
-
-    uint32_t op_dec(uint8_t& reg) noexcept;
-    uint32_t op_dec(uint16_t addr) noexcept;
+    // Instructions are dispatched through tables generated from opcodes (see opcodes.hpp), each entry an
+    // instantiation of execute_op for that opcode, which decodes its operands and returns the cycles it took.
+    template<opcode Info>
+    uint32_t execute_op() noexcept;
+    uint32_t execute_ext(uint8_t op) noexcept;
+
+    // operand access for execute_op
+    template<operand O>
+    uint8_t& reg8() noexcept;
+    template<operand O>
+    uint16_t& reg16() noexcept;
+    template<operand O>
+    uint8_t load() noexcept;
+    template<operand O>
+    void store(uint8_t val) noexcept;
+    template<operand O>
+    [[nodiscard]] bool taken() const noexcept;
+
+    // logs the instruction at pc, when tracing
+    void trace(uint16_t pc) noexcept;
+
+    // Instruction implementations, templated on the operands they work on so every opcode's instantiation accesses
+    // fixed registers. Src operands are read, O operands read and written.
+
+    // 8-bit alu, on A (and ADD HL,rr)
+    template<operand Src>
+    void op_add() noexcept;
+    template<operand Src>
+    void op_adc() noexcept;
+    template<operand Src>
+    void op_sub() noexcept;
+    template<operand Src>
+    void op_sbc() noexcept;
+    template<operand Src>
+    void op_and() noexcept;
+    template<operand Src>
+    void op_or() noexcept;
+    template<operand Src>
+    void op_xor() noexcept;
+    template<operand Src>
+    void op_cp() noexcept;
+    template<operand O>
+    void op_inc() noexcept; // also 16-bit registers
+    template<operand O>
+    void op_dec() noexcept; // also 16-bit registers
 
     // 16-bit alu
-    uint32_t op_add(uint16_t& reg, uint16_t val) noexcept;
-    uint32_t op_add_sp() noexcept;
-    uint32_t op_inc16(uint16_t& reg) noexcept;
-    uint32_t op_dec16(uint16_t& reg) noexcept;
+    void     op_add_sp() noexcept;
+    void     op_ld16_HL() noexcept; // LD HL,SP+e
+    uint16_t sp_plus_e8() noexcept; // SP plus the signed immediate, for both of the above
+
+    // stack ops
+    void     push(uint16_t val) noexcept;
+    uint16_t pop() noexcept;
+    template<operand O>
+    void op_push() noexcept;
+    template<operand O>
+    void op_pop() noexcept;
 
     // misc
-    uint32_t op_swap(uint8_t& reg) noexcept;
-    uint32_t op_swap(uint16_t addr) noexcept;
-    uint32_t op_daa() noexcept; // "Decimal Adjust" register A
-    uint32_t op_cpl() noexcept; // complement register A
-    uint32_t op_ccf() noexcept; // complement carry flag
-    uint32_t op_scf() noexcept; // set carry flag
-    uint32_t op_nop() noexcept;
-    uint32_t op_halt() noexcept;
-    uint32_t op_stop() noexcept;
-    uint32_t op_di() noexcept; // disable interrupts
-    uint32_t op_ei() noexcept; // enable interrupts
+    template<operand O>
+    void op_swap() noexcept;
+    void op_daa() noexcept; // "Decimal Adjust" register A
+    void op_cpl() noexcept; // complement register A
+    void op_ccf() noexcept; // complement carry flag
+    void op_scf() noexcept; // set carry flag
+    void op_halt() noexcept;
+    void op_stop() noexcept;
+    void op_di() noexcept; // disable interrupts
+    void op_ei() noexcept; // enable interrupts
 
     // rotates and shifts
-    uint32_t op_rlc(uint8_t& reg) noexcept;  // rotate left into carry
-    uint32_t op_rlc(uint16_t addr) noexcept; // rotate left into carry
-    uint32_t op_rl(uint8_t& reg) noexcept;   // rotate left
-    uint32_t op_rl(uint16_t addr) noexcept;  // rotate left
-    uint32_t op_rrc(uint8_t& reg) noexcept;  // rotate right into carry
-    uint32_t op_rrc(uint16_t addr) noexcept; // rotate right into carry
-    uint32_t op_rr(uint8_t& reg) noexcept;   // rotate right
-    uint32_t op_rr(uint16_t addr) noexcept;  // rotate right
-
-    uint32_t op_sla(uint8_t& reg) noexcept;  // shift left
-    uint32_t op_sla(uint16_t addr) noexcept; // shift left
-    uint32_t op_sra(uint8_t& reg) noexcept;  // shift right
-    uint32_t op_sra(uint16_t addr) noexcept; // shift right
-    uint32_t op_srl(uint8_t& reg) noexcept;  // shift right
-    uint32_t op_srl(uint16_t addr) noexcept; // shift right
-
-    // bit ops
-    uint32_t op_bit(uint8_t& reg, uint8_t n) noexcept;
-    uint32_t op_bit(uint16_t addr, uint8_t n) noexcept;
-    uint32_t op_set(uint8_t& reg, uint8_t n) noexcept;
-    uint32_t op_set(uint16_t addr, uint8_t n) noexcept;
-    uint32_t op_res(uint8_t& reg, uint8_t n) noexcept;
-    uint32_t op_res(uint16_t addr, uint8_t n) noexcept;
-
-    // jumps
-    uint32_t op_jp() noexcept;
-    uint32_t op_jp(uint16_t addr) noexcept;
-    uint32_t op_jp(condition cond) noexcept;
-    uint32_t op_jr() noexcept;
-    uint32_t op_jr(condition cond) noexcept;
-    uint32_t op_call() noexcept;
-    uint32_t op_call(condition cond) noexcept;
-    uint32_t op_rst(uint8_t base) noexcept;
-    uint32_t op_ret() noexcept;
-    uint32_t op_ret(condition cond) noexcept;
-    uint32_t op_reti() noexcept;
-
-    const std::unique_ptr<memory> mem;
-
-    std::stack<action> pipeline;
+    template<operand O>
+    void op_rlc() noexcept; // rotate left, bit 7 into both bit 0 and carry
+    template<operand O>
+    void op_rl() noexcept; // rotate left through carry
+    template<operand O>
+    void op_rrc() noexcept; // rotate right, bit 0 into both bit 7 and carry
+    template<operand O>
+    void op_rr() noexcept; // rotate right through carry
+    template<operand O>
+    void op_sla() noexcept; // shift left
+    template<operand O>
+    void op_sra() noexcept; // shift right
+    template<operand O>
+    void op_srl() noexcept; // shift right
+
+    // bit ops, on bit N
+    template<operand O, uint8_t N>
+    void op_bit() noexcept;
+    template<operand O, uint8_t N>
+    void op_set() noexcept;
+    template<operand O, uint8_t N>
+    void op_res() noexcept;
+
+    // calls
+    void op_call(uint16_t addr) noexcept;
+    void op_rst(uint8_t base) noexcept;
+    void op_ret() noexcept;
+    void op_reti() noexcept;
+
+    std::unique_ptr<memory> owned; // unless mem belongs to someone else
+    memory* const           mem;
+
+    // the deepest the pipeline gets, with EI or HALT on top of the next instruction, and some room to spare
+    static constexpr size_t pipeline_depth = 4;
+
+    util::fixed_stack<action, pipeline_depth> pipeline;
 
     std::atomic_bool running;
     bool             interrupts_enabled;
     uint32_t         cycles;
-    bool             debug_mode;
+    uint64_t         total_cycles;
+    uint32_t         timer_cycles; // progress towards the next TIMA increment
+    bool             idle_skipping;
+
+    // the most recent short backward loop, watched to see if it spins
+    struct idle_loop
+    {
+        uint16_t  start   = 0;
+        uint16_t  branch  = 0; // address of the jump closing the loop
+        uint8_t   watches = 0; // what the loop polls, or not_idle
+        uint64_t  arrived = 0; // total_cycles when the loop last started over
+        registers state{};     // registers when the loop last started over
+    };
+
+    idle_loop idle;
+    debugger* debug;      // attached, if any
+    bool      tracing;    // every instruction, when verbose logging is on
+    bool      debug_mode; // tracing, or there are breakpoints to check
+    bool      debug_stop; // see stopped_by_debugger
 
     registers r;
 };
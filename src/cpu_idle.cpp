@@ -0,0 +1,165 @@
+#include "cpu.hpp"
+#include "memory.hpp"
+#include "opcodes.hpp"
+
+namespace gb
+{
+
+// loops longer than this are rarely just waiting on something
+constexpr uint16_t max_idle_loop_bytes = 16;
+
+// watch_for classifies what a read from addr inside a loop means for skipping it
+uint8_t cpu::watch_for(uint16_t addr) noexcept
+{
+    // ROM only changes with a (bank switching) write, and WRAM/HRAM only by the CPU itself, which outside of the loop
+    // means an interrupt handler. VRAM and OAM are written by DMA, and cartridge RAM can be an RTC.
+    if (addr < 0x8000) return 0;
+    if (addr < 0xC000) return not_idle;
+    if (addr < 0xFE00) return 0;
+    if (addr < 0xFF00) return not_idle;
+    if (addr >= 0xFF80) return 0;
+
+    switch (addr)
+    {
+    case memory::stat:
+    case memory::vram_dma_end: return watch_stat;
+    case memory::ly: return watch_ly;
+
+    case memory::divider: return watch_div;
+    case memory::timer_counter: return watch_tima;
+
+    // SB and SC only change when a transfer completes or at a link sync point, both covered by next_event
+    case memory::serial_transfer_data:
+    case memory::serial_transfer_ctrl: return 0;
+
+    default:
+        if (addr >= memory::sound_start && addr <= memory::wave_pattern_end) return not_idle;
+
+        // everything else only changes when the CPU writes it, or along with an interrupt request (IF, P1)
+        return 0;
+    }
+}
+
+// scan_idle_loop decodes the loop body from start up to the jump at branch, returning what it polls, or not_idle if any
+// instruction could write memory or have some other side effect.
+uint8_t cpu::scan_idle_loop(uint16_t start, uint16_t branch) noexcept
+{
+    uint8_t watches = 0;
+
+    for (uint16_t pc = start; pc != branch;)
+    {
+        if (pc > branch) return not_idle; // didn't land on the jump, so the bytes aren't what was run
+
+        const opcode& info = lookup(mem->peek(pc), mem->peek(pc + 1));
+
+        // what reading o polls, the instruction's operand bytes following pc
+        auto polls = [&](operand o) -> uint8_t
+        {
+            switch (o)
+            {
+            case operand::at_BC: return watch_for(r.BC);
+            case operand::at_DE: return watch_for(r.DE);
+            case operand::at_HL: return watch_for(r.HL);
+            case operand::at_C: return watch_for(0xFF00 + r.C);
+            case operand::at_n8: return watch_for(0xFF00 + mem->peek(pc + 1));
+            case operand::at_n16: return watch_for(mem->peek16(pc + 1));
+            default: return 0;
+            }
+        };
+
+        switch (info.name)
+        {
+        case mnemonic::NOP:
+        case mnemonic::RLCA:
+        case mnemonic::RRCA:
+        case mnemonic::RLA:
+        case mnemonic::RRA:
+        case mnemonic::CPL:
+        case mnemonic::SCF:
+        case mnemonic::CCF:
+        case mnemonic::JR: break;
+
+        case mnemonic::JP:
+            if (info.src == operand::HL) return not_idle;
+            break;
+
+        case mnemonic::LD:
+        case mnemonic::LDH:
+            // only loads into a register, and not (HL+) or (HL-), which change HL
+            if (!is_reg8(info.dst) || info.src == operand::at_HLI || info.src == operand::at_HLD) return not_idle;
+            watches |= polls(info.src);
+            break;
+
+        case mnemonic::ADD:
+        case mnemonic::ADC:
+        case mnemonic::SUB:
+        case mnemonic::SBC:
+        case mnemonic::AND:
+        case mnemonic::XOR:
+        case mnemonic::OR:
+        case mnemonic::CP:
+            if (info.dst != operand::A) return not_idle;
+            watches |= polls(info.src);
+            break;
+
+        // only BIT, the rest of the 0xCB prefixed instructions write their operand
+        case mnemonic::BIT: watches |= polls(info.dst); break;
+
+        default: return not_idle;
+        }
+
+        if ((watches & not_idle) != 0) return not_idle;
+        pc += info.length;
+    }
+
+    return watches;
+}
+
+// skip_idle_loop is called after the jump at branch went backwards, taking spent cycles. A loop that reads nothing
+// but what scan_idle_loop allows, and comes back around with every register unchanged, will keep doing exactly that
+// until something it reads changes, so it is fast-forwarded by as many whole iterations as fit before then.
+uint32_t cpu::skip_idle_loop(uint16_t branch, uint32_t spent) noexcept
+{
+    const uint64_t now = total_cycles + spent;
+
+    if (branch - r.pc > max_idle_loop_bytes)
+    {
+        idle.start = idle.branch = 0;
+        return 0;
+    }
+
+    if (idle.start != r.pc || idle.branch != branch)
+    {
+        idle.start   = r.pc;
+        idle.branch  = branch;
+        idle.watches = scan_idle_loop(r.pc, branch);
+        idle.arrived = now;
+        idle.state   = r;
+        return 0;
+    }
+
+    const uint64_t iteration = now - idle.arrived;
+    idle.arrived             = now;
+
+    if ((idle.watches & not_idle) != 0) return 0;
+
+    const bool same = r.AF == idle.state.AF && r.BC == idle.state.BC && r.DE == idle.state.DE
+                   && r.HL == idle.state.HL && r.sp == idle.state.sp;
+    idle.state = r;
+
+    if (!same || iteration == 0) return 0;
+
+    // an interrupt about to be serviced ends the loop right away
+    if (interrupts_enabled && mem->interrupts().pending() != 0) return 0;
+
+    // stop short of the change, so the loop itself sees it on the same iteration it would have
+    const uint32_t until = next_change(idle.watches);
+    if (until <= spent + 1) return 0;
+
+    const uint64_t skip = (until - spent - 1) / iteration * iteration;
+    idle.arrived       += skip;
+
+    return static_cast<uint32_t>(skip);
+}
+
+}
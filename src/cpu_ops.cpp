@@ -1,459 +1,579 @@
 #include "cpu.hpp"
+
+#include <SDL2/SDL_log.h>
+
+#include <array>
+#include <string>
+#include <utility>
+
+#include "disassembler.hpp"
 #include "memory.hpp"
 #include "util.hpp"
 
 namespace gb
 {
 
-uint32_t cpu::op_ld_n(uint8_t& reg) noexcept
+template<operand O>
+uint8_t& cpu::reg8() noexcept
 {
-    reg = fetch();
-    return 8;
-}
+    using enum operand;
+    static_assert(is_reg8(O));
 
-uint32_t cpu::op_ld_n(uint16_t addr) noexcept
-{
-    mem->write(addr, fetch());
-    return 12;
+    if constexpr (O == A) return r.A;
+    else if constexpr (O == B) return r.B;
+    else if constexpr (O == C) return r.C;
+    else if constexpr (O == D) return r.D;
+    else if constexpr (O == E) return r.E;
+    else if constexpr (O == H) return r.H;
+    else return r.L;
 }
 
-uint32_t cpu::op_ld(uint8_t& dst, uint8_t val) noexcept
+template<operand O>
+uint16_t& cpu::reg16() noexcept
 {
-    dst = val;
-    return 4;
-}
+    using enum operand;
+    static_assert(is_reg16(O));
 
-uint32_t cpu::op_ld(uint8_t& dst, uint16_t addr) noexcept
-{
-    dst = mem->read(addr);
-    return 8;
+    if constexpr (O == AF) return r.AF;
+    else if constexpr (O == BC) return r.BC;
+    else if constexpr (O == DE) return r.DE;
+    else if constexpr (O == HL) return r.HL;
+    else return r.sp;
 }
 
-uint32_t cpu::op_ld(uint16_t addr, uint8_t val) noexcept
+template<operand O>
+uint8_t cpu::load() noexcept
 {
-    mem->write(addr, val);
-    return 8;
-}
+    using enum operand;
 
-uint32_t cpu::op_ld_from_nn(uint8_t& dst) noexcept
-{
-    uint16_t addr = fetch16();
-    dst           = mem->read(addr);
-    return 16;
+    if constexpr (is_reg8(O)) return reg8<O>();
+    else if constexpr (O == at_BC) return mem->read(r.BC);
+    else if constexpr (O == at_DE) return mem->read(r.DE);
+    else if constexpr (O == at_HL) return mem->read(r.HL);
+    else if constexpr (O == at_HLI) return mem->read(r.HL++);
+    else if constexpr (O == at_HLD) return mem->read(r.HL--);
+    else if constexpr (O == at_C) return mem->read(0xFF00 + r.C);
+    else if constexpr (O == n8) return fetch();
+    else if constexpr (O == at_n8) return mem->read(0xFF00 + fetch());
+    else if constexpr (O == at_n16) return mem->read(fetch16());
+    else static_assert(O == n8, "not an 8-bit source");
 }
 
-uint32_t cpu::op_ld_to_nn(uint8_t val) noexcept
+template<operand O>
+void cpu::store(uint8_t val) noexcept
 {
-    mem->write(fetch16(), val);
-    return 16;
-}
+    using enum operand;
 
-uint32_t cpu::op_ldd_A() noexcept
-{
-    r.A = mem->read(r.HL);
-    r.HL--;
-    return 8;
+    if constexpr (is_reg8(O)) reg8<O>() = val;
+    else if constexpr (O == at_BC) mem->write(r.BC, val);
+    else if constexpr (O == at_DE) mem->write(r.DE, val);
+    else if constexpr (O == at_HL) mem->write(r.HL, val);
+    else if constexpr (O == at_HLI) mem->write(r.HL++, val);
+    else if constexpr (O == at_HLD) mem->write(r.HL--, val);
+    else if constexpr (O == at_C) mem->write(0xFF00 + r.C, val);
+    else if constexpr (O == at_n8) mem->write(0xFF00 + fetch(), val);
+    else if constexpr (O == at_n16) mem->write(fetch16(), val);
+    else static_assert(O == at_n16, "not an 8-bit destination");
 }
 
-uint32_t cpu::op_ldd_HL() noexcept
+template<operand O>
+bool cpu::taken() const noexcept
 {
-    mem->write(r.HL, r.A);
-    r.HL--;
-    return 8;
-}
+    static_assert(is_condition(O));
 
-uint32_t cpu::op_ldi_A() noexcept
-{
-    r.A = mem->read(r.HL);
-    r.HL++;
-    return 8;
+    // the conditions are in the same order in both
+    return check(static_cast<condition>(static_cast<uint8_t>(O) - static_cast<uint8_t>(operand::if_NZ)));
 }
 
-uint32_t cpu::op_ldi_HL() noexcept
-{
-    mem->write(r.HL, r.A);
-    r.HL++;
-    return 8;
-}
+// The handlers below are instantiated per operand, so each accesses a fixed register rather than one through a
+// reference, which the compiler has to assume memory writes alias.
 
-uint32_t cpu::op_ldh_A() noexcept
+template<operand Src>
+void cpu::op_add() noexcept
 {
-    mem->write(0xff00 + fetch(), r.A);
-    return 12;
-}
+    if constexpr (is_reg16(Src))
+    {
+        // ADD HL,rr
+        const uint16_t val = reg16<Src>();
 
-uint32_t cpu::op_ldh_n() noexcept
-{
-    r.A = mem->read(0xff00 + fetch());
-    return 12;
-}
+        // zero not affected
+        r.reset_sub();
+        r.half_carry(check_add_half_carry(r.HL, val));
+        r.carry(check_add_carry(r.HL, val));
 
-uint32_t cpu::op_ld16(uint16_t& reg) noexcept
-{
-    reg = fetch16();
-    return 12;
-}
+        r.HL += val;
+    }
+    else
+    {
+        const uint8_t val = load<Src>();
+        const uint8_t res = r.A + val;
 
-uint32_t cpu::op_ld16(uint16_t& reg, uint16_t val) noexcept
-{
-    reg = val;
-    return 8;
+        r.zero(res == 0);
+        r.reset_sub();
+        r.half_carry(check_add_half_carry(r.A, val));
+        r.carry(check_add_carry(r.A, val));
+
+        r.A = res;
+    }
 }
 
-uint32_t cpu::op_ld16_HL() noexcept
+template<operand Src>
+void cpu::op_adc() noexcept
 {
-    auto immd = static_cast<int8_t>(fetch());
-    r.HL      = mem->read(r.sp + immd);
+    // the carry is added along with val, so counts towards both carries
+    const uint8_t val   = load<Src>();
+    const bool    carry = r.carry();
+    const uint8_t res   = r.A + val + (carry ? 1 : 0);
 
-    r.reset_zero();
+    r.zero(res == 0);
     r.reset_sub();
+    r.half_carry(check_add_half_carry(r.A, val, carry));
+    r.carry(check_add_carry(r.A, val, carry));
 
-    if (immd >= 0)
-    {
-        r.half_carry(check_add_half_carry(r.sp, static_cast<uint16_t>(immd)));
-        r.carry(check_add_carry(r.sp, static_cast<uint16_t>(immd)));
-    }
-    else
-    {
-        immd *= -1;
-        r.half_carry(check_sub_half_carry(r.sp, static_cast<uint16_t>(immd)));
-        r.carry(check_sub_carry(r.sp, static_cast<uint16_t>(immd)));
-    }
-
-    return 12;
+    r.A = res;
 }
 
-uint32_t cpu::op_ld16_nn() noexcept
+template<operand Src>
+void cpu::op_sub() noexcept
 {
-    mem->write16(fetch16(), r.sp);
-    return 20;
-}
+    const uint8_t val = load<Src>();
+    const uint8_t res = r.A - val;
 
-uint32_t cpu::op_push(uint16_t val) noexcept
-{
-    mem->write16(r.sp, val);
-    r.sp -= 2;
-    return 16;
-}
+    r.zero(res == 0);
+    r.set_sub();
+    r.half_carry(check_sub_half_carry(r.A, val));
+    r.carry(check_sub_carry(r.A, val));
 
-uint32_t cpu::op_pop(uint16_t& reg) noexcept
-{
-    reg = mem->read16(r.sp);
-    r.sp += 2;
-    return 12;
+    r.A = res;
 }
 
-uint32_t cpu::op_add(uint8_t& reg, uint8_t val) noexcept
+template<operand Src>
+void cpu::op_sbc() noexcept
 {
-    auto res = reg + val;
+    // the carry is borrowed along with val, so counts towards both borrows
+    const uint8_t val   = load<Src>();
+    const bool    carry = r.carry();
+    const uint8_t res   = r.A - val - (carry ? 1 : 0);
 
     r.zero(res == 0);
-    r.reset_sub();
-    r.half_carry(check_add_half_carry(reg, val));
-    r.carry(check_add_carry(reg, val));
+    r.set_sub();
+    r.half_carry(check_sub_half_carry(r.A, val, carry));
+    r.carry(check_sub_carry(r.A, val, carry));
 
-    reg = res;
-    return 4;
+    r.A = res;
 }
 
-uint32_t cpu::op_add(uint8_t& reg, uint16_t addr) noexcept
+template<operand Src>
+void cpu::op_and() noexcept
 {
-    op_add(reg, mem->read(addr));
-    return 8;
-}
+    r.A &= load<Src>();
 
-uint32_t cpu::op_add_n(uint8_t& reg) noexcept
-{
-    op_add(reg, fetch());
-    return 8;
+    r.zero(r.A == 0);
+    r.reset_sub();
+    r.set_half_carry();
+    r.reset_carry();
 }
 
-uint32_t cpu::op_adc(uint8_t& reg, uint8_t val) noexcept
+template<operand Src>
+void cpu::op_or() noexcept
 {
-    auto res = reg + val;
-    if (r.carry()) res += 1;
+    r.A |= load<Src>();
 
-    r.zero(res == 0);
+    r.zero(r.A == 0);
     r.reset_sub();
-    r.half_carry(check_add_half_carry(reg, val));
-    r.carry(check_add_carry(reg, val));
-
-    reg = res;
-    return 4;
+    r.reset_half_carry();
+    r.reset_carry();
 }
 
-uint32_t cpu::op_adc(uint8_t& reg, uint16_t addr) noexcept
+template<operand Src>
+void cpu::op_xor() noexcept
 {
-    op_adc(reg, mem->read(addr));
-    return 8;
-}
+    r.A ^= load<Src>();
 
-uint32_t cpu::op_adc_n(uint8_t& reg) noexcept
-{
-    op_adc(reg, fetch());
-    return 8;
+    r.zero(r.A == 0);
+    r.reset_sub();
+    r.reset_half_carry();
+    r.reset_carry();
 }
 
-uint32_t cpu::op_sub(uint8_t& reg, uint8_t val) noexcept
+template<operand Src>
+void cpu::op_cp() noexcept
 {
-    auto res = reg - val;
+    const uint8_t val = load<Src>();
 
-    r.zero(res == 0);
+    r.zero(r.A - val == 0);
     r.set_sub();
-    r.half_carry(check_add_half_carry(reg, val));
-    r.carry(check_add_carry(reg, val));
-
-    reg = res;
-    return 4;
+    r.half_carry(check_sub_half_carry(r.A, val));
+    r.carry(check_sub_carry(r.A, val));
 }
 
-uint32_t cpu::op_sub(uint8_t& reg, uint16_t addr) noexcept
+template<operand O>
+void cpu::op_inc() noexcept
 {
-    op_sub(reg, mem->read(addr));
-    return 8;
-}
+    if constexpr (is_reg16(O))
+    {
+        ++reg16<O>(); // no flags affected
+    }
+    else
+    {
+        const uint8_t val = load<O>();
+        const uint8_t res = val + 1;
 
-uint32_t cpu::op_sub_n(uint8_t& reg) noexcept
-{
-    op_sub(reg, fetch());
-    return 8;
+        r.zero(res == 0);
+        r.reset_sub();
+        r.half_carry(check_add_half_carry(val, 1_u8));
+        // carry not affected
+
+        store<O>(res);
+    }
 }
 
-uint32_t cpu::op_sbc(uint8_t& reg, uint8_t val) noexcept
+template<operand O>
+void cpu::op_dec() noexcept
 {
-    auto res = reg - val;
-    if (r.carry()) res += 1;
+    if constexpr (is_reg16(O))
+    {
+        --reg16<O>(); // no flags affected
+    }
+    else
+    {
+        const uint8_t val = load<O>();
+        const uint8_t res = val - 1;
 
-    r.zero(res == 0);
-    r.set_sub();
-    r.half_carry(check_add_half_carry(reg, val));
-    r.carry(check_add_carry(reg, val));
+        r.zero(res == 0);
+        r.set_sub();
+        r.half_carry(check_sub_half_carry(val, 1_u8));
+        // carry not affected
 
-    reg = res;
-    return 4;
+        store<O>(res);
+    }
 }
 
-uint32_t cpu::op_sbc(uint8_t& reg, uint16_t addr) noexcept
+template<operand O>
+void cpu::op_push() noexcept
 {
-    op_sub(reg, mem->read(addr));
-    return 8;
+    push(reg16<O>());
 }
 
-uint32_t cpu::op_sbc_n(uint8_t& reg) noexcept
+template<operand O>
+void cpu::op_pop() noexcept
 {
-    op_sub(reg, fetch());
-    return 8;
+    reg16<O>() = pop();
 }
 
-uint32_t cpu::op_and(uint8_t& reg, uint8_t val) noexcept
+template<operand O>
+void cpu::op_swap() noexcept
 {
-    reg &= val;
+    const uint8_t val = load<O>();
+    const uint8_t res = (val & 0x0f) << 4 | (val & 0xf0) >> 4;
 
-    r.zero(reg == 0);
+    r.zero(res == 0);
     r.reset_sub();
-    r.set_half_carry();
+    r.reset_half_carry();
     r.reset_carry();
 
-    return 4;
+    store<O>(res);
 }
 
-uint32_t cpu::op_and(uint8_t& reg, uint16_t addr) noexcept
+template<operand O>
+void cpu::op_rlc() noexcept
 {
-    op_and(reg, mem->read(addr));
-    return 8;
-}
+    const uint8_t val = load<O>();
+    const uint8_t res = static_cast<uint8_t>(val << 1) | val >> 7;
 
-uint32_t cpu::op_and_n(uint8_t& reg) noexcept
-{
-    op_and(reg, fetch());
-    return 8;
+    r.zero(res == 0);
+    r.reset_sub();
+    r.reset_half_carry();
+    r.carry((val & 0x80) != 0);
+
+    store<O>(res);
 }
 
-uint32_t cpu::op_or(uint8_t& reg, uint8_t val) noexcept
+template<operand O>
+void cpu::op_rl() noexcept
 {
-    reg |= val;
+    const uint8_t val = load<O>();
+    const uint8_t res = static_cast<uint8_t>(val << 1) | (r.carry() ? 0x01 : 0x00);
 
-    r.zero(reg == 0);
+    r.zero(res == 0);
     r.reset_sub();
     r.reset_half_carry();
-    r.reset_carry();
+    r.carry((val & 0x80) != 0);
 
-    return 4;
+    store<O>(res);
 }
 
-uint32_t cpu::op_or(uint8_t& reg, uint16_t addr) noexcept
+template<operand O>
+void cpu::op_rrc() noexcept
 {
-    op_or(reg, mem->read(addr));
-    return 8;
+    const uint8_t val = load<O>();
+    const uint8_t res = val >> 1 | static_cast<uint8_t>(val << 7);
+
+    r.zero(res == 0);
+    r.reset_sub();
+    r.reset_half_carry();
+    r.carry((val & 0x01) != 0);
+
+    store<O>(res);
 }
 
-uint32_t cpu::op_or_n(uint8_t& reg) noexcept
+template<operand O>
+void cpu::op_rr() noexcept
 {
-    op_or(reg, fetch());
-    return 8;
+    const uint8_t val = load<O>();
+    const uint8_t res = val >> 1 | (r.carry() ? 0x80 : 0x00);
+
+    r.zero(res == 0);
+    r.reset_sub();
+    r.reset_half_carry();
+    r.carry((val & 0x01) != 0);
+
+    store<O>(res);
 }
 
-uint32_t cpu::op_xor(uint8_t& reg, uint8_t val) noexcept
+template<operand O>
+void cpu::op_sla() noexcept
 {
-    reg ^= val;
+    uint8_t val = load<O>();
+    auto    msb = (val & 0x80) != 0;
+    val <<= 1;
+    val &= 0xfe;
 
-    r.zero(reg == 0);
+    r.zero(val == 0);
     r.reset_sub();
     r.reset_half_carry();
-    r.reset_carry();
+    r.carry(msb);
 
-    return 4;
+    store<O>(val);
 }
 
-uint32_t cpu::op_xor(uint8_t& reg, uint16_t addr) noexcept
+template<operand O>
+void cpu::op_sra() noexcept
 {
-    op_xor(reg, mem->read(addr));
-    return 8;
+    uint8_t val = load<O>();
+    auto    lsb = (val & 0x01) != 0;
+    auto    msb = val & 0x80;
+    val >>= 1;
+    val |= msb;
+
+    r.zero(val == 0);
+    r.reset_sub();
+    r.reset_half_carry();
+    r.carry(lsb);
+
+    store<O>(val);
 }
 
-uint32_t cpu::op_xor_n(uint8_t& reg) noexcept
+template<operand O>
+void cpu::op_srl() noexcept
 {
-    op_xor(reg, fetch());
-    return 8;
+    uint8_t val = load<O>();
+    auto    lsb = (val & 0x01) != 0;
+    val >>= 1;
+    val &= 0x7f;
+
+    r.zero(val == 0);
+    r.reset_sub();
+    r.reset_half_carry();
+    r.carry(lsb);
+
+    store<O>(val);
 }
 
-uint32_t cpu::op_cp(uint8_t& reg, uint8_t val) noexcept
+template<operand O, uint8_t N>
+void cpu::op_bit() noexcept
 {
-    r.zero(reg - val == 0);
-    r.set_sub();
-    r.half_carry(check_sub_half_carry(reg, val));
-    r.carry(check_sub_carry(reg, val));
-
-    return 4;
+    r.zero((load<O>() & 1 << N) == 0);
+    r.reset_sub();
+    r.set_half_carry();
+    // carry unaffected
 }
 
-uint32_t cpu::op_cp(uint8_t& reg, uint16_t addr) noexcept
+template<operand O, uint8_t N>
+void cpu::op_set() noexcept
 {
-    op_cp(reg, mem->read(addr));
-    return 8;
+    store<O>(load<O>() | 1 << N);
 }
 
-uint32_t cpu::op_cp_n(uint8_t& reg) noexcept
+template<operand O, uint8_t N>
+void cpu::op_res() noexcept
 {
-    op_cp(reg, fetch());
-    return 8;
+    store<O>(load<O>() & ~(1 << N));
 }
 
-uint32_t cpu::op_inc(uint8_t& reg) noexcept
+template<opcode Info>
+uint32_t cpu::execute_op() noexcept
 {
-    auto res = reg + 1;
+    using enum mnemonic;
 
-    r.zero(res == 0);
-    r.reset_sub();
-    r.half_carry(check_add_half_carry(reg, 1_u8));
-    // carry not affected
+    constexpr auto name = Info.name;
+    constexpr auto dst  = Info.dst;
+    constexpr auto src  = Info.src;
 
-    reg = res;
-    return 4;
-}
+    if constexpr (name == NOP || name == ILLEGAL)
+    {
+        // TODO illegal opcodes actually hang the CPU
+    }
+    else if constexpr (name == STOP)
+    {
+        if (fetch() == 0x00) op_stop(); // TODO anything else actually hangs the CPU
+    }
+    else if constexpr (name == HALT) op_halt();
+    else if constexpr (name == LD || name == LDH)
+    {
+        if constexpr (src == operand::n16) reg16<dst>() = fetch16();
+        else if constexpr (src == operand::SP_e8) op_ld16_HL();
+        else if constexpr (src == operand::SP) mem->write16(fetch16(), r.sp);
+        else if constexpr (dst == operand::SP) r.sp = r.HL;
+        else store<dst>(load<src>());
+    }
+    else if constexpr (name == INC) op_inc<dst>();
+    else if constexpr (name == DEC) op_dec<dst>();
+    else if constexpr (name == ADD && dst == operand::SP) op_add_sp();
+    else if constexpr (name == ADD) op_add<src>();
+    else if constexpr (name == ADC) op_adc<src>();
+    else if constexpr (name == SUB) op_sub<src>();
+    else if constexpr (name == SBC) op_sbc<src>();
+    else if constexpr (name == AND) op_and<src>();
+    else if constexpr (name == XOR) op_xor<src>();
+    else if constexpr (name == OR) op_or<src>();
+    else if constexpr (name == CP) op_cp<src>();
+    else if constexpr (name == RLCA || name == RRCA || name == RLA || name == RRA)
+    {
+        if constexpr (name == RLCA) op_rlc<operand::A>();
+        else if constexpr (name == RRCA) op_rrc<operand::A>();
+        else if constexpr (name == RLA) op_rl<operand::A>();
+        else op_rr<operand::A>();
 
-uint32_t cpu::op_inc(uint16_t addr) noexcept
-{
-    auto val = mem->read(addr);
-    op_inc(val);
-    mem->write(addr, val);
-    return 12;
-}
+        // unlike the prefixed rotates, these always clear Z
+        r.reset_zero();
+    }
+    else if constexpr (name == DAA) op_daa();
+    else if constexpr (name == CPL) op_cpl();
+    else if constexpr (name == SCF) op_scf();
+    else if constexpr (name == CCF) op_ccf();
+    else if constexpr (name == JR || name == JP || name == CALL)
+    {
+        uint16_t target = 0;
+        if constexpr (name == JR)
+        {
+            const auto offset = static_cast<int8_t>(fetch());
+            target            = r.pc + offset;
+        }
+        else if constexpr (src == operand::HL) target = r.HL;
+        else target = fetch16();
 
-uint32_t cpu::op_dec(uint8_t& reg) noexcept
-{
-    auto res = reg - 1;
+        // the operand is read either way
+        if constexpr (is_condition(dst))
+        {
+            if (!taken<dst>()) return Info.cycles;
+        }
 
-    r.zero(res == 0);
-    r.set_sub();
-    r.half_carry(check_sub_half_carry(reg, 1_u8));
-    // carry not affected
+        if constexpr (name == CALL) op_call(target);
+        else r.pc = target;
+    }
+    else if constexpr (name == RET)
+    {
+        if constexpr (is_condition(dst))
+        {
+            if (!taken<dst>()) return Info.cycles;
+        }
 
-    return 4;
-}
+        op_ret();
+    }
+    else if constexpr (name == RETI) op_reti();
+    else if constexpr (name == RST) op_rst(Info.value);
+    else if constexpr (name == PUSH) op_push<src>();
+    else if constexpr (name == POP) op_pop<dst>();
+    else if constexpr (name == DI) op_di();
+    else if constexpr (name == EI) op_ei();
+    else if constexpr (name == PREFIX) return execute_ext(fetch());
+    else if constexpr (name == RLC) op_rlc<dst>();
+    else if constexpr (name == RRC) op_rrc<dst>();
+    else if constexpr (name == RL) op_rl<dst>();
+    else if constexpr (name == RR) op_rr<dst>();
+    else if constexpr (name == SLA) op_sla<dst>();
+    else if constexpr (name == SRA) op_sra<dst>();
+    else if constexpr (name == SWAP) op_swap<dst>();
+    else if constexpr (name == SRL) op_srl<dst>();
+    else if constexpr (name == BIT) op_bit<dst, Info.value>();
+    else if constexpr (name == RES) op_res<dst, Info.value>();
+    else if constexpr (name == SET) op_set<dst, Info.value>();
+    else static_assert(name == NOP, "unhandled mnemonic");
 
-uint32_t cpu::op_dec(uint16_t addr) noexcept
-{
-    auto val = mem->read(addr);
-    op_dec(val);
-    mem->write(addr, val);
-    return 12;
+    // branches that got this far were taken
+    if constexpr (is_condition(dst)) return Info.taken;
+    else return Info.cycles;
 }
 
-uint32_t cpu::op_add(uint16_t& reg, uint16_t val) noexcept
+uint32_t cpu::execute(uint8_t op) noexcept
 {
-    // zero not affected
-    r.reset_sub();
-    r.half_carry(check_add_half_carry(reg, val));
-    r.carry(check_add_carry(reg, val));
+    // every entry an instantiation of execute_op for the matching opcode
+    static constexpr auto handlers = []<size_t... I>(std::index_sequence<I...>)
+    { return std::array<uint32_t (cpu::*)() noexcept, sizeof...(I)>{&cpu::execute_op<opcodes[I]>...}; }(
+        std::make_index_sequence<opcodes.size()>{});
 
-    reg += val;
-    return 8;
+    return (this->*handlers[op])();
 }
 
-uint32_t cpu::op_add_sp() noexcept
+uint32_t cpu::execute_ext(uint8_t op) noexcept
 {
-    r.reset_zero();
-    r.reset_sub();
+    static constexpr auto handlers = []<size_t... I>(std::index_sequence<I...>)
+    { return std::array<uint32_t (cpu::*)() noexcept, sizeof...(I)>{&cpu::execute_op<ext_opcodes[I]>...}; }(
+        std::make_index_sequence<ext_opcodes.size()>{});
 
-    auto val = static_cast<int8_t>(fetch());
+    return (this->*handlers[op])();
+}
 
-    if (val >= 0)
-    {
-        r.half_carry(check_add_half_carry(r.sp, static_cast<uint16_t>(val)));
-        r.carry(check_add_carry(r.sp, static_cast<uint16_t>(val)));
-        r.sp += val;
-    }
-    else
-    {
-        val *= -1;
-        r.half_carry(check_sub_half_carry(r.sp, static_cast<uint16_t>(val)));
-        r.carry(check_sub_carry(r.sp, static_cast<uint16_t>(val)));
-        r.sp -= val;
-    }
+void cpu::trace(uint16_t pc) noexcept
+{
+    std::array<uint8_t, 3> code{};
+    for (size_t i = 0; i < code.size(); ++i) code[i] = mem->peek(static_cast<uint16_t>(pc + i));
 
-    return 16;
+    std::string text;
+    disassemble(pc, code, text);
+    SDL_LogVerbose(SDL_LOG_CATEGORY_APPLICATION, "%04X: %s", pc, text.c_str());
 }
 
-uint32_t cpu::op_inc16(uint16_t& reg) noexcept
+void cpu::op_ld16_HL() noexcept
 {
-    reg++;
-    return 8;
+    r.HL = sp_plus_e8();
 }
 
-uint32_t cpu::op_dec16(uint16_t& reg) noexcept
+void cpu::push(uint16_t val) noexcept
 {
-    reg--;
-    return 8;
+    // the stack grows down, SP pointing at the last value pushed
+    r.sp -= 2;
+    mem->write16(r.sp, val);
 }
 
-uint32_t cpu::op_swap(uint8_t& reg) noexcept
+uint16_t cpu::pop() noexcept
 {
-    reg = (reg & 0x0f << 4) | (reg & 0xf0 >> 4);
-
-    r.zero(reg == 0);
-    r.reset_sub();
-    r.reset_half_carry();
-    r.reset_carry();
+    const uint16_t val = mem->read16(r.sp);
+    r.sp += 2;
+    return val;
+}
 
-    return 4;
+void cpu::op_add_sp() noexcept
+{
+    r.sp = sp_plus_e8();
 }
 
-uint32_t cpu::op_swap(uint16_t addr) noexcept
+uint16_t cpu::sp_plus_e8() noexcept
 {
-    auto val = mem->read(addr);
-    val      = (val & 0x0f) << 4 | (val & 0xf0) >> 4;
-    mem->write(addr, val);
+    // the offset is signed, but the flags come from adding its byte to SP's low byte, whichever way it goes
+    const uint8_t e8  = fetch();
+    const auto    low = static_cast<uint8_t>(r.sp);
 
-    r.zero(val == 0);
+    r.reset_zero();
     r.reset_sub();
-    r.reset_half_carry();
-    r.reset_carry();
+    r.half_carry(check_add_half_carry(low, e8));
+    r.carry(check_add_carry(low, e8));
 
-    return 12;
+    return r.sp + static_cast<int8_t>(e8);
 }
 
-uint32_t cpu::op_daa() noexcept
+void cpu::op_daa() noexcept
 {
     // NOTE: this is a complex and poorly documented instruction
 
@@ -482,11 +602,9 @@ uint32_t cpu::op_daa() noexcept
     // sub flag not affected
     r.reset_half_carry();
     // carry flag is set (or unchanged) above
-
-    return 4;
 }
 
-uint32_t cpu::op_cpl() noexcept
+void cpu::op_cpl() noexcept
 {
     r.A = ~r.A;
 
@@ -494,387 +612,87 @@ uint32_t cpu::op_cpl() noexcept
     r.set_sub();
     r.set_half_carry();
     // carry unaffected
-
-    return 4;
 }
 
-uint32_t cpu::op_ccf() noexcept
+void cpu::op_ccf() noexcept
 {
     // zero unaffected
     r.reset_sub();
     r.reset_half_carry();
     r.carry(!r.carry());
-    return 4;
 }
 
-uint32_t cpu::op_scf() noexcept
+void cpu::op_scf() noexcept
 {
     // zero unaffected
     r.reset_sub();
     r.reset_half_carry();
     r.set_carry();
-    return 4;
 }
 
-uint32_t cpu::op_nop() noexcept { return 4; }
-
-uint32_t cpu::op_halt() noexcept
+void cpu::op_halt() noexcept
 {
     pipeline.push(action::halt);
-    return 4;
 }
 
-uint32_t cpu::op_stop() noexcept
+void cpu::op_stop() noexcept
 {
+    // on color hardware, an armed speed switch is all STOP does
+    if (mem->speed_switch_armed())
+    {
+        mem->switch_speed();
+        return;
+    }
+
     op_halt();
     // TODO halt display
     // TODO keep paused until a button is pressed
-    return 4;
 }
 
-uint32_t cpu::op_di() noexcept
+void cpu::op_di() noexcept
 {
     /* pipeline.push(action::disable_interrupts); */
     interrupts_enabled = false;
-    return 4;
 }
 
-uint32_t cpu::op_ei() noexcept
+void cpu::op_ei() noexcept
 {
     pipeline.push(action::enable_interrupts);
-    return 4;
-}
-
-uint32_t cpu::op_rlc(uint8_t& reg) noexcept
-{
-    auto msb = (reg & 0x80) != 0;
-    reg <<= 1;
-
-    if (r.carry()) reg |= 0x01;
-    else reg &= 0xfe;
-
-    r.zero(reg == 0);
-    r.reset_sub();
-    r.reset_half_carry();
-    r.carry(msb);
-
-    return 4;
-}
-
-uint32_t cpu::op_rlc(uint16_t addr) noexcept
-{
-    auto val = mem->read(addr);
-    op_rlc(val);
-    mem->write(addr, val);
-    return 12;
-}
-
-uint32_t cpu::op_rl(uint8_t& reg) noexcept
-{
-    auto msb = (reg & 0x80) != 0;
-    reg <<= 1;
-
-    r.zero(reg == 0);
-    r.reset_sub();
-    r.reset_half_carry();
-    r.carry(msb);
-
-    return 4;
-}
-
-uint32_t cpu::op_rl(uint16_t addr) noexcept
-{
-    auto val = mem->read(addr);
-    op_rl(val);
-    mem->write(addr, val);
-    return 12;
-}
-
-uint32_t cpu::op_rrc(uint8_t& reg) noexcept
-{
-    auto lsb = (reg & 0x01) != 0;
-    reg >>= 1;
-
-    if (r.carry()) reg |= 0x80;
-    else reg &= 0x7f;
-
-    r.zero(reg == 0);
-    r.reset_sub();
-    r.reset_half_carry();
-    r.carry(lsb);
-
-    return 4;
-}
-
-uint32_t cpu::op_rrc(uint16_t addr) noexcept
-{
-    auto val = mem->read(addr);
-    op_rrc(val);
-    mem->write(addr, val);
-    return 12;
-}
-
-uint32_t cpu::op_rr(uint8_t& reg) noexcept
-{
-    auto lsb = (reg & 0x01) != 0;
-    reg >>= 1;
-
-    r.zero(reg == 0);
-    r.reset_sub();
-    r.reset_half_carry();
-    r.carry(lsb);
-
-    return 4;
-}
-
-uint32_t cpu::op_rr(uint16_t addr) noexcept
-{
-    auto val = mem->read(addr);
-    op_rr(val);
-    mem->write(addr, val);
-    return 12;
-}
-
-uint32_t cpu::op_sla(uint8_t& reg) noexcept
-{
-    auto msb = (reg & 0x80) != 0;
-    reg <<= 1;
-    reg &= 0xfe;
-
-    r.zero(reg == 0);
-    r.reset_sub();
-    r.reset_half_carry();
-    r.carry(msb);
-
-    return 4;
-}
-
-uint32_t cpu::op_sla(uint16_t addr) noexcept
-{
-    auto val = mem->read(addr);
-    op_sla(val);
-    mem->write(addr, val);
-    return 12;
-}
-
-uint32_t cpu::op_sra(uint8_t& reg) noexcept
-{
-    auto lsb = (reg & 0x01) != 0;
-    auto msb = reg & 0x80;
-    reg >>= 1;
-    reg |= msb;
-
-    r.zero(reg == 0);
-    r.reset_sub();
-    r.reset_half_carry();
-    r.carry(lsb);
-
-    return 4;
-}
-
-uint32_t cpu::op_sra(uint16_t addr) noexcept
-{
-    auto val = mem->read(addr);
-    op_sra(val);
-    mem->write(addr, val);
-    return 12;
 }
 
-uint32_t cpu::op_srl(uint8_t& reg) noexcept
-{
-    auto lsb = (reg & 0x01) != 0;
-    reg >>= 1;
-    reg &= 0x7f;
-
-    r.zero(reg == 0);
-    r.reset_sub();
-    r.reset_half_carry();
-    r.carry(lsb);
-
-    return 4;
-}
-
-uint32_t cpu::op_srl(uint16_t addr) noexcept
-{
-    auto val = mem->read(addr);
-    op_srl(val);
-    mem->write(addr, val);
-    return 12;
-}
-
-uint32_t cpu::op_bit(uint8_t& reg, uint8_t n) noexcept
-{
-    r.zero((reg & 1 << n) == 0);
-    r.reset_sub();
-    r.set_half_carry();
-    // carry unaffected
-    return 4;
-}
-
-uint32_t cpu::op_bit(uint16_t addr, uint8_t n) noexcept
-{
-    auto val = mem->read(addr);
-    op_bit(val, n);
-    mem->write(addr, val);
-    return 12;
-}
-
-uint32_t cpu::op_set(uint8_t& reg, uint8_t n) noexcept
-{
-    reg |= 1 << n;
-    return 4;
-}
-
-uint32_t cpu::op_set(uint16_t addr, uint8_t n) noexcept
-{
-    auto val = mem->read(addr);
-    op_bit(val, n);
-    mem->write(addr, val);
-    return 12;
-}
-
-uint32_t cpu::op_res(uint8_t& reg, uint8_t n) noexcept
-{
-    reg &= ~(1 << n);
-    return 4;
-}
-
-uint32_t cpu::op_res(uint16_t addr, uint8_t n) noexcept
-{
-    auto val = mem->read(addr);
-    op_bit(val, n);
-    mem->write(addr, val);
-    return 12;
-}
-
-uint32_t cpu::op_jp() noexcept
-{
-    r.pc = fetch16();
-    return 12;
-}
-
-uint32_t cpu::op_jp(uint16_t addr) noexcept
-{
-    r.pc = addr;
-    return 4;
-}
-
-uint32_t cpu::op_jp(condition cond) noexcept
-{
-    switch (cond)
-    {
-    case condition::NZ:
-        if (!r.zero()) op_jp();
-        break;
-    case condition::Z:
-        if (r.zero()) op_jp();
-        break;
-    case condition::NC:
-        if (!r.carry()) op_jp();
-        break;
-    case condition::C:
-        if (r.carry()) op_jp();
-        break;
-    }
-    return 12;
-}
-
-uint32_t cpu::op_jr() noexcept
-{
-    r.pc += static_cast<int8_t>(fetch());
-    return 8;
-}
-
-uint32_t cpu::op_jr(condition cond) noexcept
+bool cpu::check(condition cond) const noexcept
 {
     switch (cond)
     {
-    case condition::NZ:
-        if (!r.zero()) op_jr();
-        break;
-    case condition::Z:
-        if (r.zero()) op_jr();
-        break;
-    case condition::NC:
-        if (!r.carry()) op_jr();
-        break;
-    case condition::C:
-        if (r.carry()) op_jr();
-        break;
+    case condition::NZ: return !r.zero();
+    case condition::Z: return r.zero();
+    case condition::NC: return !r.carry();
+    case condition::C: return r.carry();
     }
-    return 8;
+    return false;
 }
 
-uint32_t cpu::op_call() noexcept
+void cpu::op_call(uint16_t addr) noexcept
 {
-    auto addr = fetch16();
-    op_push(r.pc);
+    push(r.pc);
     r.pc = addr;
-    return 12;
 }
 
-uint32_t cpu::op_call(condition cond) noexcept
+void cpu::op_rst(uint8_t base) noexcept
 {
-    switch (cond)
-    {
-    case condition::NZ:
-        if (!r.zero()) op_call();
-        break;
-    case condition::Z:
-        if (r.zero()) op_call();
-        break;
-    case condition::NC:
-        if (!r.carry()) op_call();
-        break;
-    case condition::C:
-        if (r.carry()) op_call();
-        break;
-    }
-    return 12;
+    // a one byte call to one of the fixed addresses in page zero
+    op_call(base);
 }
 
-uint32_t cpu::op_rst(uint8_t base) noexcept
+void cpu::op_ret() noexcept
 {
-    // TODO wtf is this supposed to do, and why so many cycles?
-
-    op_push(r.pc);
-    r.pc = mem->read(base);
-    return 32;
-}
-
-uint32_t cpu::op_ret() noexcept
-{
-    uint16_t addr = 0;
-    op_pop(addr);
-    r.pc = addr;
-    return 8;
-}
-
-uint32_t cpu::op_ret(condition cond) noexcept
-{
-    switch (cond)
-    {
-    case condition::NZ:
-        if (!r.zero()) op_ret();
-        break;
-    case condition::Z:
-        if (r.zero()) op_ret();
-        break;
-    case condition::NC:
-        if (!r.carry()) op_ret();
-        break;
-    case condition::C:
-        if (r.carry()) op_ret();
-        break;
-    }
-    return 8;
+    r.pc = pop();
 }
 
-uint32_t cpu::op_reti() noexcept
+void cpu::op_reti() noexcept
 {
     op_ret();
     interrupts_enabled = true;
-    return 8;
 }
 
 }
@@ -0,0 +1,166 @@
+#include "debugger.hpp"
+
+#include <algorithm>
+#include <utility>
+
+#include "cpu.hpp"
+#include "memory.hpp"
+
+namespace gb
+{
+
+static bool includes(debugger::access kind, debugger::access what) noexcept
+{
+    return (static_cast<uint8_t>(kind) & static_cast<uint8_t>(what)) != 0;
+}
+
+debugger::debugger(cpu& target) noexcept
+    : target{target}
+    , next_id{1}
+{
+    target.debug         = this;
+    target.bus().watcher = this;
+    target.debug_stop    = false;
+}
+
+debugger::~debugger()
+{
+    breakpoints.clear();
+    watchpoints.clear();
+    update();
+
+    target.debug         = nullptr;
+    target.bus().watcher = nullptr;
+    target.debug_stop    = false;
+}
+
+std::error_code debugger::add_breakpoint(uint16_t addr, std::string_view condition, uint32_t& id)
+{
+    expression cond;
+    if (auto err = expression::parse(condition, cond); err) return err;
+
+    id = next_id++;
+    breakpoints.push_back({.id = id, .addr = addr, .condition = std::move(cond)});
+    update();
+    return {};
+}
+
+std::error_code debugger::add_watchpoint(uint16_t         first,
+                                         uint16_t         last,
+                                         access           kind,
+                                         std::string_view condition,
+                                         uint32_t&        id)
+{
+    if (last < first) return std::make_error_code(std::errc::invalid_argument);
+
+    expression cond;
+    if (auto err = expression::parse(condition, cond); err) return err;
+
+    id = next_id++;
+    watchpoints.push_back({.id = id, .first = first, .last = last, .kind = kind, .condition = std::move(cond)});
+    update();
+    return {};
+}
+
+bool debugger::remove(uint32_t id) noexcept
+{
+    const auto removed = std::erase_if(breakpoints, [id](const breakpoint& b) { return b.id == id; })
+                       + std::erase_if(watchpoints, [id](const watchpoint& w) { return w.id == id; });
+    if (removed == 0) return false;
+
+    update();
+    return true;
+}
+
+void debugger::clear() noexcept
+{
+    breakpoints.clear();
+    watchpoints.clear();
+    update();
+}
+
+void debugger::resume() noexcept
+{
+    if (last.has_value() && last->reason == stop::kind::breakpoint) resume_pc = last->pc;
+
+    last.reset();
+    target.debug_stop = false;
+}
+
+bool debugger::breaks_at(uint16_t pc) noexcept
+{
+    // the instruction right after a resume is the one stopped at, which runs this time
+    if (resume_pc.has_value())
+    {
+        const bool resuming = *resume_pc == pc;
+        resume_pc.reset();
+        if (resuming) return false;
+    }
+
+    if (!break_at[pc]) return false;
+
+    // stepping again without resuming stays put
+    if (last.has_value() && last->reason == stop::kind::breakpoint && last->pc == pc)
+    {
+        target.stop();
+        return true;
+    }
+
+    for (const auto& b : breakpoints)
+    {
+        if (b.addr != pc || b.condition.evaluate(target.regs(), target.bus()) == 0) continue;
+
+        hit(stop::kind::breakpoint, b.id, pc, target.bus().peek(pc));
+        return true;
+    }
+
+    return false;
+}
+
+void debugger::on_read(uint16_t addr, uint8_t val) noexcept { check_watches(access::read, addr, val); }
+
+void debugger::on_write(uint16_t addr, uint8_t val) noexcept { check_watches(access::write, addr, val); }
+
+void debugger::check_watches(access kind, uint16_t addr, uint8_t val) noexcept
+{
+    for (const auto& w : watchpoints)
+    {
+        if (addr < w.first || addr > w.last || !includes(w.kind, kind)) continue;
+        if (w.condition.evaluate(target.regs(), target.bus(), val) == 0) continue;
+
+        hit(kind == access::read ? stop::kind::read : stop::kind::write, w.id, addr, val);
+        return;
+    }
+}
+
+void debugger::hit(stop::kind reason, uint32_t id, uint16_t addr, uint8_t val) noexcept
+{
+    last = stop{.reason = reason, .id = id, .pc = target.regs().pc, .addr = addr, .value = val};
+
+    // a watchpoint is hit partway through an instruction, which finishes before the cpu stops
+    target.debug_stop = true;
+    target.stop();
+}
+
+void debugger::update() noexcept
+{
+    break_at.reset();
+    for (const auto& b : breakpoints) break_at.set(b.addr);
+
+    auto& mem = target.bus();
+    mem.watched.fill(0);
+    for (const auto& w : watchpoints)
+    {
+        uint8_t flags = 0;
+        if (includes(w.kind, access::read)) flags |= memory::watch_reads;
+        if (includes(w.kind, access::write)) flags |= memory::watch_writes;
+
+        for (size_t page = w.first >> memory::page_bits; page <= (w.last >> memory::page_bits); ++page)
+            mem.watched[page] |= flags;
+    }
+    mem.remap();
+
+    target.debug_mode = target.tracing || !breakpoints.empty();
+}
+
+}
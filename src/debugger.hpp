@@ -0,0 +1,121 @@
+#pragma once
+
+#include <bitset>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#include "expression.hpp"
+
+namespace gb
+{
+
+struct cpu;
+
+// debugger stops a cpu at breakpoints, before the instruction at an address runs, and at watchpoints, after an
+// instruction that read or wrote an address in a range. Either can be given a condition (see expression.hpp), and then
+// only stops the cpu if it holds.
+//
+// None of it costs anything while nothing is set. Breakpoints are checked at the same point in cpu::step as tracing,
+// so only once per instruction while there are any. Watchpoints take the pages they cover out of memory's page tables:
+// accesses to those pages take the slow path, where they are checked, while every other page keeps its direct access.
+//
+// Instruction fetches are reads like any other, so a read watchpoint on code stops when it runs.
+struct debugger
+{
+public:
+    enum class access : uint8_t
+    {
+        read  = 1U << 0U,
+        write = 1U << 1U,
+        any   = read | write,
+    };
+
+    // stop is why the cpu stopped
+    struct stop
+    {
+        enum class kind : uint8_t
+        {
+            breakpoint,
+            read,
+            write,
+        };
+
+        kind     reason;
+        uint32_t id;    // of the breakpoint or watchpoint
+        uint16_t pc;    // when hit, which for a watchpoint is partway through the instruction
+        uint16_t addr;  // watched address accessed, or the breakpoint's
+        uint8_t  value; // read or written
+    };
+
+    // Only one debugger can be attached to a cpu at a time, and it must be destroyed before the cpu is.
+    explicit debugger(cpu& target) noexcept;
+    ~debugger();
+
+    debugger(const debugger&)            = delete;
+    debugger& operator=(const debugger&) = delete;
+
+    // add_breakpoint and add_watchpoint set id to the new point's, failing if condition doesn't parse
+    std::error_code add_breakpoint(uint16_t addr, std::string_view condition, uint32_t& id);
+    std::error_code add_watchpoint(uint16_t         first,
+                                   uint16_t         last,
+                                   access           kind,
+                                   std::string_view condition,
+                                   uint32_t&        id);
+
+    // remove removes the breakpoint or watchpoint id, returning false if there is none
+    bool remove(uint32_t id) noexcept;
+    void clear() noexcept;
+
+    // stopped is why the cpu last stopped, until it is resumed
+    [[nodiscard]] const std::optional<stop>& stopped() const noexcept { return last; }
+
+    // resume clears the stop, so that running on goes past the breakpoint the cpu was stopped at
+    void resume() noexcept;
+
+private:
+    friend struct cpu;
+    friend struct memory;
+
+    struct breakpoint
+    {
+        uint32_t   id;
+        uint16_t   addr;
+        expression condition;
+    };
+
+    struct watchpoint
+    {
+        uint32_t   id;
+        uint16_t   first;
+        uint16_t   last; // inclusive
+        access     kind;
+        expression condition;
+    };
+
+    // breaks_at is called by the cpu before every instruction while there are breakpoints, returning true if the cpu
+    // stops before the one at pc
+    bool breaks_at(uint16_t pc) noexcept;
+
+    // on_read and on_write are called by memory for the program's accesses to watched pages
+    void on_read(uint16_t addr, uint8_t val) noexcept;
+    void on_write(uint16_t addr, uint8_t val) noexcept;
+    void check_watches(access kind, uint16_t addr, uint8_t val) noexcept;
+
+    void hit(stop::kind reason, uint32_t id, uint16_t addr, uint8_t val) noexcept;
+
+    // update points the cpu and memory at what is set now
+    void update() noexcept;
+
+    cpu&                    target;
+    std::vector<breakpoint> breakpoints;
+    std::vector<watchpoint> watchpoints;
+    std::bitset<0x10000>    break_at; // addresses with breakpoints
+    std::optional<stop>     last;
+    uint32_t                next_id;
+    std::optional<uint16_t> resume_pc; // breakpoint to let the cpu past, once
+};
+
+}
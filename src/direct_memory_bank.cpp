@@ -3,7 +3,7 @@
 namespace gb
 {
 
-direct_memory_bank::direct_memory_bank(cartridge& cart)
+direct_memory_bank::direct_memory_bank(const cartridge& cart)
     : cart{cart}
 {}
 
@@ -6,18 +6,20 @@
 namespace gb
 {
 
+// direct_memory_bank is a cartridge without a controller: ROM mapped straight in, and writes to it go nowhere, so the
+// cartridge can be shared by any number of instances.
 class direct_memory_bank : public memory_bank_controller
 {
 public:
-    explicit direct_memory_bank(cartridge& cart);
+    explicit direct_memory_bank(const cartridge& cart);
 
-    uint8_t read(uint16_t addr) noexcept override { return cart.data[addr]; }
+    uint8_t read(uint16_t addr) noexcept override { return addr < cart.data.size() ? cart.data[addr] : 0xFF; }
     /* uint16_t read16(uint16_t addr) noexcept override; */
-    void write(uint16_t addr, uint8_t val) noexcept override { cart.data[addr] = val; }
+    void write(uint16_t /* addr */, uint8_t /* val */) noexcept override {}
     /* void     write16(uint16_t addr, uint16_t val) noexcept override; */
 
 private:
-    cartridge& cart;
+    const cartridge& cart;
 };
 
 }
@@ -0,0 +1,189 @@
+#include "disassembler.hpp"
+
+#include <array>
+#include <cstdio>
+
+namespace gb
+{
+
+const char* mnemonic_name(mnemonic name) noexcept
+{
+    using enum mnemonic;
+
+    switch (name)
+    {
+    case NOP: return "NOP";
+    case STOP: return "STOP";
+    case HALT: return "HALT";
+    case LD: return "LD";
+    case LDH: return "LDH";
+    case INC: return "INC";
+    case DEC: return "DEC";
+    case ADD: return "ADD";
+    case ADC: return "ADC";
+    case SUB: return "SUB";
+    case SBC: return "SBC";
+    case AND: return "AND";
+    case XOR: return "XOR";
+    case OR: return "OR";
+    case CP: return "CP";
+    case RLCA: return "RLCA";
+    case RRCA: return "RRCA";
+    case RLA: return "RLA";
+    case RRA: return "RRA";
+    case DAA: return "DAA";
+    case CPL: return "CPL";
+    case SCF: return "SCF";
+    case CCF: return "CCF";
+    case JR: return "JR";
+    case JP: return "JP";
+    case CALL: return "CALL";
+    case RET: return "RET";
+    case RETI: return "RETI";
+    case RST: return "RST";
+    case PUSH: return "PUSH";
+    case POP: return "POP";
+    case DI: return "DI";
+    case EI: return "EI";
+    case PREFIX: return "PREFIX";
+    case ILLEGAL: return "DB"; // not an instruction, so shown as data
+    case RLC: return "RLC";
+    case RRC: return "RRC";
+    case RL: return "RL";
+    case RR: return "RR";
+    case SLA: return "SLA";
+    case SRA: return "SRA";
+    case SWAP: return "SWAP";
+    case SRL: return "SRL";
+    case BIT: return "BIT";
+    case RES: return "RES";
+    case SET: return "SET";
+    }
+    return "?";
+}
+
+static void append_hex(std::string& out, uint32_t val, int digits)
+{
+    std::array<char, 8> buf{};
+    std::snprintf(buf.data(), buf.size(), "$%0*X", digits, val);
+    out += buf.data();
+}
+
+// append_operand formats o, whose operand bytes (if any) start at args
+static void append_operand(std::string& out, const opcode& info, operand o, uint16_t pc, const uint8_t* args)
+{
+    using enum operand;
+
+    const uint16_t imm16 = static_cast<uint16_t>(args[0] | (args[1] << 8));
+    const auto     e     = static_cast<int8_t>(args[0]);
+
+    switch (o)
+    {
+    case none: break;
+
+    case A: out += 'A'; break;
+    case B: out += 'B'; break;
+    case C: out += 'C'; break;
+    case D: out += 'D'; break;
+    case E: out += 'E'; break;
+    case H: out += 'H'; break;
+    case L: out += 'L'; break;
+    case AF: out += "AF"; break;
+    case BC: out += "BC"; break;
+    case DE: out += "DE"; break;
+    case HL: out += "HL"; break;
+    case SP: out += "SP"; break;
+
+    case at_BC: out += "(BC)"; break;
+    case at_DE: out += "(DE)"; break;
+    case at_HL: out += "(HL)"; break;
+    case at_HLI: out += "(HL+)"; break;
+    case at_HLD: out += "(HL-)"; break;
+    case at_C: out += "($FF00+C)"; break;
+
+    case n8: append_hex(out, args[0], 2); break;
+    case n16: append_hex(out, imm16, 4); break;
+
+    case at_n8:
+        out += '(';
+        append_hex(out, 0xFF00U + args[0], 4);
+        out += ')';
+        break;
+
+    case at_n16:
+        out += '(';
+        append_hex(out, imm16, 4);
+        out += ')';
+        break;
+
+    case e8:
+        if (info.name == mnemonic::JR)
+        {
+            // relative to the end of the instruction
+            append_hex(out, static_cast<uint16_t>(pc + info.length + e), 4);
+            break;
+        }
+
+        // ADD SP,e
+        if (e < 0) out += '-';
+        append_hex(out, static_cast<uint32_t>(e < 0 ? -e : e), 2);
+        break;
+
+    case SP_e8:
+        out += e < 0 ? "SP-" : "SP+";
+        append_hex(out, static_cast<uint32_t>(e < 0 ? -e : e), 2);
+        break;
+
+    case if_NZ: out += "NZ"; break;
+    case if_Z: out += 'Z'; break;
+    case if_NC: out += "NC"; break;
+    case if_C: out += 'C'; break;
+
+    case bit: out += static_cast<char>('0' + info.value); break;
+    case vector: append_hex(out, info.value, 2); break;
+    }
+}
+
+size_t disassemble(uint16_t pc, std::span<const uint8_t> code, std::string& out)
+{
+    if (code.empty()) return 0;
+    if (code[0] == 0xCB && code.size() < 2) return 0;
+
+    const opcode& info = lookup(code[0], code.size() > 1 ? code[1] : 0);
+    if (code.size() < info.length) return 0;
+
+    out += mnemonic_name(info.name);
+    if (info.name == mnemonic::ILLEGAL)
+    {
+        out += ' ';
+        append_hex(out, code[0], 2);
+        return info.length;
+    }
+
+    // operand bytes follow the opcode, and for 0xCB prefixed instructions there are none
+    std::array<uint8_t, 2> args{};
+    for (size_t i = 1; i < info.length && code[0] != 0xCB; ++i) args[i - 1] = code[i];
+
+    // BIT, RES and SET put the bit number first
+    const bool     swapped = info.src == operand::bit;
+    const operand  first   = swapped ? info.src : info.dst;
+    const operand  second  = swapped ? info.dst : info.src;
+    const uint8_t* arg     = args.data();
+
+    if (first != operand::none)
+    {
+        out += ' ';
+        append_operand(out, info, first, pc, arg);
+        arg += operand_bytes(first);
+    }
+
+    if (second != operand::none)
+    {
+        out += first != operand::none ? ", " : " ";
+        append_operand(out, info, second, pc, arg);
+    }
+
+    return info.length;
+}
+
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+
+#include "opcodes.hpp"
+
+namespace gb
+{
+
+[[nodiscard]] const char* mnemonic_name(mnemonic name) noexcept;
+
+// disassemble appends the instruction at the start of code, located at pc, to out, resolving relative jumps to their
+// targets. It returns the instruction's length, or 0 without touching out if code is too short to hold it.
+size_t disassemble(uint16_t pc, std::span<const uint8_t> code, std::string& out);
+
+}
@@ -0,0 +1,281 @@
+#include "expression.hpp"
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cctype>
+
+#include "memory.hpp"
+
+namespace gb
+{
+
+// in the order of op::reg's arg
+constexpr std::array<std::string_view, 14> register_names = {
+    "A", "F", "B", "C", "D", "E", "H", "L", "AF", "BC", "DE", "HL", "SP", "PC",
+};
+
+static uint32_t read_register(const registers& r, uint16_t index) noexcept
+{
+    switch (index)
+    {
+    case 0: return r.A;
+    case 1: return r.F;
+    case 2: return r.B;
+    case 3: return r.C;
+    case 4: return r.D;
+    case 5: return r.E;
+    case 6: return r.H;
+    case 7: return r.L;
+    case 8: return r.AF;
+    case 9: return r.BC;
+    case 10: return r.DE;
+    case 11: return r.HL;
+    case 12: return r.sp;
+    default: return r.pc;
+    }
+}
+
+static bool equal_nocase(std::string_view a, std::string_view b) noexcept
+{
+    return std::ranges::equal(a, b, [](char x, char y) { return std::toupper(x) == std::toupper(y); });
+}
+
+// parser is a recursive descent parser, emitting terms as it goes
+struct expression::parser
+{
+    struct binary
+    {
+        std::string_view token;
+        op               code;
+    };
+
+    // binary operators by precedence, loosest first; within a level, longer tokens come first
+    static constexpr std::array<std::array<binary, 4>, 8> levels = {{
+        {{{"||", op::logical_or}}},
+        {{{"&&", op::logical_and}}},
+        {{{"|", op::bit_or}}},
+        {{{"^", op::bit_xor}}},
+        {{{"&", op::bit_and}}},
+        {{{"==", op::eq}, {"!=", op::ne}}},
+        {{{"<=", op::le}, {">=", op::ge}, {"<", op::lt}, {">", op::gt}}},
+        {{{"+", op::add}, {"-", op::sub}}},
+    }};
+
+    // how deeply parentheses and brackets can nest, so a hostile condition can't exhaust the stack
+    static constexpr int max_nesting = 32;
+
+    std::string_view   text;
+    std::vector<term>& out;
+    size_t             pos     = 0;
+    int                nesting = 0;
+    bool               failed  = false;
+
+    void skip_space() noexcept
+    {
+        while (pos < text.size() && std::isspace(static_cast<unsigned char>(text[pos])) != 0) ++pos;
+    }
+
+    bool accept(std::string_view token) noexcept
+    {
+        skip_space();
+        if (!text.substr(pos).starts_with(token)) return false;
+
+        // | and & are not the first half of || and &&
+        const bool halved = token.size() == 1 && (token[0] == '|' || token[0] == '&') && pos + 1 < text.size()
+                         && text[pos + 1] == token[0];
+        if (halved) return false;
+
+        pos += token.size();
+        return true;
+    }
+
+    void expect(std::string_view token) noexcept
+    {
+        if (!accept(token)) failed = true;
+    }
+
+    void parse_binary(size_t level)
+    {
+        if (level == levels.size())
+        {
+            parse_unary();
+            return;
+        }
+
+        parse_binary(level + 1);
+        while (!failed)
+        {
+            const auto& ops   = levels[level];
+            const auto  match = std::ranges::find_if(ops, [&](const binary& b)
+                                                    { return !b.token.empty() && accept(b.token); });
+            if (match == ops.end()) return;
+
+            parse_binary(level + 1);
+            out.push_back({match->code, 0});
+        }
+    }
+
+    void parse_unary()
+    {
+        if (accept("!")) unary(op::logical_not);
+        else if (accept("~")) unary(op::complement);
+        else if (accept("-")) unary(op::negate);
+        else parse_primary();
+    }
+
+    void unary(op code)
+    {
+        parse_unary();
+        out.push_back({code, 0});
+    }
+
+    void parse_primary()
+    {
+        if (failed) return;
+
+        if (accept("(")) nested(")");
+        else if (accept("["))
+        {
+            nested("]");
+            out.push_back({op::load, 0});
+        }
+        else if (accept("$") || accept("0x") || accept("0X")) parse_number(16);
+        else if (pos < text.size() && std::isdigit(static_cast<unsigned char>(text[pos])) != 0) parse_number(10);
+        else if (pos < text.size() && std::isalpha(static_cast<unsigned char>(text[pos])) != 0) parse_name();
+        else failed = true;
+    }
+
+    void nested(std::string_view close)
+    {
+        if (++nesting > max_nesting)
+        {
+            failed = true;
+            return;
+        }
+
+        parse_binary(0);
+        expect(close);
+        --nesting;
+    }
+
+    void parse_number(int base) noexcept
+    {
+        uint32_t   val   = 0;
+        const auto begin = text.data() + pos;
+        const auto [end, err] = std::from_chars(begin, text.data() + text.size(), val, base);
+        if (err != std::errc{} || val > 0xFFFF)
+        {
+            failed = true;
+            return;
+        }
+
+        pos += static_cast<size_t>(end - begin);
+        out.push_back({op::constant, static_cast<uint16_t>(val)});
+    }
+
+    void parse_name()
+    {
+        const size_t start = pos;
+        while (pos < text.size() && std::isalnum(static_cast<unsigned char>(text[pos])) != 0) ++pos;
+        const auto name = text.substr(start, pos - start);
+
+        if (equal_nocase(name, "value"))
+        {
+            out.push_back({op::value, 0});
+            return;
+        }
+
+        const auto is_name = [&](std::string_view r) { return equal_nocase(name, r); };
+        const auto found   = std::ranges::find_if(register_names, is_name);
+        if (found == register_names.end())
+        {
+            failed = true;
+            return;
+        }
+
+        out.push_back({op::reg, static_cast<uint16_t>(found - register_names.begin())});
+    }
+};
+
+std::error_code expression::parse(std::string_view text, expression& out)
+{
+    out.code.clear();
+
+    parser p{.text = text, .out = out.code};
+    p.skip_space();
+    if (p.pos == text.size()) return {}; // always true
+
+    p.parse_binary(0);
+    p.skip_space();
+    if (p.failed || p.pos != text.size()) return std::make_error_code(std::errc::invalid_argument);
+
+    // operands push, binary operators pop
+    size_t depth   = 0;
+    size_t deepest = 0;
+    for (const term& t : out.code)
+    {
+        if (t.code < op::load) deepest = std::max(deepest, ++depth);
+        else if (t.code >= op::add) --depth;
+    }
+    if (deepest > max_depth) return std::make_error_code(std::errc::invalid_argument);
+
+    return {};
+}
+
+uint32_t expression::evaluate(const registers& r, memory& mem, uint8_t value) const noexcept
+{
+    if (code.empty()) return 1;
+
+    std::array<uint32_t, max_depth> stack{};
+    size_t                          top = 0;
+
+    for (const term& t : code)
+    {
+        if (t.code < op::load)
+        {
+            uint32_t val = t.arg;
+            if (t.code == op::reg) val = read_register(r, t.arg);
+            else if (t.code == op::value) val = value;
+
+            stack[top++] = val;
+            continue;
+        }
+
+        if (t.code < op::add)
+        {
+            uint32_t& a = stack[top - 1];
+            switch (t.code)
+            {
+            case op::load: a = mem.peek(static_cast<uint16_t>(a)); break;
+            case op::negate: a = 0U - a; break;
+            case op::complement: a = ~a; break;
+            default: a = a == 0 ? 1 : 0; break;
+            }
+            continue;
+        }
+
+        const uint32_t b   = stack[--top];
+        uint32_t&      lhs = stack[top - 1];
+        switch (t.code)
+        {
+        case op::add: lhs += b; break;
+        case op::sub: lhs -= b; break;
+        case op::bit_and: lhs &= b; break;
+        case op::bit_xor: lhs ^= b; break;
+        case op::bit_or: lhs |= b; break;
+        case op::lt: lhs = lhs < b ? 1 : 0; break;
+        case op::le: lhs = lhs <= b ? 1 : 0; break;
+        case op::gt: lhs = lhs > b ? 1 : 0; break;
+        case op::ge: lhs = lhs >= b ? 1 : 0; break;
+        case op::eq: lhs = lhs == b ? 1 : 0; break;
+        case op::ne: lhs = lhs != b ? 1 : 0; break;
+        case op::logical_and: lhs = lhs != 0 && b != 0 ? 1 : 0; break;
+        default: lhs = lhs != 0 || b != 0 ? 1 : 0; break;
+        }
+    }
+
+    return stack[0];
+}
+
+}
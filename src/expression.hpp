@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#include "registers.hpp"
+
+namespace gb
+{
+
+struct memory;
+
+// expression is a condition on the state of the machine, such as "A == $10 && [HL] != 0", compiled once so that
+// checking it every time a breakpoint or watchpoint is hit is cheap.
+//
+// Operands are numbers ($FF or 0xFF in hex, otherwise decimal), registers (A F B C D E H L AF BC DE HL SP PC, in any
+// case), bytes of memory ([addr]), and "value", the byte a watchpoint saw read or written. Operators bind as in C,
+// loosest first: || && | ^ & == != < <= > >= + - and the unary ! ~ -. Anything but 0 is true.
+struct expression
+{
+public:
+    // parse compiles text into out, failing with invalid_argument if it isn't a well-formed expression
+    static std::error_code parse(std::string_view text, expression& out);
+
+    [[nodiscard]] bool empty() const noexcept { return code.empty(); }
+
+    // evaluate returns the expression's value, reading memory without side effects; an empty expression is true
+    [[nodiscard]] uint32_t evaluate(const registers& r, memory& mem, uint8_t value = 0) const noexcept;
+
+private:
+    struct parser;
+
+    enum class op : uint8_t
+    {
+        constant, // push arg
+        reg,      // push register arg, see register_names
+        value,    // push the watched byte
+        load,     // replace the top with the byte it addresses
+
+        // unary, on the top
+        negate,
+        complement,
+        logical_not,
+
+        // binary, popping the right hand side into the left
+        add,
+        sub,
+        lt,
+        le,
+        gt,
+        ge,
+        eq,
+        ne,
+        bit_and,
+        bit_xor,
+        bit_or,
+        logical_and,
+        logical_or,
+    };
+
+    struct term
+    {
+        op       code;
+        uint16_t arg;
+    };
+
+    // the deepest the evaluation stack can get, far beyond any condition worth typing
+    static constexpr size_t max_depth = 16;
+
+    std::vector<term> code; // in postfix order
+};
+
+}
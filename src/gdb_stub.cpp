@@ -0,0 +1,758 @@
+#include "gdb_stub.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <span>
+#include <vector>
+
+#include <SDL2/SDL_log.h>
+
+#include "cpu.hpp"
+#include "debugger.hpp"
+#include "memory.hpp"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#define GB_HAVE_UNIX_SOCKETS 1
+#endif
+
+namespace gb
+{
+
+// how often waiting threads check whether they should stop, or whether the client has anything to say
+constexpr int stop_poll_ms = 20;
+
+// the most memory sent in one reply, well within the packet size offered to clients
+constexpr uint32_t max_memory_reply = 0x400;
+
+constexpr std::string_view supported = "PacketSize=1000;qXfer:features:read+;QStartNoAckMode+";
+
+constexpr std::string_view target_xml = R"(<?xml version="1.0"?>
+<!DOCTYPE target SYSTEM "gdb-target.dtd">
+<target version="1.0">
+  <architecture>gbz80</architecture>
+  <feature name="org.gnu.gdb.z80.cpu">
+    <reg name="af" bitsize="16" type="int"/>
+    <reg name="bc" bitsize="16" type="int"/>
+    <reg name="de" bitsize="16" type="int"/>
+    <reg name="hl" bitsize="16" type="data_ptr"/>
+    <reg name="sp" bitsize="16" type="data_ptr"/>
+    <reg name="pc" bitsize="16" type="code_ptr"/>
+  </feature>
+</target>
+)";
+
+// signals reported in stop replies
+constexpr uint8_t sigint  = 2;
+constexpr uint8_t sigtrap = 5;
+
+// in the order clients see them
+static uint16_t* register_at(registers& r, uint32_t index) noexcept
+{
+    const std::array<uint16_t*, 6> regs = {&r.AF, &r.BC, &r.DE, &r.HL, &r.sp, &r.pc};
+    return index < regs.size() ? regs[index] : nullptr;
+}
+
+static void append_hex(std::string& out, uint8_t val)
+{
+    constexpr std::string_view digits = "0123456789abcdef";
+    out += digits[val >> 4U];
+    out += digits[val & 0x0FU];
+}
+
+// parse_hex parses all of text as a hex number
+static bool parse_hex(std::string_view text, uint32_t& out) noexcept
+{
+    const auto [end, err] = std::from_chars(text.data(), text.data() + text.size(), out, 16);
+    return err == std::errc{} && end == text.data() + text.size() && !text.empty();
+}
+
+// parse_bytes decodes the hex bytes in text into out, which they must fill exactly
+static bool parse_bytes(std::string_view text, std::span<uint8_t> out) noexcept
+{
+    if (text.size() != out.size() * 2) return false;
+
+    for (size_t i = 0; i < out.size(); ++i)
+    {
+        uint32_t val = 0;
+        if (!parse_hex(text.substr(i * 2, 2), val)) return false;
+        out[i] = static_cast<uint8_t>(val);
+    }
+    return true;
+}
+
+// parse_range parses "addr,len" as sent in m, M and Z packets, which must stay within the address space
+static bool parse_range(std::string_view text, uint16_t& addr, uint16_t& len) noexcept
+{
+    const auto comma = text.find(',');
+    if (comma == std::string_view::npos) return false;
+
+    uint32_t a = 0;
+    uint32_t n = 0;
+    if (!parse_hex(text.substr(0, comma), a) || !parse_hex(text.substr(comma + 1), n)) return false;
+    if (a > 0xFFFF || n > 0x10000 - a) return false;
+
+    addr = static_cast<uint16_t>(a);
+    len  = static_cast<uint16_t>(n);
+    return true;
+}
+
+static uint8_t checksum(std::string_view payload) noexcept
+{
+    uint8_t sum = 0;
+    for (const char c : payload) sum += static_cast<uint8_t>(c);
+    return sum;
+}
+
+// binary data escapes the characters that frame packets, sending '}' then the character XORed with 0x20
+constexpr char escape = '}';
+
+static bool needs_escape(char c) noexcept { return c == '#' || c == '$' || c == escape || c == '*'; }
+
+static void append_escaped(std::string& out, std::string_view data)
+{
+    for (const char c : data)
+    {
+        if (needs_escape(c))
+        {
+            out += escape;
+            out += static_cast<char>(c ^ 0x20);
+        }
+        else
+        {
+            out += c;
+        }
+    }
+}
+
+// unescape decodes the binary data in text into out, which it must fill exactly
+static bool unescape(std::string_view text, std::span<uint8_t> out) noexcept
+{
+    size_t n = 0;
+    for (size_t i = 0; i < text.size(); ++i, ++n)
+    {
+        if (n == out.size()) return false;
+
+        auto c = static_cast<uint8_t>(text[i]);
+        if (c == escape)
+        {
+            if (++i == text.size()) return false;
+            c = static_cast<uint8_t>(text[i]) ^ 0x20U;
+        }
+        out[n] = c;
+    }
+    return n == out.size();
+}
+
+gdb_stub::gdb_stub(cpu& target, debugger& debug) noexcept
+    : target{target}
+    , debug{debug}
+    , halted{false}
+    , interrupting{false}
+{}
+
+gdb_stub::~gdb_stub() { stop(); }
+
+void gdb_stub::stop() noexcept
+{
+    if (!worker.joinable()) return;
+
+    worker.request_stop();
+    worker.join();
+
+    // in case the client had the cpu when the stub stopped
+    release();
+}
+
+bool gdb_stub::hold(const std::stop_token& stop)
+{
+    if (!interrupting.load(std::memory_order_acquire) && !target.stopped_by_debugger()) return false;
+
+    std::unique_lock guard{lock};
+    halted = true;
+    wake.notify_all();
+    wake.wait(guard, stop, [this] { return !halted; });
+    return true;
+}
+
+void gdb_stub::interrupt() noexcept
+{
+    interrupting.store(true, std::memory_order_release);
+    target.stop();
+}
+
+void gdb_stub::release()
+{
+    {
+        std::lock_guard guard{lock};
+        halted = false;
+        interrupting.store(false, std::memory_order_release);
+    }
+    wake.notify_all();
+}
+
+void gdb_stub::stop_reply(std::string& out) const
+{
+    const auto& stopped = debug.stopped();
+    if (!stopped.has_value() || stopped->reason == debugger::stop::kind::breakpoint)
+    {
+        // at a breakpoint, stepped, or interrupted by the client
+        const bool interrupted = !stopped.has_value() && interrupting.load(std::memory_order_acquire);
+        out += 'S';
+        append_hex(out, interrupted ? sigint : sigtrap);
+        return;
+    }
+
+    // watchpoints say what was accessed, in the terms the client set them in
+    const auto found = std::ranges::find(points, stopped->id, &point::id);
+    const char type  = found != points.end() ? found->type : '2';
+
+    out += 'T';
+    append_hex(out, sigtrap);
+    out += type == '4' ? "awatch:" : type == '3' ? "rwatch:" : "watch:";
+    append_hex(out, static_cast<uint8_t>(stopped->addr >> 8U));
+    append_hex(out, static_cast<uint8_t>(stopped->addr));
+    out += ';';
+}
+
+void gdb_stub::set_point(std::string_view args, bool add, std::string& reply)
+{
+    // type,addr,kind[;cond...], any conditions being the client's to evaluate
+    if (args.size() < 2 || args[1] != ',') return;
+    const char type = args[0];
+    args            = args.substr(2);
+    args            = args.substr(0, args.find(';'));
+
+    uint16_t addr = 0;
+    uint16_t len  = 0;
+    if (!parse_range(args, addr, len))
+    {
+        reply = "E01";
+        return;
+    }
+
+    const auto same  = [&](const point& p) { return p.type == type && p.addr == addr && p.len == len; };
+    const auto found = std::ranges::find_if(points, same);
+
+    if (!add)
+    {
+        if (found != points.end())
+        {
+            debug.remove(found->id);
+            points.erase(found);
+        }
+        reply = "OK";
+        return;
+    }
+
+    // clients may set what is already set
+    if (found != points.end())
+    {
+        reply = "OK";
+        return;
+    }
+
+    // watchpoints cover len bytes, breakpoints one instruction whatever its length
+    const auto last = static_cast<uint16_t>(addr + std::max<uint16_t>(len, 1) - 1);
+
+    uint32_t        id = 0;
+    std::error_code err;
+    switch (type)
+    {
+    case '0':
+    case '1': err = debug.add_breakpoint(addr, {}, id); break;
+    case '2': err = debug.add_watchpoint(addr, last, debugger::access::write, {}, id); break;
+    case '3': err = debug.add_watchpoint(addr, last, debugger::access::read, {}, id); break;
+    case '4': err = debug.add_watchpoint(addr, last, debugger::access::any, {}, id); break;
+    default: return; // not supported
+    }
+
+    if (err)
+    {
+        reply = "E01";
+        return;
+    }
+
+    points.push_back({.type = type, .addr = addr, .len = len, .id = id});
+    reply = "OK";
+}
+
+#ifdef GB_HAVE_UNIX_SOCKETS
+
+struct gdb_stub::connection
+{
+    int         fd = -1;
+    std::string input{};
+    std::string last_sent{}; // sent again if the client asks
+    bool        acks        = true;
+    bool        interrupted = false;
+
+    // receive waits up to wait_ms for more from the client, returning false once it has hung up
+    bool receive(int wait_ms)
+    {
+        pollfd client{.fd = fd, .events = POLLIN, .revents = 0};
+        const int ready = ::poll(&client, 1, wait_ms);
+        if (ready < 0) return errno == EINTR;
+        if (ready == 0) return true;
+
+        std::array<char, 4096> buf{};
+        const auto             n = ::recv(fd, buf.data(), buf.size(), 0);
+        if (n < 0) return errno == EINTR;
+        if (n == 0) return false;
+
+        input.append(buf.data(), static_cast<size_t>(n));
+        take_interrupts();
+        return true;
+    }
+
+    // take_interrupts takes any interrupt (a bare 0x03) out of the input ahead of the next packet
+    void take_interrupts()
+    {
+        while (!input.empty() && input[0] != '$')
+        {
+            if (input[0] == '\x03') interrupted = true;
+            else if (input[0] == '-' && !last_sent.empty()) send_raw(last_sent);
+            input.erase(0, 1);
+        }
+    }
+
+    // next takes the next whole packet out of the input, acknowledging it, or returns false if there is none yet
+    bool next(std::string& packet)
+    {
+        for (;;)
+        {
+            take_interrupts();
+            if (input.empty()) return false;
+
+            const auto end = input.find('#');
+            if (end == std::string::npos || end + 2 >= input.size()) return false;
+
+            uint32_t   sum  = 0;
+            const bool good = parse_hex(std::string_view{input}.substr(end + 1, 2), sum)
+                           && sum == checksum(std::string_view{input}.substr(1, end - 1));
+
+            packet.assign(input, 1, end - 1);
+            input.erase(0, end + 3);
+
+            if (acks) send_raw(good ? "+" : "-");
+            if (good) return true;
+        }
+    }
+
+    bool send(std::string_view payload)
+    {
+        last_sent = '$';
+        last_sent += payload;
+        last_sent += '#';
+        append_hex(last_sent, checksum(payload));
+        return send_raw(last_sent);
+    }
+
+    bool send_raw(std::string_view data) const
+    {
+#ifdef MSG_NOSIGNAL
+        constexpr int send_flags = MSG_NOSIGNAL;
+#else
+        constexpr int send_flags = 0;
+#endif
+
+        while (!data.empty())
+        {
+            const auto n = ::send(fd, data.data(), data.size(), send_flags);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+
+            data.remove_prefix(static_cast<size_t>(n));
+        }
+        return true;
+    }
+};
+
+static std::error_code listen_on(int server, const sockaddr* addr, socklen_t len)
+{
+    if (::bind(server, addr, len) != 0 || ::listen(server, 1) != 0)
+    {
+        std::error_code err{errno, std::generic_category()};
+        ::close(server);
+        return err;
+    }
+    return {};
+}
+
+std::error_code gdb_stub::listen_tcp(uint16_t port)
+{
+    if (worker.joinable()) return std::make_error_code(std::errc::device_or_resource_busy);
+
+    const int server = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (server < 0) return {errno, std::generic_category()};
+
+    const int on = 1;
+    (void)::setsockopt(server, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+    // local clients only: the protocol has no authentication whatsoever
+    sockaddr_in addr{};
+    addr.sin_family      = AF_INET;
+    addr.sin_port        = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if (auto err = listen_on(server, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)); err) return err;
+
+    worker = std::jthread{[this, server](const std::stop_token& stop) { serve_loop(stop, server, {}); }};
+    return {};
+}
+
+std::error_code gdb_stub::listen_unix(const std::filesystem::path& path)
+{
+    if (worker.joinable()) return std::make_error_code(std::errc::device_or_resource_busy);
+
+    const auto& native = path.native();
+
+    sockaddr_un addr{};
+    if (native.size() >= sizeof(addr.sun_path)) return std::make_error_code(std::errc::filename_too_long);
+    addr.sun_family = AF_UNIX;
+    std::memcpy(addr.sun_path, native.c_str(), native.size());
+
+    const int server = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (server < 0) return {errno, std::generic_category()};
+
+    ::unlink(path.c_str());
+    if (auto err = listen_on(server, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)); err) return err;
+
+    worker = std::jthread{[this, server, path](const std::stop_token& stop) { serve_loop(stop, server, path); }};
+    return {};
+}
+
+void gdb_stub::serve_loop(const std::stop_token& stop, int server, const std::filesystem::path& path)
+{
+    while (!stop.stop_requested())
+    {
+        pollfd listening{.fd = server, .events = POLLIN, .revents = 0};
+        if (::poll(&listening, 1, stop_poll_ms) <= 0) continue;
+
+        const int fd = ::accept(server, nullptr, nullptr);
+        if (fd < 0) continue;
+
+        // replies are small and every one is waited on, so don't let them sit in the send buffer (fails harmlessly on
+        // Unix sockets)
+        const int on = 1;
+        (void)::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+        connection conn{.fd = fd};
+        serve(stop, conn);
+        ::close(fd);
+    }
+
+    ::close(server);
+    if (!path.empty()) ::unlink(path.c_str());
+}
+
+void gdb_stub::serve(const std::stop_token& stop, connection& conn)
+{
+    SDL_Log("gdb: client connected");
+
+    // clients expect the target to be stopped when they attach
+    interrupt();
+    if (!wait_halted(stop, &conn))
+    {
+        detach(stop);
+        return;
+    }
+
+    std::string packet;
+    std::string reply;
+    while (!stop.stop_requested())
+    {
+        if (!conn.next(packet))
+        {
+            if (!conn.receive(stop_poll_ms)) break;
+            continue;
+        }
+
+        reply.clear();
+        const after next = handle(packet, reply);
+        if (next == after::detach)
+        {
+            if (!reply.empty()) (void)conn.send(reply);
+            break;
+        }
+
+        if (next == after::resume)
+        {
+            release();
+            if (!wait_halted(stop, &conn)) break;
+            stop_reply(reply);
+        }
+
+        if (!conn.send(reply)) break;
+        if (packet == "QStartNoAckMode") conn.acks = false;
+    }
+
+    detach(stop);
+    SDL_Log("gdb: client disconnected");
+}
+
+bool gdb_stub::wait_halted(const std::stop_token& stop, connection* conn)
+{
+    for (;;)
+    {
+        {
+            std::unique_lock guard{lock};
+            const auto       wait = std::chrono::milliseconds{stop_poll_ms};
+            if (wake.wait_for(guard, stop, wait, [this] { return halted; }))
+            {
+                // an interrupt that arrives too late has nothing left to interrupt
+                if (conn != nullptr) conn->interrupted = false;
+                return true;
+            }
+            if (stop.stop_requested()) return false;
+        }
+
+        // while the cpu runs, all the client can do is interrupt it or hang up
+        if (conn == nullptr) continue;
+        if (!conn->receive(0)) return false;
+        if (conn->interrupted)
+        {
+            conn->interrupted = false;
+            interrupt();
+        }
+    }
+}
+
+void gdb_stub::detach(const std::stop_token& stop)
+{
+    bool have_cpu = false;
+    {
+        std::lock_guard guard{lock};
+        have_cpu = halted;
+    }
+
+    // what the client set can only be cleared while the cpu is stopped
+    if (!have_cpu)
+    {
+        interrupt();
+        if (!wait_halted(stop, nullptr)) return;
+    }
+
+    for (const auto& p : points) debug.remove(p.id);
+    points.clear();
+
+    debug.resume();
+    release();
+}
+
+gdb_stub::after gdb_stub::handle(std::string_view packet, std::string& reply)
+{
+    if (packet.empty()) return after::reply;
+
+    auto&      r    = target.regs();
+    auto&      mem  = target.bus();
+    const auto args = packet.substr(1);
+    uint16_t   addr = 0;
+    uint16_t   len  = 0;
+    uint32_t   num  = 0;
+
+    switch (packet[0])
+    {
+    case '?': stop_reply(reply); break;
+
+    case 'g':
+        for (uint32_t i = 0; uint16_t* reg = register_at(r, i); ++i)
+        {
+            append_hex(reply, static_cast<uint8_t>(*reg));
+            append_hex(reply, static_cast<uint8_t>(*reg >> 8U));
+        }
+        break;
+
+    case 'G':
+    {
+        std::array<uint8_t, 12> bytes{};
+        if (!parse_bytes(args, bytes))
+        {
+            reply = "E01";
+            break;
+        }
+
+        for (uint32_t i = 0; uint16_t* reg = register_at(r, i); ++i)
+        {
+            *reg = static_cast<uint16_t>(bytes[i * 2] | (bytes[i * 2 + 1] << 8U));
+        }
+        reply = "OK";
+        break;
+    }
+
+    case 'p':
+    {
+        uint16_t* reg = parse_hex(args, num) ? register_at(r, num) : nullptr;
+        if (reg == nullptr)
+        {
+            reply = "E01";
+            break;
+        }
+
+        append_hex(reply, static_cast<uint8_t>(*reg));
+        append_hex(reply, static_cast<uint8_t>(*reg >> 8U));
+        break;
+    }
+
+    case 'P':
+    {
+        const auto             eq  = args.find('=');
+        uint16_t*              reg = nullptr;
+        std::array<uint8_t, 2> bytes{};
+        if (eq != std::string_view::npos && parse_hex(args.substr(0, eq), num)) reg = register_at(r, num);
+        if (reg == nullptr || !parse_bytes(args.substr(eq + 1), bytes))
+        {
+            reply = "E01";
+            break;
+        }
+
+        *reg  = static_cast<uint16_t>(bytes[0] | (bytes[1] << 8U));
+        reply = "OK";
+        break;
+    }
+
+    case 'm':
+        if (!parse_range(args, addr, len))
+        {
+            reply = "E01";
+            break;
+        }
+
+        // peek, so reading memory for the client has no side effects
+        for (uint32_t i = 0; i < std::min<uint32_t>(len, max_memory_reply); ++i)
+        {
+            append_hex(reply, mem.peek(static_cast<uint16_t>(addr + i)));
+        }
+        break;
+
+    case 'M':
+    {
+        const auto colon = args.find(':');
+        if (colon == std::string_view::npos || !parse_range(args.substr(0, colon), addr, len)
+            || args.size() - colon - 1 != len * 2U)
+        {
+            reply = "E01";
+            break;
+        }
+
+        for (uint32_t i = 0; i < len; ++i)
+        {
+            uint8_t val = 0;
+            (void)parse_bytes(args.substr(colon + 1 + i * 2, 2), std::span{&val, 1});
+            mem.poke(static_cast<uint16_t>(addr + i), val);
+        }
+        reply = "OK";
+        break;
+    }
+
+    case 'X':
+    {
+        // as M, with the data in binary
+        const auto colon = args.find(':');
+        if (colon == std::string_view::npos || !parse_range(args.substr(0, colon), addr, len))
+        {
+            reply = "E01";
+            break;
+        }
+
+        std::vector<uint8_t> bytes(len);
+        if (!unescape(args.substr(colon + 1), bytes))
+        {
+            reply = "E01";
+            break;
+        }
+
+        for (uint32_t i = 0; i < len; ++i) mem.poke(static_cast<uint16_t>(addr + i), bytes[i]);
+        reply = "OK";
+        break;
+    }
+
+    case 'c':
+    case 's':
+        // optionally from a new address
+        if (!args.empty())
+        {
+            if (!parse_hex(args, num) || num > 0xFFFF)
+            {
+                reply = "E01";
+                break;
+            }
+            r.pc = static_cast<uint16_t>(num);
+        }
+
+        debug.resume();
+        if (packet[0] == 'c') return after::resume;
+
+        interrupting.store(false, std::memory_order_release);
+        target.step();
+        stop_reply(reply);
+        break;
+
+    case 'Z':
+    case 'z': set_point(args, packet[0] == 'Z', reply); break;
+
+    case 'q':
+        if (packet.starts_with("qSupported")) reply = supported;
+        else if (packet == "qAttached") reply = "1";
+        else if (packet.starts_with("qXfer:features:read:target.xml:"))
+        {
+            const auto range = packet.substr(packet.rfind(':') + 1);
+            if (!parse_range(range, addr, len))
+            {
+                reply = "E01";
+                break;
+            }
+
+            const auto chunk = target_xml.substr(std::min<size_t>(addr, target_xml.size()), len);
+            reply            = addr + chunk.size() < target_xml.size() ? 'm' : 'l';
+            append_escaped(reply, chunk);
+        }
+        break;
+
+    case 'Q':
+        // acks stop after this reply
+        if (packet == "QStartNoAckMode") reply = "OK";
+        break;
+
+    case 'H': reply = "OK"; break;
+
+    case 'D': reply = "OK"; return after::detach;
+    case 'k': return after::detach; // leaves the instance running, which is the point of attaching to it live
+
+    default: break; // an empty reply means not supported
+    }
+
+    return after::reply;
+}
+
+#else
+
+struct gdb_stub::connection
+{};
+
+std::error_code gdb_stub::listen_tcp(uint16_t) { return std::make_error_code(std::errc::not_supported); }
+
+std::error_code gdb_stub::listen_unix(const std::filesystem::path&)
+{
+    return std::make_error_code(std::errc::not_supported);
+}
+
+void gdb_stub::serve_loop(const std::stop_token&, int, const std::filesystem::path&) {}
+void gdb_stub::serve(const std::stop_token&, connection&) {}
+bool gdb_stub::wait_halted(const std::stop_token&, connection*) { return false; }
+void gdb_stub::detach(const std::stop_token&) {}
+gdb_stub::after gdb_stub::handle(std::string_view, std::string&) { return after::reply; }
+
+#endif
+
+}
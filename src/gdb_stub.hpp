@@ -0,0 +1,107 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <stop_token>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+namespace gb
+{
+
+struct cpu;
+struct debugger;
+
+// gdb_stub serves the GDB remote serial protocol for one cpu, so gdb (or any other client speaking it) can attach to a
+// running instance to read and write its registers and memory, set breakpoints and watchpoints, and step or continue.
+//
+// Registers are sent as AF BC DE HL SP PC, 16 bits each and little-endian, and described that way to clients that ask
+// for a target description, as the gbz80 architecture (binutils' name for the SM83).
+//
+// The stub talks to its client on its own thread, and leaves the cpu alone while it runs. Once the cpu stops, at a
+// breakpoint or watchpoint or because the client interrupted it, the thread running it hands it over by calling hold,
+// which blocks until the client continues. Only one client is served at a time.
+class gdb_stub
+{
+public:
+    // target and debug must outlive the stub
+    gdb_stub(cpu& target, debugger& debug) noexcept;
+
+    gdb_stub(const gdb_stub&)            = delete;
+    gdb_stub& operator=(const gdb_stub&) = delete;
+    gdb_stub(gdb_stub&&)                 = delete;
+    gdb_stub& operator=(gdb_stub&&)      = delete;
+
+    ~gdb_stub();
+
+    // listen_tcp serves clients connecting to port on localhost, listen_unix on a Unix domain socket at path
+    std::error_code listen_tcp(uint16_t port);
+    std::error_code listen_unix(const std::filesystem::path& path);
+
+    // stop disconnects any client and stops listening, and is done on destruction
+    void stop() noexcept;
+
+    // hold is called by the thread running the cpu each time it returns from running it. If the cpu was stopped for
+    // the client, hold blocks until the client continues it (or stop is requested) and returns true. Otherwise it
+    // returns false straight away.
+    bool hold(const std::stop_token& stop = {});
+
+private:
+    struct connection;
+
+    // what's left to do after handling a packet
+    enum class after : uint8_t
+    {
+        reply,
+        resume, // reply once the cpu next stops
+        detach,
+    };
+
+    // a breakpoint or watchpoint set by the client, as it knows it
+    struct point
+    {
+        char     type; // as in the Z packet
+        uint16_t addr;
+        uint16_t len;
+        uint32_t id;
+    };
+
+    void serve_loop(const std::stop_token& stop, int server, const std::filesystem::path& path);
+    void serve(const std::stop_token& stop, connection& conn);
+    after handle(std::string_view packet, std::string& reply);
+
+    // interrupt asks the thread running the cpu to stop it and hand it over
+    void interrupt() noexcept;
+
+    // wait_halted waits for the cpu to be handed over, passing on interrupts from conn (if any) meanwhile. It returns
+    // false if stop is requested or the client hangs up first.
+    bool wait_halted(const std::stop_token& stop, connection* conn);
+
+    // release hands the cpu back to the thread running it
+    void release();
+
+    void detach(const std::stop_token& stop);
+    void stop_reply(std::string& out) const;
+
+    // set_point handles the rest of a Z (add) or z packet
+    void set_point(std::string_view args, bool add, std::string& reply);
+
+    cpu&               target;
+    debugger&          debug;
+    std::vector<point> points;
+
+    std::mutex                  lock;
+    std::condition_variable_any wake;
+    bool                        halted; // the stub's thread has the cpu
+    std::atomic_bool            interrupting;
+
+    std::jthread worker;
+};
+
+}
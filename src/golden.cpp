@@ -0,0 +1,112 @@
+#include "golden.hpp"
+
+#include <array>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+
+#include "hash.hpp"
+
+namespace gb
+{
+
+constexpr std::array<char, 4> golden_magic   = {'G', 'B', 'F', 'H'};
+constexpr uint32_t            golden_version = 1;
+constexpr size_t              record_size    = 8; // a frame's hash
+
+using file_ptr = std::unique_ptr<std::FILE, decltype(&std::fclose)>;
+
+static void put64(std::array<uint8_t, 8>& out, uint64_t v) noexcept
+{
+    for (size_t i = 0; i < out.size(); ++i) out[i] = static_cast<uint8_t>(v >> (i * 8));
+}
+
+static uint64_t get64(const uint8_t* in) noexcept
+{
+    uint64_t v = 0;
+    for (size_t i = 8; i > 0; --i) v = (v << 8) | in[i - 1];
+    return v;
+}
+
+uint64_t hash_frame(const framebuffer& frame) noexcept
+{
+    // NOTE: pixels are hashed in host byte order, so golden files are only portable between hosts of the same
+    // endianness
+    return hash::hash64(frame.data(), frame.size() * sizeof(framebuffer::value_type));
+}
+
+std::error_code load_golden(const std::filesystem::path& path, golden& out)
+{
+    file_ptr file{std::fopen(path.c_str(), "rb"), &std::fclose};
+    if (file == nullptr) return {errno, std::generic_category()};
+
+    std::array<uint8_t, 32> header{};
+    if (std::fread(header.data(), 1, header.size(), file.get()) != header.size())
+        return std::make_error_code(std::errc::illegal_byte_sequence);
+
+    if (std::memcmp(header.data(), golden_magic.data(), golden_magic.size()) != 0)
+        return std::make_error_code(std::errc::illegal_byte_sequence);
+
+    uint32_t version = 0;
+    for (size_t i = 4; i > 0; --i) version = (version << 8) | header[4 + i - 1];
+    if (version != golden_version) return std::make_error_code(std::errc::not_supported);
+
+    out.rom_hash   = get64(&header[16]);
+    out.input_hash = get64(&header[24]);
+    out.frames.clear();
+
+    // the frames are all that follows the header, so the count has to account for exactly the rest of the file
+    std::error_code err;
+    const auto      size  = std::filesystem::file_size(path, err);
+    const auto      count = get64(&header[8]);
+    if (err) return err;
+    if (size < header.size() || count != (size - header.size()) / record_size
+        || (size - header.size()) % record_size != 0)
+        return std::make_error_code(std::errc::illegal_byte_sequence);
+
+    out.frames.reserve(count);
+
+    std::array<uint8_t, record_size> buf{};
+    for (uint64_t i = 0; i < count; ++i)
+    {
+        if (std::fread(buf.data(), 1, buf.size(), file.get()) != buf.size())
+            return std::make_error_code(std::errc::illegal_byte_sequence);
+
+        out.frames.push_back(get64(buf.data()));
+    }
+
+    return {};
+}
+
+std::error_code save_golden(const std::filesystem::path& path, const golden& in)
+{
+    file_ptr file{std::fopen(path.c_str(), "wb"), &std::fclose};
+    if (file == nullptr) return {errno, std::generic_category()};
+
+    // magic, version (u32), frame count (u64), rom hash (u64), input hash (u64)
+    std::array<uint8_t, 32> header{};
+    std::memcpy(header.data(), golden_magic.data(), golden_magic.size());
+    for (size_t i = 0; i < 4; ++i) header[4 + i] = static_cast<uint8_t>(golden_version >> (i * 8));
+
+    std::array<uint8_t, 8> buf{};
+    put64(buf, in.frames.size());
+    std::memcpy(&header[8], buf.data(), buf.size());
+    put64(buf, in.rom_hash);
+    std::memcpy(&header[16], buf.data(), buf.size());
+    put64(buf, in.input_hash);
+    std::memcpy(&header[24], buf.data(), buf.size());
+
+    if (std::fwrite(header.data(), 1, header.size(), file.get()) != header.size())
+        return {errno, std::generic_category()};
+
+    for (auto hash : in.frames)
+    {
+        put64(buf, hash);
+        if (std::fwrite(buf.data(), 1, buf.size(), file.get()) != buf.size()) return {errno, std::generic_category()};
+    }
+
+    return {};
+}
+
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <system_error>
+#include <vector>
+
+#include "ppu.hpp"
+
+namespace gb
+{
+
+// hash_frame hashes the pixels of a frame, for cheap comparison against a golden sequence.
+[[nodiscard]] uint64_t hash_frame(const framebuffer& frame) noexcept;
+
+// golden is the sequence of per-frame hashes a ROM produces for a given input script.
+//
+// On disk it is a 32 byte little-endian header ("GBFH", version, frame count, ROM hash, input hash) followed by one
+// 64-bit hash per frame.
+struct golden
+{
+    uint64_t              rom_hash   = 0;
+    uint64_t              input_hash = 0; // hash of the input script the sequence was recorded with, 0 if none
+    std::vector<uint64_t> frames;
+};
+
+std::error_code load_golden(const std::filesystem::path& path, golden& out);
+std::error_code save_golden(const std::filesystem::path& path, const golden& in);
+
+}
@@ -0,0 +1,285 @@
+#include "hash.hpp"
+
+#include <array>
+#include <bit>
+#include <cstring>
+
+#include "simd.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+#define GB_SIMD_X86 1
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define GB_SIMD_NEON 1
+#endif
+
+namespace gb::hash
+{
+
+constexpr uint64_t prime32_1 = 0x9E3779B1U;
+constexpr uint64_t prime64_1 = 0x9E3779B185EBCA87ULL;
+constexpr uint64_t prime64_2 = 0xC2B2AE3D27D4EB4FULL;
+constexpr uint64_t prime64_3 = 0x165667B19E3779F9ULL;
+
+constexpr size_t lanes           = 8;
+constexpr size_t stripe_len      = lanes * sizeof(uint64_t);
+constexpr size_t stripes_per_mix = 16; // accumulators are scrambled every 1 KiB
+
+// per-lane keys, mixed into the input before multiplying so a run of zeros doesn't zero out a lane
+constexpr std::array<uint64_t, lanes> keys = {
+    0xBE4BA423396CFEB8ULL,
+    0x1CAD21F72C81017CULL,
+    0xDB979083E96DD4DEULL,
+    0x1F67B3B7A4A44072ULL,
+    0x78E5C0CC4EE679CBULL,
+    0x2172FFCC7DD05A82ULL,
+    0x8E2443F7744608B8ULL,
+    0x4C263A81E69035E0ULL,
+};
+
+static inline uint64_t load64(const uint8_t* p) noexcept
+{
+    if constexpr (std::endian::native == std::endian::little)
+    {
+        uint64_t v = 0;
+        std::memcpy(&v, p, sizeof(v));
+        return v;
+    }
+    else
+    {
+        uint64_t v = 0;
+        for (size_t i = sizeof(v); i > 0; --i) v = (v << 8) | p[i - 1];
+        return v;
+    }
+}
+
+static inline uint64_t avalanche(uint64_t h) noexcept
+{
+    h ^= h >> 33;
+    h *= prime64_2;
+    h ^= h >> 29;
+    h *= prime64_3;
+    h ^= h >> 32;
+    return h;
+}
+
+// accumulate is written as a plain loop over the lanes so the compiler can keep acc in vector registers
+static inline void accumulate(std::array<uint64_t, lanes>& acc, const uint8_t* stripe) noexcept
+{
+    for (size_t i = 0; i < lanes; ++i)
+    {
+        const uint64_t v = load64(stripe + i * sizeof(uint64_t));
+        const uint64_t k = v ^ keys[i];
+        acc[i] += (k & 0xFFFFFFFFULL) * (k >> 32) + v;
+    }
+}
+
+static inline void scramble(std::array<uint64_t, lanes>& acc) noexcept
+{
+    for (size_t i = 0; i < lanes; ++i)
+    {
+        acc[i] ^= acc[i] >> 47;
+        acc[i] *= prime32_1;
+    }
+}
+
+// accumulate_blocks runs accumulate over blocks of stripes_per_mix stripes, scrambling after each block
+using accumulate_blocks_fn = void (*)(std::array<uint64_t, lanes>& acc, const uint8_t* p, size_t blocks) noexcept;
+
+static void accumulate_blocks_scalar(std::array<uint64_t, lanes>& acc, const uint8_t* p, size_t blocks) noexcept
+{
+    for (size_t b = 0; b < blocks; ++b)
+    {
+        for (size_t s = 0; s < stripes_per_mix; ++s) accumulate(acc, p + (((b * stripes_per_mix) + s) * stripe_len));
+        scramble(acc);
+    }
+}
+
+// The vector versions are the same arithmetic, a 64-bit lane per accumulator: PMULUDQ (UMULL on ARM) is exactly the
+// 32x32->64 bit multiply accumulate uses, and multiplying by a 32-bit prime while scrambling takes two of them.
+
+#ifdef GB_SIMD_X86
+
+static void accumulate_blocks_sse2(std::array<uint64_t, lanes>& acc, const uint8_t* p, size_t blocks) noexcept
+{
+    constexpr size_t regs = lanes / 2;
+
+    // plain arrays, as std::array would drop the vector type's attributes
+    __m128i a[regs];
+    __m128i k[regs];
+    for (size_t r = 0; r < regs; ++r)
+    {
+        a[r] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(acc.data() + (r * 2)));
+        k[r] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys.data() + (r * 2)));
+    }
+
+    const __m128i prime = _mm_set1_epi64x(prime32_1);
+
+    for (size_t b = 0; b < blocks; ++b)
+    {
+        for (size_t s = 0; s < stripes_per_mix; ++s, p += stripe_len)
+        {
+            for (size_t r = 0; r < regs; ++r)
+            {
+                const __m128i v    = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + (r * 16)));
+                const __m128i x    = _mm_xor_si128(v, k[r]);
+                const __m128i prod = _mm_mul_epu32(x, _mm_srli_epi64(x, 32));
+                a[r]               = _mm_add_epi64(a[r], _mm_add_epi64(prod, v));
+            }
+        }
+
+        for (size_t r = 0; r < regs; ++r)
+        {
+            const __m128i x  = _mm_xor_si128(a[r], _mm_srli_epi64(a[r], 47));
+            const __m128i hi = _mm_slli_epi64(_mm_mul_epu32(_mm_srli_epi64(x, 32), prime), 32);
+            a[r]             = _mm_add_epi64(_mm_mul_epu32(x, prime), hi);
+        }
+    }
+
+    for (size_t r = 0; r < regs; ++r) _mm_storeu_si128(reinterpret_cast<__m128i*>(acc.data() + (r * 2)), a[r]);
+}
+
+#ifdef __GNUC__
+__attribute__((target("avx2"))) static void accumulate_blocks_avx2(std::array<uint64_t, lanes>& acc,
+                                                                   const uint8_t*               p,
+                                                                   size_t                       blocks) noexcept
+{
+    constexpr size_t regs = lanes / 4;
+
+    // plain arrays, as std::array would drop the vector type's attributes
+    __m256i a[regs];
+    __m256i k[regs];
+    for (size_t r = 0; r < regs; ++r)
+    {
+        a[r] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(acc.data() + (r * 4)));
+        k[r] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys.data() + (r * 4)));
+    }
+
+    const __m256i prime = _mm256_set1_epi64x(prime32_1);
+
+    for (size_t b = 0; b < blocks; ++b)
+    {
+        for (size_t s = 0; s < stripes_per_mix; ++s, p += stripe_len)
+        {
+            for (size_t r = 0; r < regs; ++r)
+            {
+                const __m256i v    = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + (r * 32)));
+                const __m256i x    = _mm256_xor_si256(v, k[r]);
+                const __m256i prod = _mm256_mul_epu32(x, _mm256_srli_epi64(x, 32));
+                a[r]               = _mm256_add_epi64(a[r], _mm256_add_epi64(prod, v));
+            }
+        }
+
+        for (size_t r = 0; r < regs; ++r)
+        {
+            const __m256i x  = _mm256_xor_si256(a[r], _mm256_srli_epi64(a[r], 47));
+            const __m256i hi = _mm256_slli_epi64(_mm256_mul_epu32(_mm256_srli_epi64(x, 32), prime), 32);
+            a[r]             = _mm256_add_epi64(_mm256_mul_epu32(x, prime), hi);
+        }
+    }
+
+    for (size_t r = 0; r < regs; ++r) _mm256_storeu_si256(reinterpret_cast<__m256i*>(acc.data() + (r * 4)), a[r]);
+}
+#endif
+
+#endif
+
+#ifdef GB_SIMD_NEON
+
+static void accumulate_blocks_neon(std::array<uint64_t, lanes>& acc, const uint8_t* p, size_t blocks) noexcept
+{
+    constexpr size_t regs = lanes / 2;
+
+    // plain arrays, as std::array would drop the vector type's attributes
+    uint64x2_t a[regs];
+    uint64x2_t k[regs];
+    for (size_t r = 0; r < regs; ++r)
+    {
+        a[r] = vld1q_u64(acc.data() + (r * 2));
+        k[r] = vld1q_u64(keys.data() + (r * 2));
+    }
+
+    const uint32x2_t prime = vdup_n_u32(static_cast<uint32_t>(prime32_1));
+
+    for (size_t b = 0; b < blocks; ++b)
+    {
+        for (size_t s = 0; s < stripes_per_mix; ++s, p += stripe_len)
+        {
+            for (size_t r = 0; r < regs; ++r)
+            {
+                const uint64x2_t v    = vreinterpretq_u64_u8(vld1q_u8(p + (r * 16)));
+                const uint64x2_t x    = veorq_u64(v, k[r]);
+                const uint64x2_t prod = vmull_u32(vmovn_u64(x), vshrn_n_u64(x, 32));
+                a[r]                  = vaddq_u64(a[r], vaddq_u64(prod, v));
+            }
+        }
+
+        for (size_t r = 0; r < regs; ++r)
+        {
+            const uint64x2_t x  = veorq_u64(a[r], vshrq_n_u64(a[r], 47));
+            const uint64x2_t hi = vshlq_n_u64(vmull_u32(vshrn_n_u64(x, 32), prime), 32);
+            a[r]                = vaddq_u64(vmull_u32(vmovn_u64(x), prime), hi);
+        }
+    }
+
+    for (size_t r = 0; r < regs; ++r) vst1q_u64(acc.data() + (r * 2), a[r]);
+}
+
+#endif
+
+static accumulate_blocks_fn select_accumulate_blocks() noexcept
+{
+    // the vector loads assume little-endian input, as load64 does on such hosts
+    if constexpr (std::endian::native != std::endian::little) return accumulate_blocks_scalar;
+
+    switch (simd::detect())
+    {
+#ifdef GB_SIMD_X86
+#ifdef __GNUC__
+    case simd::level::avx2: return accumulate_blocks_avx2;
+#endif
+    case simd::level::sse2: return accumulate_blocks_sse2;
+#endif
+#ifdef GB_SIMD_NEON
+    case simd::level::neon: return accumulate_blocks_neon;
+#endif
+    default: return accumulate_blocks_scalar;
+    }
+}
+
+uint64_t hash64(const void* data, size_t len, uint64_t seed) noexcept
+{
+    static const accumulate_blocks_fn accumulate_blocks = select_accumulate_blocks();
+
+    const auto* p = static_cast<const uint8_t*>(data);
+
+    std::array<uint64_t, lanes> acc{};
+    for (size_t i = 0; i < lanes; ++i) acc[i] = keys[i] + seed;
+
+    // whole blocks go through the widest implementation available, leaving fewer than stripes_per_mix stripes
+    const size_t num_stripes = len / stripe_len;
+    const size_t num_blocks  = num_stripes / stripes_per_mix;
+    accumulate_blocks(acc, p, num_blocks);
+
+    for (size_t s = num_blocks * stripes_per_mix; s < num_stripes; ++s) accumulate(acc, p + s * stripe_len);
+
+    // the tail is zero padded into one last stripe; the total length is mixed in at the end so padding can't collide
+    if (const size_t rest = len % stripe_len; rest != 0)
+    {
+        std::array<uint8_t, stripe_len> last{};
+        std::memcpy(last.data(), p + num_stripes * stripe_len, rest);
+        accumulate(acc, last.data());
+    }
+
+    uint64_t h = static_cast<uint64_t>(len) * prime64_1 ^ seed;
+    for (size_t i = 0; i < lanes; ++i)
+    {
+        h ^= avalanche(acc[i] + keys[lanes - 1 - i]);
+        h = std::rotl(h, 27) * prime64_1 + prime64_3;
+    }
+
+    return avalanche(h);
+}
+
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+namespace gb::hash
+{
+
+// hash64 is an xxHash-style 64-bit non-cryptographic hash.
+//
+// Input is consumed in 64 byte stripes spread across 8 independent 64-bit accumulators (the XXH3 layout), using only
+// 32x32->64 bit multiplies, so the inner loop maps directly onto SSE2/AVX2/NEON lanes; the widest the CPU supports is
+// picked at runtime.
+// The output is NOT compatible with the reference xxHash implementations - it is only meant to be compared against
+// other hashes produced by this function.
+[[nodiscard]] uint64_t hash64(const void* data, size_t len, uint64_t seed = 0) noexcept;
+
+[[nodiscard]] inline uint64_t hash64(std::span<const uint8_t> data, uint64_t seed = 0) noexcept
+{
+    return hash64(data.data(), data.size(), seed);
+}
+
+}
@@ -0,0 +1,108 @@
+#include "instance.hpp"
+
+#include <new>
+#include <vector>
+
+#include "instance_pool.hpp"
+#include "state.hpp"
+
+namespace gb
+{
+
+size_t instance::bytes(const cartridge& cart) noexcept
+{
+    const size_t size = sizeof(instance) + cart_ram_size(cart);
+    return (size + alignment - 1) / alignment * alignment;
+}
+
+instance* instance::create(void* block, const cartridge& cart, model model, boot_mode boot) noexcept
+{
+    // like the rest of the RAM, cartridge RAM starts out cleared without touching its storage (see paged_ram)
+    return new (block) instance{cart, model, boot};
+}
+
+void instance::destroy(instance* inst) noexcept { inst->~instance(); }
+
+instance::instance(const cartridge& cart, model model, boot_mode boot) noexcept
+    : bank{pick_controller(cart, {cart_ram(), cart_ram_size(cart)})}
+    , mem{std::visit([](auto& c) -> memory_bank_controller& { return c; }, bank), cart}
+    , processor{mem, model, boot}
+    , pool{nullptr}
+    , hardware{model}
+{
+}
+
+instance_ptr instance::fork()
+{
+    auto child = pool != nullptr ? pool->acquire(hardware) : make_instance(mem.game(), hardware);
+
+    // a fork's state is only the registers, a few KiB at most, so a buffer per thread never has to grow again
+    thread_local std::vector<uint8_t> buf;
+
+    state_writer out{buf, state_scope::fork};
+    processor.save_state(out);
+    if (out.size() > buf.size())
+    {
+        buf.resize(out.size());
+        out = state_writer{buf, state_scope::fork};
+        processor.save_state(out);
+    }
+
+    state_reader in{{buf.data(), out.size()}, state_scope::fork};
+    child->processor.load_state(in);
+
+    mem.share_ram(child->mem);
+    child->mem.display().copy_frames(mem.display());
+
+    child->mem.set_accurate(mem.accurate());
+    child->processor.set_idle_skipping(processor.skipping_idle());
+    return child;
+}
+
+// the same choice as make_controller (see controllers.hpp), but made in place: the controllers with RAM, or none
+static cartridge::memory_bank_controller banked_ram(const cartridge& cart) noexcept
+{
+    using enum cartridge::memory_bank_controller;
+
+    const auto kind = cart.loaded() ? cart.describe_type().controller : none;
+    return kind == mbc1 || kind == mbc3 || kind == mbc5 ? kind : none;
+}
+
+size_t instance::cart_ram_size(const cartridge& cart) noexcept
+{
+    return banked_ram(cart) != cartridge::memory_bank_controller::none ? cart.ram_size() : 0;
+}
+
+instance::controller instance::pick_controller(const cartridge& cart, std::span<uint8_t> ram) noexcept
+{
+    using kind = cartridge::memory_bank_controller;
+
+    switch (banked_ram(cart))
+    {
+    case kind::mbc1: return controller{std::in_place_type<mbc1>, cart, ram};
+    case kind::mbc3: return controller{std::in_place_type<mbc3>, cart, ram};
+    case kind::mbc5: return controller{std::in_place_type<mbc5>, cart, ram};
+    default: return controller{std::in_place_type<direct_memory_bank>, cart};
+    }
+}
+
+void instance_deleter::operator()(instance* inst) const noexcept
+{
+    if (inst->pool != nullptr)
+    {
+        inst->pool->release(inst);
+    }
+    else
+    {
+        instance::destroy(inst);
+        ::operator delete(inst, std::align_val_t{instance::alignment});
+    }
+}
+
+instance_ptr make_instance(const cartridge& cart, model model, boot_mode boot)
+{
+    void* block = ::operator new(instance::bytes(cart), std::align_val_t{instance::alignment});
+    return instance_ptr{instance::create(block, cart, model, boot)};
+}
+
+}
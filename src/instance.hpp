@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <variant>
+
+#include "cartridge.hpp"
+#include "cpu.hpp"
+#include "direct_memory_bank.hpp"
+#include "mbc1.hpp"
+#include "mbc3.hpp"
+#include "mbc5.hpp"
+#include "memory.hpp"
+#include "models.hpp"
+
+namespace gb
+{
+
+class instance;
+class instance_pool;
+
+// instance_deleter powers off an instance, handing its block back to its pool or freeing it
+struct instance_deleter
+{
+    void operator()(instance* inst) const noexcept;
+};
+
+using instance_ptr = std::unique_ptr<instance, instance_deleter>;
+
+// instance is a whole machine in one cache-line aligned block: the cpu, its memory (and with it the ppu, joypad and
+// serial port), the memory bank controller, and behind them the cartridge RAM. Nothing else is allocated, and the
+// cartridge is only read, so any number of instances can share one, each costing bytes(cart) on top.
+//
+// Cartridge RAM lives as long as the instance, and in its states, but isn't saved anywhere: instances are for running
+// many machines at once, main runs a single one with its save file. Instances started and stopped often are best taken
+// from an instance_pool (see instance_pool.hpp), which recycles their blocks.
+class alignas(64) instance
+{
+public:
+    static constexpr size_t alignment = 64; // a cache line
+
+    // bytes is the size of the block an instance running cart takes
+    [[nodiscard]] static size_t bytes(const cartridge& cart) noexcept;
+
+    // create powers on an instance running cart in block, which must be bytes(cart) long and aligned to alignment, and
+    // stay so until destroy
+    static instance* create(void* block, const cartridge& cart, model model, boot_mode boot = boot_mode::fast) noexcept;
+
+    // destroy powers off inst, leaving its block to be reused
+    static void destroy(instance* inst) noexcept;
+
+    instance(const instance&)            = delete;
+    instance& operator=(const instance&) = delete;
+
+    [[nodiscard]] cpu&       machine() noexcept { return processor; }
+    [[nodiscard]] const cpu& machine() const noexcept { return processor; }
+
+    // fork starts a new instance exactly where this one is, as if its state were saved and loaded, but sharing all of
+    // its RAM a page at a time until either writes to a page, and only copying a few KiB of registers and the frame
+    // buffers. The new instance comes from this one's pool if it has one, and has the same configuration (accurate
+    // mode, idle skipping), but no debugger or link cable.
+    //
+    // Neither this instance nor the fork may be running meanwhile, but once it is made they (and any other forks) can
+    // each run on their own thread.
+    [[nodiscard]] instance_ptr fork();
+
+private:
+    friend class instance_pool;
+    friend struct instance_deleter;
+
+    using controller = std::variant<direct_memory_bank, mbc1, mbc3, mbc5>;
+
+    instance(const cartridge& cart, model model, boot_mode boot) noexcept;
+    ~instance() = default;
+
+    [[nodiscard]] static size_t     cart_ram_size(const cartridge& cart) noexcept;
+    [[nodiscard]] static controller pick_controller(const cartridge& cart, std::span<uint8_t> ram) noexcept;
+
+    // the cartridge RAM is right after the instance, in the same block
+    [[nodiscard]] uint8_t* cart_ram() noexcept { return reinterpret_cast<uint8_t*>(this + 1); }
+
+    controller     bank;
+    memory         mem;
+    cpu            processor;
+    instance_pool* pool; // the block's, if it came from one
+    model          hardware;
+};
+
+// make_instance allocates a block for an instance running cart, and powers it on
+instance_ptr make_instance(const cartridge& cart, model model, boot_mode boot = boot_mode::fast);
+
+}
@@ -0,0 +1,85 @@
+#include "instance_pool.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <new>
+
+namespace gb
+{
+
+instance_pool::instance_pool(const cartridge& cart) noexcept
+    : cart{cart}
+    , block{instance::bytes(cart)}
+    , shards{}
+    , slabs{}
+{
+}
+
+instance_pool::~instance_pool()
+{
+    for (void* slab : slabs) ::operator delete(slab, std::align_val_t{instance::alignment});
+}
+
+instance_ptr instance_pool::acquire(model model, boot_mode boot)
+{
+    auto* inst = instance::create(take(), cart, model, boot);
+    inst->pool = this;
+    return instance_ptr{inst};
+}
+
+size_t instance_pool::allocated() const noexcept
+{
+    std::lock_guard guard{slabs_lock};
+    return slabs.size() * slab_blocks;
+}
+
+void instance_pool::release(instance* inst) noexcept
+{
+    instance::destroy(inst);
+
+    auto& s = shards[home_shard()];
+
+    std::lock_guard guard{s.lock};
+    s.head = new (static_cast<void*>(inst)) free_block{s.head};
+}
+
+void* instance_pool::take()
+{
+    const size_t home = home_shard();
+    for (size_t i = 0; i < num_shards; ++i)
+    {
+        auto& s = shards[(home + i) % num_shards];
+
+        std::lock_guard guard{s.lock};
+        if (free_block* b = s.head; b != nullptr)
+        {
+            s.head = b->next;
+            return b;
+        }
+    }
+
+    // out of blocks: keep the first of a new slab, and the rest go to this thread's shard
+    uint8_t* slab = nullptr;
+    {
+        std::lock_guard guard{slabs_lock};
+        slabs.reserve(slabs.size() + 1);
+
+        slab = static_cast<uint8_t*>(::operator new(block * slab_blocks, std::align_val_t{instance::alignment}));
+        slabs.push_back(slab);
+    }
+
+    auto& s = shards[home];
+
+    std::lock_guard guard{s.lock};
+    for (size_t i = 1; i < slab_blocks; ++i) s.head = new (slab + (i * block)) free_block{s.head};
+    return slab;
+}
+
+size_t instance_pool::home_shard() noexcept
+{
+    static std::atomic<size_t> next_shard{0};
+    thread_local const size_t  home = next_shard.fetch_add(1, std::memory_order_relaxed) % num_shards;
+    return home;
+}
+
+}
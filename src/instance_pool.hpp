@@ -0,0 +1,75 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+#include "cartridge.hpp"
+#include "instance.hpp"
+#include "models.hpp"
+
+namespace gb
+{
+
+// instance_pool hands out instances running one cartridge, carved from slabs of blocks it keeps: an instance's block
+// goes back to the pool when it is powered off, to be handed out again. Once the pool has grown to the most instances
+// in use at once, starting and stopping them allocates nothing.
+//
+// Free blocks are spread over shards, each thread taking from and giving back to its own first, so threads starting
+// and stopping instances at the same time seldom wait on each other.
+class instance_pool
+{
+public:
+    static constexpr size_t slab_blocks = 16; // blocks allocated at a time
+
+    explicit instance_pool(const cartridge& cart) noexcept;
+
+    // every instance must have gone back to the pool first
+    ~instance_pool();
+
+    instance_pool(const instance_pool&)            = delete;
+    instance_pool& operator=(const instance_pool&) = delete;
+
+    // acquire powers on an instance in a free block, growing the pool if there are none. Its instance_ptr gives the
+    // block back.
+    instance_ptr acquire(model model, boot_mode boot = boot_mode::fast);
+
+    [[nodiscard]] size_t block_bytes() const noexcept { return block; }
+
+    // allocated counts the pool's blocks, in use or free
+    [[nodiscard]] size_t allocated() const noexcept;
+
+private:
+    friend struct instance_deleter;
+
+    static constexpr size_t num_shards = 8;
+
+    // a free block holds a link to the next
+    struct free_block
+    {
+        free_block* next;
+    };
+
+    struct alignas(instance::alignment) shard
+    {
+        std::mutex  lock;
+        free_block* head = nullptr;
+    };
+
+    void release(instance* inst) noexcept;
+
+    // take takes a free block, from this thread's shard if it has one, then any other, then a new slab
+    [[nodiscard]] void* take();
+
+    [[nodiscard]] static size_t home_shard() noexcept;
+
+    const cartridge&              cart;
+    size_t                        block;
+    std::array<shard, num_shards> shards;
+
+    mutable std::mutex slabs_lock;
+    std::vector<void*> slabs;
+};
+
+}
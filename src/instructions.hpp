@@ -1,6 +0,0 @@
-#pragma once
-
-#include <cstdint>
-
-void log_instruction(uint8_t op);
-void log_ext_instruction(uint8_t op);
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+
+namespace gb
+{
+
+enum class interrupt : uint8_t
+{
+    vblank   = 1U << 0U,
+    lcd_stat = 1U << 1U,
+    timer    = 1U << 2U,
+    serial   = 1U << 3U,
+    joypad   = 1U << 4U,
+
+    END = 1U << 5U,
+};
+
+// interrupt_controller owns IF (0xFF0F) and IE (0xFFFF).
+//
+// The interrupts both requested and enabled are kept precomputed, so the CPU can check for one with a single load.
+struct interrupt_controller
+{
+public:
+    // unused IF bits read as 1
+    [[nodiscard]] uint8_t read_flags() const noexcept { return 0xE0 | flags; }
+    [[nodiscard]] uint8_t read_enable() const noexcept { return enable; }
+
+    void write_flags(uint8_t val) noexcept
+    {
+        flags = val & all;
+        update();
+    }
+
+    void write_enable(uint8_t val) noexcept
+    {
+        enable = val;
+        update();
+    }
+
+    // request sets an interrupt's IF bit, regardless of IE or IME
+    void request(interrupt type) noexcept
+    {
+        flags |= static_cast<uint8_t>(type);
+        update();
+    }
+
+    // acknowledge clears an interrupt's IF bit, as the CPU does when servicing it
+    void acknowledge(interrupt type) noexcept
+    {
+        flags &= ~static_cast<uint8_t>(type);
+        update();
+    }
+
+    // pending is IF & IE: the interrupts that end HALT, and that the CPU services if IME is set
+    [[nodiscard]] uint8_t pending() const noexcept { return pending_mask; }
+
+private:
+    static constexpr uint8_t all = static_cast<uint8_t>(interrupt::END) - 1;
+
+    void update() noexcept { pending_mask = flags & enable & all; }
+
+    uint8_t flags        = 0;
+    uint8_t enable       = 0;
+    uint8_t pending_mask = 0;
+};
+
+}
@@ -0,0 +1,51 @@
+#include "joypad.hpp"
+
+#include "memory.hpp"
+#include "state.hpp"
+
+namespace gb
+{
+
+joypad::joypad(memory& mem) noexcept
+    : mem{mem}
+    , select{select_directions | select_actions}
+    , buttons{0}
+{}
+
+uint8_t joypad::read() const noexcept
+{
+    // unused bits read as 1, as do released buttons
+    return static_cast<uint8_t>(0xC0 | select | (~selected(buttons) & 0x0F));
+}
+
+void joypad::write(uint8_t val) noexcept { select = val & (select_directions | select_actions); }
+
+void joypad::set(uint8_t state) noexcept
+{
+    const uint8_t newly_pressed = state & ~buttons;
+    buttons                     = state;
+
+    if (selected(newly_pressed) != 0) mem.irq.request(interrupt::joypad);
+}
+
+void joypad::save_state(state_writer& out) const noexcept
+{
+    out.put(select);
+    out.put(buttons);
+}
+
+void joypad::load_state(state_reader& in) noexcept
+{
+    select  = in.get<uint8_t>() & (select_directions | select_actions);
+    buttons = in.get<uint8_t>();
+}
+
+uint8_t joypad::selected(uint8_t state) const noexcept
+{
+    uint8_t out = 0;
+    if ((select & select_directions) == 0) out |= state & 0x0F;
+    if ((select & select_actions) == 0) out |= state >> 4;
+    return out;
+}
+
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+
+namespace gb
+{
+
+struct memory;
+class state_reader;
+class state_writer;
+
+enum class button : uint8_t
+{
+    right  = 1U << 0U,
+    left   = 1U << 1U,
+    up     = 1U << 2U,
+    down   = 1U << 3U,
+    a      = 1U << 4U,
+    b      = 1U << 5U,
+    select = 1U << 6U,
+    start  = 1U << 7U,
+};
+
+// joypad emulates the P1 register (0xFF00).
+//
+// Button state is a bitmask of button values, with a set bit meaning "pressed" (the opposite of how P1 reports them).
+struct joypad
+{
+public:
+    explicit joypad(memory& mem) noexcept;
+
+    [[nodiscard]] uint8_t read() const noexcept;
+    void                  write(uint8_t val) noexcept;
+
+    [[nodiscard]] uint8_t pressed() const noexcept { return buttons; }
+
+    // set replaces the state of all buttons, requesting the joypad interrupt if a button in a selected group was
+    // pressed
+    void set(uint8_t state) noexcept;
+
+    void save_state(state_writer& out) const noexcept;
+    void load_state(state_reader& in) noexcept;
+
+private:
+    static constexpr uint8_t select_directions = 1U << 4U;
+    static constexpr uint8_t select_actions    = 1U << 5U;
+
+    [[nodiscard]] uint8_t selected(uint8_t state) const noexcept;
+
+    memory& mem;
+    uint8_t select; // P1 bits 4 and 5, 0 = selected
+    uint8_t buttons;
+};
+
+}
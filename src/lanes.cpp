@@ -0,0 +1,670 @@
+#include "lanes.hpp"
+
+#include <algorithm>
+#include <utility>
+
+#include "cpu.hpp"
+#include "memory.hpp"
+#include "ppu.hpp"
+
+namespace gb
+{
+
+namespace
+{
+
+constexpr uint8_t zero_flag  = 0x80;
+constexpr uint8_t sub_flag   = 0x40;
+constexpr uint8_t half_flag  = 0x20;
+constexpr uint8_t carry_flag = 0x10;
+constexpr uint8_t low_bits   = 0x0F; // the rest of F, kept as is
+
+constexpr uint8_t flag(bool set, uint8_t bit) noexcept { return set ? bit : 0; }
+
+// in_block is true for the instructions lanes run together: those that only touch registers, memory and pc
+constexpr bool in_block(const opcode& info) noexcept
+{
+    using enum mnemonic;
+
+    switch (info.name)
+    {
+    case NOP:
+    case INC:
+    case DEC:
+    case ADC:
+    case SUB:
+    case SBC:
+    case AND:
+    case XOR:
+    case OR:
+    case CP:
+    case RLCA:
+    case RRCA:
+    case RLA:
+    case RRA:
+    case CPL:
+    case SCF:
+    case CCF:
+    case JR:
+    case JP:
+    case RLC:
+    case RRC:
+    case RL:
+    case RR:
+    case SLA:
+    case SRA:
+    case SWAP:
+    case SRL:
+    case BIT:
+    case RES:
+    case SET: return true;
+
+    case ADD: return info.dst != operand::SP;
+    case LD:
+    case LDH: return info.src != operand::SP && info.src != operand::SP_e8;
+
+    default: return false;
+    }
+}
+
+// What follows is each instruction's effect on one lane, matching cpu_ops.cpp bit for bit, so lanes never drift from
+// the same instance run on its own. Each returns the result and the whole of F.
+
+struct result
+{
+    uint8_t val;
+    uint8_t flags;
+};
+
+template<mnemonic Name>
+constexpr result alu(uint8_t a, uint8_t v, uint8_t f) noexcept
+{
+    using enum mnemonic;
+
+    // only ADC and SBC take the carry in, counting towards both carries
+    const int     carry_in = (Name == ADC || Name == SBC) && (f & carry_flag) != 0 ? 1 : 0;
+    const uint8_t low      = f & low_bits;
+
+    if constexpr (Name == ADD || Name == ADC)
+    {
+        const int  sum  = a + v + carry_in;
+        const bool half = (a & 0x0F) + (v & 0x0F) + carry_in > 0x0F;
+        const auto res  = static_cast<uint8_t>(sum);
+        return {res,
+                static_cast<uint8_t>(low | flag(res == 0, zero_flag) | flag(half, half_flag)
+                                     | flag(sum > 0xFF, carry_flag))};
+    }
+    else if constexpr (Name == SUB || Name == SBC || Name == CP)
+    {
+        // CP is SUB without keeping the result
+        const int  diff = a - v - carry_in;
+        const bool half = (a & 0x0F) - (v & 0x0F) - carry_in < 0;
+        const auto res  = static_cast<uint8_t>(diff);
+        return {Name == CP ? a : res,
+                static_cast<uint8_t>(low | flag(res == 0, zero_flag) | sub_flag | flag(half, half_flag)
+                                     | flag(diff < 0, carry_flag))};
+    }
+    else if constexpr (Name == AND)
+    {
+        const auto res = static_cast<uint8_t>(a & v);
+        return {res, static_cast<uint8_t>(low | flag(res == 0, zero_flag) | half_flag)};
+    }
+    else if constexpr (Name == XOR)
+    {
+        const auto res = static_cast<uint8_t>(a ^ v);
+        return {res, static_cast<uint8_t>(low | flag(res == 0, zero_flag))};
+    }
+    else if constexpr (Name == OR)
+    {
+        const auto res = static_cast<uint8_t>(a | v);
+        return {res, static_cast<uint8_t>(low | flag(res == 0, zero_flag))};
+    }
+    else static_assert(Name == ADD, "not an 8-bit alu instruction");
+}
+
+// shift covers the rotates, shifts and SWAP, as 0xCB prefixed instructions and on A (RLCA and friends, which always
+// clear Z)
+template<mnemonic Name>
+constexpr result shift(uint8_t v, uint8_t f) noexcept
+{
+    using enum mnemonic;
+
+    constexpr bool on_a = Name == RLCA || Name == RRCA || Name == RLA || Name == RRA;
+
+    const uint8_t carry_in = (f & carry_flag) != 0 ? 1 : 0;
+    const bool    msb      = (v & 0x80) != 0;
+    const bool    lsb      = (v & 0x01) != 0;
+
+    uint8_t res   = 0;
+    bool    carry = false;
+
+    if constexpr (Name == RLC || Name == RLCA)
+    {
+        res   = static_cast<uint8_t>(v << 1 | v >> 7);
+        carry = msb;
+    }
+    else if constexpr (Name == RL || Name == RLA)
+    {
+        res   = static_cast<uint8_t>(v << 1 | carry_in);
+        carry = msb;
+    }
+    else if constexpr (Name == SLA)
+    {
+        res   = static_cast<uint8_t>(v << 1);
+        carry = msb;
+    }
+    else if constexpr (Name == RRC || Name == RRCA)
+    {
+        res   = static_cast<uint8_t>(v >> 1 | v << 7);
+        carry = lsb;
+    }
+    else if constexpr (Name == RR || Name == RRA)
+    {
+        res   = static_cast<uint8_t>(v >> 1 | carry_in << 7);
+        carry = lsb;
+    }
+    else if constexpr (Name == SRL)
+    {
+        res   = static_cast<uint8_t>(v >> 1);
+        carry = lsb;
+    }
+    else if constexpr (Name == SRA)
+    {
+        res   = static_cast<uint8_t>(v >> 1 | (v & 0x80));
+        carry = lsb;
+    }
+    else if constexpr (Name == SWAP) res = static_cast<uint8_t>(v << 4 | v >> 4);
+    else static_assert(Name == SWAP, "not a shift instruction");
+
+    return {res,
+            static_cast<uint8_t>((f & low_bits) | flag(!on_a && res == 0, zero_flag) | flag(carry, carry_flag))};
+}
+
+template<mnemonic Name>
+constexpr bool is_alu = Name == mnemonic::ADD || Name == mnemonic::ADC || Name == mnemonic::SUB || Name == mnemonic::SBC
+                     || Name == mnemonic::AND || Name == mnemonic::XOR || Name == mnemonic::OR || Name == mnemonic::CP;
+
+template<mnemonic Name>
+constexpr bool is_shift = Name == mnemonic::RLC || Name == mnemonic::RRC || Name == mnemonic::RL || Name == mnemonic::RR
+                       || Name == mnemonic::SLA || Name == mnemonic::SRA || Name == mnemonic::SWAP
+                       || Name == mnemonic::SRL || Name == mnemonic::RLCA || Name == mnemonic::RRCA
+                       || Name == mnemonic::RLA || Name == mnemonic::RRA;
+
+// blend sets the lanes of dst in mask to those of val. The arguments are copies, so the compiler knows they don't
+// overlap dst and the loop vectorizes without checks.
+template<typename T, size_t N>
+void blend(std::array<T, N>& dst, std::array<T, N> val, std::array<uint8_t, N> mask) noexcept
+{
+    for (size_t i = 0; i < N; ++i)
+    {
+        const auto m = static_cast<T>(-static_cast<T>(mask[i] & 1)); // all ones or all zeroes, as wide as T
+        dst[i]       = static_cast<T>((val[i] & m) | (dst[i] & ~m));
+    }
+}
+
+}
+
+template<operand O>
+lanes::lane_array<uint8_t>& lanes::reg8(block& b) noexcept
+{
+    using enum operand;
+    static_assert(is_reg8(O));
+
+    if constexpr (O == A) return b.A;
+    else if constexpr (O == B) return b.B;
+    else if constexpr (O == C) return b.C;
+    else if constexpr (O == D) return b.D;
+    else if constexpr (O == E) return b.E;
+    else if constexpr (O == H) return b.H;
+    else return b.L;
+}
+
+template<operand O>
+uint16_t lanes::get16(const block& b, size_t i) noexcept
+{
+    using enum operand;
+
+    if constexpr (O == BC) return static_cast<uint16_t>(b.B[i] << 8 | b.C[i]);
+    else if constexpr (O == DE) return static_cast<uint16_t>(b.D[i] << 8 | b.E[i]);
+    else if constexpr (O == HL) return static_cast<uint16_t>(b.H[i] << 8 | b.L[i]);
+    else if constexpr (O == SP) return b.sp[i];
+    else static_assert(O == SP, "not a 16-bit register");
+}
+
+template<operand O>
+void lanes::set16(block& b, size_t i, uint16_t val) noexcept
+{
+    using enum operand;
+
+    const auto high = static_cast<uint8_t>(val >> 8);
+    const auto low  = static_cast<uint8_t>(val);
+
+    if constexpr (O == BC) b.B[i] = high, b.C[i] = low;
+    else if constexpr (O == DE) b.D[i] = high, b.E[i] = low;
+    else if constexpr (O == HL) b.H[i] = high, b.L[i] = low;
+    else if constexpr (O == SP) b.sp[i] = val;
+    else static_assert(O == SP, "not a 16-bit register");
+}
+
+template<operand O>
+uint16_t lanes::address(block& b, size_t i) noexcept
+{
+    using enum operand;
+
+    if constexpr (O == at_BC) return get16<BC>(b, i);
+    else if constexpr (O == at_DE) return get16<DE>(b, i);
+    else if constexpr (O == at_HL) return get16<HL>(b, i);
+    else if constexpr (O == at_HLI || O == at_HLD)
+    {
+        const uint16_t hl = get16<HL>(b, i);
+        set16<HL>(b, i, O == at_HLI ? hl + 1 : hl - 1);
+        return hl;
+    }
+    else if constexpr (O == at_C) return 0xFF00 + b.C[i];
+    else if constexpr (O == at_n8) return 0xFF00 + b.lo[i];
+    else if constexpr (O == at_n16) return static_cast<uint16_t>(b.hi[i] << 8 | b.lo[i]);
+    else static_assert(O == at_n16, "not a memory operand");
+}
+
+template<operand O>
+void lanes::load(block& b, const lane_mask& mask, lane_array<uint8_t>& out) noexcept
+{
+    if constexpr (is_reg8(O)) out = reg8<O>(b);
+    else if constexpr (O == operand::n8) out = b.lo;
+    else
+    {
+        // each lane from its own memory, in the same order as the cpu would
+        for (size_t i = 0; i < b.count; ++i)
+        {
+            if (mask[i] != 0) out[i] = b.buses[i]->read(address<O>(b, i));
+        }
+    }
+}
+
+template<operand O>
+void lanes::store(block& b, const lane_mask& mask, const lane_array<uint8_t>& val) noexcept
+{
+    if constexpr (is_reg8(O)) blend(reg8<O>(b), val, mask);
+    else
+    {
+        for (size_t i = 0; i < b.count; ++i)
+        {
+            if (mask[i] != 0) b.buses[i]->write(address<O>(b, i), val[i]);
+        }
+    }
+}
+
+template<opcode Info>
+void lanes::execute_op(block& b, const lane_mask& mask) noexcept
+{
+    using enum mnemonic;
+
+    constexpr auto name = Info.name;
+    constexpr auto dst  = Info.dst;
+    constexpr auto src  = Info.src;
+
+    lane_array<uint8_t> val{};
+    lane_array<uint8_t> res{};
+    lane_array<uint8_t> flags = b.F;
+
+    if constexpr (name == JR || name == JP)
+    {
+        lane_array<uint16_t> pc     = b.pc;
+        lane_array<uint8_t>  cycles = b.cycles;
+
+        for (size_t i = 0; i < width; ++i)
+        {
+            const auto next = static_cast<uint16_t>(pc[i] + Info.length);
+
+            uint16_t target = 0;
+            if constexpr (name == JR) target = static_cast<uint16_t>(next + static_cast<int8_t>(b.lo[i]));
+            else if constexpr (src == operand::HL) target = get16<operand::HL>(b, i);
+            else target = static_cast<uint16_t>(b.hi[i] << 8 | b.lo[i]);
+
+            bool taken = true;
+            if constexpr (dst == operand::if_NZ) taken = (b.F[i] & zero_flag) == 0;
+            else if constexpr (dst == operand::if_Z) taken = (b.F[i] & zero_flag) != 0;
+            else if constexpr (dst == operand::if_NC) taken = (b.F[i] & carry_flag) == 0;
+            else if constexpr (dst == operand::if_C) taken = (b.F[i] & carry_flag) != 0;
+
+            pc[i]     = taken ? target : next;
+            cycles[i] = taken && is_condition(dst) ? Info.taken : Info.cycles;
+        }
+
+        blend(b.pc, pc, mask);
+        blend(b.cycles, cycles, mask);
+        return;
+    }
+    else if constexpr (name == NOP)
+    {
+    }
+    else if constexpr (name == LD || name == LDH)
+    {
+        if constexpr (src == operand::n16)
+        {
+            for (size_t i = 0; i < b.count; ++i)
+            {
+                if (mask[i] != 0) set16<dst>(b, i, static_cast<uint16_t>(b.hi[i] << 8 | b.lo[i]));
+            }
+        }
+        else if constexpr (dst == operand::SP)
+        {
+            for (size_t i = 0; i < b.count; ++i)
+            {
+                if (mask[i] != 0) b.sp[i] = get16<operand::HL>(b, i);
+            }
+        }
+        else
+        {
+            load<src>(b, mask, val);
+            store<dst>(b, mask, val);
+        }
+    }
+    else if constexpr ((name == INC || name == DEC) && is_reg16(dst))
+    {
+        // no flags affected
+        for (size_t i = 0; i < b.count; ++i)
+        {
+            const uint16_t step = mask[i] & 1;
+            set16<dst>(b, i, static_cast<uint16_t>(name == INC ? get16<dst>(b, i) + step : get16<dst>(b, i) - step));
+        }
+    }
+    else if constexpr (name == INC || name == DEC)
+    {
+        load<dst>(b, mask, val);
+        for (size_t i = 0; i < width; ++i)
+        {
+            // carry not affected
+            const auto kept = static_cast<uint8_t>(flags[i] & (carry_flag | low_bits));
+            if constexpr (name == INC)
+            {
+                res[i]   = static_cast<uint8_t>(val[i] + 1);
+                flags[i] = kept | flag(res[i] == 0, zero_flag) | flag((val[i] & 0x0F) == 0x0F, half_flag);
+            }
+            else
+            {
+                res[i]   = static_cast<uint8_t>(val[i] - 1);
+                flags[i] = kept | flag(res[i] == 0, zero_flag) | sub_flag | flag((val[i] & 0x0F) == 0, half_flag);
+            }
+        }
+        store<dst>(b, mask, res);
+        blend(b.F, flags, mask);
+    }
+    else if constexpr (name == ADD && is_reg16(src))
+    {
+        // ADD HL,rr, zero not affected
+        for (size_t i = 0; i < b.count; ++i)
+        {
+            if (mask[i] == 0) continue;
+
+            const uint16_t hl = get16<operand::HL>(b, i);
+            const uint16_t rr = get16<src>(b, i);
+            const bool     h  = (hl & 0x0FFF) + (rr & 0x0FFF) > 0x0FFF;
+            const bool     c  = hl + rr > 0xFFFF;
+
+            b.F[i] = static_cast<uint8_t>((b.F[i] & (zero_flag | low_bits)) | flag(h, half_flag) | flag(c, carry_flag));
+            set16<operand::HL>(b, i, static_cast<uint16_t>(hl + rr));
+        }
+    }
+    else if constexpr (is_alu<name>)
+    {
+        load<src>(b, mask, val);
+        const lane_array<uint8_t> a = b.A;
+        for (size_t i = 0; i < width; ++i)
+        {
+            const auto out = alu<name>(a[i], val[i], flags[i]);
+            res[i]         = out.val;
+            flags[i]       = out.flags;
+        }
+        blend(b.A, res, mask);
+        blend(b.F, flags, mask);
+    }
+    else if constexpr (is_shift<name>)
+    {
+        constexpr auto target = name == RLCA || name == RRCA || name == RLA || name == RRA ? operand::A : dst;
+
+        load<target>(b, mask, val);
+        for (size_t i = 0; i < width; ++i)
+        {
+            const auto out = shift<name>(val[i], flags[i]);
+            res[i]         = out.val;
+            flags[i]       = out.flags;
+        }
+        store<target>(b, mask, res);
+        blend(b.F, flags, mask);
+    }
+    else if constexpr (name == CPL || name == SCF || name == CCF)
+    {
+        const lane_array<uint8_t> a = b.A;
+        for (size_t i = 0; i < width; ++i)
+        {
+            const auto f = flags[i];
+            if constexpr (name == CPL)
+            {
+                res[i]   = static_cast<uint8_t>(~a[i]);
+                flags[i] = f | sub_flag | half_flag;
+            }
+            else if constexpr (name == SCF)
+            {
+                res[i]   = a[i];
+                flags[i] = static_cast<uint8_t>((f & (zero_flag | low_bits)) | carry_flag);
+            }
+            else
+            {
+                res[i]   = a[i];
+                flags[i] = static_cast<uint8_t>((f & (zero_flag | low_bits)) | ((f & carry_flag) ^ carry_flag));
+            }
+        }
+        blend(b.A, res, mask);
+        blend(b.F, flags, mask);
+    }
+    else if constexpr (name == BIT)
+    {
+        load<dst>(b, mask, val);
+        for (size_t i = 0; i < width; ++i)
+        {
+            const bool clear = (val[i] & (1U << Info.value)) == 0;
+            const auto kept  = static_cast<uint8_t>(flags[i] & (carry_flag | low_bits));
+            flags[i]         = kept | flag(clear, zero_flag) | half_flag;
+        }
+        blend(b.F, flags, mask);
+    }
+    else if constexpr (name == SET || name == RES)
+    {
+        load<dst>(b, mask, val);
+        for (size_t i = 0; i < width; ++i)
+        {
+            constexpr auto bit = static_cast<uint8_t>(1U << Info.value);
+            res[i]             = static_cast<uint8_t>(name == SET ? val[i] | bit : val[i] & ~bit);
+        }
+        store<dst>(b, mask, res);
+    }
+    else static_assert(name == NOP, "not run as part of a block");
+
+    lane_array<uint16_t> pc = b.pc;
+    lane_array<uint8_t>  cycles{};
+    for (auto& next : pc) next += Info.length;
+    cycles.fill(Info.cycles);
+
+    blend(b.pc, pc, mask);
+    blend(b.cycles, cycles, mask);
+}
+
+size_t lanes::add(cpu& instance)
+{
+    if (blocks.empty() || blocks.back().count == width) blocks.emplace_back();
+
+    auto& b           = blocks.back();
+    b.cpus[b.count]   = &instance;
+    b.buses[b.count]  = &instance.bus();
+    b.count          += 1;
+
+    return instances++;
+}
+
+void lanes::run_frame() noexcept
+{
+    for (auto& b : blocks) run_frame(b);
+}
+
+void lanes::run_frame(block& b) noexcept
+{
+    lane_mask            running{};
+    lane_array<uint64_t> frames{};
+
+    for (size_t i = 0; i < b.count; ++i)
+    {
+        b.cpus[i]->running = true;
+        frames[i]          = b.buses[i]->display().frame_count();
+        running[i]         = 0xFF;
+        load(b, i);
+    }
+
+    while (std::any_of(running.begin(), running.end(), [](uint8_t lane) { return lane != 0; }))
+    {
+        step(b, running, frames);
+    }
+
+    for (size_t i = 0; i < b.count; ++i) store(b, i);
+}
+
+lanes::handler lanes::decode(block& b, size_t i) noexcept
+{
+    // every entry an instantiation of execute_op for the matching opcode, or empty for those peeled off
+    static constexpr auto handlers = []<size_t... I>(std::index_sequence<I...>)
+    {
+        auto pick = []<size_t Op>(std::integral_constant<size_t, Op>) -> handler
+        {
+            constexpr const opcode& info = Op < 0x100 ? opcodes[Op] : ext_opcodes[Op - 0x100];
+            if constexpr (info.name != mnemonic::PREFIX && in_block(info)) return &execute_op<info>;
+            else return nullptr;
+        };
+        return std::array<handler, sizeof...(I)>{pick(std::integral_constant<size_t, I>{})...};
+    }(std::make_index_sequence<0x200>{});
+
+    const cpu& c   = *b.cpus[i];
+    memory&    mem = *b.buses[i];
+
+    // The program's own reads have to see what peek does (no DMA bus conflicts), and not be counted or watched, since
+    // the instruction is read ahead of deciding how to run it.
+    if (c.debug_mode || c.debug != nullptr || mem.counting || mem.oam_dma_active) return nullptr;
+
+    // HALT, or the instruction after EI, which turns interrupts on as it goes
+    if (c.pipeline.top() != cpu::action::execute) return nullptr;
+
+    const uint16_t pc = b.pc[i];
+    const uint8_t  op = mem.peek(pc);
+
+    b.op[i] = op == 0xCB ? 0x100 + mem.peek(pc + 1) : op;
+
+    const opcode& info = b.op[i] < 0x100 ? opcodes[op] : ext_opcodes[b.op[i] - 0x100];
+    if (info.length > 1) b.lo[i] = mem.peek(pc + 1);
+    if (info.length > 2) b.hi[i] = mem.peek(pc + 2);
+
+    return handlers[b.op[i]];
+}
+
+void lanes::step(block& b, lane_mask& running, const lane_array<uint64_t>& frames) noexcept
+{
+    auto done = [&](size_t i) { return !b.cpus[i]->running || b.buses[i]->display().frame_count() != frames[i]; };
+
+    lane_array<handler> next{};
+    for (size_t i = 0; i < b.count; ++i)
+    {
+        if (running[i] == 0) continue;
+
+        next[i] = decode(b, i);
+        if (next[i] != nullptr) continue;
+
+        peel(b, i);
+        if (done(i)) running[i] = 0;
+    }
+
+    const lane_array<uint16_t> at = b.pc;
+
+    // each different instruction once, masked to the lanes running it
+    lane_mask pending{};
+    for (size_t i = 0; i < b.count; ++i) pending[i] = next[i] != nullptr ? 0xFF : 0x00;
+
+    for (size_t i = 0; i < b.count; ++i)
+    {
+        if (pending[i] == 0) continue;
+
+        lane_mask mask{};
+        for (size_t j = i; j < b.count; ++j) mask[j] = next[j] == next[i] ? 0xFF : 0x00;
+        next[i](b, mask);
+
+        for (size_t j = i; j < b.count; ++j) pending[j] &= ~mask[j];
+    }
+
+    // then the rest of each lane's step, as cpu::step would have carried on
+    for (size_t i = 0; i < b.count; ++i)
+    {
+        if (next[i] == nullptr) continue;
+
+        cpu& c = *b.cpus[i];
+
+        uint32_t spent = b.cycles[i];
+        c.mem->counters().instructions.add();
+        vector_steps += 1;
+
+        if (c.idle_skipping && b.pc[i] < at[i])
+        {
+            store(b, i);
+            const uint32_t skipped = c.skip_idle_loop(at[i], spent);
+            c.mem->counters().idle_cycles.add(skipped);
+            spent += skipped;
+        }
+
+        // taking an interrupt pushes pc and jumps, which the cpu does on its own registers
+        const bool interrupted = c.interrupts_enabled && c.mem->interrupts().pending() != 0;
+        if (interrupted) store(b, i);
+        c.finish(spent);
+        if (interrupted) load(b, i);
+
+        if (done(i)) running[i] = 0;
+    }
+}
+
+void lanes::peel(block& b, size_t i) noexcept
+{
+    store(b, i);
+    b.cpus[i]->step();
+    load(b, i);
+
+    scalar_steps += 1;
+}
+
+void lanes::load(block& b, size_t i) noexcept
+{
+    const auto& r = b.cpus[i]->r;
+
+    b.A[i]  = r.A;
+    b.F[i]  = r.F;
+    b.B[i]  = r.B;
+    b.C[i]  = r.C;
+    b.D[i]  = r.D;
+    b.E[i]  = r.E;
+    b.H[i]  = r.H;
+    b.L[i]  = r.L;
+    b.sp[i] = r.sp;
+    b.pc[i] = r.pc;
+}
+
+void lanes::store(const block& b, size_t i) noexcept
+{
+    auto& r = b.cpus[i]->r;
+
+    r.A  = b.A[i];
+    r.F  = b.F[i];
+    r.B  = b.B[i];
+    r.C  = b.C[i];
+    r.D  = b.D[i];
+    r.E  = b.E[i];
+    r.H  = b.H[i];
+    r.L  = b.L[i];
+    r.sp = b.sp[i];
+    r.pc = b.pc[i];
+}
+
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "opcodes.hpp"
+
+namespace gb
+{
+
+struct cpu;
+struct memory;
+
+// lanes runs many instances of the same game in lockstep, as training loops do to try different inputs from the same
+// point. It is experimental.
+//
+// Instances are stepped a block of width at a time, with their registers laid out as structure of arrays, a byte per
+// lane. Lanes about to run the same register or memory instruction run it as one: decoded once, the arithmetic done on
+// every lane of the block at once (masked to those running it, and vectorized by the compiler), and memory accessed
+// through each lane's own bus. Anything else (calls, returns, the stack, HALT, EI, an interrupt being taken) and any
+// lane with a debugger, access counting or an OAM DMA in the way peels off to its own cpu for the step.
+//
+// The results are exactly those of running each instance on its own, down to the cycle, but so far it is slower: the
+// ppu, timers and DMA still step lane by lane after every instruction, and interleaving the lanes loses the branch
+// prediction and cache locality an instance has running on its own, which outweighs the decoding and arithmetic
+// saved. Batching the peripherals the same way is what would have to come next.
+//
+// So it is only built when asked for, with the GBEMU_LANES CMake option, which also has gbemu_run use it for batches
+// run on the calling thread. The tests always build it, to check it against the cpu.
+struct lanes
+{
+public:
+    static constexpr size_t width = 16; // lanes per block, so one register of every lane fills a 128-bit vector
+
+    // add adds instance to the next free lane, returning its index. The instance must outlive any run, and not be run
+    // by anything else during one.
+    size_t add(cpu& instance);
+
+    // run_frame runs every instance until it completes a frame, or is stopped
+    void run_frame() noexcept;
+
+    [[nodiscard]] size_t size() const noexcept { return instances; }
+
+    // vectorized counts the instructions run as part of a block, peeled the steps lanes ran on their own
+    [[nodiscard]] uint64_t vectorized() const noexcept { return vector_steps; }
+    [[nodiscard]] uint64_t peeled() const noexcept { return scalar_steps; }
+
+private:
+    template<typename T>
+    using lane_array = std::array<T, width>;
+
+    // masks are 0xFF in the lanes an instruction applies to, 0x00 elsewhere
+    using lane_mask = lane_array<uint8_t>;
+
+    struct block
+    {
+        alignas(16) lane_array<uint8_t> A{};
+        alignas(16) lane_array<uint8_t> F{};
+        alignas(16) lane_array<uint8_t> B{};
+        alignas(16) lane_array<uint8_t> C{};
+        alignas(16) lane_array<uint8_t> D{};
+        alignas(16) lane_array<uint8_t> E{};
+        alignas(16) lane_array<uint8_t> H{};
+        alignas(16) lane_array<uint8_t> L{};
+        alignas(16) lane_array<uint16_t> sp{};
+        alignas(16) lane_array<uint16_t> pc{};
+
+        // the instruction each lane is about to run: its opcode (0x100 up for 0xCB prefixed ones) and the two bytes
+        // after it, then the cycles it took
+        lane_array<uint16_t> op{};
+        lane_array<uint8_t>  lo{};
+        lane_array<uint8_t>  hi{};
+        lane_array<uint8_t>  cycles{};
+
+        std::array<cpu*, width>    cpus{};
+        std::array<memory*, width> buses{};
+        size_t                     count = 0;
+    };
+
+    using handler = void (*)(block&, const lane_mask&) noexcept;
+
+    void run_frame(block& b) noexcept;
+    void step(block& b, lane_mask& running, const lane_array<uint64_t>& frames) noexcept;
+
+    // decode finds the handler for what lane i is about to run, if it can run as part of the block
+    [[nodiscard]] static handler decode(block& b, size_t i) noexcept;
+
+    // peel runs a step of lane i on its own cpu
+    void peel(block& b, size_t i) noexcept;
+
+    // load copies lane i's registers from its cpu, store back
+    static void load(block& b, size_t i) noexcept;
+    static void store(const block& b, size_t i) noexcept;
+
+    // Instruction handlers, generated from opcodes like the cpu's (see cpu_ops.cpp), and sharing their semantics
+    // exactly.
+    template<opcode Info>
+    static void execute_op(block& b, const lane_mask& mask) noexcept;
+
+    template<operand O>
+    static lane_array<uint8_t>& reg8(block& b) noexcept;
+    template<operand O>
+    static uint16_t get16(const block& b, size_t i) noexcept;
+    template<operand O>
+    static void set16(block& b, size_t i, uint16_t val) noexcept;
+    template<operand O>
+    static uint16_t address(block& b, size_t i) noexcept;
+    template<operand O>
+    static void load(block& b, const lane_mask& mask, lane_array<uint8_t>& out) noexcept;
+    template<operand O>
+    static void store(block& b, const lane_mask& mask, const lane_array<uint8_t>& val) noexcept;
+
+    std::vector<block> blocks;
+    size_t             instances    = 0;
+    uint64_t           vector_steps = 0;
+    uint64_t           scalar_steps = 0;
+};
+
+}
@@ -0,0 +1,299 @@
+#include "link.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#define GB_HAVE_UNIX_SOCKETS 1
+#endif
+
+namespace gb
+{
+
+std::error_code loopback_link::exchange(const link_batch& out, link_batch& in) noexcept
+{
+    in = out;
+    return {};
+}
+
+// memory_channel carries batches one way between the ends of an in-process cable, without locks.
+//
+// Batches alternate between two slots. That's enough, since the sender can only post batch n + 2 once it has received
+// the other end's batch n + 1, which the other end only posts once it is done reading batch n.
+struct memory_channel
+{
+    static constexpr uint64_t closed = uint64_t{1} << 63U; // set in posted once the sending end is gone
+
+    std::array<link_batch, 2> slots;
+    std::atomic<uint64_t>     posted{0}; // number of batches posted
+};
+
+class memory_link : public link_transport
+{
+public:
+    memory_link(std::shared_ptr<std::array<memory_channel, 2>> channels, size_t end)
+        : channels{std::move(channels)}
+        , end{end}
+        , exchanged{0}
+    {}
+
+    memory_link(const memory_link&)            = delete;
+    memory_link& operator=(const memory_link&) = delete;
+    memory_link(memory_link&&)                 = delete;
+    memory_link& operator=(memory_link&&)      = delete;
+
+    ~memory_link() override
+    {
+        auto& send = (*channels)[end ^ 1U];
+        send.posted.fetch_or(memory_channel::closed, std::memory_order_release);
+        send.posted.notify_all();
+    }
+
+    std::error_code exchange(const link_batch& out, link_batch& in) noexcept override
+    {
+        auto& send = (*channels)[end ^ 1U];
+        auto& recv = (*channels)[end];
+
+        send.slots[exchanged & 1U] = out;
+        send.posted.store(exchanged + 1, std::memory_order_release);
+        send.posted.notify_one();
+
+        for (;;)
+        {
+            const uint64_t posted = recv.posted.load(std::memory_order_acquire);
+            if ((posted & ~memory_channel::closed) > exchanged) break;
+            if ((posted & memory_channel::closed) != 0) return std::make_error_code(std::errc::connection_reset);
+
+            recv.posted.wait(posted, std::memory_order_acquire);
+        }
+
+        in = recv.slots[exchanged & 1U];
+        ++exchanged;
+        return {};
+    }
+
+private:
+    std::shared_ptr<std::array<memory_channel, 2>> channels; // indexed by receiving end
+    size_t                                         end;
+    uint64_t                                       exchanged;
+};
+
+link_pair make_memory_link()
+{
+    auto channels = std::make_shared<std::array<memory_channel, 2>>();
+    return {std::make_unique<memory_link>(channels, 0), std::make_unique<memory_link>(channels, 1)};
+}
+
+#ifdef GB_HAVE_UNIX_SOCKETS
+
+static std::error_code last_error() noexcept { return {errno, std::generic_category()}; }
+
+// socket_link sends each batch as the SB byte, a 32-bit little-endian transfer count, then the transfers.
+//
+// Before that, each end says hello: "GBLK" then its quantum, 32-bit little-endian. Ends syncing every different number
+// of cycles would still trade batches, but not at the same emulated cycle, so they are refused from the start.
+class socket_link : public link_transport
+{
+public:
+    explicit socket_link(int fd) noexcept
+        : fd{fd}
+    {}
+
+    // handshake trades hellos with the other end, failing with protocol_error if it isn't gbemu, and invalid_argument
+    // if it syncs every different number of cycles
+    std::error_code handshake(uint32_t quantum) noexcept
+    {
+        std::array<uint8_t, hello_size> hello = {'G', 'B', 'L', 'K'};
+        for (size_t i = 0; i < 4; ++i) hello[4 + i] = static_cast<uint8_t>(quantum >> (8 * i));
+        if (auto err = send_all(hello.data(), hello.size()); err) return err;
+
+        std::array<uint8_t, hello_size> peer{};
+        if (auto err = recv_all(peer.data(), peer.size()); err) return err;
+        if (!std::equal(hello.begin(), hello.begin() + 4, peer.begin())) return drop(std::errc::protocol_error);
+
+        uint32_t peer_quantum = 0;
+        for (size_t i = 0; i < 4; ++i) peer_quantum |= static_cast<uint32_t>(peer[4 + i]) << (8 * i);
+        if (peer_quantum != quantum) return drop(std::errc::invalid_argument);
+
+        return {};
+    }
+
+    socket_link(const socket_link&)            = delete;
+    socket_link& operator=(const socket_link&) = delete;
+    socket_link(socket_link&&)                 = delete;
+    socket_link& operator=(socket_link&&)      = delete;
+
+    ~socket_link() override { ::close(fd); }
+
+    std::error_code exchange(const link_batch& out, link_batch& in) noexcept override
+    {
+        // both ends send before receiving, so neither waits on the other for more than a batch
+        if (out.transfers.size() > max_transfers) return drop(std::errc::message_size);
+        const auto count = static_cast<uint32_t>(out.transfers.size());
+
+        buffer.resize(header_size + count);
+        buffer[0] = out.data;
+        for (size_t i = 0; i < 4; ++i) buffer[1 + i] = static_cast<uint8_t>(count >> (8 * i));
+        std::copy(out.transfers.begin(), out.transfers.end(), buffer.begin() + header_size);
+
+        if (auto err = send_all(buffer.data(), buffer.size()); err) return err;
+
+        std::array<uint8_t, header_size> header{};
+        if (auto err = recv_all(header.data(), header.size()); err) return err;
+
+        uint32_t received = 0;
+        for (size_t i = 0; i < 4; ++i) received |= static_cast<uint32_t>(header[1 + i]) << (8 * i);
+
+        // the count comes from the other end, so is checked before anything is allocated for it
+        if (received > max_transfers) return drop(std::errc::bad_message);
+
+        in.data = header[0];
+        in.transfers.resize(received);
+        return recv_all(in.transfers.data(), in.transfers.size());
+    }
+
+private:
+    static constexpr size_t header_size = 5;
+    static constexpr size_t hello_size  = 8;
+
+    // max_transfers is the most a batch may carry: all the fast clock can transfer in 16 seconds, far beyond any
+    // sensible quantum
+    static constexpr size_t max_transfers = size_t{1} << 20;
+
+    // drop disconnects from a peer that broke the protocol (or would be, by this end), failing this exchange and any
+    // after it
+    std::error_code drop(std::errc err) noexcept
+    {
+        ::shutdown(fd, SHUT_RDWR);
+        return std::make_error_code(err);
+    }
+
+    std::error_code send_all(const uint8_t* data, size_t len) noexcept
+    {
+#ifdef MSG_NOSIGNAL
+        constexpr int flags = MSG_NOSIGNAL;
+#else
+        constexpr int flags = 0;
+#endif
+        while (len > 0)
+        {
+            const auto n = ::send(fd, data, len, flags);
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0) return last_error();
+
+            data += n;
+            len  -= static_cast<size_t>(n);
+        }
+        return {};
+    }
+
+    std::error_code recv_all(uint8_t* data, size_t len) noexcept
+    {
+        while (len > 0)
+        {
+            const auto n = ::recv(fd, data, len, 0);
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0) return last_error();
+            if (n == 0) return std::make_error_code(std::errc::connection_reset);
+
+            data += n;
+            len  -= static_cast<size_t>(n);
+        }
+        return {};
+    }
+
+    int                  fd;
+    std::vector<uint8_t> buffer;
+};
+
+static std::error_code socket_address(const std::filesystem::path& path, sockaddr_un& addr) noexcept
+{
+    const auto& native = path.native();
+    if (native.size() >= sizeof(addr.sun_path)) return std::make_error_code(std::errc::filename_too_long);
+
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    std::memcpy(addr.sun_path, native.c_str(), native.size());
+    return {};
+}
+
+// start_socket_link says hello over the freshly connected socket fd, handing it to out if the other end agrees
+static std::error_code start_socket_link(int fd, uint32_t quantum, std::unique_ptr<link_transport>& out)
+{
+    auto link = std::make_unique<socket_link>(fd);
+    if (auto err = link->handshake(quantum); err) return err;
+
+    out = std::move(link);
+    return {};
+}
+
+std::error_code listen_socket_link(const std::filesystem::path&     path,
+                                   uint32_t                         quantum,
+                                   std::unique_ptr<link_transport>& out)
+{
+    sockaddr_un addr{};
+    if (auto err = socket_address(path, addr); err) return err;
+
+    const int server = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (server < 0) return last_error();
+
+    ::unlink(path.c_str());
+    if (::bind(server, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0 || ::listen(server, 1) != 0)
+    {
+        auto err = last_error();
+        ::close(server);
+        return err;
+    }
+
+    int fd = -1;
+    while ((fd = ::accept(server, nullptr, nullptr)) < 0 && errno == EINTR) {}
+
+    auto err = fd < 0 ? last_error() : std::error_code{};
+    ::close(server);
+    ::unlink(path.c_str());
+    if (err) return err;
+
+    return start_socket_link(fd, quantum, out);
+}
+
+std::error_code connect_socket_link(const std::filesystem::path&     path,
+                                    uint32_t                         quantum,
+                                    std::unique_ptr<link_transport>& out)
+{
+    sockaddr_un addr{};
+    if (auto err = socket_address(path, addr); err) return err;
+
+    const int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return last_error();
+
+    if (::connect(fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0)
+    {
+        auto err = last_error();
+        ::close(fd);
+        return err;
+    }
+
+    return start_socket_link(fd, quantum, out);
+}
+
+#else
+
+std::error_code listen_socket_link(const std::filesystem::path&, uint32_t, std::unique_ptr<link_transport>&)
+{
+    return std::make_error_code(std::errc::not_supported);
+}
+
+std::error_code connect_socket_link(const std::filesystem::path&, uint32_t, std::unique_ptr<link_transport>&)
+{
+    return std::make_error_code(std::errc::not_supported);
+}
+
+#endif
+
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <system_error>
+#include <utility>
+
+#include "link_transport.hpp"
+
+namespace gb
+{
+
+// loopback_link is a cable plugged back into the port it comes from: bytes clocked out come straight back in.
+class loopback_link : public link_transport
+{
+public:
+    std::error_code exchange(const link_batch& out, link_batch& in) noexcept override;
+};
+
+using link_pair = std::pair<std::unique_ptr<link_transport>, std::unique_ptr<link_transport>>;
+
+// make_memory_link returns the two ends of a cable between two emulators in the same process.
+//
+// An exchange waits, without taking any locks, until the other end reaches the same sync point, so the ends must be
+// driven from separate threads. Destroying either end disconnects the other.
+[[nodiscard]] link_pair make_memory_link();
+
+// listen_socket_link creates a Unix domain socket at path and waits for the other end to connect to it. Both ends
+// must sync every quantum cycles, or it fails with std::errc::invalid_argument as soon as they connect.
+std::error_code listen_socket_link(const std::filesystem::path&     path,
+                                   uint32_t                         quantum,
+                                   std::unique_ptr<link_transport>& out);
+
+// connect_socket_link connects to a Unix domain socket created by listen_socket_link, checking the quantum likewise.
+std::error_code connect_socket_link(const std::filesystem::path&     path,
+                                    uint32_t                         quantum,
+                                    std::unique_ptr<link_transport>& out);
+
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <system_error>
+#include <vector>
+
+namespace gb
+{
+
+// link_batch is everything one end of a link cable did between two sync points.
+struct link_batch
+{
+    uint8_t              data = 0xFF; // SB as of the sync point, what the other end reads back when it clocks a byte
+    std::vector<uint8_t> transfers;   // bytes clocked out with the internal clock, in order
+};
+
+// link_transport carries link_batches between the two ends of a link cable.
+//
+// Exchanges happen at sync points, the same (emulated) cycle on both ends, and each exchange pairs one end's batch with
+// the other end's batch for the same sync point. That is what keeps linked emulators in lockstep.
+class link_transport
+{
+public:
+    link_transport() = default;
+
+    link_transport(const link_transport&)            = delete;
+    link_transport& operator=(const link_transport&) = delete;
+
+    link_transport(link_transport&&) noexcept            = default;
+    link_transport& operator=(link_transport&&) noexcept = default;
+
+    virtual ~link_transport() = default;
+
+    // exchange sends out and replaces in with the other end's batch for the same sync point
+    virtual std::error_code exchange(const link_batch& out, link_batch& in) noexcept = 0;
+};
+
+}
@@ -0,0 +1,106 @@
+#include "lockstep.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <thread>
+
+#include "cpu.hpp"
+#include "link.hpp"
+#include "memory.hpp"
+
+namespace gb
+{
+
+lockstep::lockstep(uint32_t quantum) noexcept
+    : quantum{std::max<uint32_t>(quantum, 1)}
+    , instances{}
+    , linked{}
+    , running{false}
+{}
+
+lockstep::~lockstep()
+{
+    for (cpu* instance : linked) instance->bus().serial_port().connect(nullptr);
+}
+
+size_t lockstep::add(cpu& instance)
+{
+    instances.push_back(&instance);
+    return instances.size() - 1;
+}
+
+void lockstep::link(size_t a, size_t b)
+{
+    auto [first, second] = make_memory_link();
+    instances[a]->bus().serial_port().connect(std::move(first), quantum);
+    instances[b]->bus().serial_port().connect(std::move(second), quantum);
+
+    linked.push_back(instances[a]);
+    linked.push_back(instances[b]);
+}
+
+void lockstep::run(uint64_t cycles)
+{
+    running = true;
+
+    {
+        std::vector<std::jthread> threads;
+        threads.reserve(instances.size());
+
+        try
+        {
+            for (cpu* instance : instances)
+            {
+                threads.emplace_back([this, instance, cycles] { run_instance(*instance, cycles); });
+            }
+        }
+        catch (...)
+        {
+            // the instances already started can't be left waiting on those that weren't
+            stop();
+            throw;
+        }
+    }
+
+    running = false;
+}
+
+void lockstep::stop() noexcept
+{
+    running = false;
+    for (cpu* instance : instances) instance->stop();
+}
+
+void lockstep::run_instance(cpu& instance, uint64_t cycles) noexcept
+{
+    auto& port = instance.bus().serial_port();
+
+    if (cycles != 0 && port.connected())
+    {
+        // both ends count the same sync points from when they were plugged in, so each stops right after the same one,
+        // rather than one going on to the next and waiting there for an end that has stopped
+        const uint64_t end = port.sync_count() + cycles / quantum + (cycles % quantum != 0 ? 1 : 0);
+        port.hold_syncs(end);
+
+        while (running && port.connected() && port.sync_count() < end) instance.run_for(port.until_next_sync());
+
+        port.hold_syncs(serial::no_limit);
+    }
+    else
+    {
+        uint64_t left = cycles != 0 ? cycles : std::numeric_limits<uint64_t>::max();
+
+        // run a quantum at a time, so a stop can't be missed while cpu::run_for is starting up
+        while (running && left > 0)
+        {
+            const uint64_t start = instance.elapsed();
+            instance.run_for(std::min<uint64_t>(left, quantum));
+            left -= std::min(left, instance.elapsed() - start);
+        }
+    }
+
+    // stopped part way, so unplug, or anything linked to this instance would wait on it forever
+    if (!running) port.connect(nullptr);
+}
+
+}
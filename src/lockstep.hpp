@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "serial.hpp"
+
+namespace gb
+{
+
+struct cpu;
+
+// lockstep runs several emulators side by side, each on its own thread.
+//
+// Instances linked together sync up through their link cable every quantum cycles, so they never drift more than a
+// quantum apart. Nothing else is shared: there is no global lock or barrier, and an instance that isn't linked to
+// anything never waits on another.
+struct lockstep
+{
+public:
+    explicit lockstep(uint32_t quantum = serial::default_quantum) noexcept;
+
+    lockstep(const lockstep&)            = delete;
+    lockstep& operator=(const lockstep&) = delete;
+    lockstep(lockstep&&)                 = delete;
+    lockstep& operator=(lockstep&&)      = delete;
+
+    // the cables plugged in by link are unplugged again
+    ~lockstep();
+
+    // add schedules instance, returning its index. The instance must outlive the lockstep.
+    size_t add(cpu& instance);
+
+    // link plugs a cable between the serial ports of the instances at indices a and b, which stays plugged in from one
+    // run to the next
+    void link(size_t a, size_t b);
+
+    // run runs every instance for cycles, or until stop if cycles is 0, returning once they are all done. Linked
+    // instances run on to the end of the quantum cycles falls in, so that each ends the run at the same sync point as
+    // the other end of its cable, and the next run picks up from there.
+    void run(uint64_t cycles = 0);
+
+    // stop ends a run in progress, and may be called from any thread. That leaves linked instances at different
+    // points, so it unplugs their cables, or one would wait forever on the other at its next sync point.
+    void stop() noexcept;
+
+    [[nodiscard]] size_t size() const noexcept { return instances.size(); }
+
+private:
+    void run_instance(cpu& instance, uint64_t cycles) noexcept;
+
+    uint32_t          quantum;
+    std::vector<cpu*> instances;
+    std::vector<cpu*> linked; // plugged in by link
+    std::atomic_bool  running;
+};
+
+}
@@ -1,3 +1,7 @@
+#include <array>
+#include <atomic>
+#include <charconv>
+#include <chrono>
 #include <cstdint>
 #include <cstdio>
 #include <filesystem>
@@ -5,27 +9,79 @@
 #include <ios>
 #include <iostream>
 #include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
 #include <system_error>
 #include <thread>
+#include <utility>
+#include <vector>
 
 #include <cxxopts.hpp>
 
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_error.h>
 #include <SDL2/SDL_events.h>
+#include <SDL2/SDL_keyboard.h>
 #include <SDL2/SDL_log.h>
 #include <SDL2/SDL_render.h>
 #include <SDL2/SDL_video.h>
 
 #include "cartridge.hpp"
+#include "controllers.hpp"
 #include "cpu.hpp"
-#include "direct_memory_bank.hpp"
+#include "debugger.hpp"
+#include "gdb_stub.hpp"
+#include "golden.hpp"
+#include "hash.hpp"
+#include "instance.hpp"
+#include "joypad.hpp"
+#include "link.hpp"
 #include "memory.hpp"
+#include "metrics_exporter.hpp"
+#include "movie.hpp"
+#include "ppu.hpp"
 
 namespace fs = std::filesystem;
 
 std::error_code load_cart(const fs::path& path, gb::cartridge& cart);
 
+struct headless_options
+{
+    uint64_t          frames = 0;
+    gb::golden*       check  = nullptr;
+    gb::golden*       record = nullptr;
+    gb::movie_player* player = nullptr;
+    gb::debugger*     debug  = nullptr;
+    gb::gdb_stub*     stub   = nullptr;
+};
+
+int run_headless(gb::cpu& cpu, gb::memory& mem, const headless_options& opts);
+
+// start_metrics exports cpu's metrics as asked for on the command line, returning false if that fails
+bool start_metrics(const cxxopts::ParseResult& results,
+                   const std::string&         name,
+                   gb::cpu&                   cpu,
+                   gb::metrics_exporter&      out);
+
+// start_debugger attaches a debugger to cpu if breakpoints, watchpoints or a gdb stub are asked for on the command
+// line, returning false if one of them is malformed
+bool start_debugger(const cxxopts::ParseResult& results, gb::cpu& cpu, std::optional<gb::debugger>& out);
+
+// start_gdb serves the GDB remote protocol for cpu if asked for on the command line, returning false if that fails
+bool start_gdb(const cxxopts::ParseResult&  results,
+               gb::cpu&                     cpu,
+               std::optional<gb::debugger>& debug,
+               std::optional<gb::gdb_stub>& out);
+
+// link_error describes why plugging in a link cable failed
+std::string link_error(const std::error_code& err);
+
+// report_stop logs why cpu stopped
+void report_stop(const gb::debugger::stop& stop, const gb::cpu& cpu);
+
+uint8_t key_to_button(SDL_Keycode key) noexcept;
+
 int main(int argc, char* argv[])
 {
     cxxopts::Options options("gbemu", "A Gameboy Emulator");
@@ -38,6 +94,27 @@ int main(int argc, char* argv[])
             ("f,factor", "Integer to multiply base window size by.", cxxopts::value<int>()->default_value("5"))
             ("v,verbose", "Enable verbose logging.", cxxopts::value<bool>())
             ("d,debug", "Enable debug mode - LOTS of output.", cxxopts::value<bool>())
+            ("dmg", "Emulate the original Game Boy even for color games.", cxxopts::value<bool>())
+            ("accurate", "Emulate timing details such as DMA bus conflicts exactly, and don't fast-forward busy-wait loops.", cxxopts::value<bool>())
+            ("boot-rom", "Run the boot ROM instead of starting directly at the cartridge entry point.", cxxopts::value<bool>())
+            ("headless", "Run without a window, as fast as possible.", cxxopts::value<bool>())
+            ("n,frames", "Number of frames to run when headless. 0 runs until the golden sequence ends.", cxxopts::value<uint64_t>()->default_value("0"))
+            ("check-golden", "Compare frame hashes against a golden sequence file, stopping at the first divergence.", cxxopts::value<std::string>())
+            ("record-golden", "Record frame hashes to a golden sequence file.", cxxopts::value<std::string>())
+            ("record-movie", "Record joypad input to a movie file.", cxxopts::value<std::string>())
+            ("play-movie", "Replay a movie file, headless. Runs until the last input unless --frames is given.", cxxopts::value<std::string>())
+            ("link-listen", "Wait for another gbemu to plug into a link cable at this Unix socket path.", cxxopts::value<std::string>())
+            ("link-connect", "Plug into the link cable another gbemu is listening on at this Unix socket path.", cxxopts::value<std::string>())
+            ("link-loopback", "Plug the link cable back into the same Game Boy.", cxxopts::value<bool>())
+            ("link-quantum", "Cycles between link cable sync points.", cxxopts::value<uint32_t>()->default_value("4096"))
+            ("metrics-file", "Write Prometheus metrics to this file every --metrics-interval.", cxxopts::value<std::string>())
+            ("metrics-socket", "Serve Prometheus metrics on this Unix socket path.", cxxopts::value<std::string>())
+            ("metrics-interval", "Milliseconds between updates of --metrics-file.", cxxopts::value<uint32_t>()->default_value("1000"))
+            ("break", "Stop before running the instruction at ADDR, or with \"ADDR if COND\" only when COND holds. May be repeated.", cxxopts::value<std::vector<std::string>>())
+            ("watch", "Stop after a write to ADDR, or ADDR-LAST, optionally followed by \"if COND\". May be repeated.", cxxopts::value<std::vector<std::string>>())
+            ("rwatch", "As --watch, but for reads.", cxxopts::value<std::vector<std::string>>())
+            ("awatch", "As --watch, but for reads and writes.", cxxopts::value<std::vector<std::string>>())
+            ("gdb", "Serve the GDB remote protocol on this localhost TCP port, or Unix socket path.", cxxopts::value<std::string>())
             ("h,help", "Show help", cxxopts::value<bool>())
         ;
     // clang-format on
@@ -94,6 +171,134 @@ int main(int argc, char* argv[])
         return 1;
     }
 
+    const auto rom_hash = cart.content_hash();
+    const auto boot     = results["boot-rom"].as<bool>() ? gb::boot_mode::full : gb::boot_mode::fast;
+
+    const bool color_game = cart.color_flag() != gb::cartridge::color_support::monochrome_supported;
+    const bool accurate   = results["accurate"].as<bool>();
+    const auto model      = color_game && !results["dmg"].as<bool>() ? gb::model::color : gb::model::original;
+
+    gb::golden check;
+    gb::golden record{.rom_hash = rom_hash, .input_hash = 0, .frames = {}};
+    gb::movie  input{.rom_hash = rom_hash, .events = {}};
+
+    headless_options headless{.frames = results["frames"].as<uint64_t>()};
+
+    std::optional<gb::movie_player> player;
+    if (results.count("play-movie") != 0)
+    {
+        const fs::path path = results["play-movie"].as<std::string>();
+        if (auto err = gb::load_movie(path, input); err)
+        {
+            std::cerr << "unable to load " << std::quoted(path.string()) << ": " << err.message() << std::endl;
+            return 1;
+        }
+
+        if (input.rom_hash != rom_hash)
+        {
+            std::cerr << std::quoted(path.string()) << " was not recorded with " << std::quoted(rom_file.string())
+                      << std::endl;
+            return 1;
+        }
+
+        player.emplace(input);
+        headless.player   = &*player;
+        record.input_hash = input.hash();
+    }
+
+    if (results.count("check-golden") != 0)
+    {
+        const fs::path path = results["check-golden"].as<std::string>();
+        if (auto err = gb::load_golden(path, check); err)
+        {
+            std::cerr << "unable to load " << std::quoted(path.string()) << ": " << err.message() << std::endl;
+            return 1;
+        }
+
+        if (check.rom_hash != rom_hash)
+        {
+            std::cerr << std::quoted(path.string()) << " was not recorded with " << std::quoted(rom_file.string())
+                      << std::endl;
+            return 1;
+        }
+
+        if (check.input_hash != record.input_hash)
+        {
+            std::cerr << std::quoted(path.string()) << " was recorded with different input" << std::endl;
+            return 1;
+        }
+
+        headless.check = &check;
+    }
+
+    if (results.count("record-golden") != 0) headless.record = &record;
+
+    const uint32_t link_quantum = results["link-quantum"].as<uint32_t>();
+
+    std::unique_ptr<gb::link_transport> cable;
+    if (results["link-loopback"].as<bool>()) cable = std::make_unique<gb::loopback_link>();
+
+    if (results.count("link-listen") != 0)
+    {
+        const fs::path path = results["link-listen"].as<std::string>();
+        SDL_Log("waiting for the other end of the link cable on %s", path.c_str());
+        if (auto err = gb::listen_socket_link(path, link_quantum, cable); err)
+        {
+            std::cerr << "unable to listen on " << std::quoted(path.string()) << ": " << link_error(err) << std::endl;
+            return 1;
+        }
+    }
+
+    if (results.count("link-connect") != 0)
+    {
+        const fs::path path = results["link-connect"].as<std::string>();
+        if (auto err = gb::connect_socket_link(path, link_quantum, cable); err)
+        {
+            std::cerr << "unable to connect to " << std::quoted(path.string()) << ": " << link_error(err) << std::endl;
+            return 1;
+        }
+    }
+
+    const bool headless_run = results["headless"].as<bool>() || headless.check != nullptr
+                           || headless.record != nullptr || headless.player != nullptr;
+
+    if (headless_run)
+    {
+        // saves are left alone, so every headless run starts from the same state
+        auto  instance = gb::make_instance(cart, model, boot);
+        auto& cpu      = instance->machine();
+        auto& bus      = cpu.bus();
+        bus.set_accurate(accurate);
+        cpu.set_idle_skipping(!accurate);
+        if (cable != nullptr) bus.serial_port().connect(std::move(cable), link_quantum);
+
+        gb::metrics_exporter exporter;
+        if (!start_metrics(results, rom_file.stem().string(), cpu, exporter)) return 1;
+
+        std::optional<gb::debugger> debug;
+        if (!start_debugger(results, cpu, debug)) return 1;
+        if (debug.has_value()) headless.debug = &*debug;
+
+        std::optional<gb::gdb_stub> stub;
+        if (!start_gdb(results, cpu, debug, stub)) return 1;
+        if (stub.has_value()) headless.stub = &*stub;
+
+        const int status = run_headless(cpu, bus, headless);
+        exporter.stop();
+
+        if (headless.record != nullptr)
+        {
+            const fs::path path = results["record-golden"].as<std::string>();
+            if (auto err = gb::save_golden(path, record); err)
+            {
+                std::cerr << "unable to save " << std::quoted(path.string()) << ": " << err.message() << std::endl;
+                return 1;
+            }
+        }
+
+        return status;
+    }
+
     int res = SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO | SDL_INIT_EVENTS);
     if (res != 0)
     {
@@ -135,12 +340,65 @@ int main(int argc, char* argv[])
     }
 
     {
-        // TODO determine memory_bank_controller to use
-        auto controller = std::make_unique<gb::direct_memory_bank>(cart);
+        auto controller = gb::make_controller(cart, fs::path{rom_file}.replace_extension(".sav"));
+
+        auto        mem     = std::make_unique<gb::memory>(std::move(controller), cart);
+        auto&       bus     = *mem;
+        auto&       display = mem->display();
+        gb::cpu     cpu     = gb::cpu{std::move(mem), model, boot};
+        bus.set_accurate(accurate);
+        cpu.set_idle_skipping(!accurate);
+        if (cable != nullptr) bus.serial_port().connect(std::move(cable), link_quantum);
+
+        gb::metrics_exporter exporter;
+        if (!start_metrics(results, rom_file.stem().string(), cpu, exporter)) return 1;
+
+        std::optional<gb::debugger> debug;
+        if (!start_debugger(results, cpu, debug)) return 1;
+
+        std::optional<gb::gdb_stub> stub;
+        if (!start_gdb(results, cpu, debug, stub)) return 1;
 
-        auto         mem = std::make_unique<gb::memory>(std::move(controller), cart);
-        gb::cpu      cpu = gb::cpu{std::move(mem), gb::model::original};
-        std::jthread cpu_thread{&gb::cpu::run, &cpu};
+        const bool recording = results.count("record-movie") != 0;
+
+        // input is only applied between frames, on the cpu thread, so it lands at a reproducible point in emulated time
+        std::atomic<uint8_t> buttons{0};
+
+        auto emulate = [&](const std::stop_token& stop)
+        {
+            while (!stop.stop_requested())
+            {
+                const uint8_t state = buttons.load(std::memory_order_relaxed);
+                if (state != bus.input().pressed())
+                {
+                    bus.input().set(state);
+                    if (recording) input.record(display.frame_count(), 0, state);
+                }
+
+                cpu.run_frame();
+
+                // a gdb client inspects the stopped cpu itself; otherwise report the stop and carry on
+                if (stub.has_value()) stub->hold(stop);
+                else if (cpu.stopped_by_debugger())
+                {
+                    report_stop(*debug->stopped(), cpu);
+                    debug->resume();
+                }
+            }
+        };
+
+        std::jthread cpu_thread{emulate};
+
+        SDL_Texture* screen = SDL_CreateTexture(renderer,
+                                                SDL_PIXELFORMAT_BGR555,
+                                                SDL_TEXTUREACCESS_STREAMING,
+                                                gb::screen_width,
+                                                gb::screen_height);
+        if (screen == nullptr)
+        {
+            SDL_LogCritical(SDL_LOG_CATEGORY_APPLICATION, "failure to create texture: %s", SDL_GetError());
+            return 1;
+        }
 
         bool run = true;
         while (run)
@@ -152,16 +410,36 @@ int main(int argc, char* argv[])
                 {
                 case SDL_QUIT:
                     run = false;
-                    cpu.stop();
+                    cpu_thread.request_stop();
                     break;
+
+                case SDL_KEYDOWN:
+                    if (event.key.repeat == 0) buttons.fetch_or(key_to_button(event.key.keysym.sym));
+                    break;
+
+                case SDL_KEYUP: buttons.fetch_and(static_cast<uint8_t>(~key_to_button(event.key.keysym.sym))); break;
                 }
             }
 
             SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
             SDL_RenderClear(renderer);
-            // TODO
+
+            const auto& frame = display.take_frame();
+            SDL_UpdateTexture(screen, nullptr, frame.data(), gb::screen_width * sizeof(gb::framebuffer::value_type));
+            SDL_RenderCopy(renderer, screen, nullptr, nullptr);
+
             SDL_RenderPresent(renderer);
         }
+
+        SDL_DestroyTexture(screen);
+        cpu_thread.join();
+
+        if (recording)
+        {
+            const fs::path path = results["record-movie"].as<std::string>();
+            if (auto err = gb::save_movie(path, input); err)
+                std::cerr << "unable to save " << std::quoted(path.string()) << ": " << err.message() << std::endl;
+        }
     }
 
     if (window != nullptr) SDL_DestroyWindow(window);
@@ -184,9 +462,252 @@ std::error_code load_cart(const fs::path& path, gb::cartridge& cart)
     auto* file = std::fopen(path.c_str(), "rb");
     if (file == nullptr) return std::error_code{errno, std::iostream_category()};
 
-    cart.data.reserve(size);
+    cart.data.resize(size);
     size_t actual = std::fread(cart.data.data(), 1, size, file);
-    if (actual != size) std::error_code(errno, std::iostream_category());
+    std::fclose(file);
+    if (actual != size) return std::error_code(errno, std::iostream_category());
 
     return {};
 }
+
+int run_headless(gb::cpu& cpu, gb::memory& mem, const headless_options& opts)
+{
+    uint64_t frames = opts.frames;
+    if (frames == 0 && opts.check != nullptr) frames = opts.check->frames.size();
+    if (frames == 0 && opts.player != nullptr) frames = opts.player->last_frame() + 1;
+    if (frames == 0)
+    {
+        std::cerr << "--frames is required when running headless without --check-golden or --play-movie\n";
+        return 1;
+    }
+    if (opts.check != nullptr && frames > opts.check->frames.size())
+    {
+        std::cerr << "--frames is " << frames << ", but the golden only has " << opts.check->frames.size()
+                  << " frames to check\n";
+        return 1;
+    }
+
+    for (uint64_t n = 0; n < frames; ++n)
+    {
+        // a gdb client gets the cpu whenever it stops, after which the rest of the frame runs
+        const auto frame = mem.display().frame_count();
+        do
+        {
+            if (opts.player != nullptr) opts.player->run_frame(cpu, mem);
+            else cpu.run_frame();
+
+            if (opts.stub != nullptr) opts.stub->hold();
+            else if (cpu.stopped_by_debugger())
+            {
+                report_stop(*opts.debug->stopped(), cpu);
+                return 3;
+            }
+        } while (mem.display().frame_count() == frame);
+
+        const auto hash = gb::hash_frame(mem.display().front());
+
+        if (opts.record != nullptr) opts.record->frames.push_back(hash);
+
+        if (opts.check != nullptr && opts.check->frames[n] != hash)
+        {
+            std::cerr << "frame " << n << " diverged: expected " << std::hex << std::setw(16) << std::setfill('0')
+                      << opts.check->frames[n] << ", got " << std::setw(16) << hash << std::dec << std::endl;
+            return 2;
+        }
+    }
+
+    if (opts.check != nullptr) std::cout << frames << " frames match" << std::endl;
+
+    return 0;
+}
+
+bool start_metrics(const cxxopts::ParseResult& results,
+                   const std::string&         name,
+                   gb::cpu&                   cpu,
+                   gb::metrics_exporter&      out)
+{
+    const bool to_file   = results.count("metrics-file") != 0;
+    const bool to_socket = results.count("metrics-socket") != 0;
+    if (!to_file && !to_socket) return true;
+
+    if (to_file && to_socket)
+    {
+        std::cerr << "--metrics-file and --metrics-socket can't be used together\n";
+        return false;
+    }
+
+    cpu.bus().set_access_counting(true);
+    out.add(name, cpu);
+
+    const fs::path path     = results[to_file ? "metrics-file" : "metrics-socket"].as<std::string>();
+    const auto     interval = std::chrono::milliseconds{results["metrics-interval"].as<uint32_t>()};
+    const auto     err      = to_file ? out.write_file(path, interval) : out.serve(path);
+    if (err)
+    {
+        std::cerr << "unable to export metrics to " << std::quoted(path.string()) << ": " << err.message() << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+// parse_address parses a hex address, with or without a $ or 0x prefix, from the front of text
+static bool parse_address(std::string_view& text, uint16_t& addr)
+{
+    if (text.starts_with('$')) text.remove_prefix(1);
+    else if (text.starts_with("0x") || text.starts_with("0X")) text.remove_prefix(2);
+
+    uint32_t val = 0;
+    const auto [end, err] = std::from_chars(text.data(), text.data() + text.size(), val, 16);
+    if (err != std::errc{} || val > 0xFFFF) return false;
+
+    text.remove_prefix(static_cast<size_t>(end - text.data()));
+    addr = static_cast<uint16_t>(val);
+    return true;
+}
+
+// parse_point splits "ADDR[-LAST] [if COND]"
+static bool parse_point(std::string_view spec, uint16_t& first, uint16_t& last, std::string_view& condition)
+{
+    condition = {};
+    if (const auto at = spec.find(" if "); at != std::string_view::npos)
+    {
+        condition = spec.substr(at + 4);
+        spec      = spec.substr(0, at);
+    }
+
+    while (spec.ends_with(' ')) spec.remove_suffix(1);
+
+    if (!parse_address(spec, first)) return false;
+    last = first;
+
+    if (spec.starts_with('-'))
+    {
+        spec.remove_prefix(1);
+        if (!parse_address(spec, last)) return false;
+    }
+
+    return spec.empty();
+}
+
+bool start_debugger(const cxxopts::ParseResult& results, gb::cpu& cpu, std::optional<gb::debugger>& out)
+{
+    using access = gb::debugger::access;
+
+    constexpr std::array<std::pair<const char*, access>, 4> kinds = {{
+        {"break", access{}},
+        {"watch", access::write},
+        {"rwatch", access::read},
+        {"awatch", access::any},
+    }};
+
+    if (results.count("gdb") != 0) out.emplace(cpu);
+
+    for (const auto& [option, kind] : kinds)
+    {
+        if (results.count(option) == 0) continue;
+        if (!out.has_value()) out.emplace(cpu);
+
+        for (const auto& spec : results[option].as<std::vector<std::string>>())
+        {
+            uint16_t         first = 0;
+            uint16_t         last  = 0;
+            std::string_view condition;
+            uint32_t         id = 0;
+
+            std::error_code err = std::make_error_code(std::errc::invalid_argument);
+            if (parse_point(spec, first, last, condition))
+            {
+                err = kind == access{} ? out->add_breakpoint(first, condition, id)
+                                       : out->add_watchpoint(first, last, kind, condition, id);
+            }
+
+            if (err)
+            {
+                std::cerr << "--" << option << " " << std::quoted(spec) << ": " << err.message() << std::endl;
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+bool start_gdb(const cxxopts::ParseResult&  results,
+               gb::cpu&                     cpu,
+               std::optional<gb::debugger>& debug,
+               std::optional<gb::gdb_stub>& out)
+{
+    if (results.count("gdb") == 0) return true;
+
+    // all digits is a port, anything else a path
+    const auto where = results["gdb"].as<std::string>();
+    uint32_t   port  = 0;
+
+    const auto [end, parse_err] = std::from_chars(where.data(), where.data() + where.size(), port);
+    const bool is_port          = parse_err == std::errc{} && end == where.data() + where.size();
+
+    if (is_port && (port == 0 || port > 0xFFFF))
+    {
+        std::cerr << "--gdb port must be between 1 and 65535\n";
+        return false;
+    }
+
+    out.emplace(cpu, *debug);
+    const auto err = is_port ? out->listen_tcp(static_cast<uint16_t>(port)) : out->listen_unix(where);
+    if (err)
+    {
+        std::cerr << "unable to serve gdb on " << std::quoted(where) << ": " << err.message() << std::endl;
+        out.reset();
+        return false;
+    }
+
+    SDL_Log("gdb: listening on %s%s", is_port ? "localhost:" : "", where.c_str());
+    return true;
+}
+
+std::string link_error(const std::error_code& err)
+{
+    if (err == std::errc::invalid_argument) return "the other end has a different --link-quantum";
+    if (err == std::errc::protocol_error) return "the other end isn't a gbemu link cable";
+    return err.message();
+}
+
+void report_stop(const gb::debugger::stop& stop, const gb::cpu& cpu)
+{
+    using kind = gb::debugger::stop::kind;
+
+    const auto& r = cpu.regs();
+    if (stop.reason == kind::breakpoint)
+    {
+        SDL_Log("breakpoint %u at %04X", stop.id, stop.addr);
+    }
+    else
+    {
+        SDL_Log("watchpoint %u: %s $%02X at %04X",
+                stop.id,
+                stop.reason == kind::read ? "read" : "wrote",
+                stop.value,
+                stop.addr);
+    }
+
+    SDL_Log("PC=%04X SP=%04X AF=%04X BC=%04X DE=%04X HL=%04X", r.pc, r.sp, r.AF, r.BC, r.DE, r.HL);
+}
+
+uint8_t key_to_button(SDL_Keycode key) noexcept
+{
+    using enum gb::button;
+
+    switch (key)
+    {
+    case SDLK_RIGHT: return static_cast<uint8_t>(right);
+    case SDLK_LEFT: return static_cast<uint8_t>(left);
+    case SDLK_UP: return static_cast<uint8_t>(up);
+    case SDLK_DOWN: return static_cast<uint8_t>(down);
+    case SDLK_x: return static_cast<uint8_t>(a);
+    case SDLK_z: return static_cast<uint8_t>(b);
+    case SDLK_BACKSPACE: return static_cast<uint8_t>(select);
+    case SDLK_RETURN: return static_cast<uint8_t>(start);
+    default: return 0;
+    }
+}
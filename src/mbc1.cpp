@@ -0,0 +1,106 @@
+#include "mbc1.hpp"
+
+#include <algorithm>
+
+#include "state.hpp"
+
+namespace gb
+{
+
+constexpr size_t   rom_bank_size = 0x4000;
+constexpr size_t   ram_bank_size = 0x2000;
+constexpr uint16_t ram_start     = 0xA000;
+
+mbc1::mbc1(const cartridge& cart, std::unique_ptr<save_file> save)
+    : cart{cart}
+    , save{std::move(save)}
+    , volatile_ram(this->save != nullptr ? 0 : cart.ram_size())
+    , ram{this->save != nullptr ? this->save->ram() : std::span<uint8_t>{volatile_ram}, true}
+    , rom_bank{1}
+    , upper{0}
+    , ram_mode{false}
+    , ram_enabled{false}
+{
+}
+
+mbc1::mbc1(const cartridge& cart, std::span<uint8_t> ram)
+    : cart{cart}
+    , save{nullptr}
+    , volatile_ram{}
+    , ram{ram}
+    , rom_bank{1}
+    , upper{0}
+    , ram_mode{false}
+    , ram_enabled{false}
+{
+}
+
+uint8_t mbc1::read(uint16_t addr) noexcept
+{
+    if (addr < ram_start)
+    {
+        // the upper bits reach the ROM at 0000 - 3FFF too, in RAM banking mode
+        const size_t bank   = addr < rom_bank_size ? (ram_mode ? upper << 5U : 0) : (upper << 5U) | rom_bank;
+        const size_t offset = (bank * rom_bank_size) + (addr % rom_bank_size);
+
+        // bank numbers beyond the ROM wrap around, as only as many bank lines as it needs are wired up
+        return cart.data[offset % cart.data.size()];
+    }
+
+    if (!ram_enabled) return 0xFF;
+
+    const size_t offset = ram_offset(addr);
+    return offset < ram.size() ? ram.read(offset) : 0xFF;
+}
+
+void mbc1::write(uint16_t addr, uint8_t val) noexcept
+{
+    switch (addr >> 13U)
+    {
+    case 0: ram_enabled = (val & 0x0F) == 0x0A; return;
+    case 1: rom_bank = std::max<uint8_t>(val & 0x1F, 1); return;
+    case 2: upper = val & 0x03; return;
+    case 3: ram_mode = (val & 0x01) != 0; return;
+    default: break;
+    }
+
+    if (addr < ram_start || !ram_enabled) return;
+
+    const size_t offset = ram_offset(addr);
+    if (offset >= ram.size()) return;
+
+    ram.write(offset, val);
+    if (save != nullptr) save->dirty(offset);
+}
+
+size_t mbc1::ram_offset(uint16_t addr) const noexcept
+{
+    // a RAM smaller than a bank repeats over it
+    const size_t bank = ram_mode ? upper : 0;
+    return ram.size() < ram_bank_size ? (addr - ram_start) % std::max<size_t>(ram.size(), 1)
+                                      : (bank * ram_bank_size) + (addr - ram_start);
+}
+
+void mbc1::save_state(state_writer& out) const noexcept
+{
+    out.put(rom_bank);
+    out.put(upper);
+    out.put(ram_mode);
+    out.put(ram_enabled);
+    if (out.scope() == state_scope::full) ram.save_state(out);
+}
+
+void mbc1::load_state(state_reader& in) noexcept
+{
+    rom_bank    = std::max<uint8_t>(in.get<uint8_t>() & 0x1F, 1);
+    upper       = in.get<uint8_t>() & 0x03;
+    ram_mode    = in.get<bool>();
+    ram_enabled = in.get<bool>();
+    if (in.scope() == state_scope::full) ram.load_state(in);
+
+    if (save != nullptr) save->dirty_all();
+}
+
+void mbc1::share_ram(memory_bank_controller& other) { ram.share_with(static_cast<mbc1&>(other).ram); }
+
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+
+#include "cartridge.hpp"
+#include "memory_bank_controller.hpp"
+#include "paged_ram.hpp"
+#include "save_file.hpp"
+
+namespace gb
+{
+
+// mbc1 is the MBC1 memory bank controller: up to 2 MiB of ROM and 32 KiB of RAM, the two sharing a 2-bit register
+// that either selects the RAM bank or extends the ROM bank, depending on the banking mode.
+class mbc1 : public memory_bank_controller
+{
+public:
+    // save holds the RAM on cartridges with a battery; without one it is lost at power off
+    mbc1(const cartridge& cart, std::unique_ptr<save_file> save);
+
+    // ram (cart.ram_size() bytes) is kept by whoever made the controller, and like RAM without a battery is lost at
+    // power off
+    mbc1(const cartridge& cart, std::span<uint8_t> ram);
+
+    uint8_t read(uint16_t addr) noexcept override;
+    void    write(uint16_t addr, uint8_t val) noexcept override;
+
+    void save_state(state_writer& out) const noexcept override;
+    void load_state(state_reader& in) noexcept override;
+
+    void share_ram(memory_bank_controller& other) override;
+
+private:
+    // ram_offset is where addr, in A000 - BFFF, is in the RAM
+    [[nodiscard]] size_t ram_offset(uint16_t addr) const noexcept;
+
+    const cartridge&           cart;
+    std::unique_ptr<save_file> save;
+    std::vector<uint8_t>       volatile_ram; // used instead of save without a battery
+    paged_ram                  ram;
+
+    uint8_t rom_bank;  // the low 5 bits of the ROM bank, never 0
+    uint8_t upper;     // RAM bank, or bits 5 and 6 of the ROM bank
+    bool    ram_mode;  // the upper bits select the RAM bank, and the ROM bank at 0000 - 3FFF
+    bool    ram_enabled;
+};
+
+}
@@ -0,0 +1,252 @@
+#include "mbc3.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+#include "state.hpp"
+
+namespace gb
+{
+
+constexpr size_t   rom_bank_size     = 0x4000;
+constexpr size_t   ram_bank_size     = 0x2000;
+constexpr uint16_t ram_start         = 0xA000;
+constexpr uint8_t  clock_select      = 0x08;
+constexpr uint32_t cycles_per_second = 4194304;
+
+// bits that exist in each clock register
+constexpr std::array<uint8_t, 5> clock_masks = {0x3F, 0x3F, 0x1F, 0xFF, 0xC1};
+
+static uint64_t get_le(std::span<const uint8_t> in, size_t pos, size_t len) noexcept
+{
+    uint64_t v = 0;
+    for (size_t i = 0; i < len; ++i) v |= static_cast<uint64_t>(in[pos + i]) << (8 * i);
+    return v;
+}
+
+static void put_le(std::span<uint8_t> out, size_t pos, size_t len, uint64_t v) noexcept
+{
+    for (size_t i = 0; i < len; ++i) out[pos + i] = static_cast<uint8_t>(v >> (8 * i));
+}
+
+static uint64_t unix_time() noexcept
+{
+    const auto now = std::chrono::system_clock::now().time_since_epoch();
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::seconds>(now).count());
+}
+
+mbc3::mbc3(const cartridge& cart, std::unique_ptr<save_file> save)
+    : cart{cart}
+    , save{std::move(save)}
+    , volatile_ram(this->save != nullptr ? 0 : cart.ram_size())
+    , ram{this->save != nullptr ? this->save->ram() : std::span<uint8_t>{volatile_ram}, true}
+    , has_clock{cart.describe_type().hardware & cartridge::additional_hardware::timer}
+    , rom_bank{1}
+    , ram_bank{0}
+    , ram_enabled{false}
+    , latch{0xFF}
+    , clock{}
+    , latched{}
+    , clock_cycles{0}
+{
+    if (has_clock) load_clock();
+}
+
+mbc3::mbc3(const cartridge& cart, std::span<uint8_t> ram)
+    : cart{cart}
+    , save{nullptr}
+    , volatile_ram{}
+    , ram{ram}
+    , has_clock{cart.describe_type().hardware & cartridge::additional_hardware::timer}
+    , rom_bank{1}
+    , ram_bank{0}
+    , ram_enabled{false}
+    , latch{0xFF}
+    , clock{}
+    , latched{}
+    , clock_cycles{0}
+{
+}
+
+uint8_t mbc3::read(uint16_t addr) noexcept
+{
+    if (addr < ram_start)
+    {
+        const size_t offset = addr < rom_bank_size ? addr : (rom_bank * rom_bank_size) + (addr - rom_bank_size);
+        return offset < cart.data.size() ? cart.data[offset] : 0xFF;
+    }
+
+    if (!ram_enabled) return 0xFF;
+
+    if (ram_bank >= clock_select)
+    {
+        const size_t reg = ram_bank - clock_select;
+        return has_clock && reg < latched.size() ? latched[reg] : 0xFF;
+    }
+
+    const size_t offset = (ram_bank * ram_bank_size) + (addr - ram_start);
+    return offset < ram.size() ? ram.read(offset) : 0xFF;
+}
+
+void mbc3::write(uint16_t addr, uint8_t val) noexcept
+{
+    switch (addr >> 13U)
+    {
+    case 0: ram_enabled = (val & 0x0F) == 0x0A; return;
+    case 1: rom_bank = (val & 0x7F) != 0 ? (val & 0x7F) : 1; return;
+    case 2: ram_bank = val; return;
+
+    case 3:
+        // writing 0 then 1 copies the clock into the latched registers, which are what reads see
+        if (latch == 0 && val == 1) latched = clock;
+        latch = val;
+        return;
+
+    default: break;
+    }
+
+    if (addr < ram_start || !ram_enabled) return;
+
+    if (ram_bank >= clock_select)
+    {
+        const size_t reg = ram_bank - clock_select;
+        if (!has_clock || reg >= clock.size()) return;
+
+        // writing the seconds also resets the divider counting up to the next one
+        if (reg == seconds) clock_cycles = 0;
+
+        // the latched registers keep what they had until the next latch
+        clock[reg] = val & clock_masks[reg];
+        store_clock();
+        return;
+    }
+
+    const size_t offset = (ram_bank * ram_bank_size) + (addr - ram_start);
+    if (offset >= ram.size()) return;
+
+    ram.write(offset, val);
+    if (save != nullptr) save->dirty(offset);
+}
+
+void mbc3::save_state(state_writer& out) const noexcept
+{
+    out.put(rom_bank);
+    out.put(ram_bank);
+    out.put(ram_enabled);
+    out.put(latch);
+    out.put_bytes(clock);
+    out.put_bytes(latched);
+    out.put(clock_cycles);
+    if (out.scope() == state_scope::full) ram.save_state(out);
+}
+
+void mbc3::load_state(state_reader& in) noexcept
+{
+    rom_bank    = std::max<uint8_t>(in.get<uint8_t>() & 0x7F, 1);
+    ram_bank    = in.get<uint8_t>();
+    ram_enabled = in.get<bool>();
+    latch       = in.get<uint8_t>();
+    in.get_bytes(clock);
+    in.get_bytes(latched);
+    clock_cycles = std::min(in.get<uint32_t>(), cycles_per_second - 1);
+    if (in.scope() == state_scope::full) ram.load_state(in);
+
+    if (save != nullptr)
+    {
+        save->dirty_all();
+        store_clock();
+    }
+}
+
+void mbc3::share_ram(memory_bank_controller& other) { ram.share_with(static_cast<mbc3&>(other).ram); }
+
+void mbc3::step(uint32_t cycles) noexcept
+{
+    if (!has_clock || (clock[days_high] & clock_halted) != 0) return;
+
+    clock_cycles += cycles;
+    while (clock_cycles >= cycles_per_second)
+    {
+        clock_cycles -= cycles_per_second;
+        tick();
+    }
+}
+
+void mbc3::tick() noexcept
+{
+    // each counter wraps at the width of its register, so a value written out of range counts up to that instead
+    auto count = [&](clock_register reg, uint8_t limit)
+    {
+        clock[reg] = (clock[reg] + 1) & clock_masks[reg];
+        if (clock[reg] != limit) return false;
+
+        clock[reg] = 0;
+        return true;
+    };
+
+    if (count(seconds, 60) && count(minutes, 60) && count(hours, 24))
+    {
+        uint32_t days = clock[days_low] | ((clock[days_high] & day_high_bit) << 8U);
+        if (++days == 512)
+        {
+            days               = 0;
+            clock[days_high]  |= day_carry;
+        }
+
+        clock[days_low]  = days & 0xFF;
+        clock[days_high] = (clock[days_high] & ~day_high_bit) | (days >> 8U);
+    }
+
+    store_clock();
+}
+
+void mbc3::store_clock() noexcept
+{
+    if (save == nullptr || save->rtc().size() < save_file::rtc_size) return;
+
+    auto footer = save->rtc();
+    for (size_t i = 0; i < clock.size(); ++i)
+    {
+        put_le(footer, i * 4, 4, clock[i]);
+        put_le(footer, (clock.size() + i) * 4, 4, latched[i]);
+    }
+    put_le(footer, 40, 8, unix_time());
+
+    save->dirty(ram.size());
+    save->dirty(ram.size() + save_file::rtc_size - 1);
+}
+
+void mbc3::load_clock() noexcept
+{
+    if (save == nullptr || save->rtc().size() < save_file::rtc_size) return;
+
+    const auto footer = save->rtc();
+    for (size_t i = 0; i < clock.size(); ++i)
+    {
+        clock[i]   = get_le(footer, i * 4, 4) & clock_masks[i];
+        latched[i] = get_le(footer, (clock.size() + i) * 4, 4) & clock_masks[i];
+    }
+
+    // the clock kept running while the emulator wasn't
+    const uint64_t saved = get_le(footer, 40, 8);
+    const uint64_t now   = unix_time();
+    if (saved == 0 || now <= saved || (clock[days_high] & clock_halted) != 0) return;
+
+    uint64_t days = clock[days_low] | ((clock[days_high] & day_high_bit) << 8U);
+    uint64_t time = clock[seconds] + (60 * (clock[minutes] + (60 * (clock[hours] + (24 * days))))) + (now - saved);
+
+    clock[seconds]  = time % 60;
+    time           /= 60;
+    clock[minutes]  = time % 60;
+    time           /= 60;
+    clock[hours]    = time % 24;
+    days            = time / 24;
+
+    if (days >= 512) clock[days_high] |= day_carry;
+    days %= 512;
+
+    clock[days_low]  = days & 0xFF;
+    clock[days_high] = (clock[days_high] & ~day_high_bit) | (days >> 8U);
+}
+
+}
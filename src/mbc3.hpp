@@ -0,0 +1,75 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+
+#include "cartridge.hpp"
+#include "memory_bank_controller.hpp"
+#include "paged_ram.hpp"
+#include "save_file.hpp"
+
+namespace gb
+{
+
+// mbc3 is the MBC3 memory bank controller: up to 2 MiB of ROM, 32 KiB of RAM, and on some cartridges a real time clock.
+class mbc3 : public memory_bank_controller
+{
+public:
+    // save holds the RAM and clock on cartridges with a battery; without one they are lost at power off
+    mbc3(const cartridge& cart, std::unique_ptr<save_file> save);
+
+    // ram (cart.ram_size() bytes) is kept by whoever made the controller, and like RAM without a battery is lost at
+    // power off
+    mbc3(const cartridge& cart, std::span<uint8_t> ram);
+
+    uint8_t read(uint16_t addr) noexcept override;
+    void    write(uint16_t addr, uint8_t val) noexcept override;
+    void    step(uint32_t cycles) noexcept override;
+
+    void save_state(state_writer& out) const noexcept override;
+    void load_state(state_reader& in) noexcept override;
+
+    void share_ram(memory_bank_controller& other) override;
+
+private:
+    // the clock registers, in the order they are selected by 0x08 - 0x0C
+    enum clock_register : uint8_t
+    {
+        seconds,
+        minutes,
+        hours,
+        days_low,
+        days_high, // bit 0 is day bit 8, bit 6 halts the clock, bit 7 is set when the day counter overflows
+    };
+
+    static constexpr uint8_t day_high_bit = 1U << 0U;
+    static constexpr uint8_t clock_halted = 1U << 6U;
+    static constexpr uint8_t day_carry    = 1U << 7U;
+
+    void tick() noexcept;
+
+    // the clock is saved in the 48 byte footer most emulators use: the clock and latched clock registers as 32-bit
+    // values, then the time it was saved as a 64-bit unix timestamp, all little-endian
+    void store_clock() noexcept;
+    void load_clock() noexcept;
+
+    const cartridge&           cart;
+    std::unique_ptr<save_file> save;
+    std::vector<uint8_t>       volatile_ram; // used instead of save without a battery
+    paged_ram                  ram;
+    bool                       has_clock;
+
+    uint8_t rom_bank;
+    uint8_t ram_bank; // 0x00 - 0x03 selects a RAM bank, 0x08 - 0x0C a clock register
+    bool    ram_enabled;
+    uint8_t latch;    // last value written to the latch register
+
+    std::array<uint8_t, 5> clock;
+    std::array<uint8_t, 5> latched;
+    uint32_t               clock_cycles; // progress towards the next second
+};
+
+}
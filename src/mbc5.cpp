@@ -0,0 +1,101 @@
+#include "mbc5.hpp"
+
+#include "state.hpp"
+
+namespace gb
+{
+
+constexpr size_t   rom_bank_size = 0x4000;
+constexpr size_t   ram_bank_size = 0x2000;
+constexpr uint16_t ram_start     = 0xA000;
+
+static uint8_t ram_bank_mask_for(const cartridge& cart) noexcept
+{
+    return cart.describe_type().hardware & cartridge::additional_hardware::rumble ? 0x07 : 0x0F;
+}
+
+mbc5::mbc5(const cartridge& cart, std::unique_ptr<save_file> save)
+    : cart{cart}
+    , save{std::move(save)}
+    , volatile_ram(this->save != nullptr ? 0 : cart.ram_size())
+    , ram{this->save != nullptr ? this->save->ram() : std::span<uint8_t>{volatile_ram}, true}
+    , ram_bank_mask{ram_bank_mask_for(cart)}
+    , rom_bank{1}
+    , ram_bank{0}
+    , ram_enabled{false}
+{
+}
+
+mbc5::mbc5(const cartridge& cart, std::span<uint8_t> ram)
+    : cart{cart}
+    , save{nullptr}
+    , volatile_ram{}
+    , ram{ram}
+    , ram_bank_mask{ram_bank_mask_for(cart)}
+    , rom_bank{1}
+    , ram_bank{0}
+    , ram_enabled{false}
+{
+}
+
+uint8_t mbc5::read(uint16_t addr) noexcept
+{
+    if (addr < ram_start)
+    {
+        const size_t offset = addr < rom_bank_size ? addr : (rom_bank * rom_bank_size) + (addr - rom_bank_size);
+
+        // bank numbers beyond the ROM wrap around, as only as many bank lines as it needs are wired up
+        return cart.data[offset % cart.data.size()];
+    }
+
+    if (!ram_enabled) return 0xFF;
+
+    const size_t offset = (ram_bank * ram_bank_size) + (addr - ram_start);
+    return offset < ram.size() ? ram.read(offset) : 0xFF;
+}
+
+void mbc5::write(uint16_t addr, uint8_t val) noexcept
+{
+    switch (addr >> 12U)
+    {
+    case 0x0:
+    case 0x1: ram_enabled = (val & 0x0F) == 0x0A; return;
+    case 0x2: rom_bank = static_cast<uint16_t>((rom_bank & 0x100) | val); return;
+    case 0x3: rom_bank = static_cast<uint16_t>((rom_bank & 0xFF) | ((val & 0x01) << 8U)); return;
+    case 0x4:
+    case 0x5: ram_bank = val & ram_bank_mask; return;
+    case 0x6:
+    case 0x7: return;
+    default: break;
+    }
+
+    if (addr < ram_start || !ram_enabled) return;
+
+    const size_t offset = (ram_bank * ram_bank_size) + (addr - ram_start);
+    if (offset >= ram.size()) return;
+
+    ram.write(offset, val);
+    if (save != nullptr) save->dirty(offset);
+}
+
+void mbc5::save_state(state_writer& out) const noexcept
+{
+    out.put(rom_bank);
+    out.put(ram_bank);
+    out.put(ram_enabled);
+    if (out.scope() == state_scope::full) ram.save_state(out);
+}
+
+void mbc5::load_state(state_reader& in) noexcept
+{
+    rom_bank    = in.get<uint16_t>() & 0x1FF;
+    ram_bank    = in.get<uint8_t>() & ram_bank_mask;
+    ram_enabled = in.get<bool>();
+    if (in.scope() == state_scope::full) ram.load_state(in);
+
+    if (save != nullptr) save->dirty_all();
+}
+
+void mbc5::share_ram(memory_bank_controller& other) { ram.share_with(static_cast<mbc5&>(other).ram); }
+
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+
+#include "cartridge.hpp"
+#include "memory_bank_controller.hpp"
+#include "paged_ram.hpp"
+#include "save_file.hpp"
+
+namespace gb
+{
+
+// mbc5 is the MBC5 memory bank controller: up to 8 MiB of ROM in 9-bit banks, and up to 128 KiB of RAM, of which
+// paged_ram keeps the first 64 KiB. On cartridges with a rumble motor, bit 3 of the RAM bank drives it instead.
+class mbc5 : public memory_bank_controller
+{
+public:
+    // save holds the RAM on cartridges with a battery; without one it is lost at power off
+    mbc5(const cartridge& cart, std::unique_ptr<save_file> save);
+
+    // ram (cart.ram_size() bytes) is kept by whoever made the controller, and like RAM without a battery is lost at
+    // power off
+    mbc5(const cartridge& cart, std::span<uint8_t> ram);
+
+    uint8_t read(uint16_t addr) noexcept override;
+    void    write(uint16_t addr, uint8_t val) noexcept override;
+
+    void save_state(state_writer& out) const noexcept override;
+    void load_state(state_reader& in) noexcept override;
+
+    void share_ram(memory_bank_controller& other) override;
+
+private:
+    const cartridge&           cart;
+    std::unique_ptr<save_file> save;
+    std::vector<uint8_t>       volatile_ram; // used instead of save without a battery
+    paged_ram                  ram;
+    uint8_t                    ram_bank_mask; // 0x07 with a rumble motor on bit 3, 0x0F otherwise
+
+    uint16_t rom_bank; // unlike the other controllers, bank 0 can be mapped at 4000 - 7FFF too
+    uint8_t  ram_bank;
+    bool     ram_enabled;
+};
+
+}
@@ -1,63 +1,218 @@
 #include "memory.hpp"
 
+#include <algorithm>
 #include <cstdio>
+#include <cstring>
 #include <ios>
+#include <utility>
+
+#include "debugger.hpp"
+#include "state.hpp"
 
 namespace gb
 {
 
-memory::memory(std::unique_ptr<memory_bank_controller> controller, cartridge& cart)
-    : controller{std::move(controller)}
+constexpr uint32_t oam_dma_setup_cycles = 4; // one M-cycle before the first byte
+constexpr uint32_t oam_dma_byte_cycles  = 4;
+constexpr uint16_t vram_dma_block_size  = 0x10;
+
+// VRAM DMA stalls the CPU for 8 M-cycles per block, at either speed
+constexpr uint32_t vram_dma_block_cycles = 32;
+
+static bool on_vram_bus(uint16_t addr) noexcept { return addr >= 0x8000 && addr < 0xA000; }
+
+// writes a byte of palette RAM through a BCPS/OCPS style index register, bit 7 of which enables auto-increment
+static void write_palette(std::array<uint8_t, 0x40>& ram, uint8_t& index, uint8_t val) noexcept
+{
+    ram[index & 0x3F] = val;
+    if ((index & 0x80) != 0) index = 0x80 | ((index + 1) & 0x3F);
+}
+
+memory::memory(std::unique_ptr<memory_bank_controller> controller, const cartridge& cart)
+    : memory{*controller, cart}
+{
+    owned_controller = std::move(controller);
+}
+
+memory::memory(memory_bank_controller& controller, const cartridge& cart)
+    : owned_controller{nullptr}
+    , controller{&controller}
     , cart{cart}
-    , vram{}
-    , wram_bank_0{}
-    , wram_bank_n{}
+    , vram{{vram_storage.data(), vram_storage.size()}}
+    , wram{{wram_storage.data(), wram_storage.size()}}
+    , oam{}
     , io_registers{}
     , stack{}
-    , interrupt_enable_register{}
-{}
+    , irq{}
+    , bg_palettes{}
+    , obj_palettes{}
+    , read_pages{}
+    , write_pages{}
+    , watcher{nullptr}
+    , watched{}
+    , hram_pairs{0}
+    , color{false}
+    , exact{false}
+    , counting{false}
+    , oam_dma_source{0}
+    , oam_dma_elapsed{0}
+    , oam_dma_active{false}
+    , vram_dma_source{0}
+    , vram_dma_dest{0}
+    , vram_dma_blocks{0}
+    , hdma_active{false}
+    , stall{0}
+    , video{*this}
+    , pad{*this}
+    , sio{*this}
+    , stats{}
+{
+    // the CGB boot ROM leaves every background color white
+    for (size_t i = 0; i < bg_palettes.size(); i += 2)
+    {
+        bg_palettes[i]     = 0xFF;
+        bg_palettes[i + 1] = 0x7F;
+    }
+
+    remap();
+}
+
+uint8_t memory::read_slow(uint16_t addr) noexcept
+{
+    if (dma_conflict(addr))
+    {
+        // OAM reads back nothing, any other address on the DMA's bus reads whatever the DMA is reading
+        if (addr >= mirror_n_end) return 0xFF;
 
-uint8_t memory::read(uint16_t addr) noexcept
+        const auto index = std::min<uint32_t>((oam_dma_elapsed - oam_dma_setup_cycles) / oam_dma_byte_cycles,
+                                              oam.size() - 1);
+        return read_bus(oam_dma_source + index);
+    }
+
+    return read_bus(addr);
+}
+
+uint8_t memory::read_bus(uint16_t addr) noexcept
 {
     if (addr < rom_bank_0_end)
     {
         // 0x50 == disable_boot_rom register
         if (addr < boot_rom_end && io_registers[0x50] == 0) return bootstrap_rom[addr];
 
-        return cart.data[addr];
+        return addr < cart.data.size() ? cart.data[addr] : 0xFF;
     }
 
     if (addr < rom_bank_n_end) return controller->read(addr);
-    if (addr < vram_end) return vram[addr - rom_bank_n_end];
+    if (addr < vram_end) return vram.read(vram_bank() + (addr - rom_bank_n_end));
     if (addr < ext_ram_end) return controller->read(addr);
-    if (addr < wram_0_end) return wram_bank_0[addr - ext_ram_end];
-    if (addr < wram_n_end) return wram_bank_n[addr - wram_0_end];
-    if (addr < mirror_0_end) return wram_bank_0[addr - wram_n_end];
-    if (addr < mirror_n_end) return wram_bank_n[addr - mirror_0_end];
-    if (addr < oam_end) return 0;         // TODO: if NOT color, return 0, otherwise... TODO
+    if (addr < wram_0_end) return wram.read(addr - ext_ram_end);
+    if (addr < wram_n_end) return wram.read(wram_bank_n() + (addr - wram_0_end));
+    if (addr < mirror_0_end) return wram.read(addr - wram_n_end);
+    if (addr < mirror_n_end) return wram.read(wram_bank_n() + (addr - mirror_0_end));
+    if (addr < oam_end) return oam[addr - mirror_n_end];
     if (addr < oam_invalid_end) return 0; // TODO
-    if (addr < io_registers_end) return io_registers[addr - oam_invalid_end];
+    if (addr < io_registers_end) return read_io(addr);
     if (addr < stack_end) return stack[addr - io_registers_end];
 
-    return interrupt_enable_register;
+    return irq.read_enable();
+}
+
+uint8_t memory::read_io(uint16_t addr) noexcept
+{
+    const uint8_t val = io_registers[addr - oam_invalid_end];
+
+    switch (addr)
+    {
+    case joypad_input: return pad.read();
+    case serial_transfer_data: return sio.read_data();
+    case serial_transfer_ctrl: return sio.read_control();
+    case interrupt_flag: return irq.read_flags();
+
+    // color registers read as open bus on a DMG, or in DMG mode
+    case key1: return color ? 0x7E | val : 0xFF;
+    case vram_bank_key: return color ? 0xFE | val : 0xFF;
+    case wram_bank_select: return color ? 0xF8 | val : 0xFF;
+    case bg_palette_index:
+    case obj_palette_index: return color ? 0x40 | val : 0xFF;
+    case bg_palette_data: return color ? bg_palettes[io_registers[bg_palette_index - oam_invalid_end] & 0x3F] : 0xFF;
+    case obj_palette_data: return color ? obj_palettes[io_registers[obj_palette_index - oam_invalid_end] & 0x3F] : 0xFF;
+
+    // the source and destination can't be read back
+    case vram_dma_start:
+    case vram_dma_start + 1:
+    case vram_dma_start + 2:
+    case vram_dma_start + 3: return 0xFF;
+    case vram_dma_end: return color ? val : 0xFF;
+
+    default: return val;
+    }
+}
+
+uint16_t memory::peek16_slow(uint16_t addr) noexcept
+{
+    const uint8_t low = peek(addr);
+    return static_cast<uint16_t>((peek(addr + 1) << 8) | low);
+}
+
+void memory::poke16_slow(uint16_t addr, uint16_t val) noexcept
+{
+    poke(addr, static_cast<uint8_t>(val));
+    poke(addr + 1, static_cast<uint8_t>(val >> 8));
+}
+
+uint16_t memory::read16_slow(uint16_t addr) noexcept
+{
+    auto byte = [this](uint16_t at)
+    {
+        const uint8_t* page = read_pages[at >> page_bits];
+        return page != nullptr ? page[at & page_mask] : read_watched(at);
+    };
+
+    const uint8_t low = byte(addr);
+    return static_cast<uint16_t>((byte(addr + 1) << 8) | low);
 }
 
-uint16_t memory::read16(uint16_t addr) noexcept
+void memory::write16_slow(uint16_t addr, uint16_t val) noexcept
 {
-    return (static_cast<uint16_t>(read(addr + 1)) << 8) | static_cast<uint16_t>(read(addr));
+    auto byte = [this](uint16_t at, uint8_t b)
+    {
+        if (uint8_t* page = write_pages[at >> page_bits]; page != nullptr) page[at & page_mask] = b;
+        else write_watched(at, b);
+    };
+
+    byte(addr, static_cast<uint8_t>(val));
+    byte(addr + 1, static_cast<uint8_t>(val >> 8));
+}
+
+uint8_t memory::read_watched(uint16_t addr) noexcept
+{
+    const uint8_t val = read_slow(addr);
+    if ((watched[addr >> page_bits] & watch_reads) != 0) watcher->on_read(addr, val);
+    return val;
 }
 
-void memory::write(uint16_t addr, uint8_t val) noexcept
+void memory::write_watched(uint16_t addr, uint8_t val) noexcept
 {
+    write_slow(addr, val);
+    if ((watched[addr >> page_bits] & watch_writes) != 0) watcher->on_write(addr, val);
+}
+
+void memory::write_slow(uint16_t addr, uint8_t val) noexcept
+{
+    // writes lose out to the DMA
+    if (dma_conflict(addr)) return;
+
     if (addr < rom_bank_n_end)
     {
+        // every controller selects banks through 2000 - 5FFF
+        if (addr >= 0x2000 && addr < 0x6000) stats.bank_switches.add();
         controller->write(addr, val);
         return;
     }
 
     if (addr < vram_end)
     {
-        vram[addr - rom_bank_n_end] = val;
+        *writable(vram, vram_bank() + (addr - rom_bank_n_end)) = val;
         return;
     }
 
@@ -69,31 +224,31 @@ void memory::write(uint16_t addr, uint8_t val) noexcept
 
     if (addr < wram_0_end)
     {
-        wram_bank_0[addr - ext_ram_end] = val;
+        *writable(wram, addr - ext_ram_end) = val;
         return;
     }
 
     if (addr < wram_n_end)
     {
-        wram_bank_n[addr - wram_0_end] = val;
+        *writable(wram, wram_bank_n() + (addr - wram_0_end)) = val;
         return;
     }
 
     if (addr < mirror_0_end)
     {
-        wram_bank_0[addr - wram_n_end] = val;
+        *writable(wram, addr - wram_n_end) = val;
         return;
     }
 
     if (addr < mirror_n_end)
     {
-        wram_bank_n[addr - mirror_0_end] = val;
+        *writable(wram, wram_bank_n() + (addr - mirror_0_end)) = val;
         return;
     }
 
     if (addr < oam_end)
     {
-        // TODO: if not color, ignore write.
+        oam[addr - mirror_n_end] = val;
         return;
     }
 
@@ -105,7 +260,7 @@ void memory::write(uint16_t addr, uint8_t val) noexcept
 
     if (addr < io_registers_end)
     {
-        io_registers[addr - oam_invalid_end] = val;
+        write_io(addr, val);
         return;
     }
 
@@ -115,13 +270,397 @@ void memory::write(uint16_t addr, uint8_t val) noexcept
         return;
     }
 
-    interrupt_enable_register = val;
+    irq.write_enable(val);
+}
+
+void memory::write_io(uint16_t addr, uint8_t val) noexcept
+{
+    auto& reg = io_registers[addr - oam_invalid_end];
+
+    switch (addr)
+    {
+    case joypad_input: pad.write(val); break;
+    case serial_transfer_data: sio.write_data(val); break;
+    case serial_transfer_ctrl: sio.write_control(val); break;
+    case interrupt_flag: irq.write_flags(val); break;
+
+    case ly: break; // read-only
+
+    case stat:
+        // mode and LY=LYC bits are read-only
+        reg = (val & 0x78) | (reg & 0x07);
+        break;
+
+    case dma:
+        reg = val;
+        start_oam_dma(val);
+        break;
+
+    case vram_dma_end:
+        if (color) start_vram_dma(val);
+        break;
+
+    case disable_boot_rom:
+        // once unmapped, the boot ROM stays unmapped
+        if (reg == 0)
+        {
+            reg = val;
+            remap();
+        }
+        break;
+
+    case key1:
+        // only the "prepare speed switch" bit is writable, STOP performs the switch
+        if (color) reg = (reg & 0x80) | (val & 0x01);
+        break;
+
+    case vram_bank_key:
+        if (color)
+        {
+            reg = val & 0x01;
+            remap();
+        }
+        break;
+
+    case wram_bank_select:
+        if (color)
+        {
+            reg = val & 0x07;
+            remap();
+        }
+        break;
+
+    case bg_palette_index:
+    case obj_palette_index:
+        if (color) reg = val & 0xBF;
+        break;
+
+    case bg_palette_data:
+        if (color) write_palette(bg_palettes, io_registers[bg_palette_index - oam_invalid_end], val);
+        break;
+
+    case obj_palette_data:
+        if (color) write_palette(obj_palettes, io_registers[obj_palette_index - oam_invalid_end], val);
+        break;
+
+    default: reg = val; break;
+    }
 }
 
-void memory::write16(uint16_t addr, uint16_t val) noexcept
+void memory::install_io(const io_image& io, uint8_t ie) noexcept
+{
+    io_registers = io;
+
+    pad.write(io[joypad_input - oam_invalid_end]);
+    sio.write_data(io[serial_transfer_data - oam_invalid_end]);
+    sio.write_control(io[serial_transfer_ctrl - oam_invalid_end]);
+    irq.write_flags(io[interrupt_flag - oam_invalid_end]);
+    irq.write_enable(ie);
+    remap();
+}
+
+void memory::save_state(state_writer& out) const noexcept
+{
+    if (out.scope() == state_scope::full)
+    {
+        vram.save_state(out);
+        wram.save_state(out);
+    }
+    out.put_bytes(oam);
+    out.put_bytes(io_registers);
+    out.put_bytes(stack);
+    out.put(irq.read_flags());
+    out.put(irq.read_enable());
+    out.put_bytes(bg_palettes);
+    out.put_bytes(obj_palettes);
+
+    out.put(oam_dma_source);
+    out.put(oam_dma_elapsed);
+    out.put(oam_dma_active);
+    out.put(vram_dma_source);
+    out.put(vram_dma_dest);
+    out.put(vram_dma_blocks);
+    out.put(hdma_active);
+    out.put(stall);
+
+    video.save_state(out);
+    pad.save_state(out);
+    sio.save_state(out);
+    controller->save_state(out);
+}
+
+void memory::load_state(state_reader& in) noexcept
+{
+    if (in.scope() == state_scope::full)
+    {
+        vram.load_state(in);
+        wram.load_state(in);
+    }
+    in.get_bytes(oam);
+    in.get_bytes(io_registers);
+    in.get_bytes(stack);
+    irq.write_flags(in.get<uint8_t>());
+    irq.write_enable(in.get<uint8_t>());
+    in.get_bytes(bg_palettes);
+    in.get_bytes(obj_palettes);
+
+    oam_dma_source  = in.get<uint16_t>();
+    oam_dma_elapsed = in.get<uint32_t>();
+    oam_dma_active  = in.get<bool>();
+    vram_dma_source = in.get<uint16_t>();
+    vram_dma_dest   = in.get<uint16_t>() % vram_bank_size;
+    vram_dma_blocks = in.get<uint8_t>();
+    hdma_active     = in.get<bool>();
+    stall           = in.get<uint32_t>();
+
+    video.load_state(in);
+    pad.load_state(in);
+    sio.load_state(in);
+    controller->load_state(in);
+
+    // the banks selected, and whether the boot ROM is mapped, come with the registers
+    remap();
+}
+
+void memory::set_color_mode(bool enabled) noexcept
+{
+    color = enabled;
+    remap();
+}
+
+void memory::switch_speed() noexcept
+{
+    // toggles the current speed, and disarms the switch
+    auto& reg = io_registers[key1 - oam_invalid_end];
+    reg       = (reg & 0x80) ^ 0x80;
+}
+
+void memory::set_accurate(bool enabled) noexcept { exact = enabled; }
+
+void memory::step(uint32_t cycles) noexcept
 {
-    write(addr, (val & 0x00ff) >> 0);
-    write(addr, (val & 0xff00) >> 8);
+    sio.step(cycles);
+    controller->step(double_speed() ? cycles / 2 : cycles);
+    if (oam_dma_active) step_oam_dma(cycles);
+}
+
+void memory::step_oam_dma(uint32_t cycles) noexcept
+{
+    // number of bytes fully transferred after elapsed cycles
+    auto copied = [&](uint32_t elapsed) -> uint32_t
+    {
+        if (elapsed < oam_dma_setup_cycles) return 0;
+        return std::min<uint32_t>((elapsed - oam_dma_setup_cycles) / oam_dma_byte_cycles, oam.size());
+    };
+
+    const uint32_t from = copied(oam_dma_elapsed);
+    oam_dma_elapsed    += cycles;
+    const uint32_t to   = copied(oam_dma_elapsed);
+
+    for (uint32_t i = from; i < to; ++i) oam[i] = read_bus(oam_dma_source + i);
+
+    if (to == oam.size())
+    {
+        oam_dma_active = false;
+        remap();
+    }
+}
+
+uint32_t memory::take_stall() noexcept { return std::exchange(stall, 0); }
+
+void memory::start_oam_dma(uint8_t page) noexcept
+{
+    // sources past DFFF are the WRAM mirror
+    oam_dma_source = static_cast<uint16_t>(page < 0xE0 ? page : page - 0x20) << 8;
+
+    if (exact)
+    {
+        // the transfer runs in step(), with every page going through the slow path to see the bus conflicts
+        oam_dma_elapsed = 0;
+        oam_dma_active  = true;
+        remap();
+        return;
+    }
+
+    if (const uint8_t* src = read_pages[oam_dma_source >> page_bits]; src != nullptr)
+    {
+        std::memcpy(oam.data(), src + (oam_dma_source & page_mask), oam.size());
+        return;
+    }
+
+    for (uint16_t i = 0; i < oam.size(); ++i) oam[i] = read_bus(oam_dma_source + i);
+}
+
+void memory::start_vram_dma(uint8_t control) noexcept
+{
+    auto& reg = io_registers[vram_dma_end - oam_invalid_end];
+
+    // writing bit 7 clear during an HDMA cancels it, leaving the remaining length readable
+    if (hdma_active && (control & 0x80) == 0)
+    {
+        hdma_active = false;
+        reg         = 0x80 | ((vram_dma_blocks - 1) & 0x7F);
+        return;
+    }
+
+    const uint8_t* hdma = &io_registers[vram_dma_start - oam_invalid_end];
+
+    vram_dma_source = static_cast<uint16_t>((hdma[0] << 8) | (hdma[1] & 0xF0));
+    vram_dma_dest   = static_cast<uint16_t>(((hdma[2] & 0x1F) << 8) | (hdma[3] & 0xF0));
+    vram_dma_blocks = (control & 0x7F) + 1;
+
+    if ((control & 0x80) != 0)
+    {
+        hdma_active = true;
+        reg         = control & 0x7F;
+        return;
+    }
+
+    // general purpose DMA: all at once, with the CPU stalled until done
+    stall += vram_dma_blocks * vram_dma_block_cycles * (double_speed() ? 2 : 1);
+    while (vram_dma_blocks > 0)
+    {
+        copy_vram_block();
+        --vram_dma_blocks;
+    }
+    reg = 0xFF;
+}
+
+void memory::copy_vram_block() noexcept
+{
+    // blocks are 16 byte aligned, so never cross a page
+    uint8_t* dest = writable(vram, vram_bank() + vram_dma_dest);
+
+    if (const uint8_t* src = read_pages[vram_dma_source >> page_bits]; src != nullptr)
+    {
+        std::memcpy(dest, src + (vram_dma_source & page_mask), vram_dma_block_size);
+    }
+    else
+    {
+        for (uint16_t i = 0; i < vram_dma_block_size; ++i) dest[i] = read_bus(vram_dma_source + i);
+    }
+
+    vram_dma_source += vram_dma_block_size;
+    vram_dma_dest    = (vram_dma_dest + vram_dma_block_size) & (vram_bank_size - 1);
+}
+
+void memory::hblank() noexcept
+{
+    if (!hdma_active) return;
+
+    copy_vram_block();
+    stall += vram_dma_block_cycles * (double_speed() ? 2 : 1);
+
+    auto& reg = io_registers[vram_dma_end - oam_invalid_end];
+    if (--vram_dma_blocks == 0)
+    {
+        hdma_active = false;
+        reg         = 0xFF;
+    }
+    else
+    {
+        reg = vram_dma_blocks - 1;
+    }
+}
+
+bool memory::dma_conflict(uint16_t addr) const noexcept
+{
+    if (!oam_dma_active || oam_dma_elapsed < oam_dma_setup_cycles) return false;
+
+    // I/O and HRAM sit on their own bus, which is what makes HRAM the place to wait for a DMA from
+    if (addr >= oam_invalid_end) return false;
+    if (addr >= mirror_n_end) return true;
+
+    // everything else shares either the VRAM bus or the external (cartridge and WRAM) bus
+    return on_vram_bus(addr) == on_vram_bus(oam_dma_source);
+}
+
+size_t memory::vram_bank() const noexcept
+{
+    const uint8_t bank = color ? io_registers[vram_bank_key - oam_invalid_end] & 0x01 : 0;
+    return size_t{bank} * vram_bank_size;
+}
+
+size_t memory::wram_bank_n() const noexcept
+{
+    // selecting bank 0 selects bank 1
+    const uint8_t bank = color ? io_registers[wram_bank_select - oam_invalid_end] & 0x07 : 1;
+    return size_t{std::max<uint8_t>(bank, 1)} * wram_bank_size;
+}
+
+uint8_t* memory::writable(paged_ram& ram, size_t offset) noexcept
+{
+    const size_t page = offset >> page_bits;
+    if (ram.own_page(page) == nullptr)
+    {
+        ram.make_own(page);
+        remap(); // the page moved
+    }
+    return ram.own_page(page) + (offset & page_mask);
+}
+
+void memory::share_ram(memory& other)
+{
+    // the pages move on both sides, even if running out of memory stops it part of the way through
+    try
+    {
+        vram.share_with(other.vram);
+        wram.share_with(other.wram);
+        controller->share_ram(*other.controller);
+    }
+    catch (...)
+    {
+        remap();
+        other.remap();
+        throw;
+    }
+    remap();
+    other.remap();
+}
+
+void memory::remap() noexcept
+{
+    read_pages.fill(nullptr);
+    write_pages.fill(nullptr);
+
+    // HRAM shares the last page with I/O, which is never mapped, so it is only left out of the pair shortcut
+    hram_pairs = watched[num_pages - 1] != 0 ? 0 : stack_end - 1 - io_registers_end;
+
+    // an OAM DMA in accurate mode needs every access to check for bus conflicts
+    if (oam_dma_active) return;
+
+    // ROM bank 0 is read-only (writes go to the controller), and its first page is hidden by the boot ROM until that is
+    // disabled. Everything else from the cartridge goes through the controller.
+    for (size_t page = 0; page < (rom_bank_0_end >> page_bits); ++page)
+    {
+        if (((page + 1) << page_bits) > cart.data.size()) break;
+        read_pages[page] = cart.data.data() + (page << page_bits);
+    }
+    if (io_registers[disable_boot_rom - oam_invalid_end] == 0) read_pages[0] = nullptr;
+
+    // pages a fork shares are only mapped for reading, writes to them make a copy first
+    auto map_ram = [&](uint16_t start, paged_ram& ram, size_t base, uint16_t size)
+    {
+        for (uint32_t offset = 0; offset < size; offset += 1U << page_bits)
+        {
+            const size_t page = (start + offset) >> page_bits;
+            read_pages[page]  = ram.page((base + offset) >> page_bits);
+            write_pages[page] = ram.own_page((base + offset) >> page_bits);
+        }
+    };
+
+    map_ram(rom_bank_n_end, vram, vram_bank(), vram_bank_size);
+    map_ram(ext_ram_end, wram, 0, wram_bank_size);
+    map_ram(wram_0_end, wram, wram_bank_n(), wram_bank_size);
+    map_ram(wram_n_end, wram, 0, wram_bank_size); // mirror of bank 0
+
+    // F000 - FFFF mixes the bank n mirror with OAM and I/O, so it always takes the slow path
+
+    for (size_t page = 0; page < num_pages; ++page)
+    {
+        if ((watched[page] & watch_reads) != 0) read_pages[page] = nullptr;
+        if ((watched[page] & watch_writes) != 0) write_pages[page] = nullptr;
+    }
 }
 
 }
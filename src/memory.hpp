@@ -7,11 +7,23 @@
 #include <system_error>
 
 #include "cartridge.hpp"
+#include "interrupts.hpp"
+#include "joypad.hpp"
 #include "memory_bank_controller.hpp"
+#include "metrics.hpp"
+#include "models.hpp"
+#include "paged_ram.hpp"
+#include "ppu.hpp"
+#include "serial.hpp"
+#include "util.hpp"
 
 namespace gb
 {
 
+struct debugger;
+class state_reader;
+class state_writer;
+
 struct memory
 {
 public:
@@ -67,14 +79,162 @@ public:
 
     static constexpr uint16_t interrupt_enable = 0xFFFF; // aka IE
 
-    memory(std::unique_ptr<memory_bank_controller> controller, cartridge& cart);
+    memory(std::unique_ptr<memory_bank_controller> controller, const cartridge& cart);
+
+    // memory banking through controller, which must outlive it, as an instance's does (see instance.hpp)
+    memory(memory_bank_controller& controller, const cartridge& cart);
+
+    // Plain RAM and ROM is reached through a table of 4 KiB pages, anything with side effects (or not mapped in the
+    // table) takes the slow path. So do pages a debugger is watching, see debugger.hpp.
+    uint8_t read(uint16_t addr) noexcept
+    {
+        if (counting) count(stats.reads, addr);
+        if (const uint8_t* page = read_pages[addr >> page_bits]; page != nullptr) return page[addr & page_mask];
+        return read_watched(addr);
+    }
+
+    void write(uint16_t addr, uint8_t val) noexcept
+    {
+        if (counting) count(stats.writes, addr);
+        if (uint8_t* page = write_pages[addr >> page_bits]; page != nullptr)
+        {
+            page[addr & page_mask] = val;
+            return;
+        }
+        write_watched(addr, val);
+    }
+
+    // read16 and write16 access a little-endian pair of bytes, as 16-bit operands and the stack are laid out
+    uint16_t read16(uint16_t addr) noexcept
+    {
+        if (counting)
+        {
+            count(stats.reads, addr);
+            count(stats.reads, addr + 1);
+        }
+        if (const uint8_t* pair = find_pair(read_pages, addr); pair != nullptr) return util::load_le16(pair);
+        return read16_slow(addr);
+    }
+
+    void write16(uint16_t addr, uint16_t val) noexcept
+    {
+        if (counting)
+        {
+            count(stats.writes, addr);
+            count(stats.writes, addr + 1);
+        }
+        if (uint8_t* pair = find_pair(write_pages, addr); pair != nullptr)
+        {
+            util::store_le16(pair, val);
+            return;
+        }
+        write16_slow(addr, val);
+    }
+
+    // peek and poke are read and write on behalf of the emulator itself (timers, idle loop detection, ...) rather than
+    // the emulated program, so they don't show up in the access counts
+    uint8_t peek(uint16_t addr) noexcept
+    {
+        if (const uint8_t* page = read_pages[addr >> page_bits]; page != nullptr) return page[addr & page_mask];
+        return read_slow(addr);
+    }
+
+    void poke(uint16_t addr, uint8_t val) noexcept
+    {
+        if (uint8_t* page = write_pages[addr >> page_bits]; page != nullptr)
+        {
+            page[addr & page_mask] = val;
+            return;
+        }
+        write_slow(addr, val);
+    }
+
+    // A pair within one page of plain memory, or within HRAM (where the stack often is), is a single 16-bit load or
+    // store, instead of two trips through the page table.
+    uint16_t peek16(uint16_t addr) noexcept
+    {
+        if (const uint8_t* pair = find_pair(read_pages, addr); pair != nullptr) return util::load_le16(pair);
+        return peek16_slow(addr);
+    }
+
+    void poke16(uint16_t addr, uint16_t val) noexcept
+    {
+        if (uint8_t* pair = find_pair(write_pages, addr); pair != nullptr)
+        {
+            util::store_le16(pair, val);
+            return;
+        }
+        poke16_slow(addr, val);
+    }
+
+    // install_io replaces all I/O registers and IE at once, bypassing the side effects of writing them one by one
+    void install_io(const io_image& io, uint8_t ie) noexcept;
+
+    [[nodiscard]] const cartridge& game() const noexcept { return cart; }
+
+    // color_mode enables the CGB-only registers and banks. Off, the memory map is a DMG's, even on color hardware.
+    void               set_color_mode(bool enabled) noexcept;
+    [[nodiscard]] bool color_mode() const noexcept { return color; }
+
+    // double speed mode (CGB only) runs the CPU and timers at twice the clock of everything else
+    [[nodiscard]] bool double_speed() const noexcept
+    {
+        return color && (io_registers[key1 - oam_invalid_end] & 0x80) != 0;
+    }
+    [[nodiscard]] bool speed_switch_armed() const noexcept
+    {
+        return color && (io_registers[key1 - oam_invalid_end] & 0x01) != 0;
+    }
+
+    // switch_speed performs an armed speed switch, as done by STOP
+    void switch_speed() noexcept;
+
+    // Accurate mode trades speed for exact timing: OAM DMA copies a byte per cycle, and the CPU sees the bus conflicts
+    // that causes, instead of the whole transfer landing at once.
+    void               set_accurate(bool enabled) noexcept;
+    [[nodiscard]] bool accurate() const noexcept { return exact; }
+
+    // step advances transfers that take time by cycles CPU cycles
+    void step(uint32_t cycles) noexcept;
+
+    // take_stall returns, and clears, the CPU cycles lost to VRAM DMA since the last call
+    [[nodiscard]] uint32_t take_stall() noexcept;
+
+    [[nodiscard]] ppu&       display() noexcept { return video; }
+    [[nodiscard]] const ppu& display() const noexcept { return video; }
+
+    [[nodiscard]] joypad&       input() noexcept { return pad; }
+    [[nodiscard]] const joypad& input() const noexcept { return pad; }
+
+    [[nodiscard]] serial&       serial_port() noexcept { return sio; }
+    [[nodiscard]] const serial& serial_port() const noexcept { return sio; }
+
+    [[nodiscard]] interrupt_controller&       interrupts() noexcept { return irq; }
+    [[nodiscard]] const interrupt_controller& interrupts() const noexcept { return irq; }
+
+    // counters are this instance's metrics, safe to read from any thread
+    [[nodiscard]] metrics&       counters() noexcept { return stats; }
+    [[nodiscard]] const metrics& counters() const noexcept { return stats; }
+
+    // Counting accesses by region costs a little on every access, so unlike the other metrics it is off until enabled.
+    void               set_access_counting(bool enabled) noexcept { counting = enabled; }
+    [[nodiscard]] bool access_counting() const noexcept { return counting; }
+
+    // save_state and load_state cover memory and everything mapped into it, see state.hpp
+    void save_state(state_writer& out) const noexcept;
+    void load_state(state_reader& in) noexcept;
 
-    uint8_t  read(uint16_t addr) noexcept;
-    uint16_t read16(uint16_t addr) noexcept;
-    void     write(uint16_t addr, uint8_t val) noexcept;
-    void     write16(uint16_t addr, uint16_t val) noexcept;
+    // share_ram makes other's VRAM, WRAM and cartridge RAM the same as this memory's, sharing them a page at a time
+    // until either writes to a page (see paged_ram), for a fork
+    void share_ram(memory& other);
 
 private:
+    friend struct debugger;
+    friend struct lanes;
+    friend struct ppu;
+    friend struct joypad;
+    friend struct serial;
+
     // 0000 - 3FFF: 16 KiB ROM bank 00: from cartridge, usually a fixed bank
     // 4000 - 7FFF: 16 KiB ROM bank 01-NN: from cartridge, switch bank via mapper (if any)
     // 8000 - 9FFF: 8 KiB Video RAM (VRAM): in CGB mode, switchable bank 0/1
@@ -106,16 +266,122 @@ private:
     static constexpr uint16_t io_registers_end = 0xFF80;
     static constexpr uint16_t stack_end        = 0xFFFF;
 
-    std::unique_ptr<memory_bank_controller> controller;
-    cartridge&                              cart;
-    std::array<uint8_t, 0x2000>             vram; // TODO: switchable in color
-    std::array<uint8_t, 0x1000>             wram_bank_0;
-    std::array<uint8_t, 0x1000>             wram_bank_n; // TODO: switchable in color
-    // TODO Sprite Attribute Table                       //
+    static constexpr uint16_t vram_bank_size = 0x2000;
+    static constexpr uint16_t wram_bank_size = 0x1000;
+
+    static constexpr uint32_t page_bits = 12;
+    static constexpr uint16_t page_mask = (1U << page_bits) - 1;
+    static constexpr size_t   num_pages = 0x10000 >> page_bits;
+
+    static_assert(page_bits == paged_ram::page_bits, "RAM pages are mapped straight into the page table");
+
+    static void count(std::array<counter, num_regions>& counts, uint16_t addr) noexcept
+    {
+        counts[static_cast<size_t>(region_of(addr))].add();
+    }
+
+    // find_pair points at the byte at addr if it and the next can be accessed directly, through pages or in HRAM.
+    // HRAM sits on its own bus, so it is never blocked by a DMA, and is safe to access directly unless watched.
+    template<typename T>
+    T* find_pair(const std::array<T*, num_pages>& pages, uint16_t addr) noexcept
+    {
+        if ((addr & page_mask) != page_mask)
+        {
+            if (T* page = pages[addr >> page_bits]; page != nullptr) return page + (addr & page_mask);
+        }
+        if (static_cast<uint16_t>(addr - io_registers_end) < hram_pairs) return &stack[addr - io_registers_end];
+        return nullptr;
+    }
+
+    uint16_t peek16_slow(uint16_t addr) noexcept;
+    void     poke16_slow(uint16_t addr, uint16_t val) noexcept;
+    uint16_t read16_slow(uint16_t addr) noexcept;
+    void     write16_slow(uint16_t addr, uint16_t val) noexcept;
+
+    // read_watched and write_watched are the slow paths of the program's accesses, which a debugger may be watching
+    uint8_t read_watched(uint16_t addr) noexcept;
+    void    write_watched(uint16_t addr, uint8_t val) noexcept;
+
+    uint8_t read_slow(uint16_t addr) noexcept;
+    uint8_t read_bus(uint16_t addr) noexcept;
+    uint8_t read_io(uint16_t addr) noexcept;
+    void    write_slow(uint16_t addr, uint8_t val) noexcept;
+    void    write_io(uint16_t addr, uint8_t val) noexcept;
+
+    void start_oam_dma(uint8_t page) noexcept;
+    void step_oam_dma(uint32_t cycles) noexcept;
+    void start_vram_dma(uint8_t control) noexcept;
+    void copy_vram_block() noexcept;
+
+    // called by the ppu at the start of every hblank, when HDMA copies its next block
+    void hblank() noexcept;
+
+    // dma_conflict is true if an OAM DMA in progress owns the bus addr is on
+    [[nodiscard]] bool dma_conflict(uint16_t addr) const noexcept;
+
+    // remap points the page tables at the currently selected banks, leaving out watched pages; it must be called
+    // whenever a bank or what is watched changes
+    void remap() noexcept;
+
+    // offsets of the selected banks into vram and wram
+    [[nodiscard]] size_t vram_bank() const noexcept;
+    [[nodiscard]] size_t wram_bank_n() const noexcept;
+
+    // writable is where to write the byte at offset in ram, copying its page first if a fork shares it
+    [[nodiscard]] uint8_t* writable(paged_ram& ram, size_t offset) noexcept;
+
+    std::unique_ptr<memory_bank_controller> owned_controller; // unless controller belongs to someone else
+    memory_bank_controller*                 controller;
+    const cartridge&                        cart;
+    paged_ram                               vram; // over vram_storage, bank 1 is only reachable in color mode
+    paged_ram                               wram; // over wram_storage, bank 0 is fixed at C000, 2-7 color mode only
+    std::array<uint8_t, 0xA0>               oam;
     // TODO "Invalid" Sprite Attribute Table
     std::array<uint8_t, 0x80> io_registers;
     std::array<uint8_t, 0x7F> stack;
-    uint8_t                   interrupt_enable_register;
+    interrupt_controller      irq; // IF and IE
+
+    // color palette RAM, 8 palettes of 4 little-endian BGR555 colors each, reached through BCPS/BCPD and OCPS/OCPD
+    std::array<uint8_t, 0x40> bg_palettes;
+    std::array<uint8_t, 0x40> obj_palettes;
+
+    std::array<const uint8_t*, num_pages> read_pages;
+    std::array<uint8_t*, num_pages>       write_pages;
+
+    // watch flags, per page
+    static constexpr uint8_t watch_reads  = 1U << 0U;
+    static constexpr uint8_t watch_writes = 1U << 1U;
+
+    debugger*                      watcher;
+    std::array<uint8_t, num_pages> watched;
+    uint16_t                       hram_pairs; // offsets into HRAM where a pair can be accessed directly
+
+    bool color;
+    bool exact;
+    bool counting; // accesses by region
+
+    // OAM DMA, only ever in progress in accurate mode
+    uint16_t oam_dma_source;
+    uint32_t oam_dma_elapsed;
+    bool     oam_dma_active;
+
+    // CGB VRAM DMA: general purpose DMA copies everything at once, HDMA one 16 byte block per hblank
+    uint16_t vram_dma_source;
+    uint16_t vram_dma_dest; // offset into the current VRAM bank
+    uint8_t  vram_dma_blocks;
+    bool     hdma_active;
+    uint32_t stall;
+
+    ppu    video;
+    joypad pad;
+    serial sio;
+
+    metrics stats;
+
+    // the banks' own pages are last, so everything else is together ahead of them; they start out unused, see
+    // paged_ram
+    std::array<uint8_t, vram_bank_size * 2> vram_storage;
+    std::array<uint8_t, wram_bank_size * 8> wram_storage;
 
     // clang-format off
     static constexpr std::array<uint8_t, 0x100> bootstrap_rom = {
@@ -2,6 +2,12 @@
 
 #include <cstdint>
 
+namespace gb
+{
+class state_reader;
+class state_writer;
+}
+
 class memory_bank_controller
 {
 public:
@@ -19,4 +25,14 @@ public:
     /* virtual uint16_t read16(uint16_t addr) noexcept                = 0; */
     virtual void write(uint16_t addr, uint8_t val) noexcept = 0;
     /* virtual void     write16(uint16_t addr, uint16_t val) noexcept = 0; */
+
+    // step advances anything on the cartridge that keeps time, such as a real time clock, by cycles at normal speed
+    virtual void step(uint32_t /* cycles */) noexcept {}
+
+    // save_state and load_state cover the controller's registers and RAM, see state.hpp
+    virtual void save_state(gb::state_writer& /* out */) const noexcept {}
+    virtual void load_state(gb::state_reader& /* in */) noexcept {}
+
+    // share_ram makes other, a controller of the same kind, share this one's RAM for a fork (see gb::paged_ram)
+    virtual void share_ram(memory_bank_controller& /* other */) {}
 };
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace gb
+{
+
+// counter is a running total with a single writer, the thread running the emulator, that any other thread can read at
+// any time without locking anything.
+//
+// With only one writer, bumping it takes a plain load and store rather than a locked read-modify-write, so it costs the
+// emulator no more than an ordinary integer would.
+class counter
+{
+public:
+    void add(uint64_t n = 1) noexcept
+    {
+        total.store(total.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] uint64_t load() const noexcept { return total.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> total{0};
+};
+
+// the parts of the memory map accesses are counted by
+enum class region : uint8_t
+{
+    rom,
+    vram,
+    cart_ram,
+    wram,
+    echo, // the mirror of WRAM at E000 - FDFF
+    oam,
+    io,   // including the unusable FEA0 - FEFF and IE
+    hram,
+
+    END,
+};
+
+constexpr size_t num_regions = static_cast<size_t>(region::END);
+
+[[nodiscard]] constexpr region region_of(uint16_t addr) noexcept
+{
+    if (addr < 0x8000) return region::rom;
+    if (addr < 0xA000) return region::vram;
+    if (addr < 0xC000) return region::cart_ram;
+    if (addr < 0xE000) return region::wram;
+    if (addr < 0xFE00) return region::echo;
+    if (addr < 0xFEA0) return region::oam;
+    if (addr >= 0xFF80 && addr < 0xFFFF) return region::hram;
+    return region::io;
+}
+
+[[nodiscard]] constexpr const char* region_name(region r) noexcept
+{
+    switch (r)
+    {
+    case region::rom: return "rom";
+    case region::vram: return "vram";
+    case region::cart_ram: return "cart_ram";
+    case region::wram: return "wram";
+    case region::echo: return "echo";
+    case region::oam: return "oam";
+    case region::io: return "io";
+    case region::hram: return "hram";
+    case region::END: break;
+    }
+    return "unknown";
+}
+
+// metrics are the counters an emulator instance keeps about its own work, for monitoring.
+//
+// Frames completed are counted by the ppu (see ppu::frame_count), everything else here.
+struct metrics
+{
+    counter instructions;  // instructions retired
+    counter cycles;        // CPU cycles run
+    counter bank_switches; // writes to the cartridge's bank select registers (2000 - 5FFF)
+    counter halt_cycles;   // cycles skipped over in HALT
+    counter idle_cycles;   // cycles fast-forwarded by idle loop skipping
+
+    std::array<counter, 5> interrupts; // interrupts serviced, indexed by IF bit
+
+    // CPU accesses to the memory map, only counted once memory::set_access_counting turns it on
+    std::array<counter, num_regions> reads;
+    std::array<counter, num_regions> writes;
+};
+
+}
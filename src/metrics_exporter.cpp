@@ -0,0 +1,316 @@
+#include "metrics_exporter.hpp"
+
+#include <array>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+#include <SDL2/SDL_log.h>
+
+#include "cpu.hpp"
+#include "memory.hpp"
+#include "metrics.hpp"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#define GB_HAVE_UNIX_SOCKETS 1
+#endif
+
+namespace gb
+{
+
+using file_ptr = std::unique_ptr<std::FILE, decltype(&std::fclose)>;
+
+// indexed by IF bit
+constexpr std::array<const char*, 5> interrupt_names = {"vblank", "lcd_stat", "timer", "serial", "joypad"};
+
+static std::string escape_label(const std::string& value)
+{
+    std::string out;
+    out.reserve(value.size());
+
+    for (const char c : value)
+    {
+        switch (c)
+        {
+        case '\\': out += "\\\\"; break;
+        case '"': out += "\\\""; break;
+        case '\n': out += "\\n"; break;
+        default: out += c; break;
+        }
+    }
+
+    return out;
+}
+
+static void family(std::string& out, const char* name, const char* help)
+{
+    out += "# HELP ";
+    out += name;
+    out += ' ';
+    out += help;
+    out += "\n# TYPE ";
+    out += name;
+    out += " counter\n";
+}
+
+// sample writes one line of a family, labelled with the instance and optionally one more label
+static void sample(std::string&       out,
+                   const char*        name,
+                   const std::string& instance,
+                   uint64_t           value,
+                   const char*        label       = nullptr,
+                   const char*        label_value = nullptr)
+{
+    out += name;
+    out += "{instance=\"";
+    out += instance;
+    out += '"';
+    if (label != nullptr)
+    {
+        out += ',';
+        out += label;
+        out += "=\"";
+        out += label_value;
+        out += '"';
+    }
+    out += "} ";
+    out += std::to_string(value);
+    out += '\n';
+}
+
+metrics_exporter::~metrics_exporter() { stop(); }
+
+void metrics_exporter::add(std::string name, const cpu& instance)
+{
+    sources.push_back({escape_label(name), &instance});
+}
+
+void metrics_exporter::stop() noexcept
+{
+    if (!worker.joinable()) return;
+
+    worker.request_stop();
+    worker.join();
+}
+
+void metrics_exporter::render(std::string& out) const
+{
+    // every counter of one instance, the same way
+    auto each = [&](const char* name, const char* help, uint64_t (*value)(const memory&))
+    {
+        family(out, name, help);
+        for (const auto& src : sources) sample(out, name, src.name, value(src.instance->bus()));
+    };
+
+    each("gbemu_instructions_total",
+         "Instructions retired.",
+         [](const memory& mem) { return mem.counters().instructions.load(); });
+    each("gbemu_cycles_total", "CPU cycles run.", [](const memory& mem) { return mem.counters().cycles.load(); });
+    each("gbemu_frames_total",
+         "Frames completed by the display.",
+         [](const memory& mem) { return mem.display().frame_count(); });
+    each("gbemu_bank_switches_total",
+         "Writes to the cartridge's bank select registers.",
+         [](const memory& mem) { return mem.counters().bank_switches.load(); });
+    each("gbemu_halt_cycles_skipped_total",
+         "Cycles skipped over in HALT.",
+         [](const memory& mem) { return mem.counters().halt_cycles.load(); });
+    each("gbemu_idle_cycles_skipped_total",
+         "Cycles fast-forwarded through busy-wait loops.",
+         [](const memory& mem) { return mem.counters().idle_cycles.load(); });
+
+    family(out, "gbemu_interrupts_total", "Interrupts serviced, by type.");
+    for (const auto& src : sources)
+    {
+        const auto& stats = src.instance->bus().counters();
+        for (size_t i = 0; i < interrupt_names.size(); ++i)
+        {
+            sample(out, "gbemu_interrupts_total", src.name, stats.interrupts[i].load(), "type", interrupt_names[i]);
+        }
+    }
+
+    // only instances counting accesses have any to report
+    auto accesses = [&](const char* name, const char* help, std::array<counter, num_regions> metrics::*counts)
+    {
+        family(out, name, help);
+        for (const auto& src : sources)
+        {
+            const auto& mem = src.instance->bus();
+            if (!mem.access_counting()) continue;
+
+            for (size_t i = 0; i < num_regions; ++i)
+            {
+                const auto count = (mem.counters().*counts)[i].load();
+                sample(out, name, src.name, count, "region", region_name(static_cast<region>(i)));
+            }
+        }
+    };
+
+    accesses("gbemu_memory_reads_total", "Memory reads by the CPU, by region.", &metrics::reads);
+    accesses("gbemu_memory_writes_total", "Memory writes by the CPU, by region.", &metrics::writes);
+}
+
+static std::error_code write_text(const std::filesystem::path& path, const std::string& text)
+{
+    // written next to path and renamed over it, so readers never see a partial file
+    auto temp = path;
+    temp     += ".tmp";
+
+    {
+        file_ptr file{std::fopen(temp.c_str(), "wb"), &std::fclose};
+        if (file == nullptr) return {errno, std::generic_category()};
+
+        const size_t written = std::fwrite(text.data(), 1, text.size(), file.get());
+        if (written != text.size()) return {errno, std::generic_category()};
+        if (std::fclose(file.release()) != 0) return {errno, std::generic_category()};
+    }
+
+    std::error_code err;
+    std::filesystem::rename(temp, path, err);
+    return err;
+}
+
+std::error_code metrics_exporter::write_file(const std::filesystem::path& path, std::chrono::milliseconds interval)
+{
+    if (worker.joinable()) return std::make_error_code(std::errc::device_or_resource_busy);
+
+    std::string text;
+    render(text);
+    if (auto err = write_text(path, text); err) return err;
+
+    worker = std::jthread{[this, path, interval](const std::stop_token& stop) { write_loop(stop, path, interval); }};
+    return {};
+}
+
+void metrics_exporter::write_loop(const std::stop_token&       stop,
+                                  const std::filesystem::path& path,
+                                  std::chrono::milliseconds    interval)
+{
+    std::mutex                  lock;
+    std::condition_variable_any wake;
+    std::unique_lock            guard{lock};
+
+    std::string text;
+    bool        failing = false;
+
+    for (;;)
+    {
+        // the last write happens once stopped, leaving the final totals behind
+        const bool stopped = wake.wait_for(guard, stop, interval, [&] { return stop.stop_requested(); });
+
+        text.clear();
+        render(text);
+
+        // only the first of a run of failures is worth reporting
+        const auto err = write_text(path, text);
+        if (err && !failing)
+        {
+            SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "unable to write metrics: %s", err.message().c_str());
+        }
+        failing = static_cast<bool>(err);
+
+        if (stopped) return;
+    }
+}
+
+#ifdef GB_HAVE_UNIX_SOCKETS
+
+std::error_code metrics_exporter::serve(const std::filesystem::path& path)
+{
+    if (worker.joinable()) return std::make_error_code(std::errc::device_or_resource_busy);
+
+    const auto& native = path.native();
+
+    sockaddr_un addr{};
+    if (native.size() >= sizeof(addr.sun_path)) return std::make_error_code(std::errc::filename_too_long);
+    addr.sun_family = AF_UNIX;
+    std::memcpy(addr.sun_path, native.c_str(), native.size());
+
+    const int server = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (server < 0) return {errno, std::generic_category()};
+
+    ::unlink(path.c_str());
+    if (::bind(server, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0 || ::listen(server, 8) != 0)
+    {
+        std::error_code err{errno, std::generic_category()};
+        ::close(server);
+        return err;
+    }
+
+    worker = std::jthread{[this, server, path](const std::stop_token& stop) { serve_loop(stop, server, path); }};
+    return {};
+}
+
+void metrics_exporter::serve_loop(const std::stop_token& stop, int server, const std::filesystem::path& path)
+{
+    // how often the thread checks whether it should stop while nobody connects
+    constexpr int stop_poll_ms = 250;
+    // how long to wait for a request before answering anyway, so plain clients (socat, nc -U) work too
+    constexpr int request_wait_ms = 100;
+
+#ifdef MSG_NOSIGNAL
+    constexpr int send_flags = MSG_NOSIGNAL;
+#else
+    constexpr int send_flags = 0;
+#endif
+
+    constexpr std::string_view header = "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n\r\n";
+
+    std::string            response;
+    std::array<char, 4096> request{};
+
+    while (!stop.stop_requested())
+    {
+        pollfd listening{.fd = server, .events = POLLIN, .revents = 0};
+        if (::poll(&listening, 1, stop_poll_ms) <= 0) continue;
+
+        const int fd = ::accept(server, nullptr, nullptr);
+        if (fd < 0) continue;
+
+        // the request itself doesn't matter, every path gets the metrics
+        pollfd client{.fd = fd, .events = POLLIN, .revents = 0};
+        if (::poll(&client, 1, request_wait_ms) > 0) (void)::recv(fd, request.data(), request.size(), 0);
+
+        response = header;
+        render(response);
+
+        const char* data = response.data();
+        size_t      len  = response.size();
+        while (len > 0)
+        {
+            const auto n = ::send(fd, data, len, send_flags);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) break;
+
+            data += n;
+            len  -= static_cast<size_t>(n);
+        }
+
+        ::close(fd);
+    }
+
+    ::close(server);
+    ::unlink(path.c_str());
+}
+
+#else
+
+std::error_code metrics_exporter::serve(const std::filesystem::path&)
+{
+    return std::make_error_code(std::errc::not_supported);
+}
+
+void metrics_exporter::serve_loop(const std::stop_token&, int, const std::filesystem::path&) {}
+
+#endif
+
+}
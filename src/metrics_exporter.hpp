@@ -0,0 +1,66 @@
+#pragma once
+
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+namespace gb
+{
+
+struct cpu;
+
+// metrics_exporter publishes the metrics of emulator instances in the Prometheus text format.
+//
+// Everything happens on the exporter's own thread, which only ever reads the instances' counters, so the threads
+// running them are never held up by it.
+class metrics_exporter
+{
+public:
+    static constexpr std::chrono::milliseconds default_interval{1000};
+
+    metrics_exporter() = default;
+
+    metrics_exporter(const metrics_exporter&)            = delete;
+    metrics_exporter& operator=(const metrics_exporter&) = delete;
+    metrics_exporter(metrics_exporter&&)                 = delete;
+    metrics_exporter& operator=(metrics_exporter&&)      = delete;
+
+    ~metrics_exporter();
+
+    // add exports instance's metrics, labelled with name. Instances must be added before exporting starts, and outlive
+    // the exporter.
+    void add(std::string name, const cpu& instance);
+
+    // write_file rewrites path with the latest metrics every interval, replacing it atomically, as the node exporter's
+    // textfile collector expects
+    std::error_code write_file(const std::filesystem::path& path,
+                               std::chrono::milliseconds    interval = default_interval);
+
+    // serve creates a Unix domain socket at path, answering every connection with the latest metrics as an HTTP
+    // response (so it can be scraped with curl --unix-socket, or through a proxy)
+    std::error_code serve(const std::filesystem::path& path);
+
+    // stop ends exporting, and is done on destruction
+    void stop() noexcept;
+
+    // render appends the current metrics of every instance to out
+    void render(std::string& out) const;
+
+private:
+    struct source
+    {
+        std::string name;
+        const cpu*  instance;
+    };
+
+    void write_loop(const std::stop_token& stop, const std::filesystem::path& path, std::chrono::milliseconds interval);
+    void serve_loop(const std::stop_token& stop, int server, const std::filesystem::path& path);
+
+    std::vector<source> sources;
+    std::jthread        worker;
+};
+
+}
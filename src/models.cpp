@@ -66,4 +66,93 @@ void initialize_registers(model m, registers& r, bool color_game) noexcept
     r.HL = values->hl;
 }
 
+static constexpr io_image make_post_boot_io(bool color_hw) noexcept
+{
+    io_image io{};
+
+    auto set = [&](uint16_t addr, uint8_t val) { io[addr - 0xFF00] = val; };
+
+    set(0xFF00, 0xCF); // P1
+    set(0xFF01, 0x00); // SB
+    set(0xFF02, 0x7E); // SC
+    set(0xFF04, 0xAB); // DIV
+    set(0xFF05, 0x00); // TIMA
+    set(0xFF06, 0x00); // TMA
+    set(0xFF07, 0xF8); // TAC
+    set(0xFF0F, 0xE1); // IF
+
+    set(0xFF10, 0x80);
+    set(0xFF11, 0xBF);
+    set(0xFF12, 0xF3);
+    set(0xFF13, 0xFF);
+    set(0xFF14, 0xBF);
+    set(0xFF16, 0x3F);
+    set(0xFF17, 0x00);
+    set(0xFF18, 0xFF);
+    set(0xFF19, 0xBF);
+    set(0xFF1A, 0x7F);
+    set(0xFF1B, 0xFF);
+    set(0xFF1C, 0x9F);
+    set(0xFF1D, 0xFF);
+    set(0xFF1E, 0xBF);
+    set(0xFF20, 0xFF);
+    set(0xFF21, 0x00);
+    set(0xFF22, 0x00);
+    set(0xFF23, 0xBF);
+    set(0xFF24, 0x77);
+    set(0xFF25, 0xF3);
+    set(0xFF26, 0xF1);
+
+    set(0xFF40, 0x91); // LCDC
+    set(0xFF41, 0x85); // STAT
+    set(0xFF42, 0x00); // SCY
+    set(0xFF43, 0x00); // SCX
+    set(0xFF44, 0x00); // LY
+    set(0xFF45, 0x00); // LYC
+    set(0xFF46, 0xFF); // DMA
+    set(0xFF47, 0xFC); // BGP
+    set(0xFF48, 0x00); // OBP0
+    set(0xFF49, 0x00); // OBP1
+    set(0xFF4A, 0x00); // WY
+    set(0xFF4B, 0x00); // WX
+
+    set(0xFF4D, 0xFF); // KEY1
+    set(0xFF4F, 0xFF); // VBK
+    set(0xFF50, 0xFF); // boot ROM disabled
+
+    for (uint16_t addr = 0xFF51; addr <= 0xFF55; ++addr) set(addr, 0xFF); // HDMA1-5
+
+    set(0xFF56, 0xFF); // RP
+    set(0xFF68, 0xFF); // BCPS
+    set(0xFF69, 0xFF); // BCPD
+    set(0xFF6A, 0xFF); // OCPS
+    set(0xFF6B, 0xFF); // OCPD
+    set(0xFF70, 0xFF); // SVBK
+
+    if (color_hw)
+    {
+        set(0xFF02, 0x7F); // SC
+        set(0xFF4D, 0x7E); // KEY1
+        set(0xFF4F, 0xFE); // VBK
+        set(0xFF70, 0xF8); // SVBK
+    }
+
+    return io;
+}
+
+static constexpr io_image monochrome_post_boot = make_post_boot_io(false);
+static constexpr io_image color_post_boot      = make_post_boot_io(true);
+
+// everything not set by the boot ROM itself starts out cleared, and the boot ROM is mapped (0xFF50 == 0)
+static constexpr io_image power_on = []
+{
+    io_image io{};
+    io[0x00] = 0xCF; // P1
+    return io;
+}();
+
+const io_image& post_boot_io(model m) noexcept { return is_color(m) ? color_post_boot : monochrome_post_boot; }
+
+const io_image& power_on_io() noexcept { return power_on; }
+
 }
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <array>
 #include <cstdint>
 
 #include "registers.hpp"
@@ -18,6 +19,26 @@ enum class model
     advance_sp,
 };
 
+enum class boot_mode
+{
+    fast, // start at the cartridge entry point, in the state the boot ROM would have left the machine in
+    full, // run the boot ROM
+};
+
+// io_image is the content of the I/O registers, 0xFF00 - 0xFF7F
+using io_image = std::array<uint8_t, 0x80>;
+
+[[nodiscard]] constexpr bool is_color(model m) noexcept
+{
+    return m == model::color || m == model::advance || m == model::advance_sp;
+}
+
 void initialize_registers(model m, registers& r, bool color_game) noexcept;
 
+// post_boot_io is the state of the I/O registers when the boot ROM hands control to the cartridge
+[[nodiscard]] const io_image& post_boot_io(model m) noexcept;
+
+// power_on_io is the state of the I/O registers before the boot ROM has run
+[[nodiscard]] const io_image& power_on_io() noexcept;
+
 }
@@ -0,0 +1,189 @@
+#include "movie.hpp"
+
+#include <array>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+
+#include "cpu.hpp"
+#include "hash.hpp"
+#include "memory.hpp"
+
+namespace gb
+{
+
+constexpr std::array<char, 4> movie_magic   = {'G', 'B', 'I', 'M'};
+constexpr uint32_t            movie_version = 1;
+constexpr size_t              header_size   = 24;
+constexpr size_t              min_event     = 3; // a byte each for the frame delta and cycle varints, and the buttons
+
+using file_ptr = std::unique_ptr<std::FILE, decltype(&std::fclose)>;
+
+static void put_varint(std::vector<uint8_t>& out, uint64_t v)
+{
+    while (v >= 0x80)
+    {
+        out.push_back(static_cast<uint8_t>(v) | 0x80);
+        v >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(v));
+}
+
+static bool get_varint(const std::vector<uint8_t>& in, size_t& pos, uint64_t& v)
+{
+    v = 0;
+    for (uint32_t shift = 0; shift < 64; shift += 7)
+    {
+        if (pos >= in.size()) return false;
+
+        const uint8_t b = in[pos++];
+        v |= static_cast<uint64_t>(b & 0x7F) << shift;
+        if ((b & 0x80) == 0) return true;
+    }
+    return false;
+}
+
+static std::vector<uint8_t> encode(const std::vector<input_event>& events)
+{
+    std::vector<uint8_t> out;
+    out.reserve(events.size() * 4);
+
+    uint64_t prev_frame = 0;
+    for (const auto& ev : events)
+    {
+        put_varint(out, ev.frame - prev_frame);
+        put_varint(out, ev.cycle);
+        out.push_back(ev.buttons);
+        prev_frame = ev.frame;
+    }
+
+    return out;
+}
+
+void movie::record(uint64_t frame, uint32_t cycle, uint8_t buttons)
+{
+    const uint8_t current = events.empty() ? 0 : events.back().buttons;
+    if (buttons == current) return;
+
+    events.push_back({frame, cycle, buttons});
+}
+
+uint64_t movie::hash() const { return hash::hash64(encode(events)); }
+
+std::error_code load_movie(const std::filesystem::path& path, movie& out)
+{
+    file_ptr file{std::fopen(path.c_str(), "rb"), &std::fclose};
+    if (file == nullptr) return {errno, std::generic_category()};
+
+    std::vector<uint8_t>      data;
+    std::array<uint8_t, 4096> buf{};
+    while (true)
+    {
+        const size_t n = std::fread(buf.data(), 1, buf.size(), file.get());
+        data.insert(data.end(), buf.begin(), buf.begin() + static_cast<std::ptrdiff_t>(n));
+        if (n < buf.size()) break;
+    }
+    if (std::ferror(file.get()) != 0) return {errno, std::generic_category()};
+
+    if (data.size() < header_size || std::memcmp(data.data(), movie_magic.data(), movie_magic.size()) != 0)
+        return std::make_error_code(std::errc::illegal_byte_sequence);
+
+    auto get = [&](size_t offset, size_t len)
+    {
+        uint64_t v = 0;
+        for (size_t i = len; i > 0; --i) v = (v << 8) | data[offset + i - 1];
+        return v;
+    };
+
+    if (get(4, 4) != movie_version) return std::make_error_code(std::errc::not_supported);
+
+    out.rom_hash = get(8, 8);
+    out.events.clear();
+
+    // every event takes at least min_event bytes, so a count the rest of the file can't hold is corrupt, not a reason
+    // to reserve room for it
+    const uint64_t count = get(16, 8);
+    if (count > (data.size() - header_size) / min_event) return std::make_error_code(std::errc::illegal_byte_sequence);
+
+    out.events.reserve(count);
+
+    size_t   pos   = header_size;
+    uint64_t frame = 0;
+    for (uint64_t i = 0; i < count; ++i)
+    {
+        uint64_t delta = 0;
+        uint64_t cycle = 0;
+        if (!get_varint(data, pos, delta) || !get_varint(data, pos, cycle) || pos >= data.size())
+            return std::make_error_code(std::errc::illegal_byte_sequence);
+
+        frame += delta;
+        out.events.push_back({frame, static_cast<uint32_t>(cycle), data[pos++]});
+    }
+
+    return {};
+}
+
+std::error_code save_movie(const std::filesystem::path& path, const movie& in)
+{
+    file_ptr file{std::fopen(path.c_str(), "wb"), &std::fclose};
+    if (file == nullptr) return {errno, std::generic_category()};
+
+    std::vector<uint8_t> data(header_size);
+    std::memcpy(data.data(), movie_magic.data(), movie_magic.size());
+
+    auto put = [&](size_t offset, size_t len, uint64_t v)
+    {
+        for (size_t i = 0; i < len; ++i) data[offset + i] = static_cast<uint8_t>(v >> (i * 8));
+    };
+
+    put(4, 4, movie_version);
+    put(8, 8, in.rom_hash);
+    put(16, 8, in.events.size());
+
+    const auto events = encode(in.events);
+    data.insert(data.end(), events.begin(), events.end());
+
+    if (std::fwrite(data.data(), 1, data.size(), file.get()) != data.size()) return {errno, std::generic_category()};
+
+    return {};
+}
+
+movie_player::movie_player(const movie& m) noexcept
+    : recording{m}
+    , next{0}
+    , frame{~0ULL}
+    , frame_start{0}
+{}
+
+void movie_player::run_frame(cpu& cpu, memory& mem) noexcept
+{
+    const auto& display = mem.display();
+    const auto& events  = recording.events;
+
+    if (display.frame_count() != frame)
+    {
+        frame       = display.frame_count();
+        frame_start = cpu.elapsed();
+    }
+
+    while (display.frame_count() == frame && !cpu.stopped_by_debugger())
+    {
+        while (next < events.size()
+               && (events[next].frame < frame
+                   || (events[next].frame == frame && frame_start + events[next].cycle <= cpu.elapsed())))
+        {
+            mem.input().set(events[next].buttons);
+            ++next;
+        }
+
+        cpu.step();
+    }
+}
+
+uint64_t movie_player::last_frame() const noexcept
+{
+    return recording.events.empty() ? 0 : recording.events.back().frame;
+}
+
+}
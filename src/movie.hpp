@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <system_error>
+#include <vector>
+
+namespace gb
+{
+
+struct cpu;
+struct memory;
+
+// input_event is a change of joypad state.
+// Events are timestamped by the frame they occurred in, and the number of cycles since that frame began.
+struct input_event
+{
+    uint64_t frame;
+    uint32_t cycle;
+    uint8_t  buttons; // see gb::button
+};
+
+// movie is a recording of every joypad state change of a run, which is enough to replay it exactly.
+//
+// On disk it is a 24 byte little-endian header ("GBIM", version, ROM hash, event count) followed by the events, each
+// stored as LEB128 varints of (frames since the previous event, cycle), then the button byte. Most events take 3-5
+// bytes.
+struct movie
+{
+    uint64_t                 rom_hash = 0;
+    std::vector<input_event> events;
+
+    // record appends an event, if the button state actually changed
+    void record(uint64_t frame, uint32_t cycle, uint8_t buttons);
+
+    // hash identifies the input sequence, independent of which ROM it was recorded with
+    [[nodiscard]] uint64_t hash() const;
+};
+
+std::error_code load_movie(const std::filesystem::path& path, movie& out);
+std::error_code save_movie(const std::filesystem::path& path, const movie& in);
+
+// movie_player replays a movie, applying each event at exactly the cycle it was recorded at.
+struct movie_player
+{
+public:
+    explicit movie_player(const movie& m) noexcept;
+
+    // run_frame runs one frame, applying the events within it. If a debugger stops the cpu partway through, the next
+    // call runs the rest of the frame.
+    void run_frame(cpu& cpu, memory& mem) noexcept;
+
+    [[nodiscard]] bool finished() const noexcept { return next == recording.events.size(); }
+
+    // last_frame is the frame of the final event
+    [[nodiscard]] uint64_t last_frame() const noexcept;
+
+private:
+    const movie& recording;
+    size_t       next;
+    uint64_t     frame;       // being run
+    uint64_t     frame_start; // elapsed cycles when it began
+};
+
+}
@@ -0,0 +1,330 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace gb
+{
+
+// The one description of the instruction set. The CPU's dispatch, the disassembler and the idle loop detection are
+// all generated from these tables, so they can't disagree on operands, lengths or timing.
+
+enum class mnemonic : uint8_t
+{
+    NOP,
+    STOP,
+    HALT,
+    LD,
+    LDH,
+    INC,
+    DEC,
+    ADD,
+    ADC,
+    SUB,
+    SBC,
+    AND,
+    XOR,
+    OR,
+    CP,
+    RLCA,
+    RRCA,
+    RLA,
+    RRA,
+    DAA,
+    CPL,
+    SCF,
+    CCF,
+    JR,
+    JP,
+    CALL,
+    RET,
+    RETI,
+    RST,
+    PUSH,
+    POP,
+    DI,
+    EI,
+    PREFIX, // 0xCB, the rest of the instruction is in ext_opcodes
+    ILLEGAL,
+
+    // 0xCB prefixed
+    RLC,
+    RRC,
+    RL,
+    RR,
+    SLA,
+    SRA,
+    SWAP,
+    SRL,
+    BIT,
+    RES,
+    SET,
+};
+
+enum class operand : uint8_t
+{
+    none,
+
+    // registers
+    A,
+    B,
+    C,
+    D,
+    E,
+    H,
+    L,
+    AF,
+    BC,
+    DE,
+    HL,
+    SP,
+
+    // memory addressed by a register
+    at_BC,
+    at_DE,
+    at_HL,
+    at_HLI, // (HL), incrementing HL after
+    at_HLD, // (HL), decrementing HL after
+    at_C,   // (FF00 + C)
+
+    // operands following the opcode
+    n8,
+    n16,
+    at_n8,  // (FF00 + n)
+    at_n16, // (nn)
+    e8,     // signed offset from the next instruction
+    SP_e8,  // SP plus a signed offset
+
+    // branch conditions
+    if_NZ,
+    if_Z,
+    if_NC,
+    if_C,
+
+    bit,    // opcode::value is the bit number
+    vector, // opcode::value is the RST target
+};
+
+[[nodiscard]] constexpr bool is_reg8(operand o) noexcept { return o >= operand::A && o <= operand::L; }
+[[nodiscard]] constexpr bool is_reg16(operand o) noexcept { return o >= operand::AF && o <= operand::SP; }
+[[nodiscard]] constexpr bool is_memory(operand o) noexcept
+{
+    return (o >= operand::at_BC && o <= operand::at_C) || o == operand::at_n8 || o == operand::at_n16;
+}
+[[nodiscard]] constexpr bool is_condition(operand o) noexcept { return o >= operand::if_NZ && o <= operand::if_C; }
+
+// number of bytes o takes after the opcode
+[[nodiscard]] constexpr uint8_t operand_bytes(operand o) noexcept
+{
+    switch (o)
+    {
+    case operand::n8:
+    case operand::at_n8:
+    case operand::e8:
+    case operand::SP_e8: return 1;
+    case operand::n16:
+    case operand::at_n16: return 2;
+    default: return 0;
+    }
+}
+
+struct opcode
+{
+    mnemonic name   = mnemonic::ILLEGAL;
+    operand  dst    = operand::none;
+    operand  src    = operand::none;
+    uint8_t  value  = 0; // see operand::bit and operand::vector
+    uint8_t  length = 1; // in bytes, including any 0xCB prefix
+    uint8_t  cycles = 4; // for conditional branches, when not taken
+    uint8_t  taken  = 0; // for conditional branches, when taken
+
+    constexpr bool operator==(const opcode&) const = default;
+};
+
+namespace detail
+{
+
+// opcodes decode by their bit fields: xx yyy zzz, where y is also pp q
+constexpr std::array<operand, 8> r   = {operand::B,
+                                        operand::C,
+                                        operand::D,
+                                        operand::E,
+                                        operand::H,
+                                        operand::L,
+                                        operand::at_HL,
+                                        operand::A};
+constexpr std::array<operand, 4> rp  = {operand::BC, operand::DE, operand::HL, operand::SP};
+constexpr std::array<operand, 4> rp2 = {operand::BC, operand::DE, operand::HL, operand::AF};
+constexpr std::array<operand, 4> cc  = {operand::if_NZ, operand::if_Z, operand::if_NC, operand::if_C};
+
+constexpr std::array<mnemonic, 8> alu = {mnemonic::ADD,
+                                         mnemonic::ADC,
+                                         mnemonic::SUB,
+                                         mnemonic::SBC,
+                                         mnemonic::AND,
+                                         mnemonic::XOR,
+                                         mnemonic::OR,
+                                         mnemonic::CP};
+constexpr std::array<mnemonic, 8> rot = {mnemonic::RLC,
+                                         mnemonic::RRC,
+                                         mnemonic::RL,
+                                         mnemonic::RR,
+                                         mnemonic::SLA,
+                                         mnemonic::SRA,
+                                         mnemonic::SWAP,
+                                         mnemonic::SRL};
+
+constexpr opcode make(mnemonic name, operand dst, operand src, uint8_t cycles, uint8_t taken = 0, uint8_t value = 0)
+{
+    const auto length = static_cast<uint8_t>(1 + operand_bytes(dst) + operand_bytes(src));
+    return {name, dst, src, value, length, cycles, taken};
+}
+
+constexpr opcode decode(uint8_t op)
+{
+    using enum mnemonic;
+    using enum operand;
+
+    const uint8_t x = op >> 6;
+    const uint8_t y = (op >> 3) & 7;
+    const uint8_t z = op & 7;
+    const uint8_t p = y >> 1;
+    const bool    q = (y & 1) != 0;
+
+    // (HL) as an operand takes an extra memory access
+    const uint8_t hl_y = r[y] == at_HL ? 4 : 0;
+    const uint8_t hl_z = r[z] == at_HL ? 4 : 0;
+
+    switch (x)
+    {
+    case 0:
+        switch (z)
+        {
+        case 0:
+            if (y == 0) return make(NOP, none, none, 4);
+            if (y == 1) return make(LD, at_n16, SP, 20);
+            if (y == 2) return {STOP, none, none, 0, 2, 4, 0}; // followed by a (normally 0x00) byte
+            if (y == 3) return make(JR, none, e8, 12);
+            return make(JR, cc[y - 4], e8, 8, 12);
+
+        case 1: return q ? make(ADD, HL, rp[p], 8) : make(LD, rp[p], n16, 12);
+
+        case 2:
+        {
+            constexpr std::array<operand, 4> indirect = {at_BC, at_DE, at_HLI, at_HLD};
+            return q ? make(LD, A, indirect[p], 8) : make(LD, indirect[p], A, 8);
+        }
+
+        case 3: return make(q ? DEC : INC, rp[p], none, 8);
+        case 4: return make(INC, r[y], none, 4 + (hl_y * 2));
+        case 5: return make(DEC, r[y], none, 4 + (hl_y * 2));
+        case 6: return make(LD, r[y], n8, 8 + hl_y);
+
+        default:
+        {
+            constexpr std::array<mnemonic, 8> misc = {RLCA, RRCA, RLA, RRA, DAA, CPL, SCF, CCF};
+            return make(misc[y], none, none, 4);
+        }
+        }
+
+    case 1:
+        if (y == 6 && z == 6) return make(HALT, none, none, 4);
+        return make(LD, r[y], r[z], 4 + hl_y + hl_z);
+
+    case 2: return make(alu[y], A, r[z], 4 + hl_z);
+
+    default:
+        switch (z)
+        {
+        case 0:
+            if (y < 4) return make(RET, cc[y], none, 8, 20);
+            if (y == 4) return make(LDH, at_n8, A, 12);
+            if (y == 5) return make(ADD, SP, e8, 16);
+            if (y == 6) return make(LDH, A, at_n8, 12);
+            return make(LD, HL, SP_e8, 12);
+
+        case 1:
+            if (!q) return make(POP, rp2[p], none, 12);
+            if (p == 0) return make(RET, none, none, 16);
+            if (p == 1) return make(RETI, none, none, 16);
+            if (p == 2) return make(JP, none, HL, 4);
+            return make(LD, SP, HL, 8);
+
+        case 2:
+            if (y < 4) return make(JP, cc[y], n16, 12, 16);
+            if (y == 4) return make(LD, at_C, A, 8);
+            if (y == 5) return make(LD, at_n16, A, 16);
+            if (y == 6) return make(LD, A, at_C, 8);
+            return make(LD, A, at_n16, 16);
+
+        case 3:
+            if (y == 0) return make(JP, none, n16, 16);
+            if (y == 1) return make(PREFIX, none, none, 0);
+            if (y == 6) return make(DI, none, none, 4);
+            if (y == 7) return make(EI, none, none, 4);
+            return make(ILLEGAL, none, none, 4);
+
+        case 4: return y < 4 ? make(CALL, cc[y], n16, 12, 24) : make(ILLEGAL, none, none, 4);
+
+        case 5:
+            if (!q) return make(PUSH, none, rp2[p], 16);
+            if (p == 0) return make(CALL, none, n16, 24);
+            return make(ILLEGAL, none, none, 4);
+
+        case 6: return make(alu[y], A, n8, 8);
+        default: return make(RST, none, vector, 16, 0, static_cast<uint8_t>(y * 8));
+        }
+    }
+}
+
+// decode_ext decodes the byte after a 0xCB prefix, the timing including the prefix
+constexpr opcode decode_ext(uint8_t op)
+{
+    using enum mnemonic;
+    using enum operand;
+
+    const uint8_t x = op >> 6;
+    const uint8_t y = (op >> 3) & 7;
+    const uint8_t z = op & 7;
+
+    const bool    hl     = r[z] == at_HL;
+    const uint8_t cycles = hl ? (x == 1 ? 12 : 16) : 8; // BIT only reads (HL)
+
+    opcode out{};
+    if (x == 0) out = make(rot[y], r[z], none, cycles);
+    else out = make(x == 1 ? BIT : x == 2 ? RES : SET, r[z], bit, cycles, 0, y);
+
+    out.length = 2;
+    return out;
+}
+
+template<typename F>
+constexpr std::array<opcode, 256> make_table(F decoder)
+{
+    std::array<opcode, 256> table{};
+    for (size_t i = 0; i < table.size(); ++i) table[i] = decoder(static_cast<uint8_t>(i));
+    return table;
+}
+
+}
+
+inline constexpr std::array<opcode, 256> opcodes     = detail::make_table(detail::decode);
+inline constexpr std::array<opcode, 256> ext_opcodes = detail::make_table(detail::decode_ext);
+
+// lookup finds the opcode of an instruction from its first byte, and the next for 0xCB prefixed instructions
+[[nodiscard]] constexpr const opcode& lookup(uint8_t op, uint8_t next) noexcept
+{
+    return op == 0xCB ? ext_opcodes[next] : opcodes[op];
+}
+
+// a few spot checks against Pan Docs
+static_assert(opcodes[0x01] == opcode{mnemonic::LD, operand::BC, operand::n16, 0, 3, 12, 0});
+static_assert(opcodes[0x36] == opcode{mnemonic::LD, operand::at_HL, operand::n8, 0, 2, 12, 0});
+static_assert(opcodes[0x76].name == mnemonic::HALT && opcodes[0x77].dst == operand::at_HL);
+static_assert(opcodes[0xC4].cycles == 12 && opcodes[0xC4].taken == 24 && opcodes[0xC4].length == 3);
+static_assert(opcodes[0xFF].name == mnemonic::RST && opcodes[0xFF].value == 0x38);
+static_assert(ext_opcodes[0x46] == opcode{mnemonic::BIT, operand::at_HL, operand::bit, 0, 2, 12, 0});
+static_assert(ext_opcodes[0xFE].cycles == 16 && ext_opcodes[0xFE].value == 7);
+
+}
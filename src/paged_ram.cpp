@@ -0,0 +1,106 @@
+#include "paged_ram.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+
+#include "state.hpp"
+
+namespace gb
+{
+
+paged_ram::shared_page paged_ram::zeroes{};
+
+paged_ram::paged_ram(std::span<uint8_t> storage, bool keep) noexcept
+    : storage{storage.first(std::min(storage.size(), max_pages * page_size))}
+    , pages{}
+    , shared{}
+{
+    for (size_t i = 0; i < num_pages(); ++i)
+    {
+        shared[i] = keep ? nullptr : &zeroes;
+        pages[i]  = keep ? this->storage.data() + (i << page_bits) : zeroes.bytes.data();
+    }
+}
+
+paged_ram::~paged_ram()
+{
+    for (size_t i = 0; i < num_pages(); ++i)
+    {
+        if (shared[i] != nullptr) release(shared[i]);
+    }
+}
+
+void paged_ram::make_own(size_t i) noexcept
+{
+    shared_page* page = shared[i];
+    if (page == nullptr) return;
+
+    uint8_t* own = storage.data() + (i << page_bits);
+    std::memcpy(own, page->bytes.data(), page_length(i));
+    pages[i]  = own;
+    shared[i] = nullptr;
+    release(page);
+}
+
+void paged_ram::share_with(paged_ram& other)
+{
+    // copies of every page that is still this RAM's own, made before changing anything
+    std::array<std::unique_ptr<shared_page>, max_pages> copies;
+    for (size_t i = 0; i < num_pages(); ++i)
+    {
+        if (shared[i] != nullptr) continue;
+
+        copies[i] = std::make_unique_for_overwrite<shared_page>();
+        copies[i]->refs.store(1, std::memory_order_relaxed);
+        std::memcpy(copies[i]->bytes.data(), pages[i], page_length(i));
+    }
+
+    for (size_t i = 0; i < num_pages(); ++i)
+    {
+        if (copies[i] != nullptr)
+        {
+            shared[i] = copies[i].release();
+            pages[i]  = shared[i]->bytes.data();
+        }
+
+        retain(shared[i]);
+        if (other.shared[i] != nullptr) release(other.shared[i]);
+        other.shared[i] = shared[i];
+        other.pages[i]  = pages[i];
+    }
+}
+
+void paged_ram::save_state(state_writer& out) const noexcept
+{
+    for (size_t i = 0; i < num_pages(); ++i) out.put_bytes({pages[i], page_length(i)});
+}
+
+void paged_ram::load_state(state_reader& in) noexcept
+{
+    for (size_t i = 0; i < num_pages(); ++i)
+    {
+        if (shared[i] != nullptr) release(shared[i]);
+        shared[i] = nullptr;
+        pages[i]  = storage.data() + (i << page_bits);
+    }
+    in.get_bytes(storage);
+}
+
+size_t paged_ram::page_length(size_t i) const noexcept
+{
+    return std::min(page_size, storage.size() - (i << page_bits));
+}
+
+void paged_ram::retain(shared_page* page) noexcept
+{
+    if (page != &zeroes) page->refs.fetch_add(1, std::memory_order_relaxed);
+}
+
+void paged_ram::release(shared_page* page) noexcept
+{
+    // shared pages are never written, so the last to let go only has to see the others are done with it
+    if (page != &zeroes && page->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) delete page;
+}
+
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+namespace gb
+{
+
+class state_reader;
+class state_writer;
+
+// paged_ram is RAM kept in 4 KiB pages, which forks of a machine share until one of them writes (see instance::fork).
+//
+// Each page is either the RAM's own, in the storage it was made with, or a shared copy: read-only, and counted so it
+// goes with the last RAM using it. Writing to a shared page first copies it back into the RAM's own storage, which
+// moves it, so anything keeping pointers to pages (memory's page table) has to look again after make_own.
+//
+// RAM starts out cleared by sharing one page of zeroes everywhere, so the storage needn't be cleared itself, and a
+// page never written costs nothing to make or fork.
+class paged_ram
+{
+public:
+    static constexpr size_t page_bits = 12;
+    static constexpr size_t page_size = size_t{1} << page_bits;
+    static constexpr size_t page_mask = page_size - 1;
+    static constexpr size_t max_pages = 16; // 64 KiB, the most any RAM here is banked over; the rest is left out
+
+    // storage is where the RAM's own pages go. The RAM starts out cleared, leaving storage as it is, unless keep
+    // starts it out with what is already there.
+    explicit paged_ram(std::span<uint8_t> storage, bool keep = false) noexcept;
+    ~paged_ram();
+
+    paged_ram(const paged_ram&)            = delete;
+    paged_ram& operator=(const paged_ram&) = delete;
+
+    [[nodiscard]] size_t size() const noexcept { return storage.size(); }
+
+    [[nodiscard]] uint8_t read(size_t offset) const noexcept { return pages[offset >> page_bits][offset & page_mask]; }
+
+    void write(size_t offset, uint8_t val) noexcept
+    {
+        if (shared[offset >> page_bits] != nullptr) make_own(offset >> page_bits);
+        storage[offset] = val;
+    }
+
+    // page is where page i is, for reading; own_page is where it is for writing, if it isn't shared
+    [[nodiscard]] const uint8_t* page(size_t i) const noexcept { return pages[i]; }
+    [[nodiscard]] uint8_t*       own_page(size_t i) noexcept
+    {
+        return shared[i] == nullptr ? storage.data() + (i << page_bits) : nullptr;
+    }
+
+    // make_own copies page i back into the RAM's own storage if it is shared
+    void make_own(size_t i) noexcept;
+
+    // share_with makes other, RAM of the same size, share this RAM's pages, first turning those that are its own into
+    // shared copies. Running out of memory for those throws, before anything has changed.
+    void share_with(paged_ram& other);
+
+    // save_state and load_state cover the RAM's contents, see state.hpp; loaded pages are all the RAM's own
+    void save_state(state_writer& out) const noexcept;
+    void load_state(state_reader& in) noexcept;
+
+private:
+    struct shared_page
+    {
+        std::atomic<uint32_t>          refs;
+        std::array<uint8_t, page_size> bytes;
+    };
+
+    [[nodiscard]] size_t num_pages() const noexcept { return (storage.size() + page_mask) >> page_bits; }
+
+    // the last page is short if the RAM isn't a whole number of them
+    [[nodiscard]] size_t page_length(size_t i) const noexcept;
+
+    static void retain(shared_page* page) noexcept;
+    static void release(shared_page* page) noexcept;
+
+    static shared_page zeroes; // shared by every RAM, and never counted
+
+    std::span<uint8_t>                    storage;
+    std::array<const uint8_t*, max_pages> pages;
+    std::array<shared_page*, max_pages>   shared; // or nullptr for the RAM's own
+};
+
+}
@@ -0,0 +1,429 @@
+#include "ppu.hpp"
+
+#include <algorithm>
+
+#include "memory.hpp"
+#include "state.hpp"
+
+namespace gb
+{
+
+// LCDC bits
+constexpr uint8_t lcd_enabled        = 1U << 7U;
+constexpr uint8_t window_tile_map    = 1U << 6U;
+constexpr uint8_t window_enabled     = 1U << 5U;
+constexpr uint8_t tile_data_unsigned = 1U << 4U;
+constexpr uint8_t bg_tile_map        = 1U << 3U;
+constexpr uint8_t obj_size_16        = 1U << 2U;
+constexpr uint8_t obj_enabled        = 1U << 1U;
+constexpr uint8_t bg_enabled         = 1U << 0U;
+
+// STAT bits
+constexpr uint8_t lyc_interrupt    = 1U << 6U;
+constexpr uint8_t oam_interrupt    = 1U << 5U;
+constexpr uint8_t vblank_interrupt = 1U << 4U;
+constexpr uint8_t hblank_interrupt = 1U << 3U;
+constexpr uint8_t lyc_equal        = 1U << 2U;
+constexpr uint8_t mode_mask        = 0x03;
+
+// OAM attribute bits
+constexpr uint8_t obj_behind_bg = 1U << 7U;
+constexpr uint8_t obj_flip_y    = 1U << 6U;
+constexpr uint8_t obj_flip_x    = 1U << 5U;
+constexpr uint8_t obj_palette_1 = 1U << 4U;
+
+// CGB attribute bits, found in VRAM bank 1 for background/window tiles and in OAM for objects
+constexpr uint8_t bg_over_obj  = 1U << 7U;
+constexpr uint8_t tile_flip_y  = 1U << 6U;
+constexpr uint8_t tile_flip_x  = 1U << 5U;
+constexpr uint8_t tile_bank_1  = 1U << 3U;
+constexpr uint8_t palette_mask = 0x07;
+
+constexpr size_t max_objects_per_line = 10;
+
+// the DMG's four shades of grey, lightest first
+constexpr std::array<uint16_t, 4> dmg_shades = {
+    0x7FFF,
+    0x56B5,
+    0x294A,
+    0x0000,
+};
+
+static uint16_t shade(uint8_t palette, uint8_t index) noexcept { return dmg_shades[(palette >> (index * 2)) & 0x03]; }
+
+// looks up a color in CGB palette RAM, which already stores them as BGR555
+static uint16_t color_of(const std::array<uint8_t, 0x40>& ram, uint8_t palette, uint8_t index) noexcept
+{
+    const size_t at = palette * 8 + index * 2;
+    return static_cast<uint16_t>((ram[at] | ram[at + 1] << 8) & 0x7FFF);
+}
+
+ppu::ppu(memory& mem) noexcept
+    : mem{mem}
+    , buffers{}
+    , back{0}
+    , latest{1}
+    , ready{1}
+    , shown{2}
+    , frames{0}
+    , current{mode::hblank}
+    , dots{0}
+    , line{0}
+    , window_line{0}
+    , enabled{false}
+    , stat_line{false}
+{}
+
+uint8_t& ppu::reg(uint16_t addr) noexcept { return mem.io_registers[addr - 0xFF00]; }
+
+uint8_t ppu::reg(uint16_t addr) const noexcept { return mem.io_registers[addr - 0xFF00]; }
+
+const framebuffer& ppu::front() const noexcept { return buffers[latest]; }
+
+const framebuffer& ppu::take_frame() noexcept
+{
+    // only publish clears fresh, so a fresh buffer seen here is still there to take
+    if ((ready.load(std::memory_order_relaxed) & fresh) != 0)
+    {
+        shown = ready.exchange(shown, std::memory_order_acq_rel) & buffer_mask;
+    }
+    return buffers[shown];
+}
+
+uint64_t ppu::frame_count() const noexcept { return frames.load(std::memory_order_acquire); }
+
+void ppu::save_state(state_writer& out) const noexcept
+{
+    if (out.scope() == state_scope::full)
+    {
+        for (const framebuffer* buffer : {&buffers[latest], &buffers[back]})
+        {
+            out.put_bytes({reinterpret_cast<const uint8_t*>(buffer->data()), sizeof(framebuffer)});
+        }
+    }
+    out.put(uint8_t{0}); // which of the two is shown: always the first now, but older states may have either
+    out.put(frames.load(std::memory_order_relaxed));
+
+    out.put(static_cast<uint8_t>(current));
+    out.put(dots);
+    out.put(line);
+    out.put(window_line);
+    out.put(enabled);
+    out.put(stat_line);
+}
+
+void ppu::load_state(state_reader& in) noexcept
+{
+    // each buffer is loaded into the back one and published, as if drawn, so one handed out by take_frame is left
+    // alone
+    const bool full = in.scope() == state_scope::full;
+    if (full)
+    {
+        in.get_bytes({reinterpret_cast<uint8_t*>(buffers[back].data()), sizeof(framebuffer)});
+        publish();
+        in.get_bytes({reinterpret_cast<uint8_t*>(buffers[back].data()), sizeof(framebuffer)});
+    }
+    if ((in.get<uint8_t>() & 1U) != 0 && full)
+    {
+        const uint8_t first = latest;
+        publish();
+        if (back != first) buffers[back] = buffers[first];
+    }
+    frames.store(in.get<uint64_t>(), std::memory_order_release);
+
+    current     = static_cast<mode>(in.get<uint8_t>() & mode_mask);
+    dots        = std::min(in.get<uint32_t>(), cycles_per_line - 1);
+    line        = static_cast<uint8_t>(std::min<uint32_t>(in.get<uint8_t>(), lines_per_frame - 1));
+    window_line = in.get<uint8_t>();
+    enabled     = in.get<bool>();
+    stat_line   = in.get<bool>();
+}
+
+void ppu::copy_frames(const ppu& from) noexcept
+{
+    buffers[back] = from.buffers[from.latest];
+    publish();
+    buffers[back] = from.buffers[from.back];
+}
+
+void ppu::step(uint32_t cycles) noexcept
+{
+    const bool lcd_on = (reg(memory::lcd_control) & lcd_enabled) != 0;
+    if (lcd_on != enabled)
+    {
+        enabled     = lcd_on;
+        dots        = 0;
+        line        = 0;
+        window_line = 0;
+
+        reg(memory::ly) = 0;
+        if (enabled) set_mode(mode::oam_scan);
+        else reg(memory::stat) &= ~mode_mask;
+    }
+
+    dots += cycles;
+
+    if (!enabled)
+    {
+        // No lines are drawn while the LCD is off, but blank frames keep being produced at the normal rate so
+        // anything paced by frames (display, frame hashing, ...) keeps a fixed time base.
+        while (dots >= cycles_per_line)
+        {
+            dots -= cycles_per_line;
+            line = (line + 1) % lines_per_frame;
+            if (line == screen_height)
+            {
+                buffers[back].fill(dmg_shades[0]);
+                finish_frame();
+            }
+        }
+        return;
+    }
+
+    while (true)
+    {
+        if (current == mode::oam_scan && dots >= oam_scan_cycles)
+        {
+            set_mode(mode::transfer);
+            continue;
+        }
+
+        if (current == mode::transfer && dots >= oam_scan_cycles + transfer_cycles)
+        {
+            render_line();
+            set_mode(mode::hblank);
+            mem.hblank();
+            continue;
+        }
+
+        if (dots < cycles_per_line) break;
+
+        dots -= cycles_per_line;
+        next_line();
+    }
+}
+
+uint32_t ppu::next_event() const noexcept
+{
+    // a frame completes (and vblank is requested) at the start of line 144, lit or not
+    const uint32_t lines     = (screen_height + lines_per_frame - line) % lines_per_frame;
+    int64_t        to_vblank = static_cast<int64_t>(lines) * cycles_per_line - dots;
+    if (to_vblank <= 0) to_vblank += cycles_per_frame;
+
+    const auto to_frame = static_cast<uint32_t>(to_vblank);
+    if (!enabled) return to_frame;
+
+    // with no other STAT sources enabled (vblank's coincides with the frame) and no HDMA, nothing else matters
+    const bool line_events = (reg(memory::stat) & (lyc_interrupt | oam_interrupt | hblank_interrupt)) != 0
+                          || mem.hdma_active;
+    if (!line_events) return to_frame;
+
+    return next_transition();
+}
+
+uint32_t ppu::next_line_change() const noexcept
+{
+    // LY stays at 0 while the LCD is off
+    if (!enabled) return cycles_per_frame;
+
+    return cycles_per_line - dots;
+}
+
+uint32_t ppu::next_transition() const noexcept
+{
+    if (!enabled) return cycles_per_line - dots;
+
+    switch (current)
+    {
+    case mode::oam_scan: return oam_scan_cycles - dots;
+    case mode::transfer: return oam_scan_cycles + transfer_cycles - dots;
+    default: return cycles_per_line - dots;
+    }
+}
+
+void ppu::set_mode(mode m) noexcept
+{
+    current = m;
+
+    auto& stat = reg(memory::stat);
+    stat       = (stat & ~mode_mask) | static_cast<uint8_t>(m);
+
+    update_stat();
+}
+
+void ppu::next_line() noexcept
+{
+    line            = (line + 1) % lines_per_frame;
+    reg(memory::ly) = line;
+
+    if (line == screen_height)
+    {
+        mem.irq.request(interrupt::vblank);
+        finish_frame();
+        set_mode(mode::vblank);
+    }
+    else if (line < screen_height)
+    {
+        if (line == 0) window_line = 0;
+        set_mode(mode::oam_scan);
+    }
+    else
+    {
+        update_stat();
+    }
+}
+
+void ppu::update_stat() noexcept
+{
+    auto& stat = reg(memory::stat);
+
+    if (reg(memory::ly) == reg(memory::lyc)) stat |= lyc_equal;
+    else stat &= ~lyc_equal;
+
+    const bool level = ((stat & lyc_interrupt) != 0 && (stat & lyc_equal) != 0)
+                    || ((stat & hblank_interrupt) != 0 && current == mode::hblank)
+                    || ((stat & vblank_interrupt) != 0 && current == mode::vblank)
+                    || ((stat & oam_interrupt) != 0 && current == mode::oam_scan);
+
+    if (level && !stat_line) mem.irq.request(interrupt::lcd_stat);
+    stat_line = level;
+}
+
+void ppu::render_line() noexcept
+{
+    const uint8_t lcdc  = reg(memory::lcd_control);
+    const uint8_t ly    = line;
+    const bool    color = mem.color_mode();
+
+    // In color mode LCDC bit 0 doesn't turn the background off, it instead takes away all of its priority over objects
+    const bool bg_drawn    = color || (lcdc & bg_enabled) != 0;
+    const bool bg_priority = (lcdc & bg_enabled) != 0;
+
+    auto* out = &buffers[back][ly * screen_width];
+
+    // color indices (before palette lookup) of the background/window, needed for object priority,
+    // and whether each pixel's tile attributes put it above objects (color only)
+    std::array<uint8_t, screen_width> bg_index{};
+    std::array<bool, screen_width>    bg_on_top{};
+
+    auto pixel = [](const std::array<uint8_t, 2>& planes, uint8_t bit) -> uint8_t
+    {
+        return static_cast<uint8_t>(((planes[1] >> bit) & 1) << 1 | ((planes[0] >> bit) & 1));
+    };
+
+    const uint8_t bgp = reg(memory::bgp);
+
+    // draws pixel x of the line from (mx, my) of a background/window tile map
+    auto draw_bg = [&](uint32_t x, uint16_t map_base, uint8_t mx, uint8_t my)
+    {
+        const uint16_t entry = map_base + (my / 8) * 32 + mx / 8;
+        const uint8_t  tile  = mem.vram.read(entry);
+        const uint8_t  attrs = color ? mem.vram.read(memory::vram_bank_size + entry) : 0;
+
+        uint8_t row = my % 8;
+        uint8_t col = mx % 8;
+        if ((attrs & tile_flip_y) != 0) row = 7 - row;
+        if ((attrs & tile_flip_x) != 0) col = 7 - col;
+
+        uint16_t base = (lcdc & tile_data_unsigned) != 0 ? tile * 16 : 0x1000 + static_cast<int8_t>(tile) * 16;
+        if ((attrs & tile_bank_1) != 0) base += memory::vram_bank_size;
+
+        const uint8_t px = pixel({mem.vram.read(base + row * 2), mem.vram.read(base + row * 2 + 1)}, 7 - col);
+        bg_index[x]      = px;
+        bg_on_top[x]     = (attrs & bg_over_obj) != 0;
+        out[x]           = color ? color_of(mem.bg_palettes, attrs & palette_mask, px) : shade(bgp, px);
+    };
+
+    if (bg_drawn)
+    {
+        const uint16_t map = (lcdc & bg_tile_map) != 0 ? 0x1C00 : 0x1800;
+        const uint8_t  y   = reg(memory::screen_y) + ly;
+        const uint8_t  scx = reg(memory::screen_x);
+
+        for (uint32_t x = 0; x < screen_width; ++x) draw_bg(x, map, scx + x, y);
+
+        const uint8_t wy = reg(memory::window_y);
+        const int     wx = static_cast<int>(reg(memory::window_x)) - 7;
+        if ((lcdc & window_enabled) != 0 && wy <= ly && wx < static_cast<int>(screen_width))
+        {
+            const uint16_t wmap = (lcdc & window_tile_map) != 0 ? 0x1C00 : 0x1800;
+            for (int x = std::max(wx, 0); x < static_cast<int>(screen_width); ++x)
+            {
+                draw_bg(x, wmap, static_cast<uint8_t>(x - wx), window_line);
+            }
+            ++window_line;
+        }
+    }
+    else
+    {
+        std::fill(out, out + screen_width, dmg_shades[0]);
+    }
+
+    if ((lcdc & obj_enabled) == 0) return;
+
+    const uint8_t height = (lcdc & obj_size_16) != 0 ? 16 : 8;
+
+    // objects on this line, in OAM order
+    std::array<uint8_t, max_objects_per_line> visible{};
+    size_t                                    count = 0;
+    for (uint8_t i = 0; i < 40 && count < max_objects_per_line; ++i)
+    {
+        const int y = static_cast<int>(mem.oam[i * 4]) - 16;
+        if (ly >= y && ly < y + height) visible[count++] = i;
+    }
+
+    // on the DMG the object with the smaller X wins, then the one earlier in OAM, while in color mode only OAM order
+    // counts; draw lowest priority first so higher priority objects overwrite
+    if (!color)
+    {
+        std::stable_sort(visible.begin(),
+                         visible.begin() + count,
+                         [&](uint8_t a, uint8_t b) { return mem.oam[a * 4 + 1] < mem.oam[b * 4 + 1]; });
+    }
+
+    for (size_t n = count; n > 0; --n)
+    {
+        const uint8_t* obj   = &mem.oam[visible[n - 1] * 4];
+        const int      y     = static_cast<int>(obj[0]) - 16;
+        const int      x     = static_cast<int>(obj[1]) - 8;
+        uint8_t        tile  = obj[2];
+        const uint8_t  attrs = obj[3];
+
+        uint8_t row = ly - y;
+        if ((attrs & obj_flip_y) != 0) row = height - 1 - row;
+        if (height == 16) tile &= 0xFE;
+
+        uint16_t base = tile * 16 + row * 2;
+        if (color && (attrs & tile_bank_1) != 0) base += memory::vram_bank_size;
+
+        const std::array<uint8_t, 2> planes = {mem.vram.read(base), mem.vram.read(base + 1)};
+        const uint8_t palette = (attrs & obj_palette_1) != 0 ? reg(memory::object_pallete_1)
+                                                             : reg(memory::object_pallete_0);
+
+        for (int i = 0; i < 8; ++i)
+        {
+            const int sx = x + i;
+            if (sx < 0 || sx >= static_cast<int>(screen_width)) continue;
+
+            const uint8_t px = pixel(planes, (attrs & obj_flip_x) != 0 ? i : 7 - i);
+            if (px == 0) continue;
+            if (bg_priority && bg_index[sx] != 0 && ((attrs & obj_behind_bg) != 0 || bg_on_top[sx])) continue;
+
+            out[sx] = color ? color_of(mem.obj_palettes, attrs & palette_mask, px) : shade(palette, px);
+        }
+    }
+}
+
+void ppu::finish_frame() noexcept
+{
+    publish();
+    frames.fetch_add(1, std::memory_order_release);
+}
+
+void ppu::publish() noexcept
+{
+    latest = back;
+    back   = ready.exchange(static_cast<uint8_t>(back | fresh), std::memory_order_acq_rel) & buffer_mask;
+}
+
+}
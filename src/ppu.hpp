@@ -0,0 +1,104 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace gb
+{
+
+struct memory;
+class state_reader;
+class state_writer;
+
+constexpr uint32_t screen_width  = 160;
+constexpr uint32_t screen_height = 144;
+
+// pixels are 15-bit BGR (the CGB's native color format): red in bits 0-4, green in 5-9, blue in 10-14
+using framebuffer = std::array<uint16_t, screen_width * screen_height>;
+
+struct ppu
+{
+public:
+    static constexpr uint32_t cycles_per_line  = 456;
+    static constexpr uint32_t lines_per_frame  = 154;
+    static constexpr uint32_t cycles_per_frame = cycles_per_line * lines_per_frame;
+
+    explicit ppu(memory& mem) noexcept;
+
+    void step(uint32_t cycles) noexcept;
+
+    // the most recently completed frame, for the thread running the ppu (or any other while it isn't running)
+    [[nodiscard]] const framebuffer& front() const noexcept;
+
+    // take_frame hands the most recently completed frame to one other thread while the ppu keeps running: it is left
+    // alone until that thread's next take_frame, frames completing into a third buffer meanwhile
+    [[nodiscard]] const framebuffer& take_frame() noexcept;
+
+    // number of frames completed so far
+    [[nodiscard]] uint64_t frame_count() const noexcept;
+
+    // next_event is the number of cycles until the ppu next does something observable: requests an interrupt,
+    // completes a frame or starts an hblank with an HDMA transfer waiting. Nothing happens if stepped by less.
+    [[nodiscard]] uint32_t next_event() const noexcept;
+
+    // next_transition is the number of cycles until the next mode or line change, when STAT next changes
+    [[nodiscard]] uint32_t next_transition() const noexcept;
+
+    // next_line_change is the number of cycles until LY next changes
+    [[nodiscard]] uint32_t next_line_change() const noexcept;
+
+    // the state includes the frame shown and the one being drawn, so the last frame shown comes back with it
+    void save_state(state_writer& out) const noexcept;
+    void load_state(state_reader& in) noexcept;
+
+    // copy_frames copies what a fork's state leaves out, from's frame buffers
+    void copy_frames(const ppu& from) noexcept;
+
+private:
+    enum class mode : uint8_t
+    {
+        hblank   = 0,
+        vblank   = 1,
+        oam_scan = 2,
+        transfer = 3,
+    };
+
+    static constexpr uint32_t oam_scan_cycles = 80;
+    static constexpr uint32_t transfer_cycles = 172;
+
+    uint8_t&              reg(uint16_t addr) noexcept;
+    [[nodiscard]] uint8_t reg(uint16_t addr) const noexcept;
+
+    void set_mode(mode m) noexcept;
+    void next_line() noexcept;
+    void update_stat() noexcept;
+    void render_line() noexcept;
+    void finish_frame() noexcept;
+
+    // publish hands the back buffer over as the latest frame, taking whichever ready held in its place
+    void publish() noexcept;
+
+    // Frames are triple buffered: the ppu draws into buffers[back], publishing it to ready when complete (flagged
+    // fresh until taken), and take_frame swaps a fresh one for the buffer it handed out before, in shown. latest is
+    // whichever of those two holds the last frame published.
+    static constexpr uint8_t buffer_mask = 0x03;
+    static constexpr uint8_t fresh       = 0x04;
+
+    memory&                    mem;
+    std::array<framebuffer, 3> buffers;
+    uint8_t                    back;
+    uint8_t                    latest;
+    std::atomic<uint8_t>       ready;
+    uint8_t                    shown;
+    std::atomic<uint64_t>      frames;
+
+    mode     current;
+    uint32_t dots; // position within the current line
+    uint8_t  line;
+    uint8_t  window_line;
+    bool     enabled;
+    bool     stat_line; // the STAT interrupt fires on the rising edge of this
+};
+
+}
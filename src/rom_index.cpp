@@ -0,0 +1,163 @@
+#include "rom_index.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+
+namespace gb
+{
+
+constexpr std::array<char, 4> index_magic   = {'G', 'B', 'R', 'I'};
+constexpr uint32_t            index_version = 1;
+constexpr size_t              header_size   = 16;
+constexpr size_t              title_size    = 16;
+
+// slot layout: content hash (u64), ROM size (u32), RAM size (u32), path offset (u32), path length (u16, 0 for an empty
+// slot), global checksum (u16), title (16 bytes, NUL padded), cartridge type (u8), color support (u8), flags (u8), then
+// padding
+constexpr size_t slot_size = 48;
+
+constexpr uint8_t header_checksum_ok = 1U << 0U;
+constexpr uint8_t global_checksum_ok = 1U << 1U;
+
+using file_ptr = std::unique_ptr<std::FILE, decltype(&std::fclose)>;
+
+static uint64_t get_le(const uint8_t* in, size_t len) noexcept
+{
+    uint64_t v = 0;
+    for (size_t i = len; i > 0; --i) v = (v << 8) | in[i - 1];
+    return v;
+}
+
+static void put_le(uint8_t* out, size_t len, uint64_t v) noexcept
+{
+    for (size_t i = 0; i < len; ++i) out[i] = static_cast<uint8_t>(v >> (i * 8));
+}
+
+static size_t num_slots(const std::vector<uint8_t>& image) noexcept { return get_le(&image[12], 4); }
+
+size_t rom_index::size() const noexcept { return image.empty() ? 0 : get_le(&image[8], 4); }
+
+std::optional<rom_entry> rom_index::find(uint64_t content_hash) const
+{
+    if (image.empty()) return std::nullopt;
+
+    const size_t   slots   = num_slots(image);
+    const uint8_t* table   = image.data() + header_size;
+    const uint8_t* strings = table + (slots * slot_size);
+    const size_t   len     = image.size() - header_size - (slots * slot_size);
+
+    // load_index only accepts tables with an empty slot, but the image could have come from anywhere, so the probe
+    // stops after a lap regardless
+    for (size_t i = content_hash & (slots - 1), probed = 0; probed < slots; i = (i + 1) & (slots - 1), ++probed)
+    {
+        const uint8_t* slot        = table + (i * slot_size);
+        const size_t   path_offset = get_le(slot + 16, 4);
+        const size_t   path_length = get_le(slot + 20, 2);
+
+        if (path_length == 0) return std::nullopt;
+        if (get_le(slot, 8) != content_hash) continue;
+        if (path_offset + path_length > len) return std::nullopt;
+
+        rom_entry entry;
+        entry.content_hash          = content_hash;
+        entry.path                  = {reinterpret_cast<const char*>(strings + path_offset), path_length};
+        entry.title                 = {reinterpret_cast<const char*>(slot + 24), title_size};
+        entry.rom_size              = get_le(slot + 8, 4);
+        entry.ram_size              = get_le(slot + 12, 4);
+        entry.global_checksum       = get_le(slot + 22, 2);
+        entry.cartridge_type        = slot[40];
+        entry.color                 = static_cast<cartridge::color_support>(slot[41]);
+        entry.header_checksum_valid = (slot[42] & header_checksum_ok) != 0;
+        entry.global_checksum_valid = (slot[42] & global_checksum_ok) != 0;
+
+        entry.title.resize(std::strlen(entry.title.c_str()));
+        return entry;
+    }
+
+    return std::nullopt;
+}
+
+std::error_code load_index(const std::filesystem::path& path, rom_index& out)
+{
+    file_ptr file{std::fopen(path.c_str(), "rb"), &std::fclose};
+    if (file == nullptr) return {errno, std::generic_category()};
+
+    std::vector<uint8_t>           image;
+    std::array<uint8_t, 64 * 1024> buf{};
+    for (size_t n = 0; (n = std::fread(buf.data(), 1, buf.size(), file.get())) > 0;)
+    {
+        image.insert(image.end(), buf.begin(), buf.begin() + static_cast<std::ptrdiff_t>(n));
+    }
+    if (std::ferror(file.get()) != 0) return {errno, std::generic_category()};
+
+    if (image.size() < header_size || std::memcmp(image.data(), index_magic.data(), index_magic.size()) != 0)
+        return std::make_error_code(std::errc::illegal_byte_sequence);
+
+    if (get_le(&image[4], 4) != index_version) return std::make_error_code(std::errc::not_supported);
+
+    const size_t slots = num_slots(image);
+    if (!std::has_single_bit(slots) || image.size() < header_size + (slots * slot_size))
+        return std::make_error_code(std::errc::illegal_byte_sequence);
+
+    // lookups for missing hashes stop at an empty slot, which save_index always leaves (the table is at most half full)
+    bool has_empty = false;
+    for (size_t i = 0; i < slots && !has_empty; ++i)
+    {
+        has_empty = get_le(&image[header_size + (i * slot_size) + 20], 2) == 0;
+    }
+    if (!has_empty) return std::make_error_code(std::errc::illegal_byte_sequence);
+
+    out.image = std::move(image);
+    return {};
+}
+
+std::error_code save_index(const std::filesystem::path& path, std::span<const rom_entry> entries)
+{
+    const size_t slots = std::max<size_t>(16, std::bit_ceil(entries.size() * 2));
+
+    std::vector<uint8_t> image(header_size + (slots * slot_size));
+    std::memcpy(image.data(), index_magic.data(), index_magic.size());
+    put_le(&image[4], 4, index_version);
+    put_le(&image[8], 4, entries.size());
+    put_le(&image[12], 4, slots);
+
+    std::string strings;
+    for (const auto& entry : entries)
+    {
+        if (entry.path.empty() || entry.path.size() > 0xFFFF) return std::make_error_code(std::errc::invalid_argument);
+
+        size_t i = entry.content_hash & (slots - 1);
+        while (get_le(&image[header_size + (i * slot_size) + 20], 2) != 0) i = (i + 1) & (slots - 1);
+
+        uint8_t* slot = &image[header_size + (i * slot_size)];
+        put_le(slot, 8, entry.content_hash);
+        put_le(slot + 8, 4, entry.rom_size);
+        put_le(slot + 12, 4, entry.ram_size);
+        put_le(slot + 16, 4, strings.size());
+        put_le(slot + 20, 2, entry.path.size());
+        put_le(slot + 22, 2, entry.global_checksum);
+        std::memcpy(slot + 24, entry.title.data(), std::min(entry.title.size(), title_size));
+        slot[40] = entry.cartridge_type;
+        slot[41] = static_cast<uint8_t>(entry.color);
+        slot[42] = (entry.header_checksum_valid ? header_checksum_ok : 0)
+                 | (entry.global_checksum_valid ? global_checksum_ok : 0);
+
+        strings += entry.path;
+    }
+
+    file_ptr file{std::fopen(path.c_str(), "wb"), &std::fclose};
+    if (file == nullptr) return {errno, std::generic_category()};
+
+    if (std::fwrite(image.data(), 1, image.size(), file.get()) != image.size()
+        || std::fwrite(strings.data(), 1, strings.size(), file.get()) != strings.size())
+        return {errno, std::generic_category()};
+
+    return {};
+}
+
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "cartridge.hpp"
+
+namespace gb
+{
+
+// rom_entry is what a rom_index records about a ROM.
+struct rom_entry
+{
+    uint64_t                 content_hash = 0; // hash::hash64 of the whole file
+    std::string              path;
+    std::string              title;
+    uint32_t                 rom_size              = 0;
+    uint32_t                 ram_size              = 0;
+    uint8_t                  cartridge_type        = 0; // header byte 0x147, see cartridge::describe_type
+    cartridge::color_support color                 = cartridge::color_support::monochrome_supported;
+    uint16_t                 global_checksum       = 0; // as computed, not as stored in the header
+    bool                     header_checksum_valid = false;
+    bool                     global_checksum_valid = false;
+};
+
+// rom_index maps ROM content hashes to what is known about each ROM, so one can be looked up without scanning for it.
+//
+// On disk it is a 16 byte little-endian header ("GBRI", version, entry count, slot count), an open addressing hash
+// table of 48 byte slots keyed by content hash, then the paths the slots refer to. The table is at most half full, so
+// a lookup usually reads a single slot.
+struct rom_index
+{
+    std::vector<uint8_t> image;
+
+    [[nodiscard]] size_t                   size() const noexcept;
+    [[nodiscard]] std::optional<rom_entry> find(uint64_t content_hash) const;
+};
+
+std::error_code load_index(const std::filesystem::path& path, rom_index& out);
+std::error_code save_index(const std::filesystem::path& path, std::span<const rom_entry> entries);
+
+}
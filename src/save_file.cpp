@@ -0,0 +1,151 @@
+#include "save_file.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <condition_variable>
+#include <mutex>
+#include <stop_token>
+#include <thread>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define GB_HAVE_MMAP 1
+#endif
+
+namespace gb
+{
+
+// flusher is the background thread writing back every open save_file
+class flusher
+{
+public:
+    flusher()
+        : thread{[this](const std::stop_token& stop) { run(stop); }}
+    {}
+
+    void add(save_file* save)
+    {
+        std::lock_guard guard{lock};
+        saves.push_back(save);
+    }
+
+    void remove(save_file* save)
+    {
+        // once this returns the thread can't be flushing save
+        std::lock_guard guard{lock};
+        std::erase(saves, save);
+    }
+
+private:
+    void run(const std::stop_token& stop)
+    {
+        std::unique_lock guard{lock};
+        while (!wake.wait_for(guard, stop, save_file::flush_interval, [&] { return stop.stop_requested(); }))
+        {
+            for (save_file* save : saves) save->flush();
+        }
+    }
+
+    std::mutex                  lock;
+    std::condition_variable_any wake;
+    std::vector<save_file*>     saves;
+    std::jthread                thread; // last, so it stops before everything else is destroyed
+};
+
+static flusher& background() noexcept
+{
+    static flusher instance;
+    return instance;
+}
+
+save_file::save_file(uint8_t* base, size_t ram_bytes, size_t size, uint32_t page_shift)
+    : base{base}
+    , ram_bytes{ram_bytes}
+    , size{size}
+    , page_shift{page_shift}
+    , words{(((size - 1) >> page_shift) / 64) + 1}
+    , dirty_pages{std::make_unique<std::atomic<uint64_t>[]>(words)}
+{
+    background().add(this);
+}
+
+void save_file::dirty_all() noexcept
+{
+    const size_t pages = ((size - 1) >> page_shift) + 1;
+    for (size_t i = 0; i < words; ++i)
+    {
+        const size_t left = pages - (i * 64);
+        dirty_pages[i].fetch_or(left >= 64 ? ~uint64_t{0} : (uint64_t{1} << left) - 1, std::memory_order_relaxed);
+    }
+}
+
+#ifdef GB_HAVE_MMAP
+
+save_file::~save_file()
+{
+    background().remove(this);
+
+    ::msync(base, size, MS_SYNC);
+    ::munmap(base, size);
+}
+
+void save_file::flush() noexcept
+{
+    for (size_t i = 0; i < words; ++i)
+    {
+        uint64_t bits = dirty_pages[i].exchange(0, std::memory_order_relaxed);
+        while (bits != 0)
+        {
+            const size_t offset = ((i * 64) + std::countr_zero(bits)) << page_shift;
+            bits               &= bits - 1;
+
+            ::msync(base + offset, std::min<size_t>(size - offset, size_t{1} << page_shift), MS_ASYNC);
+        }
+    }
+}
+
+std::error_code open_save(const std::filesystem::path& path, size_t ram_size, bool rtc, std::unique_ptr<save_file>& out)
+{
+    const size_t size = ram_size + (rtc ? save_file::rtc_size : 0);
+    if (size == 0) return std::make_error_code(std::errc::invalid_argument);
+
+    const int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) return {errno, std::generic_category()};
+
+    // new (or short) saves are zero-filled; anything past what is needed, such as another emulator's footer, is left be
+    struct stat info{};
+    if (::fstat(fd, &info) != 0 || (static_cast<size_t>(info.st_size) < size && ::ftruncate(fd, size) != 0))
+    {
+        std::error_code err{errno, std::generic_category()};
+        ::close(fd);
+        return err;
+    }
+
+    void*           base = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    std::error_code err  = base == MAP_FAILED ? std::error_code{errno, std::generic_category()} : std::error_code{};
+    ::close(fd);
+    if (err) return err;
+
+    const auto page_shift = static_cast<uint32_t>(std::countr_zero(static_cast<size_t>(::sysconf(_SC_PAGESIZE))));
+    out.reset(new save_file{static_cast<uint8_t*>(base), ram_size, size, page_shift});
+    return {};
+}
+
+#else
+
+save_file::~save_file() { background().remove(this); }
+
+void save_file::flush() noexcept {}
+
+std::error_code open_save(const std::filesystem::path&, size_t, bool, std::unique_ptr<save_file>&)
+{
+    return std::make_error_code(std::errc::not_supported);
+}
+
+#endif
+
+}
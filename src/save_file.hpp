@@ -0,0 +1,81 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <span>
+#include <system_error>
+
+namespace gb
+{
+
+// save_file is a cartridge's battery-backed memory, kept in a memory-mapped .sav file: external RAM, followed by the
+// clock state for cartridges with one.
+//
+// Writing only touches memory and marks the page written dirty. A background thread shared by every save_file writes
+// dirty pages back every flush_interval, and the rest are written back on close, so saving never blocks emulation.
+struct save_file
+{
+public:
+    static constexpr size_t rtc_size       = 48;
+    static constexpr auto   flush_interval = std::chrono::seconds{1};
+
+    save_file(const save_file&)            = delete;
+    save_file& operator=(const save_file&) = delete;
+    save_file(save_file&&)                 = delete;
+    save_file& operator=(save_file&&)      = delete;
+
+    ~save_file();
+
+    [[nodiscard]] std::span<uint8_t> ram() noexcept { return {base, ram_bytes}; }
+
+    // rtc is empty without a clock
+    [[nodiscard]] std::span<uint8_t> rtc() noexcept { return {base + ram_bytes, size - ram_bytes}; }
+
+    // dirty marks the page holding offset, from the start of the file, as needing to be written back
+    void dirty(size_t offset) noexcept
+    {
+        const size_t   page = offset >> page_shift;
+        const uint64_t bit  = uint64_t{1} << (page % 64);
+
+        auto& word = dirty_pages[page / 64];
+        if ((word.load(std::memory_order_relaxed) & bit) == 0) word.fetch_or(bit, std::memory_order_relaxed);
+    }
+
+    // dirty_all marks every page as needing to be written back, as after the whole RAM is replaced
+    void dirty_all() noexcept;
+
+    // is_dirty is whether the page holding offset is still to be written back
+    [[nodiscard]] bool is_dirty(size_t offset) const noexcept
+    {
+        const size_t page = offset >> page_shift;
+        return (dirty_pages[page / 64].load(std::memory_order_relaxed) & (uint64_t{1} << (page % 64))) != 0;
+    }
+
+    // flush starts writing back the dirty pages, without waiting for the writes to finish
+    void flush() noexcept;
+
+private:
+    friend std::error_code open_save(const std::filesystem::path& path, size_t ram_size, bool rtc,
+                                     std::unique_ptr<save_file>& out);
+
+    save_file(uint8_t* base, size_t ram_bytes, size_t size, uint32_t page_shift);
+
+    uint8_t*                                 base;
+    size_t                                   ram_bytes;
+    size_t                                   size;
+    uint32_t                                 page_shift;
+    size_t                                   words;
+    std::unique_ptr<std::atomic<uint64_t>[]> dirty_pages; // one bit per page
+};
+
+// open_save maps the save file at path, creating it or growing it to fit ram_size bytes of RAM and the clock if needed.
+std::error_code open_save(const std::filesystem::path& path,
+                          size_t                       ram_size,
+                          bool                         rtc,
+                          std::unique_ptr<save_file>&  out);
+
+}
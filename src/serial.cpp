@@ -0,0 +1,161 @@
+#include "serial.hpp"
+
+#include <algorithm>
+
+#include <SDL2/SDL_log.h>
+
+#include "memory.hpp"
+#include "state.hpp"
+
+namespace gb
+{
+
+// cycles to clock out a byte: the bit clock runs at 8192 Hz, or 262144 Hz with the CGB's fast clock
+constexpr uint32_t byte_cycles      = 8 * 512;
+constexpr uint32_t fast_byte_cycles = 8 * 16;
+
+serial::serial(memory& mem) noexcept
+    : mem{mem}
+    , link{}
+    , out{}
+    , in{}
+    , data{0}
+    , control{0}
+    , peer_data{0xFF}
+    , remaining{none}
+    , quantum{default_quantum}
+    , until_sync{default_quantum}
+    , overdue{0}
+    , syncs{0}
+    , sync_limit{no_limit}
+{}
+
+void serial::save_state(state_writer& out) const noexcept
+{
+    out.put(data);
+    out.put(control);
+    out.put(peer_data);
+    out.put(remaining);
+    out.put(until_sync);
+}
+
+void serial::load_state(state_reader& in) noexcept
+{
+    data       = in.get<uint8_t>();
+    control    = in.get<uint8_t>();
+    peer_data  = in.get<uint8_t>();
+    remaining  = in.get<uint32_t>();
+    until_sync = std::min(in.get<uint32_t>(), quantum);
+}
+
+uint8_t serial::read_control() const noexcept
+{
+    // unused bits read as 1, and the clock speed bit only exists on the CGB
+    return control | (mem.color_mode() ? 0x7C : 0x7E);
+}
+
+void serial::write_data(uint8_t val) noexcept { data = val; }
+
+void serial::write_control(uint8_t val) noexcept
+{
+    control = val & (transfer_start | internal_clock | (mem.color_mode() ? fast_clock : 0));
+
+    if ((control & transfer_start) == 0)
+    {
+        remaining = none;
+        return;
+    }
+
+    // with the external clock, the transfer waits for the other end to clock a byte in (see sync)
+    if ((control & internal_clock) == 0) return;
+
+    remaining = (control & fast_clock) != 0 ? fast_byte_cycles : byte_cycles;
+
+    // connect makes room for every byte the clock can complete in a quantum, so this never allocates; any more can only
+    // come from restarting transfers before they complete, and are lost
+    if (link != nullptr && out.transfers.size() < out.transfers.capacity()) out.transfers.push_back(data);
+}
+
+void serial::connect(std::unique_ptr<link_transport> transport, uint32_t sync_cycles)
+{
+    quantum = std::max<uint32_t>(sync_cycles, 1);
+    if (transport != nullptr) out.transfers.reserve(quantum / fast_byte_cycles + 1);
+
+    link       = std::move(transport);
+    peer_data  = 0xFF;
+    until_sync = quantum;
+    overdue    = 0;
+    syncs      = 0;
+    sync_limit = no_limit;
+    out.transfers.clear();
+}
+
+void serial::step(uint32_t cycles) noexcept
+{
+    if (remaining != none)
+    {
+        if (cycles >= remaining) complete(peer_data);
+        else remaining -= cycles;
+    }
+
+    if (link == nullptr) return;
+
+    cycles  += overdue;
+    overdue  = 0;
+
+    while (cycles >= until_sync)
+    {
+        if (syncs >= sync_limit)
+        {
+            overdue    = cycles - until_sync;
+            until_sync = 0;
+            return;
+        }
+
+        cycles     -= until_sync;
+        until_sync  = quantum;
+        ++syncs;
+
+        sync();
+        if (link == nullptr) return;
+    }
+
+    until_sync -= cycles;
+}
+
+uint32_t serial::next_event() const noexcept { return std::min(remaining, link != nullptr ? until_sync : none); }
+
+void serial::sync() noexcept
+{
+    out.data = data;
+
+    if (auto err = link->exchange(out, in); err)
+    {
+        if (err == std::errc::connection_reset) SDL_Log("link cable unplugged at the other end");
+        else SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "link cable disconnected: %s", err.message().c_str());
+        link.reset();
+        peer_data = 0xFF;
+        out.transfers.clear();
+        return;
+    }
+
+    out.transfers.clear();
+    peer_data = in.data;
+
+    for (const uint8_t byte : in.transfers)
+    {
+        // only a transfer waiting on the external clock takes the byte, otherwise it's lost
+        if ((control & (transfer_start | internal_clock)) == transfer_start) complete(byte);
+    }
+}
+
+void serial::complete(uint8_t received) noexcept
+{
+    data      = received;
+    control  &= ~transfer_start;
+    remaining = none;
+
+    mem.irq.request(interrupt::serial);
+}
+
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <memory>
+
+#include "link_transport.hpp"
+
+namespace gb
+{
+
+struct memory;
+class state_reader;
+class state_writer;
+
+// serial emulates the link port: SB (0xFF01) and SC (0xFF02).
+//
+// Rather than trading bits with the other end as they are clocked, everything is batched up and exchanged through a
+// link_transport every quantum cycles. A byte clocked out with the internal clock completes after the usual 8 bit
+// times, receiving the other end's SB as of the last sync point, and reaches the other end at the next sync point. So
+// the two ends never drift more than a quantum apart, and only pay for synchronization once per quantum.
+struct serial
+{
+public:
+    static constexpr uint32_t default_quantum = 4096; // about 1ms
+    static constexpr uint64_t no_limit        = std::numeric_limits<uint64_t>::max();
+
+    explicit serial(memory& mem) noexcept;
+
+    [[nodiscard]] uint8_t read_data() const noexcept { return data; }
+    [[nodiscard]] uint8_t read_control() const noexcept;
+    void                  write_data(uint8_t val) noexcept;
+    void                  write_control(uint8_t val) noexcept;
+
+    // connect plugs a cable into the port (nullptr unplugs it), syncing with the other end every sync_cycles
+    void connect(std::unique_ptr<link_transport> transport, uint32_t sync_cycles = default_quantum);
+
+    [[nodiscard]] bool connected() const noexcept { return link != nullptr; }
+
+    // sync_count is the number of sync points passed since the cable was plugged in
+    [[nodiscard]] uint64_t sync_count() const noexcept { return syncs; }
+
+    // until_next_sync is the number of cycles until the next sync point, 0 while it is held
+    [[nodiscard]] uint32_t until_next_sync() const noexcept { return until_sync; }
+
+    // hold_syncs lets the port pass no more than limit sync points, holding it at the next one until it is called again
+    // with a higher limit, so that a run can end at a sync point the other end ends at too. Cycles run while a sync
+    // point is held count as run after it.
+    void hold_syncs(uint64_t limit) noexcept { sync_limit = limit; }
+
+    void step(uint32_t cycles) noexcept;
+
+    // next_event is the number of cycles until a transfer completes or the next sync point
+    [[nodiscard]] uint32_t next_event() const noexcept;
+
+    // The state of a transfer is saved, but not anything on its way over a link cable, which stays plugged in as it is.
+    void save_state(state_writer& out) const noexcept;
+    void load_state(state_reader& in) noexcept;
+
+private:
+    static constexpr uint8_t transfer_start = 1U << 7U;
+    static constexpr uint8_t fast_clock     = 1U << 1U; // CGB only
+    static constexpr uint8_t internal_clock = 1U << 0U;
+
+    static constexpr uint32_t none = std::numeric_limits<uint32_t>::max();
+
+    void sync() noexcept;
+    void complete(uint8_t received) noexcept;
+
+    memory&                         mem;
+    std::unique_ptr<link_transport> link;
+    link_batch                      out;
+    link_batch                      in;
+
+    uint8_t  data;
+    uint8_t  control;
+    uint8_t  peer_data;  // the other end's SB as of the last sync point
+    uint32_t remaining;  // cycles until the transfer in progress completes, none if there isn't one
+    uint32_t quantum;    // cycles between sync points
+    uint32_t until_sync; // cycles until the next sync point
+    uint32_t overdue;    // cycles run past a held sync point
+    uint64_t syncs;      // sync points passed since connect
+    uint64_t sync_limit; // sync points to pass before holding
+};
+
+}
@@ -0,0 +1,22 @@
+#include "simd.hpp"
+
+namespace gb::simd
+{
+
+level detect() noexcept
+{
+#if defined(__x86_64__) || defined(_M_X64)
+#if defined(__GNUC__)
+    if (__builtin_cpu_supports("avx2")) return level::avx2;
+#endif
+    // part of x86-64 itself
+    return level::sse2;
+#elif defined(__aarch64__) || defined(_M_ARM64)
+    // part of AArch64 itself
+    return level::neon;
+#else
+    return level::scalar;
+#endif
+}
+
+}
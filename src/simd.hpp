@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstdint>
+
+namespace gb::simd
+{
+
+// level is the widest vector instruction set available
+enum class level : uint8_t
+{
+    scalar,
+    sse2,
+    avx2,
+    neon,
+};
+
+// detect returns the widest level the running CPU supports, for choosing between implementations at runtime
+[[nodiscard]] level detect() noexcept;
+
+}
@@ -0,0 +1,76 @@
+#include "state.hpp"
+
+#include <algorithm>
+
+#include "cpu.hpp"
+#include "memory.hpp"
+
+namespace gb
+{
+
+constexpr std::array<uint8_t, 4> state_magic   = {'G', 'B', 'S', 'T'};
+constexpr uint16_t               state_version = 1;
+
+// the cartridge header, from the title to the checksums, identifies the game without hashing all of it
+constexpr size_t cart_header_start = 0x0134;
+constexpr size_t cart_header_end   = 0x0150;
+
+constexpr size_t header_size = state_magic.size() + sizeof(state_version) + 1 + (cart_header_end - cart_header_start);
+
+using state_header = std::array<uint8_t, header_size>;
+
+// make_header is what starts every state machine saves, and what a state must start with for machine to load it
+static state_header make_header(const cpu& machine) noexcept
+{
+    const auto& mem  = machine.bus();
+    const auto& data = mem.game().data;
+
+    std::array<uint8_t, cart_header_end - cart_header_start> cart{};
+    if (data.size() >= cart_header_end)
+    {
+        std::copy(data.begin() + cart_header_start, data.begin() + cart_header_end, cart.begin());
+    }
+
+    state_header header{};
+    state_writer out{header};
+    out.put_bytes(state_magic);
+    out.put(state_version);
+    out.put(mem.color_mode());
+    out.put_bytes(cart);
+    return header;
+}
+
+size_t state_size(const cpu& machine) noexcept
+{
+    state_writer out;
+    out.put_bytes(make_header(machine));
+    machine.save_state(out);
+    return out.size();
+}
+
+std::error_code save_state(const cpu& machine, std::span<uint8_t> out) noexcept
+{
+    state_writer writer{out};
+    writer.put_bytes(make_header(machine));
+    machine.save_state(writer);
+
+    if (writer.size() > out.size()) return std::make_error_code(std::errc::no_buffer_space);
+    return {};
+}
+
+std::error_code load_state(cpu& machine, std::span<const uint8_t> in) noexcept
+{
+    // every part of a machine's state is a fixed size, so one that is the right size all over can be read without
+    // running out part of the way through
+    const auto expected = make_header(machine);
+    if (in.size() != state_size(machine) || !std::ranges::equal(in.first(header_size), expected))
+    {
+        return std::make_error_code(std::errc::invalid_argument);
+    }
+
+    state_reader reader{in.subspan(header_size)};
+    machine.load_state(reader);
+    return {};
+}
+
+}
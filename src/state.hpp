@@ -0,0 +1,115 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <system_error>
+
+namespace gb
+{
+
+struct cpu;
+
+// state_scope is how much of a machine a state covers: all of it, or for a fork (see instance::fork) all but the RAM
+// and frames, which the fork shares or copies directly
+enum class state_scope : uint8_t
+{
+    full,
+    fork,
+};
+
+// state_writer lays out a machine's state, each part of it appending its fields in turn, integers little-endian.
+//
+// Writing past the end of out only counts the bytes, so writing to an empty span measures how big the state is.
+class state_writer
+{
+public:
+    explicit state_writer(std::span<uint8_t> out = {}, state_scope scope = state_scope::full) noexcept
+        : out{out}
+        , written{0}
+        , covers{scope}
+    {}
+
+    void put_bytes(std::span<const uint8_t> bytes) noexcept
+    {
+        if (written + bytes.size() <= out.size()) std::memcpy(out.data() + written, bytes.data(), bytes.size());
+        written += bytes.size();
+    }
+
+    template<std::unsigned_integral T>
+    void put(T val) noexcept
+    {
+        std::array<uint8_t, sizeof(T)> bytes{};
+        for (size_t i = 0; i < sizeof(T); ++i) bytes[i] = static_cast<uint8_t>(static_cast<uint64_t>(val) >> (i * 8));
+        put_bytes(bytes);
+    }
+
+    // size is the number of bytes written so far, including any that didn't fit
+    [[nodiscard]] size_t size() const noexcept { return written; }
+
+    [[nodiscard]] state_scope scope() const noexcept { return covers; }
+
+private:
+    std::span<uint8_t> out;
+    size_t             written;
+    state_scope        covers;
+};
+
+// state_reader reads back what state_writer wrote. Reading past the end reads zeroes, but load_state checks a state is
+// the right size for the machine loading it first, so that never happens part of the way through.
+class state_reader
+{
+public:
+    explicit state_reader(std::span<const uint8_t> in, state_scope scope = state_scope::full) noexcept
+        : in{in}
+        , covers{scope}
+    {}
+
+    void get_bytes(std::span<uint8_t> bytes) noexcept
+    {
+        const size_t n = std::min(bytes.size(), in.size());
+        std::memcpy(bytes.data(), in.data(), n);
+        std::memset(bytes.data() + n, 0, bytes.size() - n);
+        in = in.subspan(n);
+    }
+
+    template<std::unsigned_integral T>
+    T get() noexcept
+    {
+        std::array<uint8_t, sizeof(T)> bytes{};
+        get_bytes(bytes);
+
+        uint64_t val = 0;
+        for (size_t i = 0; i < sizeof(T); ++i) val |= static_cast<uint64_t>(bytes[i]) << (i * 8);
+        return static_cast<T>(val);
+    }
+
+    [[nodiscard]] state_scope scope() const noexcept { return covers; }
+
+private:
+    std::span<const uint8_t> in;
+    state_scope              covers;
+};
+
+// A machine's state is everything needed to carry on from where it was saved: the cpu, memory, the ppu (including the
+// frames on screen), the joypad, serial port and cartridge. What is only configuration (accurate mode, idle skipping,
+// access counting, a link cable, a debugger) or bookkeeping (metrics) is left as it is on the machine loading it.
+//
+// States are meant to be saved and loaded by the same build: they start with a version, and are only loaded by a
+// machine running the same cartridge in the same mode, but are not a stable file format.
+
+// state_size is the number of bytes save_state needs for machine, the same for as long as it runs
+[[nodiscard]] size_t state_size(const cpu& machine) noexcept;
+
+// save_state writes machine's state to out, failing with no_buffer_space if it doesn't fit
+std::error_code save_state(const cpu& machine, std::span<uint8_t> out) noexcept;
+
+// load_state replaces machine's state with in, failing with invalid_argument and leaving it as it was if in wasn't
+// saved by a machine like it
+std::error_code load_state(cpu& machine, std::span<const uint8_t> in) noexcept;
+
+}
@@ -1,6 +1,10 @@
 #pragma once
 
+#include <array>
+#include <bit>
+#include <cstddef>
 #include <cstdint>
+#include <cstring>
 
 namespace gb::util
 {
@@ -30,6 +34,40 @@ struct promote<uint32_t>
 template<typename T>
 using promote_t = typename promote<T>::type;
 
+// load_le16 and store_le16 access a little-endian 16-bit value at a possibly unaligned address
+inline uint16_t load_le16(const uint8_t* src) noexcept
+{
+    uint16_t val = 0;
+    std::memcpy(&val, src, sizeof(val));
+    if constexpr (std::endian::native == std::endian::big) val = static_cast<uint16_t>((val << 8) | (val >> 8));
+    return val;
+}
+
+inline void store_le16(uint8_t* dst, uint16_t val) noexcept
+{
+    if constexpr (std::endian::native == std::endian::big) val = static_cast<uint16_t>((val << 8) | (val >> 8));
+    std::memcpy(dst, &val, sizeof(val));
+}
+
+// fixed_stack is a stack of at most N elements, kept inline rather than on the heap as std::stack's are
+template<typename T, size_t N>
+class fixed_stack
+{
+public:
+    void push(const T& val) noexcept { items[count++] = val; }
+    void pop() noexcept { --count; }
+
+    [[nodiscard]] T&       top() noexcept { return items[count - 1]; }
+    [[nodiscard]] const T& top() const noexcept { return items[count - 1]; }
+
+    [[nodiscard]] size_t size() const noexcept { return count; }
+    [[nodiscard]] bool   empty() const noexcept { return count == 0; }
+
+private:
+    std::array<T, N> items{};
+    size_t           count = 0;
+};
+
 }
 
 constexpr uint8_t  operator"" _u8(unsigned long long v) { return static_cast<uint8_t>(v); }
@@ -0,0 +1,209 @@
+#include <doctest/doctest.h>
+
+#include <array>
+#include <cerrno>
+#include <cstdint>
+#include <vector>
+
+#include "gbemu.h"
+
+// only the public header, as a script or binding sees it
+
+namespace
+{
+
+constexpr const char* crystal = GBEMU_TESTDATA "/pokemon_crystal_usa_eur.gbc";
+
+constexpr uint64_t frame_cycles = 70224;
+
+std::vector<uint8_t> state(gbemu_instance* instance)
+{
+    std::vector<uint8_t> out(gbemu_state_size(instance));
+    REQUIRE(gbemu_save_states(&instance, 1, out.data(), out.size()) == 0);
+    return out;
+}
+
+// batch is count instances of rom, destroyed again as it goes
+struct batch
+{
+    batch(const gbemu_rom* rom, size_t count, uint32_t flags = 0)
+        : instances(count)
+    {
+        for (auto& inst : instances) REQUIRE(gbemu_create(rom, flags, &inst) == 0);
+    }
+
+    batch(const batch&)            = delete;
+    batch& operator=(const batch&) = delete;
+
+    ~batch()
+    {
+        for (auto* inst : instances) gbemu_destroy(inst);
+    }
+
+    std::vector<gbemu_instance*> instances;
+};
+
+// rom is the test ROM, freed once every batch using it has been destroyed
+struct rom
+{
+    rom() { REQUIRE(gbemu_rom_open(crystal, &loaded) == 0); }
+
+    rom(const rom&)            = delete;
+    rom& operator=(const rom&) = delete;
+
+    ~rom() { gbemu_rom_free(loaded); }
+
+    gbemu_rom* loaded = nullptr;
+};
+
+}
+
+TEST_CASE("instances created through the C API run frames, and are destroyed")
+{
+    rom game;
+    CHECK(gbemu_instance_size(game.loaded) > 0);
+    CHECK(gbemu_instance_size(nullptr) == 0);
+
+    batch b{game.loaded, 3};
+    auto& inst = b.instances;
+
+    const std::array<uint8_t, 3> buttons = {0, GBEMU_START | GBEMU_A, 0};
+    REQUIRE(gbemu_run(nullptr, inst.data(), inst.size(), buttons.data(), 30) == 0);
+    for (auto* i : inst) CHECK(gbemu_frame_count(i) == 30);
+
+    // the same buttons run the same
+    CHECK(state(inst[0]) == state(inst[2]));
+
+    std::array<const uint16_t*, 3> frames{};
+    gbemu_frames(inst.data(), inst.size(), frames.data());
+    for (const auto* f : frames) CHECK(f != nullptr);
+    CHECK(frames[0] != frames[1]);
+}
+
+TEST_CASE("a runner's threads run a batch exactly as the calling thread would")
+{
+    rom game;
+
+    constexpr size_t count = 8;
+    batch            threaded{game.loaded, count};
+    batch            on_caller{game.loaded, count};
+
+    std::array<uint8_t, count> buttons{};
+    for (size_t i = 0; i < count; ++i) buttons[i] = static_cast<uint8_t>(1U << i);
+
+    gbemu_runner* runner = nullptr;
+    REQUIRE(gbemu_runner_create(4, &runner) == 0);
+
+    CHECK(gbemu_run(runner, threaded.instances.data(), count, buttons.data(), 20) == 0);
+    CHECK(gbemu_submit(runner, threaded.instances.data(), count, buttons.data(), 20) == 0);
+    CHECK(gbemu_wait(runner) == 0);
+    gbemu_runner_destroy(runner);
+
+    CHECK(gbemu_run(nullptr, on_caller.instances.data(), count, buttons.data(), 40) == 0);
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        CHECK(gbemu_frame_count(threaded.instances[i]) == 40);
+        CHECK(state(threaded.instances[i]) == state(on_caller.instances[i]));
+    }
+}
+
+TEST_CASE("memory and states are read and written through the C API")
+{
+    rom   game;
+    batch b{game.loaded, 2};
+    auto& inst = b.instances;
+
+    REQUIRE(gbemu_run(nullptr, inst.data(), inst.size(), nullptr, 5) == 0);
+
+    const std::array<uint8_t, 2> data = {0x12, 0x34};
+    REQUIRE(gbemu_write_memory(inst[0], 0xC000, data.data(), data.size()) == 0);
+    CHECK(gbemu_write_memory(inst[0], 0xFFFF, data.data(), data.size()) == -EINVAL);
+
+    std::array<uint8_t, 4> read{};
+    REQUIRE(gbemu_read_memory(inst.data(), inst.size(), 0xC000, 2, read.data()) == 0);
+    CHECK(read[0] == 0x12);
+    CHECK(read[1] == 0x34);
+    CHECK(gbemu_read_memory(inst.data(), inst.size(), 0xFFFF, 2, read.data()) == -EINVAL);
+
+    // one state loaded into both leaves them the same
+    auto saved = state(inst[0]);
+    CHECK(gbemu_save_states(inst.data(), 1, saved.data(), saved.size() - 1) == -ENOBUFS);
+    REQUIRE(gbemu_load_states(inst.data(), inst.size(), saved.data(), 0, saved.size()) == 0);
+    CHECK(state(inst[1]) == saved);
+    CHECK(gbemu_load_states(inst.data(), 1, saved.data(), 0, saved.size() - 1) == -EINVAL);
+
+    // and only loads into an instance in the same mode
+    batch dmg{game.loaded, 1, GBEMU_DMG};
+    CHECK(gbemu_load_states(dmg.instances.data(), 1, saved.data(), 0, saved.size()) == -EINVAL);
+}
+
+TEST_CASE("a fork through the C API runs on from where its parent was, on its own")
+{
+    rom   game;
+    batch b{game.loaded, 1};
+
+    const uint8_t start = GBEMU_START;
+    REQUIRE(gbemu_run(nullptr, b.instances.data(), 1, &start, 10) == 0);
+
+    gbemu_instance* fork = nullptr;
+    REQUIRE(gbemu_fork(b.instances[0], &fork) == 0);
+    CHECK(state(fork) == state(b.instances[0]));
+
+    const std::array<gbemu_instance*, 2> both = {b.instances[0], fork};
+    const std::array<uint8_t, 2>         held = {GBEMU_A, GBEMU_A};
+    REQUIRE(gbemu_run(nullptr, both.data(), both.size(), held.data(), 10) == 0);
+    CHECK(state(fork) == state(b.instances[0]));
+
+    const uint8_t mark = 0xA5;
+    REQUIRE(gbemu_write_memory(fork, 0xD000, &mark, 1) == 0);
+
+    std::array<uint8_t, 2> read{};
+    REQUIRE(gbemu_read_memory(both.data(), both.size(), 0xD000, 1, read.data()) == 0);
+    CHECK(read[1] == 0xA5);
+    CHECK(read[0] != read[1]);
+
+    gbemu_destroy(fork);
+}
+
+TEST_CASE("linked instances run through the C API together")
+{
+    rom   game;
+    batch b{game.loaded, 2};
+    auto& inst = b.instances;
+
+    gbemu_link* link = nullptr;
+    CHECK(gbemu_link_create(inst[0], inst[0], 0, &link) == -EINVAL);
+    REQUIRE(gbemu_link_create(inst[0], inst[1], 0, &link) == 0);
+
+    CHECK(gbemu_link_run(link, 0) == -EINVAL);
+    for (uint64_t run = 1; run <= 2; ++run)
+    {
+        REQUIRE(gbemu_link_run(link, 10 * frame_cycles) == 0);
+        CHECK(gbemu_frame_count(inst[0]) == 10 * run);
+        CHECK(gbemu_frame_count(inst[1]) == 10 * run);
+    }
+
+    gbemu_link_destroy(link);
+
+    // unplugged, they run on their own again
+    CHECK(gbemu_run(nullptr, inst.data(), inst.size(), nullptr, 1) == 0);
+}
+
+TEST_CASE("the C API refuses what it can't run")
+{
+    gbemu_rom* loaded = nullptr;
+
+    const std::array<uint8_t, 0x100> short_rom{};
+    CHECK(gbemu_rom_load(short_rom.data(), short_rom.size(), &loaded) == -EINVAL);
+    CHECK(gbemu_rom_open(GBEMU_TESTDATA "/no such rom.gb", &loaded) == -ENOENT);
+    CHECK(loaded == nullptr);
+
+    gbemu_instance* inst = nullptr;
+    CHECK(gbemu_create(nullptr, 0, &inst) == -EINVAL);
+    CHECK(gbemu_fork(nullptr, &inst) == -EINVAL);
+    CHECK(gbemu_runner_create(1, nullptr) == -EINVAL);
+    CHECK(gbemu_run(nullptr, nullptr, 1, nullptr, 1) == -EINVAL);
+    CHECK(gbemu_submit(nullptr, nullptr, 0, nullptr, 1) == -EINVAL);
+    CHECK(gbemu_wait(nullptr) == -EINVAL);
+}
@@ -0,0 +1,71 @@
+#include <doctest/doctest.h>
+
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "checksum.hpp"
+#include "simd.hpp"
+
+namespace
+{
+
+// reference sums a byte at a time, the way the header checksum is defined
+uint16_t reference(const uint8_t* p, size_t len)
+{
+    uint16_t sum = 0;
+    for (size_t i = 0; i < len; ++i) sum = static_cast<uint16_t>(sum + p[i]);
+    return sum;
+}
+
+// supported is every level the running CPU can run, scalar included
+std::vector<gb::simd::level> supported()
+{
+    using enum gb::simd::level;
+
+    const auto best = gb::simd::detect();
+
+    std::vector<gb::simd::level> levels{scalar};
+    if (best == avx2) levels.push_back(sse2);
+    if (best != scalar) levels.push_back(best);
+    return levels;
+}
+
+}
+
+TEST_CASE("sum16 sums the same at every level, over odd lengths and misaligned starts")
+{
+    std::mt19937         rng{38};
+    std::vector<uint8_t> data(4096 + 64);
+    for (auto& byte : data) byte = static_cast<uint8_t>(rng());
+
+    std::vector<size_t> lengths;
+    for (size_t len = 0; len <= 200; ++len) lengths.push_back(len);
+    for (size_t len : {255, 256, 257, 511, 1023, 1025, 2047, 4095, 4096}) lengths.push_back(len);
+
+    for (const auto at : supported())
+    {
+        for (size_t offset = 0; offset < 64; ++offset)
+        {
+            for (const size_t len : lengths)
+            {
+                const uint8_t* p = data.data() + offset;
+                CHECK(gb::checksum::sum16(at, p, len) == reference(p, len));
+            }
+        }
+    }
+
+    CHECK(gb::checksum::sum16(data) == reference(data.data(), data.size()));
+}
+
+TEST_CASE("sum16 wraps at 2^16 the same at every level, however many bytes are summed")
+{
+    // enough for any one lane summing 0xFF bytes to wrap many times over
+    const std::vector<uint8_t> data(300001, 0xFF);
+
+    for (const auto at : supported())
+    {
+        CHECK(gb::checksum::sum16(at, data.data(), data.size()) == reference(data.data(), data.size()));
+        CHECK(gb::checksum::sum16(at, data.data() + 1, data.size() - 1) == reference(data.data() + 1, data.size() - 1));
+    }
+}
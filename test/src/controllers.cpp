@@ -0,0 +1,140 @@
+#include <doctest/doctest.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "cartridge.hpp"
+#include "controllers.hpp"
+#include "mbc1.hpp"
+#include "mbc5.hpp"
+
+namespace
+{
+
+constexpr size_t rom_bank_size = 0x4000;
+
+// banked is a cartridge of the given type with banks ROM banks, each starting with its number (low byte, then high),
+// and the RAM size code ram
+gb::cartridge banked(uint8_t type, size_t banks, uint8_t ram)
+{
+    gb::cartridge cart;
+    cart.data.assign(banks * rom_bank_size, 0);
+    for (size_t bank = 0; bank < banks; ++bank)
+    {
+        cart.data[(bank * rom_bank_size) + 0] = static_cast<uint8_t>(bank);
+        cart.data[(bank * rom_bank_size) + 1] = static_cast<uint8_t>(bank >> 8U);
+    }
+    cart.data[0x147] = type;
+    cart.data[0x149] = ram;
+    return cart;
+}
+
+uint16_t bank_at(memory_bank_controller& mbc, uint16_t addr)
+{
+    return static_cast<uint16_t>(mbc.read(addr) | (mbc.read(addr + 1) << 8U));
+}
+
+}
+
+TEST_CASE("MBC1 switches ROM banks, with the upper bits in either banking mode")
+{
+    const auto cart = banked(0x03, 128, 0x03); // MBC1+RAM+BATTERY, 2 MiB, 32 KiB
+    gb::mbc1   mbc{cart, std::unique_ptr<gb::save_file>{}};
+
+    CHECK(bank_at(mbc, 0x4000) == 1);
+
+    mbc.write(0x2000, 0x00); // bank 0 can't be selected, it's bank 1
+    CHECK(bank_at(mbc, 0x4000) == 1);
+
+    mbc.write(0x2000, 0x15);
+    mbc.write(0x4000, 0x02);
+    CHECK(bank_at(mbc, 0x4000) == 0x55);
+    CHECK(bank_at(mbc, 0x0000) == 0x00);
+
+    mbc.write(0x6000, 0x01); // RAM banking mode, where the upper bits reach 0000 - 3FFF too
+    CHECK(bank_at(mbc, 0x0000) == 0x40);
+    CHECK(bank_at(mbc, 0x4000) == 0x55);
+
+    mbc.write(0x2000, 0x20); // the zero check is on the low 5 bits only
+    CHECK(bank_at(mbc, 0x4000) == 0x41);
+}
+
+TEST_CASE("MBC1 RAM banks follow the banking mode, and are off until enabled")
+{
+    const auto cart = banked(0x03, 4, 0x03);
+    gb::mbc1   mbc{cart, std::unique_ptr<gb::save_file>{}};
+
+    mbc.write(0xA000, 0x11);
+    CHECK(mbc.read(0xA000) == 0xFF);
+
+    mbc.write(0x0000, 0x0A);
+    mbc.write(0xA000, 0x11);
+    mbc.write(0x6000, 0x01);
+    mbc.write(0x4000, 0x02);
+    mbc.write(0xA000, 0x22);
+    CHECK(mbc.read(0xA000) == 0x22);
+
+    mbc.write(0x6000, 0x00); // back to bank 0
+    CHECK(mbc.read(0xA000) == 0x11);
+
+    mbc.write(0x0000, 0x00);
+    CHECK(mbc.read(0xA000) == 0xFF);
+}
+
+TEST_CASE("MBC5 switches 9-bit ROM banks, bank 0 included, and 16 RAM banks")
+{
+    const auto cart = banked(0x1B, 512, 0x04); // MBC5+RAM+BATTERY, 8 MiB, 128 KiB
+    gb::mbc5   mbc{cart, std::unique_ptr<gb::save_file>{}};
+
+    CHECK(bank_at(mbc, 0x4000) == 1);
+
+    mbc.write(0x2000, 0x00);
+    CHECK(bank_at(mbc, 0x4000) == 0);
+
+    mbc.write(0x2000, 0x34);
+    mbc.write(0x3000, 0x01);
+    CHECK(bank_at(mbc, 0x4000) == 0x134);
+    CHECK(bank_at(mbc, 0x0000) == 0);
+
+    mbc.write(0x0000, 0x0A);
+    for (uint8_t bank = 0; bank < 8; ++bank)
+    {
+        mbc.write(0x4000, bank);
+        mbc.write(0xB000, static_cast<uint8_t>(0xA0 + bank));
+    }
+    for (uint8_t bank = 0; bank < 8; ++bank)
+    {
+        mbc.write(0x4000, bank);
+        CHECK(mbc.read(0xB000) == 0xA0 + bank);
+    }
+}
+
+TEST_CASE("MBC1 and MBC5 cartridges with a battery keep their RAM in the save file")
+{
+    for (const uint8_t type : {0x03, 0x1B})
+    {
+        const auto cart = banked(type, 4, 0x03);
+        const auto path =
+            std::filesystem::temp_directory_path() / ("gbemu-battery-" + std::to_string(::getpid()) + ".sav");
+        std::filesystem::remove(path);
+
+        {
+            auto mbc = gb::make_controller(cart, path);
+            mbc->write(0x0000, 0x0A);
+            mbc->write(0xA123, 0x5A);
+        }
+
+        {
+            auto mbc = gb::make_controller(cart, path);
+            mbc->write(0x0000, 0x0A);
+            CHECK(mbc->read(0xA123) == 0x5A);
+        }
+
+        std::filesystem::remove(path);
+    }
+}
@@ -0,0 +1,288 @@
+#include <doctest/doctest.h>
+
+#include <cstdint>
+#include <initializer_list>
+
+#include "cartridge.hpp"
+#include "cpu.hpp"
+#include "instance.hpp"
+#include "memory.hpp"
+
+namespace
+{
+
+constexpr uint8_t Z = 0x80;
+constexpr uint8_t N = 0x40;
+constexpr uint8_t H = 0x20;
+constexpr uint8_t C = 0x10;
+
+// blank is a ROM-only cartridge of nothing but NOPs
+gb::cartridge blank()
+{
+    gb::cartridge cart;
+    cart.data.assign(0x8000, 0);
+    return cart;
+}
+
+// execute runs the instruction in code from WRAM on a blank cartridge, starting from before, returning the registers
+// after it
+registers execute(std::initializer_list<uint8_t> code, registers before)
+{
+    const auto cart = blank();
+    auto       inst = gb::make_instance(cart, gb::model::original);
+    auto&      cpu  = inst->machine();
+
+    uint16_t at = 0xC000;
+    for (auto byte : code) cpu.bus().poke(at++, byte);
+
+    before.pc  = 0xC000;
+    cpu.regs() = before;
+
+    cpu.step();
+    return cpu.regs();
+}
+
+struct alu_case
+{
+    uint8_t op; // taking an n8 operand
+    uint8_t a;
+    uint8_t val;
+    uint8_t flags; // before, only the carry matters
+    uint8_t res;
+    uint8_t expect; // flags after
+};
+
+constexpr uint8_t add_n8 = 0xC6;
+constexpr uint8_t adc_n8 = 0xCE;
+constexpr uint8_t sub_n8 = 0xD6;
+constexpr uint8_t sbc_n8 = 0xDE;
+constexpr uint8_t cp_n8  = 0xFE;
+
+void check_alu(std::initializer_list<alu_case> cases)
+{
+    for (const auto& c : cases)
+    {
+        registers before{};
+        before.A = c.a;
+        before.F = c.flags;
+
+        const auto after = execute({c.op, c.val}, before);
+        CHECK(after.A == c.res);
+        CHECK(after.F == c.expect);
+    }
+}
+
+}
+
+TEST_CASE("ADD sets Z on wrapping to zero, and H and C from bits 3 and 7")
+{
+    check_alu({
+        {add_n8, 0x3A, 0xC6, 0, 0x00, Z | H | C},
+        {add_n8, 0x3C, 0xFF, 0, 0x3B, H | C    },
+        {add_n8, 0x3C, 0x12, 0, 0x4E, 0        },
+        {add_n8, 0x08, 0x08, 0, 0x10, H        },
+        {add_n8, 0x80, 0x80, 0, 0x00, Z | C    },
+        {add_n8, 0x00, 0x00, C, 0x00, Z        }, // the carry flag isn't added
+    });
+}
+
+TEST_CASE("ADC adds the carry, carrying out of both nibbles")
+{
+    check_alu({
+        {adc_n8, 0xE1, 0x0F, C, 0xF1, H        },
+        {adc_n8, 0xE1, 0x3B, C, 0x1D, C        },
+        {adc_n8, 0xE1, 0x1E, C, 0x00, Z | H | C},
+        {adc_n8, 0x0F, 0x00, C, 0x10, H        }, // only the carry carries
+        {adc_n8, 0xFF, 0x00, C, 0x00, Z | H | C},
+        {adc_n8, 0x0F, 0x00, 0, 0x0F, 0        },
+    });
+}
+
+TEST_CASE("SUB and CP borrow from bits 4 and 8")
+{
+    check_alu({
+        {sub_n8, 0x3E, 0x3E, 0, 0x00, Z | N    },
+        {sub_n8, 0x3E, 0x0F, 0, 0x2F, N | H    },
+        {sub_n8, 0x3E, 0x40, 0, 0xFE, N | C    },
+        {sub_n8, 0x00, 0x01, C, 0xFF, N | H | C}, // the carry flag isn't subtracted
+        {cp_n8,  0x3C, 0x2F, 0, 0x3C, N | H    },
+        {cp_n8,  0x3C, 0x3C, 0, 0x3C, Z | N    },
+        {cp_n8,  0x3C, 0x40, 0, 0x3C, N | C    },
+    });
+}
+
+TEST_CASE("SBC subtracts the carry, borrowing from both nibbles")
+{
+    check_alu({
+        {sbc_n8, 0x10, 0x01, 0, 0x0F, N | H        },
+        {sbc_n8, 0x10, 0x01, C, 0x0E, N | H        },
+        {sbc_n8, 0x3B, 0x2A, C, 0x10, N            },
+        {sbc_n8, 0x3B, 0x3A, C, 0x00, Z | N        },
+        {sbc_n8, 0x3B, 0x4F, C, 0xEB, N | H | C    },
+        {sbc_n8, 0x00, 0x00, C, 0xFF, N | H | C    }, // only the carry borrows
+        {sbc_n8, 0x00, 0xFF, C, 0x00, Z | N | H | C}, // borrows 0x100, back to zero
+        {sbc_n8, 0x0F, 0x0F, C, 0xFF, N | H | C    },
+        {sbc_n8, 0x80, 0x7F, 0, 0x01, N | H        },
+        {sbc_n8, 0x42, 0x42, 0, 0x00, Z | N        },
+    });
+}
+
+TEST_CASE("INC and DEC set Z on wrapping, and leave the carry be")
+{
+    struct
+    {
+        uint8_t op;
+        uint8_t a;
+        uint8_t flags;
+        uint8_t res;
+        uint8_t expect;
+    } const cases[] = {
+        {0x3C, 0xFF, 0, 0x00, Z | H    }, // INC A
+        {0x3C, 0x0F, C, 0x10, H | C    },
+        {0x3C, 0x10, 0, 0x11, 0        },
+        {0x3D, 0x01, 0, 0x00, Z | N    }, // DEC A
+        {0x3D, 0x10, C, 0x0F, N | H | C},
+        {0x3D, 0x00, 0, 0xFF, N | H    },
+    };
+
+    for (const auto& c : cases)
+    {
+        registers before{};
+        before.A = c.a;
+        before.F = c.flags;
+
+        const auto after = execute({c.op}, before);
+        CHECK(after.A == c.res);
+        CHECK(after.F == c.expect);
+    }
+}
+
+TEST_CASE("ADD HL,rr carries out of bits 11 and 15, leaving Z be")
+{
+    struct
+    {
+        uint16_t hl;
+        uint16_t bc;
+        uint8_t  flags;
+        uint16_t res;
+        uint8_t  expect;
+    } const cases[] = {
+        {0x8A23, 0x0605, 0, 0x9028, H    },
+        {0x8A23, 0x8A23, 0, 0x1446, H | C},
+        {0x0FFF, 0x0001, Z, 0x1000, Z | H},
+        {0xFFFF, 0x0001, N, 0x0000, H | C},
+        {0x00FF, 0x0001, 0, 0x0100, 0    }, // bit 7 doesn't count
+    };
+
+    for (const auto& c : cases)
+    {
+        registers before{};
+        before.HL = c.hl;
+        before.BC = c.bc;
+        before.F  = c.flags;
+
+        const auto after = execute({0x09}, before); // ADD HL,BC
+        CHECK(after.HL == c.res);
+        CHECK(after.F == c.expect);
+    }
+}
+
+TEST_CASE("rotates: RLC and RRC copy the bit around, RL and RR go through the carry")
+{
+    struct
+    {
+        uint8_t op; // prefixed with 0xCB
+        uint8_t a;
+        uint8_t flags;
+        uint8_t res;
+        uint8_t expect;
+    } const cases[] = {
+        {0x07, 0x85, 0, 0x0B, C    }, // RLC A
+        {0x07, 0x00, C, 0x00, Z    },
+        {0x17, 0x80, 0, 0x00, Z | C}, // RL A
+        {0x17, 0x11, C, 0x23, 0    },
+        {0x0F, 0x01, 0, 0x80, C    }, // RRC A
+        {0x0F, 0x00, C, 0x00, Z    },
+        {0x1F, 0x01, 0, 0x00, Z | C}, // RR A
+        {0x1F, 0x8A, C, 0xC5, 0    },
+    };
+
+    for (const auto& c : cases)
+    {
+        registers before{};
+        before.A = c.a;
+        before.F = c.flags | N | H;
+
+        const auto after = execute({0xCB, c.op}, before);
+        CHECK(after.A == c.res);
+        CHECK(after.F == c.expect);
+    }
+}
+
+TEST_CASE("RLCA, RLA, RRCA and RRA rotate like the prefixed forms, but always clear Z")
+{
+    struct
+    {
+        uint8_t op;
+        uint8_t a;
+        uint8_t flags;
+        uint8_t res;
+        uint8_t expect;
+    } const cases[] = {
+        {0x07, 0x85, 0, 0x0B, C}, // RLCA
+        {0x07, 0x00, Z, 0x00, 0},
+        {0x17, 0x80, 0, 0x00, C}, // RLA
+        {0x17, 0x95, C, 0x2B, C},
+        {0x0F, 0x3B, 0, 0x9D, C}, // RRCA
+        {0x0F, 0x00, Z, 0x00, 0},
+        {0x1F, 0x01, 0, 0x00, C}, // RRA
+        {0x1F, 0x81, C, 0xC0, C},
+    };
+
+    for (const auto& c : cases)
+    {
+        registers before{};
+        before.A = c.a;
+        before.F = c.flags | N | H;
+
+        const auto after = execute({c.op}, before);
+        CHECK(after.A == c.res);
+        CHECK(after.F == c.expect);
+    }
+}
+
+TEST_CASE("LD HL,SP+e8 and ADD SP,e8 add signed, with H and C from the low byte")
+{
+    struct
+    {
+        uint16_t sp;
+        uint8_t  e8;
+        uint16_t res;
+        uint8_t  expect;
+    } const cases[] = {
+        {0xFFF8, 0x08, 0x0000, H | C},
+        {0x0000, 0xFF, 0xFFFF, 0    }, // -1
+        {0x00FF, 0x01, 0x0100, H | C},
+        {0x1234, 0x80, 0x11B4, 0    }, // -128
+        {0xC0FE, 0xFE, 0xC0FC, H | C}, // -2
+        {0xC008, 0x08, 0xC010, H    },
+    };
+
+    for (const auto& c : cases)
+    {
+        registers before{};
+        before.sp = c.sp;
+        before.HL = 0x5555;
+        before.F  = Z | N;
+
+        const auto ld = execute({0xF8, c.e8}, before); // LD HL,SP+e8
+        CHECK(ld.HL == c.res);
+        CHECK(ld.sp == c.sp);
+        CHECK(ld.F == c.expect);
+
+        const auto add = execute({0xE8, c.e8}, before); // ADD SP,e8
+        CHECK(add.sp == c.res);
+        CHECK(add.HL == 0x5555);
+        CHECK(add.F == c.expect);
+    }
+}
@@ -0,0 +1,165 @@
+#include <doctest/doctest.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <initializer_list>
+#include <iterator>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include <unistd.h>
+
+#include "cartridge.hpp"
+#include "code_map.hpp"
+#include "disassembler.hpp"
+
+namespace
+{
+
+std::string disassembled(uint16_t pc, std::initializer_list<uint8_t> code, size_t& len)
+{
+    const std::vector<uint8_t> bytes{code};
+
+    std::string out;
+    len = gb::disassemble(pc, bytes, out);
+    return out;
+}
+
+std::filesystem::path scratch(const std::string& name, const std::string& ext)
+{
+    return std::filesystem::temp_directory_path() / (name + "-" + std::to_string(::getpid()) + ext);
+}
+
+// banked is a 64 KiB MBC1 ROM of illegal opcodes, apart from code at the entry point that calls into bank 2, once with
+// it selected and once with whatever was read from 0200 selected, then loops forever
+gb::cartridge banked()
+{
+    gb::cartridge cart;
+    cart.data.assign(0x10000, 0xD3);
+    cart.data[0x147] = 0x01;
+
+    const std::vector<uint8_t> entry = {
+        0x3E, 0x02,       // 0100 LD A,$02
+        0xEA, 0x00, 0x20, // 0102 LD ($2000),A
+        0xCD, 0x00, 0x40, // 0105 CALL $4000
+        0xFA, 0x00, 0x02, // 0108 LD A,($0200)
+        0xEA, 0x00, 0x20, // 010B LD ($2000),A
+        0xCD, 0x00, 0x40, // 010E CALL $4000
+        0x18, 0xFE,       // 0111 JR $0111
+    };
+    std::copy(entry.begin(), entry.end(), cart.data.begin() + 0x100);
+
+    cart.data[0x8000] = 0xC9; // RET, in bank 2
+    return cart;
+}
+
+}
+
+TEST_CASE("instructions disassemble to their mnemonic and operands")
+{
+    struct
+    {
+        uint16_t                       pc;
+        std::initializer_list<uint8_t> code;
+        const char*                    text;
+    } const cases[] = {
+        {0x0000, {0x00},             "NOP"            },
+        {0x0000, {0x3E, 0x42},       "LD A, $42"      },
+        {0x0000, {0x21, 0x34, 0x12}, "LD HL, $1234"   },
+        {0x0000, {0xEA, 0x00, 0x20}, "LD ($2000), A"  },
+        {0x0000, {0x08, 0x00, 0xC0}, "LD ($C000), SP" },
+        {0x0000, {0xE0, 0x80},       "LDH ($FF80), A" },
+        {0x0000, {0xF0, 0x44},       "LDH A, ($FF44)" },
+        {0x0000, {0xE2},             "LD ($FF00+C), A"},
+        {0x0000, {0x2A},             "LD A, (HL+)"    },
+        {0x0000, {0x32},             "LD (HL-), A"    },
+        {0x0150, {0x18, 0xFE},       "JR $0150"       }, // relative to the end of the instruction
+        {0x0150, {0x20, 0x05},       "JR NZ, $0157"   },
+        {0x0000, {0xC3, 0x50, 0x01}, "JP $0150"       },
+        {0x0000, {0xE9},             "JP HL"          },
+        {0x0000, {0xDC, 0x00, 0x40}, "CALL C, $4000"  },
+        {0x0000, {0xC9},             "RET"            },
+        {0x0000, {0xC0},             "RET NZ"         },
+        {0x0000, {0xFF},             "RST $38"        },
+        {0x0000, {0xE8, 0xFE},       "ADD SP, -$02"   },
+        {0x0000, {0xF8, 0x05},       "LD HL, SP+$05"  },
+        {0x0000, {0xF8, 0x80},       "LD HL, SP-$80"  },
+        {0x0000, {0xF5},             "PUSH AF"        },
+        {0x0000, {0xCB, 0x37},       "SWAP A"         },
+        {0x0000, {0xCB, 0x7C},       "BIT 7, H"       },
+        {0x0000, {0xCB, 0xC6},       "SET 0, (HL)"    },
+        {0x0000, {0xD3},             "DB $D3"         }, // not an instruction
+    };
+
+    for (const auto& c : cases)
+    {
+        size_t     len  = 0;
+        const auto text = disassembled(c.pc, c.code, len);
+        CHECK(text == c.text);
+        CHECK(len == c.code.size());
+    }
+}
+
+TEST_CASE("instructions cut short aren't disassembled")
+{
+    for (const auto code : {std::initializer_list<uint8_t>{},
+                            std::initializer_list<uint8_t>{0xCB},
+                            std::initializer_list<uint8_t>{0x3E},
+                            std::initializer_list<uint8_t>{0xC3, 0x50}})
+    {
+        size_t len = 1;
+        CHECK(disassembled(0, code, len).empty());
+        CHECK(len == 0);
+    }
+}
+
+TEST_CASE("the code map follows calls into the bank selected, and counts those made with no bank known")
+{
+    gb::code_map map;
+    gb::analyze(banked(), map);
+
+    using enum gb::byte_kind;
+    CHECK(map.kinds[0x0100] == code);
+    CHECK(map.kinds[0x0101] == operand);
+    CHECK(map.kinds[0x0111] == code);
+    CHECK(map.kinds[0x0200] == data);
+    CHECK(map.kinds[0x8000] == code); // bank 2
+    CHECK(map.kinds[0x4000] == unknown);
+    CHECK(map.kinds[0x0000] == unknown); // RST 00 is never reached, and holds an illegal opcode anyway
+
+    CHECK(map.instructions == 8);
+    CHECK(map.unresolved == 1);
+
+    const auto sym = scratch("code-map", ".sym");
+    REQUIRE_FALSE(gb::save_symbols(sym, map));
+
+    std::ifstream     file{sym};
+    const std::string symbols{std::istreambuf_iterator<char>{file}, {}};
+    std::filesystem::remove(sym);
+
+    CHECK(symbols.starts_with("00:0000 rst_00\n"));
+    CHECK(symbols.find("00:0040 int_vblank\n") != std::string::npos);
+    CHECK(symbols.find("00:0100 entry\n00:0111 jump_00_0111\n02:4000 sub_02_4000\n") != std::string::npos);
+}
+
+TEST_CASE("a code map saved and loaded again has the same kind for every byte")
+{
+    gb::code_map map;
+    gb::analyze(banked(), map);
+
+    const auto path = scratch("code-map", ".map");
+    REQUIRE_FALSE(gb::save_code_map(path, map));
+
+    gb::code_map loaded;
+    REQUIRE_FALSE(gb::load_code_map(path, loaded));
+    CHECK(loaded.kinds == map.kinds);
+    CHECK(loaded.instructions == map.instructions);
+
+    // cut off partway through the kinds
+    std::filesystem::resize_file(path, 16 + 100);
+    CHECK(gb::load_code_map(path, loaded) == std::errc::illegal_byte_sequence);
+    std::filesystem::remove(path);
+}
@@ -0,0 +1,147 @@
+#include <doctest/doctest.h>
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+#include "cartridge.hpp"
+#include "cpu.hpp"
+#include "expression.hpp"
+#include "instance.hpp"
+#include "memory.hpp"
+
+namespace
+{
+
+// blank is a ROM-only cartridge of nothing but NOPs
+gb::cartridge blank()
+{
+    gb::cartridge cart;
+    cart.data.assign(0x8000, 0);
+    return cart;
+}
+
+// machine is somewhere for expressions to read registers and memory from
+struct machine
+{
+    machine()
+        : cart{blank()}
+        , inst{gb::make_instance(cart, gb::model::original)}
+    {
+        auto& cpu = inst->machine();
+
+        registers r{};
+        r.AF = 0x1080;
+        r.BC = 0x0203;
+        r.HL = 0xC000;
+        r.sp = 0xDFF0;
+        r.pc = 0x0150;
+        cpu.regs() = r;
+
+        cpu.bus().poke(0xC000, 0x05);
+        cpu.bus().poke(0xC005, 0xAA);
+    }
+
+    uint32_t eval(std::string_view text, uint8_t value = 0)
+    {
+        gb::expression e;
+        REQUIRE_FALSE(gb::expression::parse(text, e));
+        return e.evaluate(inst->machine().regs(), inst->machine().bus(), value);
+    }
+
+    gb::cartridge    cart;
+    gb::instance_ptr inst;
+};
+
+}
+
+TEST_CASE("expression operators bind as in C")
+{
+    machine m;
+
+    struct
+    {
+        std::string_view text;
+        uint32_t         expect;
+    } const cases[] = {
+        {"1 + 2 == 3",                 1}, // + before ==
+        {"1 | 2 == 2",                 1}, // == before |, so 1 | 1
+        {"(1 | 2) == 2",               0},
+        {"2 & 3 ^ 1",                  3}, // & before ^
+        {"1 ^ 3 | 4",                  6}, // ^ before |
+        {"1 || 1 && 0",                1}, // && before ||
+        {"3 < 5 == 1",                 1}, // < before ==
+        {"5 - 2 - 1",                  2}, // left to right
+        {"1 - -1",                     2},
+        {"!0 + 1",                     2}, // unary first
+        {"!!7",                        1},
+        {"~0 + 1",                     0}, // 32 bits wide, wrapping
+        {"-1 == ~0",                   1},
+        {"2 <= 2 && 2 >= 3",           0},
+        {"2 != 3 & 1",                 1}, // != before &
+        {"$FF == 0xff && 0XFF == 255", 1},
+        {"65535 + 1",                  0x10000},
+    };
+
+    for (const auto& c : cases) CHECK(m.eval(c.text) == c.expect);
+}
+
+TEST_CASE("expressions read registers, memory and the watched value")
+{
+    machine m;
+
+    CHECK(m.eval("A == $10 && [HL] != 0") == 1);
+    CHECK(m.eval("a == 0x10 && f == $80") == 1); // in any case
+    CHECK(m.eval("BC == $0203 && B == 2 && C == 3") == 1);
+    CHECK(m.eval("[HL + [HL]]") == 0xAA);
+    CHECK(m.eval("SP + 1") == 0xDFF1);
+    CHECK(m.eval("pc") == 0x0150);
+    CHECK(m.eval("value == $42", 0x42) == 1);
+    CHECK(m.eval("   ") == 1); // empty is always true
+}
+
+TEST_CASE("malformed expressions are refused")
+{
+    for (const std::string_view text : {
+             "1 +",
+             "(1",
+             "1)",
+             "[HL",
+             "1 2",
+             "A ==",
+             "IX == 0",
+             "$",
+             "0x",
+             "$ FF",
+             "$10000",
+             "65536",
+             "1 === 2",
+             "1 | | 2",
+             "! ",
+             "#1",
+         })
+    {
+        gb::expression e;
+        CHECK(gb::expression::parse(text, e) == std::errc::invalid_argument);
+    }
+}
+
+TEST_CASE("expressions nested too deep to evaluate are refused")
+{
+    // every operand waits on the stack for the one after it
+    std::string deep = "1";
+    for (int i = 0; i < 16; ++i) deep = "1 + (" + deep + ")";
+
+    gb::expression e;
+    CHECK(gb::expression::parse(deep, e) == std::errc::invalid_argument);
+
+    // as are parentheses nested deeper than anyone would type
+    const std::string parens = std::string(40, '(') + "1" + std::string(40, ')');
+    CHECK(gb::expression::parse(parens, e) == std::errc::invalid_argument);
+
+    // while ones that chain to the left evaluate with one on the stack at a time
+    std::string chain = "0";
+    for (int i = 0; i < 100; ++i) chain += " + 1";
+    CHECK(machine{}.eval(chain) == 100);
+}
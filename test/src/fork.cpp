@@ -0,0 +1,124 @@
+#include <doctest/doctest.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "instance.hpp"
+#include "instance_pool.hpp"
+#include "memory.hpp"
+#include "state.hpp"
+#include "testdata.hpp"
+
+namespace
+{
+
+void run(gb::instance& inst, uint64_t frames, uint64_t seed)
+{
+    for (uint64_t frame = 0; frame < frames; ++frame)
+    {
+        inst.machine().bus().input().set(testdata::buttons(frame, seed));
+        inst.machine().run_frame();
+    }
+}
+
+std::vector<uint8_t> save(const gb::instance& inst)
+{
+    std::vector<uint8_t> state(gb::state_size(inst.machine()));
+    REQUIRE_FALSE(gb::save_state(inst.machine(), state));
+    return state;
+}
+
+}
+
+TEST_CASE("a fork starts where its parent is, and writes stay its own")
+{
+    const auto cart  = testdata::rom("pokemon_crystal_usa_eur.gbc");
+    const auto model = testdata::model_for(cart);
+
+    gb::instance_pool pool{cart};
+    auto              parent = pool.acquire(model);
+    run(*parent, 120, 1);
+
+    auto fork    = parent->fork();
+    auto sibling = parent->fork();
+    CHECK(testdata::state_hash(fork->machine()) == testdata::state_hash(parent->machine()));
+    CHECK(testdata::state_hash(sibling->machine()) == testdata::state_hash(parent->machine()));
+
+    auto& parent_bus  = parent->machine().bus();
+    auto& fork_bus    = fork->machine().bus();
+    auto& sibling_bus = sibling->machine().bus();
+
+    // WRAM, both ways
+    const uint8_t wram = parent_bus.read(0xC123);
+    fork_bus.write(0xC123, static_cast<uint8_t>(wram ^ 0xFF));
+    CHECK(fork_bus.read(0xC123) == static_cast<uint8_t>(wram ^ 0xFF));
+    CHECK(parent_bus.read(0xC123) == wram);
+    CHECK(sibling_bus.read(0xC123) == wram);
+
+    parent_bus.write(0xC456, static_cast<uint8_t>(parent_bus.read(0xC456) + 1));
+    CHECK(fork_bus.read(0xC456) == sibling_bus.read(0xC456));
+    CHECK(fork_bus.read(0xC456) != parent_bus.read(0xC456));
+
+    // cartridge RAM, enabled and banked on each
+    for (auto* bus : {&parent_bus, &fork_bus, &sibling_bus})
+    {
+        bus->write(0x0000, 0x0A);
+        bus->write(0x4000, 0x01);
+    }
+    const uint8_t cart_ram = parent_bus.read(0xA010);
+    sibling_bus.write(0xA010, static_cast<uint8_t>(cart_ram ^ 0x55));
+    CHECK(sibling_bus.read(0xA010) == static_cast<uint8_t>(cart_ram ^ 0x55));
+    CHECK(parent_bus.read(0xA010) == cart_ram);
+    CHECK(fork_bus.read(0xA010) == cart_ram);
+}
+
+TEST_CASE("a fork runs like a machine loaded from its parent's state")
+{
+    for (const auto* name : {"flappyboy.gb", "pokemon_crystal_usa_eur.gbc"})
+    {
+        const auto cart  = testdata::rom(name);
+        const auto model = testdata::model_for(cart);
+
+        gb::instance_pool pool{cart};
+        auto              parent = pool.acquire(model);
+        run(*parent, 150, 2);
+        for (int i = 0; i < 3000; ++i) parent->machine().step(); // mid-frame
+
+        auto fork   = parent->fork();
+        auto loaded = pool.acquire(model);
+        REQUIRE_FALSE(gb::load_state(loaded->machine(), save(*parent)));
+
+        // the parent takes another path meanwhile, which mustn't show up in the fork
+        run(*parent, 60, 3);
+        run(*fork, 60, 4);
+        run(*loaded, 60, 4);
+        CHECK(testdata::state_hash(fork->machine()) == testdata::state_hash(loaded->machine()));
+        CHECK(testdata::state_hash(fork->machine()) != testdata::state_hash(parent->machine()));
+    }
+}
+
+TEST_CASE("a forked instance's state saves and loads back")
+{
+    const auto cart  = testdata::rom("pokemon_crystal_usa_eur.gbc");
+    const auto model = testdata::model_for(cart);
+
+    auto parent = gb::make_instance(cart, model);
+    run(*parent, 100, 5);
+
+    // saved while most of its RAM is still shared with the parent
+    auto       fork  = parent->fork();
+    const auto state = save(*fork);
+
+    auto fresh = gb::make_instance(cart, model);
+    REQUIRE_FALSE(gb::load_state(fresh->machine(), state));
+    CHECK(save(*fresh) == state);
+
+    // and loaded back into the fork once it has moved on, replacing pages both shared and its own
+    run(*fork, 30, 6);
+    REQUIRE_FALSE(gb::load_state(fork->machine(), state));
+    CHECK(save(*fork) == state);
+
+    run(*fork, 30, 7);
+    run(*fresh, 30, 7);
+    CHECK(testdata::state_hash(fork->machine()) == testdata::state_hash(fresh->machine()));
+}
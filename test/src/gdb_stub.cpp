@@ -0,0 +1,217 @@
+#include <doctest/doctest.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "cartridge.hpp"
+#include "cpu.hpp"
+#include "debugger.hpp"
+#include "gdb_stub.hpp"
+#include "instance.hpp"
+#include "memory.hpp"
+
+namespace
+{
+
+// blank is a ROM-only cartridge of nothing but NOPs
+gb::cartridge blank()
+{
+    gb::cartridge cart;
+    cart.data.assign(0x8000, 0);
+    return cart;
+}
+
+std::string checksum(std::string_view payload)
+{
+    uint8_t sum = 0;
+    for (const char c : payload) sum += static_cast<uint8_t>(c);
+
+    char buf[3]{};
+    std::snprintf(buf, sizeof(buf), "%02x", sum);
+    return buf;
+}
+
+// session is a running instance with a stub serving it, and a client connected to the stub
+class session
+{
+public:
+    session()
+        : cart{blank()}
+        , inst{gb::make_instance(cart, gb::model::original)}
+        , debug{inst->machine()}
+        , stub{inst->machine(), debug}
+        , path{std::filesystem::temp_directory_path() / ("gdb-" + std::to_string(::getpid()) + ".sock")}
+    {
+        REQUIRE_FALSE(stub.listen_unix(path));
+
+        // as the frontend runs it, handing it over whenever it stops
+        runner = std::jthread{[this](const std::stop_token& stop)
+                              {
+                                  while (!stop.stop_requested())
+                                  {
+                                      inst->machine().run_for(10000);
+                                      (void)stub.hold(stop);
+                                  }
+                              }};
+
+        fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        REQUIRE(fd >= 0);
+
+        // so a stub that never answers fails the test, rather than hanging it
+        timeval timeout{.tv_sec = 5, .tv_usec = 0};
+        ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        std::memcpy(addr.sun_path, path.c_str(), path.native().size());
+        REQUIRE(::connect(fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) == 0);
+    }
+
+    session(const session&)            = delete;
+    session& operator=(const session&) = delete;
+
+    ~session()
+    {
+        ::close(fd);
+        stub.stop();
+        runner.request_stop();
+        runner.join();
+    }
+
+    void send_raw(std::string_view data) const
+    {
+        REQUIRE(::send(fd, data.data(), data.size(), 0) == static_cast<ssize_t>(data.size()));
+    }
+
+    void send(std::string_view payload) const
+    {
+        std::string packet = "$";
+        packet            += payload;
+        packet            += '#';
+        packet            += checksum(payload);
+        send_raw(packet);
+    }
+
+    // next is the next character from the stub, or 0 if it has nothing more to say
+    char next() const
+    {
+        char c = 0;
+        return ::recv(fd, &c, 1, 0) == 1 ? c : '\0';
+    }
+
+    // receive reads the next packet from the stub, checking it's framed and checksummed properly
+    std::string receive() const
+    {
+        REQUIRE(next() == '$');
+
+        std::string payload;
+        for (char c = next(); c != '#'; c = next())
+        {
+            REQUIRE(c != '\0');
+            payload += c;
+        }
+
+        std::string sum{next()};
+        sum += next();
+        CHECK(sum == checksum(payload));
+        return payload;
+    }
+
+    // exchange sends payload, expecting it to be acknowledged, and returns the reply
+    std::string exchange(std::string_view payload) const
+    {
+        send(payload);
+        CHECK(next() == '+');
+        return receive();
+    }
+
+    gb::cpu& machine() { return inst->machine(); }
+
+private:
+    gb::cartridge         cart;
+    gb::instance_ptr      inst;
+    gb::debugger          debug;
+    gb::gdb_stub          stub;
+    std::filesystem::path path;
+    std::jthread          runner;
+    int                   fd = -1;
+};
+
+}
+
+TEST_CASE("the gdb stub acknowledges packets with a good checksum, and asks for others again")
+{
+    session client;
+
+    // attaching stops the instance, as clients expect
+    CHECK(client.exchange("?") == "S02");
+
+    client.send_raw("$?#00");
+    CHECK(client.next() == '-');
+
+    // the one after is served as usual
+    CHECK(client.exchange("g").size() == 24);
+
+    // and with acknowledgements off, replies come straight back
+    CHECK(client.exchange("QStartNoAckMode") == "OK");
+    client.send("qAttached");
+    CHECK(client.receive() == "1");
+}
+
+TEST_CASE("the gdb stub unescapes binary data written to memory")
+{
+    session client;
+
+    // # $ } and * frame packets, so are sent escaped
+    using namespace std::string_view_literals;
+    const auto data = "}\x03}\x04}]}\x0a\x00\x41"sv;
+
+    CHECK(client.exchange("XC000,6:" + std::string{data}) == "OK");
+    CHECK(client.exchange("mC000,6") == "23247d2a0041");
+
+    // probing for X support writes nothing
+    CHECK(client.exchange("XC000,0:") == "OK");
+
+    // the data must be the length given, and not end partway through an escape
+    CHECK(client.exchange("XC000,2:" + std::string{data.substr(0, 3)}) == "E01");
+    CHECK(client.exchange("XC000,1:}") == "E01");
+    CHECK(client.exchange("XC000,1:AB") == "E01");
+    CHECK(client.machine().bus().peek(0xC000) == 0x23);
+}
+
+TEST_CASE("the gdb stub sends its target description in as many pieces as asked for")
+{
+    session client;
+
+    std::string xml;
+    for (;;)
+    {
+        char range[32]{};
+        std::snprintf(range, sizeof(range), "%zx,40", xml.size());
+
+        const auto reply = client.exchange(std::string{"qXfer:features:read:target.xml:"} + range);
+        REQUIRE(!reply.empty());
+        REQUIRE((reply[0] == 'm' || reply[0] == 'l'));
+
+        xml += reply.substr(1);
+        if (reply[0] == 'l') break;
+    }
+
+    CHECK(xml.starts_with("<?xml"));
+    CHECK(xml.find("<architecture>gbz80</architecture>") != std::string::npos);
+    CHECK(xml.ends_with("</target>\n"));
+}
+
+#endif
@@ -0,0 +1,91 @@
+#include <doctest/doctest.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include <unistd.h>
+
+#include "golden.hpp"
+#include "hash.hpp"
+
+namespace
+{
+
+// pattern is len bytes that aren't all alike
+std::vector<uint8_t> pattern(size_t len)
+{
+    std::vector<uint8_t> data(len);
+    for (size_t i = 0; i < len; ++i) data[i] = static_cast<uint8_t>((i * 31) + 7);
+    return data;
+}
+
+std::filesystem::path scratch(const std::string& name)
+{
+    return std::filesystem::temp_directory_path() / (name + "-" + std::to_string(::getpid()) + ".golden");
+}
+
+}
+
+TEST_CASE("hash64 gives the same answers everywhere, whichever vector unit runs it")
+{
+    struct
+    {
+        size_t   len;
+        uint64_t unseeded;
+        uint64_t seeded; // with 0x1234
+    } const cases[] = {
+        {0,    0xC9DB78ECCEBC0B71, 0xABC09DE156F9829A},
+        {3,    0xB365A0710407055D, 0xF9F2CF4843838203},
+        {64,   0x52191830B8C0B731, 0xFD0098E8B966430D}, // a single stripe
+        {1000, 0xCD725FB93731D00C, 0xB6AEBCE6459B6BAF},
+        {4113, 0xF0D9C3D4D90829A8, 0xEC77956F97DD1F79}, // whole blocks, then a tail
+    };
+
+    for (const auto& c : cases)
+    {
+        const auto data = pattern(c.len);
+        CHECK(gb::hash::hash64(data) == c.unseeded);
+        CHECK(gb::hash::hash64(data, 0x1234) == c.seeded);
+    }
+}
+
+TEST_CASE("a golden sequence saves and loads back as it was")
+{
+    const auto path = scratch("gbemu-golden");
+
+    gb::golden out{.rom_hash = 0x0123456789ABCDEF, .input_hash = 0xFEDCBA9876543210, .frames = {}};
+    for (uint64_t i = 0; i < 300; ++i) out.frames.push_back(gb::hash::hash64(pattern(i)));
+    REQUIRE_FALSE(gb::save_golden(path, out));
+
+    gb::golden in;
+    REQUIRE_FALSE(gb::load_golden(path, in));
+    CHECK(in.rom_hash == out.rom_hash);
+    CHECK(in.input_hash == out.input_hash);
+    CHECK(in.frames == out.frames);
+
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("a truncated golden sequence is refused")
+{
+    const auto path = scratch("gbemu-truncated");
+
+    gb::golden out{.rom_hash = 1, .input_hash = 2, .frames = {10, 20, 30}};
+    REQUIRE_FALSE(gb::save_golden(path, out));
+    const auto size = std::filesystem::file_size(path);
+
+    // part way through the last frame, at the last whole frame, and part way through the header
+    for (const auto cut : {size - 3, size - 8, uintmax_t{20}})
+    {
+        REQUIRE_FALSE(gb::save_golden(path, out));
+        std::filesystem::resize_file(path, cut);
+
+        gb::golden in;
+        CHECK(gb::load_golden(path, in) == std::errc::illegal_byte_sequence);
+    }
+
+    std::filesystem::remove(path);
+}
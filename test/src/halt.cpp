@@ -0,0 +1,48 @@
+#include <doctest/doctest.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "cartridge.hpp"
+#include "cpu.hpp"
+#include "instance.hpp"
+#include "memory.hpp"
+
+namespace
+{
+
+constexpr uint64_t frame_cycles = 154 * 456;
+
+}
+
+TEST_CASE("VBlank wakes the cpu from HALT once a frame")
+{
+    // a blank ROM-only cartridge, with just RETI at the VBlank handler
+    gb::cartridge cart;
+    cart.data.assign(0x8000, 0);
+    cart.data[0x40] = 0xD9; // RETI
+
+    auto  inst = gb::make_instance(cart, gb::model::original);
+    auto& cpu  = inst->machine();
+
+    // EI; loop: HALT; JR loop
+    cpu.bus().poke(0xC000, 0xFB);
+    cpu.bus().poke(0xC001, 0x76);
+    cpu.bus().poke(0xC002, 0x18);
+    cpu.bus().poke(0xC003, 0xFD);
+
+    cpu.bus().interrupts().write_flags(0x00);
+    cpu.bus().interrupts().write_enable(static_cast<uint8_t>(gb::interrupt::vblank));
+    cpu.regs().pc = 0xC000;
+
+    // when the handler is entered
+    std::vector<uint64_t> wakes;
+    while (cpu.elapsed() < 10 * frame_cycles)
+    {
+        cpu.step();
+        if (cpu.regs().pc == 0x40) wakes.push_back(cpu.elapsed());
+    }
+
+    REQUIRE(wakes.size() >= 9);
+    for (size_t i = 1; i < wakes.size(); ++i) CHECK(wakes[i] - wakes[i - 1] == frame_cycles);
+}
@@ -0,0 +1,63 @@
+#include <doctest/doctest.h>
+
+#include <cstdint>
+#include <memory>
+
+#include "controllers.hpp"
+#include "instance.hpp"
+#include "memory.hpp"
+#include "testdata.hpp"
+
+TEST_CASE("an instance is one cache-line aligned block")
+{
+    static_assert(alignof(gb::instance) == gb::instance::alignment);
+
+    for (const auto* name : {"flappyboy.gb", "pokemon_crystal_usa_eur.gbc"})
+    {
+        const auto cart = testdata::rom(name);
+        REQUIRE(cart.loaded());
+
+        const size_t bytes = gb::instance::bytes(cart);
+        CHECK(bytes % gb::instance::alignment == 0);
+        CHECK(bytes >= sizeof(gb::instance) + cart.ram_size());
+        CHECK(bytes < sizeof(gb::instance) + cart.ram_size() + gb::instance::alignment);
+
+        // the machine, its memory and the cartridge RAM behind them all lie in the block
+        auto        inst  = gb::make_instance(cart, testdata::model_for(cart));
+        const auto* start = reinterpret_cast<const uint8_t*>(inst.get());
+
+        auto in_block = [&](const void* p, size_t len)
+        {
+            const auto* at = static_cast<const uint8_t*>(p);
+            return at >= start && at + len <= start + bytes;
+        };
+
+        CHECK(reinterpret_cast<uintptr_t>(start) % gb::instance::alignment == 0);
+        CHECK(in_block(&inst->machine(), sizeof(gb::cpu)));
+        CHECK(in_block(&inst->machine().bus(), sizeof(gb::memory)));
+    }
+}
+
+TEST_CASE("an instance runs exactly like a machine allocated piece by piece")
+{
+    for (const auto* name : {"flappyboy.gb", "pokemon_crystal_usa_eur.gbc"})
+    {
+        const auto cart  = testdata::rom(name);
+        const auto model = testdata::model_for(cart);
+
+        auto inst     = gb::make_instance(cart, model);
+        auto separate = std::make_unique<gb::cpu>(std::make_unique<gb::memory>(gb::make_controller(cart, {}), cart),
+                                                  model);
+
+        CHECK(testdata::state_hash(inst->machine()) == testdata::state_hash(*separate));
+        for (uint64_t frame = 0; frame < 300; ++frame)
+        {
+            for (auto* machine : {&inst->machine(), separate.get()})
+            {
+                machine->bus().input().set(testdata::buttons(frame));
+                machine->run_frame();
+            }
+            if (frame % 50 == 49) CHECK(testdata::state_hash(inst->machine()) == testdata::state_hash(*separate));
+        }
+    }
+}
@@ -0,0 +1,46 @@
+#include <doctest/doctest.h>
+
+#include <cstdint>
+
+#include "instance.hpp"
+#include "instance_pool.hpp"
+#include "testdata.hpp"
+
+TEST_CASE("a recycled instance starts out exactly like a fresh one")
+{
+    for (const auto* name : {"flappyboy.gb", "pokemon_crystal_usa_eur.gbc"})
+    {
+        const auto cart  = testdata::rom(name);
+        const auto model = testdata::model_for(cart);
+
+        gb::instance_pool pool{cart};
+
+        // leave a block in a state far from power on, cartridge RAM and all
+        const void* block = nullptr;
+        {
+            auto used = pool.acquire(model);
+            block     = used.get();
+            for (uint64_t frame = 0; frame < 300; ++frame)
+            {
+                used->machine().bus().input().set(testdata::buttons(frame, 7));
+                used->machine().run_frame();
+            }
+        }
+
+        auto recycled = pool.acquire(model);
+        auto fresh    = gb::make_instance(cart, model);
+        REQUIRE(recycled.get() == block);
+        CHECK(pool.allocated() == gb::instance_pool::slab_blocks);
+
+        CHECK(testdata::state_hash(recycled->machine()) == testdata::state_hash(fresh->machine()));
+        for (uint64_t frame = 0; frame < 200; ++frame)
+        {
+            for (auto* inst : {recycled.get(), fresh.get()})
+            {
+                inst->machine().bus().input().set(testdata::buttons(frame));
+                inst->machine().run_frame();
+            }
+        }
+        CHECK(testdata::state_hash(recycled->machine()) == testdata::state_hash(fresh->machine()));
+    }
+}
@@ -0,0 +1,175 @@
+#include <doctest/doctest.h>
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "cartridge.hpp"
+#include "instance.hpp"
+#include "lanes.hpp"
+#include "memory.hpp"
+#include "opcodes.hpp"
+#include "testdata.hpp"
+
+namespace
+{
+
+constexpr uint8_t halt = 0x76;
+
+// setup is where a machine starts: the instruction at 0xC000, and its registers
+struct setup
+{
+    std::array<uint8_t, 3> code{};
+    registers              regs{};
+};
+
+// random_setup picks random registers and operands for the instruction op (0x100 up for the 0xCB prefixed ones),
+// keeping addresses it accesses in WRAM and HRAM, so that it can't turn the display off and never finish the frame
+setup random_setup(uint16_t op, std::mt19937& rng)
+{
+    using enum gb::operand;
+
+    const gb::opcode& info = op < 0x100 ? gb::opcodes[op] : gb::ext_opcodes[op - 0x100];
+
+    auto byte = [&] { return static_cast<uint8_t>(rng()); };
+    auto word = [&](uint16_t lo, uint16_t hi) { return static_cast<uint16_t>(lo + rng() % (hi - lo + 1)); };
+
+    setup s;
+    s.regs.AF = word(0, 0xFFFF);
+    s.regs.BC = word(0, 0xFFFF);
+    s.regs.DE = word(0, 0xFFFF);
+    s.regs.HL = word(0, 0xFFFF);
+    s.regs.sp = word(0xD000, 0xDFFE);
+    s.regs.pc = 0xC000;
+
+    if (op < 0x100) s.code = {static_cast<uint8_t>(op), byte(), byte()};
+    else s.code = {0xCB, static_cast<uint8_t>(op - 0x100), halt};
+
+    for (const auto o : {info.dst, info.src})
+    {
+        if (o == at_BC) s.regs.BC = word(0xC100, 0xDFFF);
+        if (o == at_DE) s.regs.DE = word(0xC100, 0xDFFF);
+        if (o == at_HL || o == at_HLI || o == at_HLD || o == HL) s.regs.HL = word(0xC100, 0xDFFF);
+        if (o == at_C) s.regs.C = static_cast<uint8_t>(word(0x80, 0xFE));
+        if (o == at_n8) s.code[1] = static_cast<uint8_t>(word(0x80, 0xFE));
+        if (o == at_n16) s.code[2] = static_cast<uint8_t>(word(0xC1, 0xDF));
+    }
+
+    // jumps and calls land in the ROM, on a HALT
+    if ((info.name == gb::mnemonic::JP || info.name == gb::mnemonic::CALL) && info.src == n16)
+    {
+        s.code[2] = static_cast<uint8_t>(word(0x00, 0x7F));
+    }
+
+    return s;
+}
+
+void apply(gb::cpu& cpu, const setup& s)
+{
+    auto& mem = cpu.bus();
+    for (uint32_t addr = 0xC000; addr < 0xE000; ++addr) mem.poke(static_cast<uint16_t>(addr), halt);
+    for (size_t i = 0; i < s.code.size(); ++i) mem.poke(static_cast<uint16_t>(0xC000 + i), s.code[i]);
+
+    // nothing to wake from HALT, so each ends up halted for the rest of the frame
+    mem.interrupts().write_enable(0);
+
+    cpu.regs() = s.regs;
+}
+
+}
+
+TEST_CASE("lanes run every instruction exactly like the cpu")
+{
+    // wherever anything jumps to, there's a HALT
+    gb::cartridge cart;
+    cart.data.assign(0x8000, halt);
+
+    std::mt19937 rng{47};
+
+    uint64_t vectorized = 0;
+    for (uint16_t op = 0; op < 0x200; ++op)
+    {
+        std::vector<gb::instance_ptr> lanes_run;
+        std::vector<gb::instance_ptr> scalar_run;
+
+        gb::lanes batch;
+        for (size_t i = 0; i < gb::lanes::width; ++i)
+        {
+            const auto s = random_setup(op, rng);
+
+            lanes_run.push_back(gb::make_instance(cart, gb::model::original));
+            scalar_run.push_back(gb::make_instance(cart, gb::model::original));
+            apply(lanes_run.back()->machine(), s);
+            apply(scalar_run.back()->machine(), s);
+
+            batch.add(lanes_run.back()->machine());
+        }
+
+        batch.run_frame();
+        for (auto& inst : scalar_run) inst->machine().run_frame();
+
+        for (size_t i = 0; i < gb::lanes::width; ++i)
+        {
+            const auto& lane   = lanes_run[i]->machine();
+            const auto& scalar = scalar_run[i]->machine();
+
+            CHECK(lane.regs().AF == scalar.regs().AF);
+            CHECK(lane.regs().BC == scalar.regs().BC);
+            CHECK(lane.regs().DE == scalar.regs().DE);
+            CHECK(lane.regs().HL == scalar.regs().HL);
+            CHECK(lane.regs().sp == scalar.regs().sp);
+            CHECK(lane.regs().pc == scalar.regs().pc);
+            CHECK(lane.elapsed() == scalar.elapsed());
+            CHECK(testdata::state_hash(lane) == testdata::state_hash(scalar));
+        }
+
+        vectorized += batch.vectorized();
+    }
+
+    // most instructions run as part of the block, rather than every lane peeling off
+    CHECK(vectorized > 0x100 * gb::lanes::width);
+}
+
+TEST_CASE("lanes run games exactly like the cpu, whatever the input")
+{
+    for (const auto* name : {"flappyboy.gb", "pokemon_crystal_usa_eur.gbc"})
+    {
+        const auto cart  = testdata::rom(name);
+        const auto model = testdata::model_for(cart);
+
+        // a full block, and a partial one
+        constexpr size_t count = gb::lanes::width + 4;
+
+        std::vector<gb::instance_ptr> lanes_run;
+        std::vector<gb::instance_ptr> scalar_run;
+
+        gb::lanes batch;
+        for (size_t i = 0; i < count; ++i)
+        {
+            lanes_run.push_back(gb::make_instance(cart, model));
+            scalar_run.push_back(gb::make_instance(cart, model));
+            batch.add(lanes_run.back()->machine());
+        }
+
+        for (uint64_t frame = 0; frame < 120; ++frame)
+        {
+            for (size_t i = 0; i < count; ++i)
+            {
+                lanes_run[i]->machine().bus().input().set(testdata::buttons(frame, i));
+                scalar_run[i]->machine().bus().input().set(testdata::buttons(frame, i));
+                scalar_run[i]->machine().run_frame();
+            }
+            batch.run_frame();
+
+            if (frame % 40 != 39) continue;
+            for (size_t i = 0; i < count; ++i)
+            {
+                CHECK(testdata::state_hash(lanes_run[i]->machine()) == testdata::state_hash(scalar_run[i]->machine()));
+            }
+        }
+
+        CHECK(batch.vectorized() > batch.peeled());
+    }
+}
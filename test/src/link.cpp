@@ -0,0 +1,87 @@
+#include <doctest/doctest.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <thread>
+
+#include <unistd.h>
+
+#include "link.hpp"
+#include "link_transport.hpp"
+
+namespace
+{
+
+struct plugged
+{
+    std::error_code                     listen_err;
+    std::error_code                     connect_err;
+    std::unique_ptr<gb::link_transport> listener;
+    std::unique_ptr<gb::link_transport> connector;
+};
+
+// plug connects two socket ends, syncing every listen_quantum and connect_quantum cycles
+plugged plug(uint32_t listen_quantum, uint32_t connect_quantum)
+{
+    const auto path = std::filesystem::temp_directory_path() / ("gbemu-link-" + std::to_string(::getpid()) + ".sock");
+
+    plugged p;
+    {
+        std::jthread listening{[&] { p.listen_err = gb::listen_socket_link(path, listen_quantum, p.listener); }};
+
+        // until the listening end has bound the socket
+        for (int tries = 0; tries < 1000; ++tries)
+        {
+            p.connect_err = gb::connect_socket_link(path, connect_quantum, p.connector);
+            if (p.connect_err != std::errc::no_such_file_or_directory && p.connect_err != std::errc::connection_refused)
+            {
+                break;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds{1});
+        }
+    }
+
+    return p;
+}
+
+}
+
+TEST_CASE("socket ends syncing every different number of cycles are refused as they connect")
+{
+    auto p = plug(4096, 1024);
+    CHECK(p.listen_err == std::errc::invalid_argument);
+    CHECK(p.connect_err == std::errc::invalid_argument);
+    CHECK(p.listener == nullptr);
+    CHECK(p.connector == nullptr);
+}
+
+TEST_CASE("socket ends with the same quantum trade batches")
+{
+    auto p = plug(1024, 1024);
+    REQUIRE_FALSE(p.listen_err);
+    REQUIRE_FALSE(p.connect_err);
+
+    gb::link_batch from_listener{.data = 0x12, .transfers = {1, 2, 3}};
+    gb::link_batch from_connector{.data = 0x34, .transfers = {}};
+    gb::link_batch to_listener;
+    gb::link_batch to_connector;
+
+    std::error_code listener_err;
+    {
+        std::jthread other{[&] { listener_err = p.listener->exchange(from_listener, to_listener); }};
+        CHECK_FALSE(p.connector->exchange(from_connector, to_connector));
+    }
+    CHECK_FALSE(listener_err);
+
+    CHECK(to_connector.data == 0x12);
+    CHECK(to_connector.transfers == from_listener.transfers);
+    CHECK(to_listener.data == 0x34);
+    CHECK(to_listener.transfers.empty());
+}
+
+#endif
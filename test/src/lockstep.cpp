@@ -0,0 +1,164 @@
+#include <doctest/doctest.h>
+
+#include <chrono>
+#include <cstdint>
+#include <initializer_list>
+#include <memory>
+#include <thread>
+
+#include "cartridge.hpp"
+#include "cpu.hpp"
+#include "instance.hpp"
+#include "link.hpp"
+#include "lockstep.hpp"
+#include "memory.hpp"
+#include "serial.hpp"
+
+namespace
+{
+
+// blank is a ROM-only cartridge of nothing but NOPs
+gb::cartridge blank()
+{
+    gb::cartridge cart;
+    cart.data.assign(0x8000, 0);
+    return cart;
+}
+
+void load(gb::cpu& cpu, std::initializer_list<uint8_t> code)
+{
+    uint16_t at = 0xC000;
+    for (auto byte : code) cpu.bus().poke(at++, byte);
+
+    cpu.bus().interrupts().write_enable(0);
+    cpu.regs().pc = 0xC000;
+}
+
+// sender clocks out 1, 2, 3 and so on, one after the other
+void load_sender(gb::cpu& cpu)
+{
+    load(cpu,
+         {
+             0x06, 0x01,       // LD B,1
+             0x78,             // loop: LD A,B
+             0xE0, 0x01,       // LDH (SB),A
+             0x3E, 0x81,       // LD A,$81
+             0xE0, 0x02,       // LDH (SC),A
+             0xF0, 0x02,       // wait: LDH A,(SC)
+             0xCB, 0x7F,       // BIT 7,A
+             0x20, 0xFA,       // JR NZ,wait
+             0x04,             // INC B
+             0x18, 0xF0,       // JR loop
+         });
+}
+
+// receiver takes bytes on the external clock, storing them from 0xD000 up
+void load_receiver(gb::cpu& cpu)
+{
+    load(cpu,
+         {
+             0x21, 0x00, 0xD0, // LD HL,$D000
+             0x3E, 0x80,       // loop: LD A,$80
+             0xE0, 0x02,       // LDH (SC),A
+             0xF0, 0x02,       // wait: LDH A,(SC)
+             0xCB, 0x7F,       // BIT 7,A
+             0x20, 0xFA,       // JR NZ,wait
+             0xF0, 0x01,       // LDH A,(SB)
+             0x22,             // LD (HL+),A
+             0x18, 0xF1,       // JR loop
+         });
+}
+
+// received is the number of bytes the receiver has stored, checking they came in order
+uint16_t received(gb::cpu& cpu)
+{
+    uint16_t count = 0;
+    while (cpu.bus().peek(static_cast<uint16_t>(0xD000 + count)) == count + 1) ++count;
+    return count;
+}
+
+}
+
+TEST_CASE("linked instances stay linked from one bounded run to the next")
+{
+    const auto cart     = blank();
+    auto       sender   = gb::make_instance(cart, gb::model::original);
+    auto       receiver = gb::make_instance(cart, gb::model::original);
+    load_sender(sender->machine());
+    load_receiver(receiver->machine());
+
+    constexpr uint32_t quantum = 1024;
+
+    gb::lockstep ends{quantum};
+    ends.add(sender->machine());
+    ends.add(receiver->machine());
+    ends.link(0, 1);
+
+    auto& sent = sender->machine().bus().serial_port();
+    auto& got  = receiver->machine().bus().serial_port();
+
+    // not a whole number of quanta, so each run rounds up to the same sync point on both ends
+    ends.run(50000);
+    REQUIRE(sent.connected());
+    REQUIRE(got.connected());
+    CHECK(sent.sync_count() == 49);
+    CHECK(got.sync_count() == 49);
+
+    const auto first = received(receiver->machine());
+    CHECK(first > 0);
+
+    ends.run(50000);
+    REQUIRE(sent.connected());
+    REQUIRE(got.connected());
+    CHECK(sent.sync_count() == 98);
+    CHECK(got.sync_count() == 98);
+
+    // nothing is lost between runs
+    CHECK(received(receiver->machine()) > first);
+    CHECK(received(receiver->machine()) + 2 >= sender->machine().regs().B);
+}
+
+TEST_CASE("stopping an unbounded run unplugs the cables")
+{
+    const auto cart     = blank();
+    auto       sender   = gb::make_instance(cart, gb::model::original);
+    auto       receiver = gb::make_instance(cart, gb::model::original);
+    load_sender(sender->machine());
+    load_receiver(receiver->machine());
+
+    gb::lockstep ends;
+    ends.add(sender->machine());
+    ends.add(receiver->machine());
+    ends.link(0, 1);
+
+    std::jthread stopper{[&]
+                         {
+                             std::this_thread::sleep_for(std::chrono::milliseconds{50});
+                             ends.stop();
+                         }};
+    ends.run();
+
+    CHECK_FALSE(sender->machine().bus().serial_port().connected());
+    CHECK_FALSE(receiver->machine().bus().serial_port().connected());
+}
+
+TEST_CASE("a held sync point runs late, without moving the ones after it")
+{
+    const auto cart = blank();
+    auto       inst = gb::make_instance(cart, gb::model::original);
+    auto&      port = inst->machine().bus().serial_port();
+
+    port.connect(std::make_unique<gb::loopback_link>(), 1024);
+    port.hold_syncs(1);
+
+    port.step(5000);
+    CHECK(port.sync_count() == 1);
+    CHECK(port.until_next_sync() == 0);
+
+    port.hold_syncs(gb::serial::no_limit);
+    port.step(4);
+
+    // 5004 cycles in, the fifth sync point is 5120
+    CHECK(port.sync_count() == 4);
+    CHECK(port.until_next_sync() == 116);
+}
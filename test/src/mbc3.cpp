@@ -0,0 +1,121 @@
+#include <doctest/doctest.h>
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "cartridge.hpp"
+#include "mbc3.hpp"
+
+namespace
+{
+
+constexpr uint32_t cycles_per_second = 4194304;
+
+// clocked is an MBC3+TIMER+RAM+BATTERY cartridge, and its controller with the RAM and clock enabled
+struct clocked
+{
+    clocked() { mbc.write(0x0000, 0x0A); }
+
+    static gb::cartridge make_cart()
+    {
+        gb::cartridge c;
+        c.data.assign(0x8000, 0);
+        c.data[0x147] = 0x10;
+        c.data[0x149] = 0x03;
+        return c;
+    }
+
+    void set(uint8_t reg, uint8_t val)
+    {
+        mbc.write(0x4000, static_cast<uint8_t>(0x08 + reg));
+        mbc.write(0xA000, val);
+    }
+
+    // latch copies the clock into what reads see
+    std::array<uint8_t, 5> latch()
+    {
+        mbc.write(0x6000, 0x00);
+        mbc.write(0x6000, 0x01);
+        return read();
+    }
+
+    std::array<uint8_t, 5> read()
+    {
+        std::array<uint8_t, 5> regs{};
+        for (uint8_t reg = 0; reg < regs.size(); ++reg)
+        {
+            mbc.write(0x4000, static_cast<uint8_t>(0x08 + reg));
+            regs[reg] = mbc.read(0xA000);
+        }
+        return regs;
+    }
+
+    gb::cartridge        cart = make_cart();
+    std::vector<uint8_t> ram  = std::vector<uint8_t>(cart.ram_size());
+    gb::mbc3             mbc{cart, ram};
+};
+
+}
+
+TEST_CASE("the MBC3 clock rolls over from 23:59:59 to the next day")
+{
+    clocked c;
+    c.set(0, 59);
+    c.set(1, 59);
+    c.set(2, 23);
+    c.set(3, 0xFF); // day 255
+    c.set(4, 0x00);
+
+    c.mbc.step(cycles_per_second - 1);
+    CHECK(c.latch() == std::array<uint8_t, 5>{59, 59, 23, 0xFF, 0x00});
+
+    c.mbc.step(1);
+    CHECK(c.latch() == std::array<uint8_t, 5>{0, 0, 0, 0x00, 0x01}); // day 256, in bit 0 of the high register
+}
+
+TEST_CASE("the MBC3 day counter carries out of day 511, and keeps the carry")
+{
+    clocked c;
+    c.set(0, 59);
+    c.set(1, 59);
+    c.set(2, 23);
+    c.set(3, 0xFF);
+    c.set(4, 0x01); // day 511
+
+    c.mbc.step(cycles_per_second);
+    CHECK(c.latch() == std::array<uint8_t, 5>{0, 0, 0, 0x00, 0x80});
+
+    // the counter moves on from day 0, but the carry stays until it is written
+    c.set(0, 59);
+    c.set(1, 59);
+    c.set(2, 23);
+    c.mbc.step(cycles_per_second);
+    CHECK(c.latch() == std::array<uint8_t, 5>{0, 0, 0, 0x01, 0x80});
+
+    c.set(4, 0x00);
+    CHECK(c.latch()[4] == 0x00);
+}
+
+TEST_CASE("the MBC3 halt bit stops the clock")
+{
+    clocked c;
+    c.set(4, 0x40);
+    c.mbc.step(3 * cycles_per_second);
+    CHECK(c.latch() == std::array<uint8_t, 5>{0, 0, 0, 0, 0x40});
+
+    c.set(4, 0x00);
+    c.mbc.step(3 * cycles_per_second);
+    CHECK(c.latch()[0] == 3);
+}
+
+TEST_CASE("writing an MBC3 clock register leaves the latched value until the next latch")
+{
+    clocked c;
+    c.set(0, 10);
+    CHECK(c.latch()[0] == 10);
+
+    c.set(0, 20);
+    CHECK(c.read()[0] == 10);
+    CHECK(c.latch()[0] == 20);
+}
@@ -0,0 +1,203 @@
+#include <doctest/doctest.h>
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <initializer_list>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+#include <unistd.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/socket.h>
+#include <sys/un.h>
+#endif
+
+#include "cartridge.hpp"
+#include "cpu.hpp"
+#include "instance.hpp"
+#include "memory.hpp"
+#include "metrics.hpp"
+#include "metrics_exporter.hpp"
+
+namespace
+{
+
+// blank is a ROM-only cartridge of nothing but NOPs
+gb::cartridge blank()
+{
+    gb::cartridge cart;
+    cart.data.assign(0x8000, 0);
+    return cart;
+}
+
+// run steps through the four instructions of a program from WRAM that selects a ROM bank, reads WRAM and writes HRAM
+void run(gb::cpu& cpu)
+{
+    uint16_t at = 0xC000;
+    for (auto byte : {
+             0x3E, 0x05,       // LD A,$05
+             0xEA, 0x00, 0x20, // LD ($2000),A
+             0xFA, 0x00, 0xC1, // LD A,($C100)
+             0xE0, 0x80,       // LDH ($80),A
+         })
+    {
+        cpu.bus().poke(at++, static_cast<uint8_t>(byte));
+    }
+
+    cpu.bus().interrupts().write_enable(0);
+    cpu.regs().pc = 0xC000;
+
+    for (int i = 0; i < 4; ++i) cpu.step();
+}
+
+uint64_t reads(const gb::cpu& cpu, gb::region r) { return cpu.bus().counters().reads[static_cast<size_t>(r)].load(); }
+uint64_t writes(const gb::cpu& cpu, gb::region r) { return cpu.bus().counters().writes[static_cast<size_t>(r)].load(); }
+
+bool contains(const std::string& text, const std::string& line) { return text.find(line + "\n") != std::string::npos; }
+
+}
+
+TEST_CASE("an instance counts the instructions, cycles and bank switches it runs")
+{
+    const auto cart = blank();
+    auto       inst = gb::make_instance(cart, gb::model::original);
+    auto&      cpu  = inst->machine();
+
+    run(cpu);
+
+    const auto& stats = cpu.bus().counters();
+    CHECK(stats.instructions.load() == 4);
+    CHECK(stats.cycles.load() == cpu.elapsed());
+    CHECK(stats.bank_switches.load() == 1);
+
+    // nothing by region until asked for
+    for (size_t i = 0; i < gb::num_regions; ++i)
+    {
+        CHECK(stats.reads[i].load() == 0);
+        CHECK(stats.writes[i].load() == 0);
+    }
+}
+
+TEST_CASE("accesses are counted by the region of the memory map they fall in")
+{
+    const auto cart = blank();
+    auto       inst = gb::make_instance(cart, gb::model::original);
+    auto&      cpu  = inst->machine();
+
+    cpu.bus().set_access_counting(true);
+    run(cpu);
+
+    // the program's own 10 bytes are fetched from WRAM too
+    CHECK(reads(cpu, gb::region::wram) == 11);
+    CHECK(reads(cpu, gb::region::rom) == 0);
+    CHECK(writes(cpu, gb::region::rom) == 1);
+    CHECK(writes(cpu, gb::region::hram) == 1);
+    CHECK(writes(cpu, gb::region::wram) == 0);
+
+    CHECK(gb::region_of(0xE000) == gb::region::echo);
+    CHECK(gb::region_of(0xFEA0) == gb::region::io);
+    CHECK(gb::region_of(0xFFFF) == gb::region::io);
+    CHECK(gb::region_of(0xFF80) == gb::region::hram);
+}
+
+TEST_CASE("the exporter renders each instance's counters, labelled with its escaped name")
+{
+    const auto cart     = blank();
+    auto       counting = gb::make_instance(cart, gb::model::original);
+    auto       plain    = gb::make_instance(cart, gb::model::original);
+
+    counting->machine().bus().set_access_counting(true);
+    run(counting->machine());
+    run(plain->machine());
+
+    gb::metrics_exporter exporter;
+    exporter.add("left \"a\"", counting->machine());
+    exporter.add("right\\b", plain->machine());
+
+    std::string text;
+    exporter.render(text);
+
+    CHECK(contains(text, "# TYPE gbemu_instructions_total counter"));
+    CHECK(contains(text, R"(gbemu_instructions_total{instance="left \"a\""} 4)"));
+    CHECK(contains(text, R"(gbemu_instructions_total{instance="right\\b"} 4)"));
+    CHECK(contains(text, R"(gbemu_bank_switches_total{instance="right\\b"} 1)"));
+    CHECK(contains(text, R"(gbemu_interrupts_total{instance="left \"a\"",type="vblank"} 0)"));
+    CHECK(contains(text, R"(gbemu_memory_writes_total{instance="left \"a\"",region="hram"} 1)"));
+
+    // only the instance counting accesses has any to report
+    CHECK(text.find(R"(gbemu_memory_reads_total{instance="right)") == std::string::npos);
+}
+
+TEST_CASE("the exporter leaves the final totals behind in its file once stopped")
+{
+    const auto cart = blank();
+    auto       inst = gb::make_instance(cart, gb::model::original);
+
+    const auto path = std::filesystem::temp_directory_path() / ("metrics-" + std::to_string(::getpid()) + ".prom");
+
+    gb::metrics_exporter exporter;
+    exporter.add("game", inst->machine());
+    REQUIRE_FALSE(exporter.write_file(path, std::chrono::milliseconds{10}));
+    CHECK(exporter.write_file(path) == std::errc::device_or_resource_busy);
+
+    run(inst->machine());
+    exporter.stop();
+
+    std::ifstream     file{path};
+    const std::string written{std::istreambuf_iterator<char>{file}, {}};
+    std::filesystem::remove(path);
+
+    std::string text;
+    exporter.render(text);
+    CHECK(written == text);
+    CHECK(contains(written, R"(gbemu_instructions_total{instance="game"} 4)"));
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+
+TEST_CASE("the exporter answers connections to its socket with the metrics over HTTP")
+{
+    const auto cart = blank();
+    auto       inst = gb::make_instance(cart, gb::model::original);
+    run(inst->machine());
+
+    const auto path = std::filesystem::temp_directory_path() / ("metrics-" + std::to_string(::getpid()) + ".sock");
+
+    gb::metrics_exporter exporter;
+    exporter.add("game", inst->machine());
+    REQUIRE_FALSE(exporter.serve(path));
+
+    const int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    REQUIRE(fd >= 0);
+
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    std::memcpy(addr.sun_path, path.c_str(), path.native().size());
+    REQUIRE(::connect(fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) == 0);
+
+    constexpr std::string_view request = "GET /metrics HTTP/1.0\r\n\r\n";
+    REQUIRE(::send(fd, request.data(), request.size(), 0) == static_cast<ssize_t>(request.size()));
+
+    std::string            response;
+    std::array<char, 4096> buf{};
+    for (ssize_t n = 0; (n = ::recv(fd, buf.data(), buf.size(), 0)) > 0;)
+    {
+        response.append(buf.data(), static_cast<size_t>(n));
+    }
+    ::close(fd);
+
+    exporter.stop();
+    CHECK_FALSE(std::filesystem::exists(path));
+
+    CHECK(response.starts_with("HTTP/1.0 200 OK\r\n"));
+    CHECK(contains(response, R"(gbemu_instructions_total{instance="game"} 4)"));
+}
+
+#endif
@@ -0,0 +1,92 @@
+#include <doctest/doctest.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+
+#include <unistd.h>
+
+#include "cpu.hpp"
+#include "golden.hpp"
+#include "instance.hpp"
+#include "memory.hpp"
+#include "movie.hpp"
+#include "ppu.hpp"
+#include "testdata.hpp"
+
+namespace
+{
+
+constexpr uint64_t frames = 120;
+
+// play runs frames of cart as a player would, pressing buttons at the start of each frame and again partway through,
+// recording every change into m. It returns the hash of the final frame.
+uint64_t play(const gb::cartridge& cart, gb::movie& m)
+{
+    auto  inst = gb::make_instance(cart, testdata::model_for(cart));
+    auto& cpu  = inst->machine();
+    auto& mem  = cpu.bus();
+
+    for (uint64_t frame = 0; frame < frames; ++frame)
+    {
+        const auto     count = mem.display().frame_count();
+        const uint64_t start = cpu.elapsed();
+
+        m.record(count, 0, testdata::buttons(frame));
+        mem.input().set(testdata::buttons(frame));
+
+        // a press that doesn't line up with the frame, so replaying has to get the cycle right too
+        while (mem.display().frame_count() == count && cpu.elapsed() - start < 20000) cpu.step();
+        if (mem.display().frame_count() == count)
+        {
+            const auto buttons = testdata::buttons(frame, 7);
+            m.record(count, static_cast<uint32_t>(cpu.elapsed() - start), buttons);
+            mem.input().set(buttons);
+        }
+
+        cpu.run_frame();
+    }
+
+    return gb::hash_frame(mem.display().front());
+}
+
+// replay runs m on a fresh instance of cart, returning the hash of the final frame
+uint64_t replay(const gb::cartridge& cart, const gb::movie& m)
+{
+    auto  inst = gb::make_instance(cart, testdata::model_for(cart));
+    auto& cpu  = inst->machine();
+
+    gb::movie_player player{m};
+    for (uint64_t frame = 0; frame < frames; ++frame) player.run_frame(cpu, cpu.bus());
+
+    CHECK(player.finished());
+    return gb::hash_frame(cpu.bus().display().front());
+}
+
+}
+
+TEST_CASE("a recorded movie replays to the same final frame, after a trip through a file")
+{
+    for (const auto* name : {"flappyboy.gb", "pokemon_crystal_usa_eur.gbc"})
+    {
+        const auto cart = testdata::rom(name);
+
+        gb::movie recorded;
+        const auto played = play(cart, recorded);
+        REQUIRE(recorded.events.size() > frames / 8);
+
+        const auto path = std::filesystem::temp_directory_path() / ("movie-" + std::to_string(::getpid()) + ".gbm");
+        REQUIRE_FALSE(gb::save_movie(path, recorded));
+
+        gb::movie loaded;
+        REQUIRE_FALSE(gb::load_movie(path, loaded));
+        std::filesystem::remove(path);
+
+        CHECK(loaded.hash() == recorded.hash());
+        CHECK(loaded.events.size() == recorded.events.size());
+        CHECK(replay(cart, loaded) == played);
+
+        // and the input made a difference
+        CHECK(replay(cart, gb::movie{}) != played);
+    }
+}
@@ -0,0 +1,105 @@
+#include <doctest/doctest.h>
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "paged_ram.hpp"
+#include "state.hpp"
+
+namespace
+{
+
+constexpr size_t ram_size = 3 * gb::paged_ram::page_size + 100; // the last page is short
+
+struct ram
+{
+    std::array<uint8_t, ram_size> storage{};
+    gb::paged_ram                 pages{storage};
+};
+
+}
+
+TEST_CASE("paged RAM starts out cleared, whatever its storage holds")
+{
+    std::array<uint8_t, ram_size> storage;
+    storage.fill(0xAA);
+
+    gb::paged_ram pages{storage};
+    for (size_t i = 0; i < ram_size; i += 97) CHECK(pages.read(i) == 0);
+
+    gb::paged_ram kept{storage, true};
+    CHECK(kept.read(0) == 0xAA);
+    CHECK(kept.read(ram_size - 1) == 0xAA);
+}
+
+TEST_CASE("shared RAM pages are read in place until written")
+{
+    ram parent;
+    ram child;
+    ram sibling;
+    for (size_t i = 0; i < ram_size; ++i) parent.pages.write(i, static_cast<uint8_t>(i * 7));
+
+    parent.pages.share_with(child.pages);
+    parent.pages.share_with(sibling.pages);
+
+    // every page is shared, read through the same bytes, and writable by none of them
+    for (size_t p = 0; p < 4; ++p)
+    {
+        CHECK(child.pages.page(p) == parent.pages.page(p));
+        CHECK(sibling.pages.page(p) == parent.pages.page(p));
+        CHECK(parent.pages.own_page(p) == nullptr);
+        CHECK(child.pages.own_page(p) == nullptr);
+    }
+    for (size_t i = 0; i < ram_size; i += 13) CHECK(child.pages.read(i) == static_cast<uint8_t>(i * 7));
+
+    // a write copies only its own page, and only for the RAM written to
+    const size_t at = gb::paged_ram::page_size + 5;
+    child.pages.write(at, 0x5A);
+    CHECK(child.pages.read(at) == 0x5A);
+    CHECK(parent.pages.read(at) == static_cast<uint8_t>(at * 7));
+    CHECK(sibling.pages.read(at) == static_cast<uint8_t>(at * 7));
+    CHECK(child.pages.own_page(1) != nullptr);
+    CHECK(child.pages.page(1) != parent.pages.page(1));
+    CHECK(child.pages.read(at + 1) == static_cast<uint8_t>((at + 1) * 7));
+    CHECK(child.pages.page(0) == parent.pages.page(0));
+    CHECK(child.pages.page(2) == parent.pages.page(2));
+
+    // the same goes the other way, and for the short last page
+    parent.pages.write(ram_size - 1, 0xC3);
+    CHECK(parent.pages.read(ram_size - 1) == 0xC3);
+    CHECK(child.pages.read(ram_size - 1) == static_cast<uint8_t>((ram_size - 1) * 7));
+    CHECK(sibling.pages.read(ram_size - 1) == static_cast<uint8_t>((ram_size - 1) * 7));
+    CHECK(sibling.pages.page(3) == child.pages.page(3));
+}
+
+TEST_CASE("shared RAM pages save and load like the RAM's own")
+{
+    ram parent;
+    ram child;
+    for (size_t i = 0; i < ram_size; ++i) parent.pages.write(i, static_cast<uint8_t>(i ^ 0x3C));
+    parent.pages.share_with(child.pages);
+    child.pages.write(10, 0xEE);
+
+    std::vector<uint8_t> saved(ram_size);
+    gb::state_writer     out{saved};
+    child.pages.save_state(out);
+    REQUIRE(out.size() == ram_size);
+
+    // loading replaces every page, shared or not, with the RAM's own
+    ram loaded;
+    parent.pages.share_with(loaded.pages);
+    gb::state_reader in{saved};
+    loaded.pages.load_state(in);
+
+    for (size_t p = 0; p < 4; ++p) CHECK(loaded.pages.own_page(p) != nullptr);
+    for (size_t i = 0; i < ram_size; ++i)
+    {
+        if (loaded.pages.read(i) != child.pages.read(i))
+        {
+            CHECK(loaded.pages.read(i) == child.pages.read(i));
+            break;
+        }
+    }
+    CHECK(parent.pages.read(10) == static_cast<uint8_t>(10 ^ 0x3C));
+}
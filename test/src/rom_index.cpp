@@ -0,0 +1,102 @@
+#include <doctest/doctest.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include <unistd.h>
+
+#include "cartridge.hpp"
+#include "rom_index.hpp"
+
+namespace
+{
+
+std::filesystem::path scratch(const std::string& name)
+{
+    return std::filesystem::temp_directory_path() / (name + "-" + std::to_string(::getpid()) + ".idx");
+}
+
+// entries makes count entries, every other one with a hash colliding with the one before in the table's low bits
+std::vector<gb::rom_entry> entries(size_t count)
+{
+    std::vector<gb::rom_entry> out;
+    for (size_t i = 0; i < count; ++i)
+    {
+        gb::rom_entry e;
+        e.content_hash          = ((i / 2) * 0x9E3779B97F4A7C15ULL) + ((i % 2) << 40);
+        e.path                  = "roms/game " + std::to_string(i) + ".gb";
+        e.title                 = i == 0 ? "SIXTEEN CHARS..." : "GAME " + std::to_string(i);
+        e.rom_size              = 0x8000U << (i % 8);
+        e.ram_size              = i % 3 == 0 ? 0 : 0x2000;
+        e.cartridge_type        = static_cast<uint8_t>(i % 0x20);
+        e.color                 = i % 2 == 0 ? gb::cartridge::color_support::monochrome_supported
+                                             : gb::cartridge::color_support::color_supported;
+        e.global_checksum       = static_cast<uint16_t>(i * 0x0101);
+        e.header_checksum_valid = i % 2 == 0;
+        e.global_checksum_valid = i % 4 < 2;
+        out.push_back(e);
+    }
+    return out;
+}
+
+}
+
+TEST_CASE("every entry saved to a ROM index can be found in it again")
+{
+    const auto path  = scratch("rom-index");
+    const auto saved = entries(100);
+    REQUIRE_FALSE(gb::save_index(path, saved));
+
+    gb::rom_index index;
+    REQUIRE_FALSE(gb::load_index(path, index));
+    std::filesystem::remove(path);
+
+    CHECK(index.size() == saved.size());
+    for (const auto& e : saved)
+    {
+        const auto found = index.find(e.content_hash);
+        REQUIRE(found);
+        CHECK(found->content_hash == e.content_hash);
+        CHECK(found->path == e.path);
+        CHECK(found->title == e.title);
+        CHECK(found->rom_size == e.rom_size);
+        CHECK(found->ram_size == e.ram_size);
+        CHECK(found->cartridge_type == e.cartridge_type);
+        CHECK(found->color == e.color);
+        CHECK(found->global_checksum == e.global_checksum);
+        CHECK(found->header_checksum_valid == e.header_checksum_valid);
+        CHECK(found->global_checksum_valid == e.global_checksum_valid);
+    }
+
+    CHECK_FALSE(index.find(0x0123456789ABCDEFULL));
+    CHECK_FALSE(gb::rom_index{}.find(saved[0].content_hash));
+}
+
+TEST_CASE("ROM indexes that are truncated or aren't indexes at all are refused")
+{
+    const auto path = scratch("rom-index-bad");
+    REQUIRE_FALSE(gb::save_index(path, entries(4)));
+
+    const auto full = std::filesystem::file_size(path);
+
+    gb::rom_index index;
+    for (const auto size : {full / 2, uintmax_t{20}, uintmax_t{0}})
+    {
+        std::filesystem::resize_file(path, size);
+        CHECK(gb::load_index(path, index) == std::errc::illegal_byte_sequence);
+    }
+
+    std::ofstream{path, std::ios::binary | std::ios::trunc} << "GBRX not an index at all";
+    CHECK(gb::load_index(path, index) == std::errc::illegal_byte_sequence);
+    CHECK(index.size() == 0);
+
+    std::filesystem::remove(path);
+
+    // and nothing is written for an entry without a path
+    std::vector<gb::rom_entry> nameless(1);
+    CHECK(gb::save_index(path, nameless) == std::errc::invalid_argument);
+}
@@ -0,0 +1,97 @@
+#include <doctest/doctest.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "save_file.hpp"
+
+namespace
+{
+
+// scratch is a save file path of its own for each test, removed again afterwards
+struct scratch
+{
+    explicit scratch(const std::string& name)
+        : path{std::filesystem::temp_directory_path() / (name + "-" + std::to_string(::getpid()) + ".sav")}
+    {
+        std::filesystem::remove(path);
+    }
+
+    scratch(const scratch&)            = delete;
+    scratch& operator=(const scratch&) = delete;
+
+    ~scratch() { std::filesystem::remove(path); }
+
+    [[nodiscard]] std::vector<uint8_t> contents() const
+    {
+        std::ifstream in{path, std::ios::binary};
+        return {std::istreambuf_iterator<char>{in}, {}};
+    }
+
+    std::filesystem::path path;
+};
+
+}
+
+TEST_CASE("a save file marks the pages written as dirty until they are flushed")
+{
+    scratch file{"gbemu-dirty"};
+
+    std::unique_ptr<gb::save_file> save;
+    REQUIRE_FALSE(gb::open_save(file.path, 0x8000, true, save));
+    REQUIRE(save->ram().size() == 0x8000);
+    REQUIRE(save->rtc().size() == gb::save_file::rtc_size);
+
+    CHECK_FALSE(save->is_dirty(0));
+    CHECK_FALSE(save->is_dirty(0x5000));
+
+    save->ram()[0x5000] = 0x42;
+    save->dirty(0x5000);
+    CHECK(save->is_dirty(0x5000));
+    CHECK_FALSE(save->is_dirty(0));
+
+    save->flush();
+    CHECK_FALSE(save->is_dirty(0x5000));
+
+    // the footer is past the RAM, on a page of its own
+    save->dirty_all();
+    CHECK(save->is_dirty(0));
+    CHECK(save->is_dirty(0x8000 + gb::save_file::rtc_size - 1));
+    save->flush();
+    CHECK_FALSE(save->is_dirty(0));
+    CHECK_FALSE(save->is_dirty(0x8000 + gb::save_file::rtc_size - 1));
+
+    save.reset();
+
+    const auto bytes = file.contents();
+    REQUIRE(bytes.size() == 0x8000 + gb::save_file::rtc_size);
+    CHECK(bytes[0x5000] == 0x42);
+}
+
+TEST_CASE("a save file keeps what was written from one opening to the next")
+{
+    scratch file{"gbemu-reopen"};
+
+    std::unique_ptr<gb::save_file> save;
+    REQUIRE_FALSE(gb::open_save(file.path, 0x2000, false, save));
+    CHECK(save->rtc().empty());
+
+    save->ram()[0x1FFF] = 0x99;
+    save->dirty(0x1FFF);
+    save.reset();
+
+    REQUIRE_FALSE(gb::open_save(file.path, 0x2000, false, save));
+    CHECK(save->ram()[0x1FFF] == 0x99);
+    CHECK(save->ram()[0] == 0);
+}
+
+#endif
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "cartridge.hpp"
+#include "cpu.hpp"
+#include "hash.hpp"
+#include "models.hpp"
+#include "state.hpp"
+
+namespace testdata
+{
+
+// rom loads one of the ROMs in testdata/
+inline gb::cartridge rom(const std::string& name)
+{
+    std::ifstream in{std::string{GBEMU_TESTDATA} + "/" + name, std::ios::binary};
+
+    gb::cartridge cart;
+    cart.data.assign(std::istreambuf_iterator<char>{in}, {});
+    return cart;
+}
+
+inline gb::model model_for(const gb::cartridge& cart)
+{
+    const bool color = cart.color_flag() != gb::cartridge::color_support::monochrome_supported;
+    return color ? gb::model::color : gb::model::original;
+}
+
+// state_hash hashes the whole of machine's state, so two machines in the same state hash the same
+inline uint64_t state_hash(const gb::cpu& machine)
+{
+    std::vector<uint8_t> state(gb::state_size(machine));
+    (void)gb::save_state(machine, state);
+    return gb::hash::hash64(state);
+}
+
+// buttons is a deterministic button pattern changing every few frames, so runs take different paths through a game
+inline uint8_t buttons(uint64_t frame, uint64_t seed = 0)
+{
+    const uint64_t x = (frame / 8 + seed) * 0x9E3779B97F4A7C15ULL;
+    return static_cast<uint8_t>(x >> 56);
+}
+
+}
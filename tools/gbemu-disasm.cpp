@@ -0,0 +1,204 @@
+// gbemu-disasm finds the code in a ROM by following its control flow, see code_map.hpp, and writes out what it found.
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+#include <cxxopts.hpp>
+
+#include "cartridge.hpp"
+#include "code_map.hpp"
+#include "disassembler.hpp"
+
+namespace fs = std::filesystem;
+
+using file_ptr = std::unique_ptr<std::FILE, decltype(&std::fclose)>;
+
+// bytes of data shown per DB line
+constexpr size_t data_per_line = 8;
+
+// append_hex appends val as two hex digits, snprintf being most of the cost of a listing otherwise
+static void append_hex(std::string& out, uint8_t val)
+{
+    constexpr std::string_view digits = "0123456789ABCDEF";
+    out += digits[val >> 4U];
+    out += digits[val & 0x0FU];
+}
+
+static std::error_code load_rom(const fs::path& path, gb::cartridge& cart)
+{
+    std::error_code err;
+    const auto      size = fs::file_size(path, err);
+    if (err) return err;
+    if (size < 0x150) return std::make_error_code(std::errc::invalid_argument);
+
+    file_ptr file{std::fopen(path.c_str(), "rb"), &std::fclose};
+    if (file == nullptr) return {errno, std::generic_category()};
+
+    cart.data.resize(size);
+    if (std::fread(cart.data.data(), 1, size, file.get()) != size) return std::make_error_code(std::errc::io_error);
+
+    return {};
+}
+
+// write_listing disassembles every byte of cart, as code or as data according to map
+static std::error_code write_listing(const fs::path& path, const gb::cartridge& cart, const gb::code_map& map)
+{
+    const std::span<const uint8_t> rom{cart.data};
+
+    std::string out;
+    out.reserve(rom.size() * 8);
+
+    std::array<char, 32> buf{};
+    std::string          text;
+    auto                 label = map.labels.begin();
+
+    for (size_t i = 0; i < rom.size();)
+    {
+        const auto bank = static_cast<unsigned>(i >> 14U);
+        const auto addr = static_cast<uint16_t>(bank == 0 ? i : (0x4000 | (i & 0x3FFF)));
+
+        if (label != map.labels.end() && label->offset == i)
+        {
+            out += '\n';
+            out += label->name();
+            out += ":\n";
+            ++label;
+        }
+
+        std::snprintf(buf.data(), buf.size(), "    %02X:%04X  ", bank, addr);
+        out += buf.data();
+
+        size_t len = 0;
+        if (map.kinds[i] == gb::byte_kind::code)
+        {
+            text.clear();
+            len = gb::disassemble(addr, rom.subspan(i, std::min<size_t>(3, rom.size() - i)), text);
+            if (len == 0) len = rom.size() - i; // cut off by the end of the ROM
+
+            for (size_t b = 0; b < 3; ++b)
+            {
+                if (b < len) append_hex(out, rom[i + b]);
+                else out += "  ";
+                out += ' ';
+            }
+
+            out += ' ';
+            out += text;
+        }
+        else
+        {
+            // a run of data, up to the next code, label or bank
+            const size_t label_at = label != map.labels.end() ? label->offset : rom.size();
+            const size_t bank_end = (i | 0x3FFF) + 1;
+            const size_t end      = std::min({i + data_per_line, label_at, bank_end, rom.size()});
+
+            out += "DB ";
+            while (len == 0 || (i + len < end && map.kinds[i + len] != gb::byte_kind::code))
+            {
+                out += len == 0 ? "$" : ",$";
+                append_hex(out, rom[i + len]);
+                ++len;
+            }
+        }
+
+        out += '\n';
+        i   += len;
+    }
+
+    file_ptr file{std::fopen(path.c_str(), "wb"), &std::fclose};
+    if (file == nullptr) return {errno, std::generic_category()};
+
+    if (std::fwrite(out.data(), 1, out.size(), file.get()) != out.size()) return {errno, std::generic_category()};
+    if (std::fclose(file.release()) != 0) return {errno, std::generic_category()};
+    return {};
+}
+
+int main(int argc, char* argv[])
+{
+    cxxopts::Options options("gbemu-disasm", "Find and disassemble the code in a Gameboy ROM");
+
+    // clang-format off
+    options
+        .set_tab_expansion()
+        .show_positional_help()
+        .add_options()
+            ("rom", "ROM to disassemble.", cxxopts::value<std::string>())
+            ("o,output", "Where to write the symbol (.sym) and code/data map (.map) files, without the extension. Defaults to beside the ROM.", cxxopts::value<std::string>())
+            ("l,listing", "Also write a disassembly of the whole ROM to this file.", cxxopts::value<std::string>())
+            ("h,help", "Show help", cxxopts::value<bool>())
+        ;
+    // clang-format on
+
+    options.parse_positional({"rom"});
+    const auto results = options.parse(argc, argv);
+
+    if (results.count("help") != 0 || results.count("rom") == 0)
+    {
+        std::cout << options.help() << std::endl;
+        return results.count("help") != 0 ? 0 : 1;
+    }
+
+    const fs::path rom_file = results["rom"].as<std::string>();
+
+    gb::cartridge cart;
+    if (auto err = load_rom(rom_file, cart); err)
+    {
+        std::cerr << "unable to read " << std::quoted(rom_file.string()) << ": " << err.message() << std::endl;
+        return 1;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+
+    gb::code_map map;
+    gb::analyze(cart, map);
+
+    const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+    fs::path base = results.count("output") != 0 ? fs::path{results["output"].as<std::string>()} : rom_file;
+
+    auto symbols_file = base;
+    symbols_file.replace_extension(".sym");
+    if (auto err = gb::save_symbols(symbols_file, map); err)
+    {
+        std::cerr << "unable to write " << std::quoted(symbols_file.string()) << ": " << err.message() << std::endl;
+        return 1;
+    }
+
+    auto map_file = base;
+    map_file.replace_extension(".map");
+    if (auto err = gb::save_code_map(map_file, map); err)
+    {
+        std::cerr << "unable to write " << std::quoted(map_file.string()) << ": " << err.message() << std::endl;
+        return 1;
+    }
+
+    if (results.count("listing") != 0)
+    {
+        const fs::path listing_file = results["listing"].as<std::string>();
+        if (auto err = write_listing(listing_file, cart, map); err)
+        {
+            std::cerr << "unable to write " << std::quoted(listing_file.string()) << ": " << err.message()
+                      << std::endl;
+            return 1;
+        }
+    }
+
+    const size_t code = map.count(gb::byte_kind::code) + map.count(gb::byte_kind::operand);
+    std::cout << map.instructions << " instructions (" << code << " bytes of " << cart.data.size() << "), "
+              << map.labels.size() << " labels, " << map.unresolved << " unresolved banked jumps, in "
+              << elapsed.count() << "ms" << std::endl;
+
+    return 0;
+}
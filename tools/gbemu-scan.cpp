@@ -0,0 +1,309 @@
+// gbemu-scan indexes a library of ROMs, see rom_index.hpp.
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <span>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <cxxopts.hpp>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define GB_HAVE_MMAP 1
+#endif
+
+#include "cartridge.hpp"
+#include "hash.hpp"
+#include "rom_index.hpp"
+
+namespace fs = std::filesystem;
+
+std::error_code scan_rom(const fs::path& path, gb::rom_entry& out);
+
+// walker hands the directories still to be listed out to a pool of threads
+class walker
+{
+public:
+    explicit walker(fs::path root)
+        : pending{std::move(root)}
+        , listing{0}
+    {}
+
+    // next waits for a directory to list, returning false once there are none left and none being listed
+    bool next(fs::path& dir)
+    {
+        std::unique_lock guard{lock};
+        changed.wait(guard, [&] { return !pending.empty() || listing == 0; });
+        if (pending.empty()) return false;
+
+        dir = std::move(pending.back());
+        pending.pop_back();
+        ++listing;
+        return true;
+    }
+
+    void push(fs::path dir)
+    {
+        {
+            std::lock_guard guard{lock};
+            pending.push_back(std::move(dir));
+        }
+        changed.notify_one();
+    }
+
+    // done is called when a directory from next has been listed
+    void done()
+    {
+        std::lock_guard guard{lock};
+        if (--listing == 0 && pending.empty()) changed.notify_all();
+    }
+
+private:
+    std::mutex              lock;
+    std::condition_variable changed;
+    std::vector<fs::path>   pending;
+    size_t                  listing;
+};
+
+static bool is_rom(const fs::path& path)
+{
+    auto ext = path.extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return std::tolower(c); });
+
+    return ext == ".gb" || ext == ".gbc" || ext == ".cgb" || ext == ".sgb";
+}
+
+// scan_directories lists directories from walk until there are none left, scanning every ROM in them into found
+static void scan_directories(walker& walk, bool verbose, std::mutex& output, std::vector<gb::rom_entry>& found)
+{
+    fs::path dir;
+    while (walk.next(dir))
+    {
+        std::error_code err;
+        for (fs::directory_iterator it{dir, fs::directory_options::skip_permission_denied, err}, end;
+             !err && it != end;
+             it.increment(err))
+        {
+            const auto&     entry = *it;
+            std::error_code ignored;
+
+            if (entry.is_directory(ignored) && !entry.is_symlink(ignored))
+            {
+                walk.push(entry.path());
+                continue;
+            }
+
+            if (!entry.is_regular_file(ignored) || !is_rom(entry.path())) continue;
+
+            gb::rom_entry rom;
+            if (auto scanned = scan_rom(entry.path(), rom); scanned)
+            {
+                std::lock_guard guard{output};
+                std::cerr << "unable to read " << std::quoted(entry.path().string()) << ": " << scanned.message()
+                          << std::endl;
+                continue;
+            }
+
+            if (verbose)
+            {
+                std::lock_guard guard{output};
+                std::cout << std::hex << std::setw(16) << std::setfill('0') << rom.content_hash << std::dec << ' '
+                          << std::quoted(rom.title) << ' ' << rom.path << std::endl;
+            }
+
+            found.push_back(std::move(rom));
+        }
+
+        if (err)
+        {
+            std::lock_guard guard{output};
+            std::cerr << "unable to list " << std::quoted(dir.string()) << ": " << err.message() << std::endl;
+        }
+
+        walk.done();
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    cxxopts::Options options("gbemu-scan", "Index a library of Gameboy ROMs");
+
+    // clang-format off
+    options
+        .set_tab_expansion()
+        .show_positional_help()
+        .add_options()
+            ("directory", "Directory to scan, recursively.", cxxopts::value<std::string>())
+            ("o,output", "Index file to write.", cxxopts::value<std::string>()->default_value("roms.idx"))
+            ("j,jobs", "Number of threads to scan with. 0 uses one per core.", cxxopts::value<unsigned>()->default_value("0"))
+            ("find", "Look a ROM up in the index given by --output instead of scanning.", cxxopts::value<std::string>())
+            ("v,verbose", "List every ROM scanned.", cxxopts::value<bool>())
+            ("h,help", "Show help", cxxopts::value<bool>())
+        ;
+    // clang-format on
+
+    options.parse_positional({"directory"});
+    const auto results = options.parse(argc, argv);
+
+    if (results.count("help") != 0 || (results.count("directory") == 0 && results.count("find") == 0))
+    {
+        std::cout << options.help() << std::endl;
+        return results.count("help") != 0 ? 0 : 1;
+    }
+
+    const fs::path index_file = results["output"].as<std::string>();
+
+    if (results.count("find") != 0)
+    {
+        const fs::path rom_file = results["find"].as<std::string>();
+
+        gb::rom_index index;
+        if (auto err = gb::load_index(index_file, index); err)
+        {
+            std::cerr << "unable to load " << std::quoted(index_file.string()) << ": " << err.message() << std::endl;
+            return 1;
+        }
+
+        gb::rom_entry rom;
+        if (auto err = scan_rom(rom_file, rom); err)
+        {
+            std::cerr << "unable to read " << std::quoted(rom_file.string()) << ": " << err.message() << std::endl;
+            return 1;
+        }
+
+        const auto found = index.find(rom.content_hash);
+        if (!found)
+        {
+            std::cout << std::quoted(rom_file.string()) << " is not in the index" << std::endl;
+            return 1;
+        }
+
+        std::cout << std::quoted(found->title) << " at " << std::quoted(found->path) << std::hex << ", type 0x"
+                  << static_cast<int>(found->cartridge_type) << std::dec << ", " << found->rom_size << " bytes ROM, "
+                  << found->ram_size << " bytes RAM" << std::endl;
+        return 0;
+    }
+
+    unsigned jobs = results["jobs"].as<unsigned>();
+    if (jobs == 0) jobs = std::max(1U, std::thread::hardware_concurrency());
+
+    const bool verbose = results["verbose"].as<bool>();
+    const auto start   = std::chrono::steady_clock::now();
+
+    walker                                  walk{results["directory"].as<std::string>()};
+    std::vector<std::vector<gb::rom_entry>> found(jobs);
+    std::mutex                              output;
+
+    {
+        std::vector<std::jthread> threads;
+        for (unsigned i = 0; i < jobs; ++i)
+        {
+            threads.emplace_back([&, i] { scan_directories(walk, verbose, output, found[i]); });
+        }
+    }
+
+    std::vector<gb::rom_entry> roms;
+    for (auto& part : found) std::move(part.begin(), part.end(), std::back_inserter(roms));
+
+    if (auto err = gb::save_index(index_file, roms); err)
+    {
+        std::cerr << "unable to save " << std::quoted(index_file.string()) << ": " << err.message() << std::endl;
+        return 1;
+    }
+
+    uint64_t bytes = 0;
+    size_t   bad   = 0;
+    for (const auto& rom : roms)
+    {
+        bytes += rom.rom_size;
+        if (!rom.global_checksum_valid) ++bad;
+    }
+
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << "indexed " << roms.size() << " ROMs (" << (bytes >> 20U) << " MiB) in " << elapsed.count() << "s, "
+              << bad << " with a bad global checksum" << std::endl;
+
+    return 0;
+}
+
+// scan_rom reads the header, checksums and hash of the ROM at path
+std::error_code scan_rom(const fs::path& path, gb::rom_entry& out)
+{
+#ifdef GB_HAVE_MMAP
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return {errno, std::generic_category()};
+
+    struct stat info{};
+    if (::fstat(fd, &info) != 0)
+    {
+        std::error_code err{errno, std::generic_category()};
+        ::close(fd);
+        return err;
+    }
+
+    const auto size = static_cast<size_t>(info.st_size);
+    if (size < 0x150 || size > UINT32_MAX)
+    {
+        ::close(fd);
+        return std::make_error_code(std::errc::invalid_argument);
+    }
+
+    void*           base = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    std::error_code err  = base == MAP_FAILED ? std::error_code{errno, std::generic_category()} : std::error_code{};
+    ::close(fd);
+    if (err) return err;
+
+    ::madvise(base, size, MADV_SEQUENTIAL);
+    const std::span<const uint8_t> rom{static_cast<const uint8_t*>(base), size};
+#else
+    std::error_code err;
+    const auto      size = fs::file_size(path, err);
+    if (err) return err;
+    if (size < 0x150 || size > UINT32_MAX) return std::make_error_code(std::errc::invalid_argument);
+
+    std::vector<uint8_t> contents(size);
+    std::FILE*           file = std::fopen(path.string().c_str(), "rb");
+    if (file == nullptr) return {errno, std::generic_category()};
+
+    const size_t actual = std::fread(contents.data(), 1, contents.size(), file);
+    std::fclose(file);
+    if (actual != contents.size()) return std::make_error_code(std::errc::io_error);
+
+    const std::span<const uint8_t> rom{contents};
+#endif
+
+    // only the header is copied, the rest is read straight from the mapping
+    gb::cartridge header;
+    header.data.assign(rom.begin(), rom.begin() + 0x150);
+
+    out.content_hash          = gb::hash::hash64(rom);
+    out.path                  = path.string();
+    out.title                 = header.title();
+    out.rom_size              = static_cast<uint32_t>(size);
+    out.ram_size              = static_cast<uint32_t>(header.ram_size());
+    out.cartridge_type        = header.data[0x147];
+    out.color                 = header.color_flag();
+    out.global_checksum       = gb::cartridge::global_checksum(rom);
+    out.header_checksum_valid = header.header_checksum_valid(nullptr);
+    out.global_checksum_valid = out.global_checksum == ((rom[0x14E] << 8U) | rom[0x14F]);
+
+#ifdef GB_HAVE_MMAP
+    ::munmap(base, size);
+#endif
+
+    return {};
+}